@@ -33,6 +33,8 @@
 
 __BEGIN_YAFRAY
 
+struct surfacePoint_t;
+
 class YAFRAYCORE_EXPORT camera_t
 {
 	public:
@@ -45,6 +47,14 @@ class YAFRAYCORE_EXPORT camera_t
 		/*! indicate whether the lense need to be sampled (u, v parameters of shootRay), i.e.
 			DOF-like effects. When false, no lense samples need to be computed */
 		virtual bool sampleLense() const = 0;
+		/*! indicate whether the camera knows the surface point of each film position in advance
+			(e.g. lightmap texels), so the integrator can skip intersecting the primary ray */
+		virtual bool surfaceSamples() const { return false; }
+		/*! get the surface point seen at film position (px, py) together with the primary ray
+			leading to it. Only called when surfaceSamples() is true.
+			\return false if no surface maps to that position */
+		virtual bool sampleSurface(PFLOAT px, PFLOAT py, surfacePoint_t &sp, ray_t &ray, PFLOAT &wt) const
+			{ return false; }
 };
 
 
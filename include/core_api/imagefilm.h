@@ -59,6 +59,13 @@ class YAFRAYCORE_EXPORT imageFilm_t
 		bool doMoreSamples(int x, int y) const;
 		/*! output all pixels to the color output */
 		void flush(int flags=IF_ALL, colorOutput_t *out=0);
+		/*! get the final RGBA value of pixel (x,y) as flush() outputs it, i.e. normalized and gamma corrected */
+		void getPixel(int x, int y, float *rgba, int flags=IF_ALL) const;
+		/*! read the image into rgba (w*h RGBA floats, row by row) the way flush() would output it, but without
+			drawing the render settings or touching any color output. Not available for a streaming film. */
+		void readImage(float *rgba, int flags=IF_ALL) const;
+		/*! read channel chan into buf (w*h floats, row by row), averaged like getChanPixel() */
+		void readChannel(int chan, float *buf) const;
 		void setClamp(bool c){ clamp = c; }
 		/*! set and enable/disable gamma correction of output; when gammaVal is <= 0 the current value is kept */
 		void setGamma(float gammaVal, bool enable);
@@ -66,10 +73,41 @@ class YAFRAYCORE_EXPORT imageFilm_t
 		//! set number of samples for correct density estimation (if enabled)
 		void setNumSamples(int n){ numSamples = n; }
 		void setAAThreshold(CFLOAT thresh){ AA_thesh=thresh; }
+		/*! enable/disable variance driven adaptive AA: instead of comparing neighbour pixels, nextPass()
+			flags pixels whose own samples have a standard error of at least AA_thesh. Pixels that never
+			received a sample (e.g. lightmap texels not covered by any triangle) are never flagged, pixels
+			with a single sample (AA_samples 1) always are, their variance is not known yet. */
+		void setVarianceAA(bool enable);
+		/*! enable/disable per pixel sample statistics; required by variance AA and accumulating channels */
+		void keepSampleStats(bool enable);
 		void setInteractive(bool ia){ interactive = ia; }
+		/*! set a monitor that gets notified of every finished area; the film does not take ownership,
+			pass 0 to remove it again */
+		void setProgressBar(progressBar_t *pb){ pbar = pb; }
 		/*! add a custom channel to image film, with the label "name".
+			\param accumulate if true, the channel takes samples via addChanSample() and outputs their
+			average per pixel, otherwise values are simply set with setChanPixel()
 			\return number of channel used to specify channel when adding samples */
-		int addChannel(const std::string &name);
+		int addChannel(const std::string &name, bool accumulate=false);
+		/*! get the number of the channel with label "name", or -1 if there is no such channel */
+		int getChannel(const std::string &name) const;
+		/*! add a sample value to an accumulating channel; pixel (x,y) must lie inside the area of the calling thread */
+		void addChanSample(float val, int chan, int x, int y);
+		/*! get the final value of channel chan at pixel (x,y), i.e. the average for accumulating channels */
+		float getChanPixel(int chan, int x, int y) const;
+		/*! enable/disable streaming output for images too large to keep in memory: the film only holds a ring
+			of a few tile rows, and each tile row is passed to the output (followed by flushArea()) and its memory
+			reused as soon as it and the tile row below it, which still adds filter contributions, are finished.
+			Only the first AA pass can be rendered this way, and flush() merely finalizes the output.
+			Call before init(). */
+		void setStreaming(bool enable);
+		bool isStreaming() const { return streaming; }
+		/*! enable/disable deterministic accumulation: samples of a tile that fall on pixels of other
+			tiles are kept apart and added in tile order once the neighbour tiles are finished, so every
+			pixel sums its contributions in the same order however many threads render. Samples added
+			without an area are not covered. Call before init(). */
+		void setDeterministic(bool enable){ deterministic = enable; }
+		bool isDeterministic() const { return deterministic; }
 
 #if HAVE_FREETYPE
 		void drawRenderSettings();
@@ -87,9 +125,28 @@ class YAFRAYCORE_EXPORT imageFilm_t
 			colorA_t col;
 			CFLOAT weight;
 		};
+		struct sampleStat_t
+		{
+			float sum, sumSq; //!< sum and square sum of sample brightness
+			int n; //!< number of samples taken for this pixel
+		};
+		//! row of the pixel buffers that holds image row y (relative to cy0)
+		int ringRow(int y) const { return y & rowMask; }
+		//! pass the finished tile row to the output and clear its ring slot for reuse
+		void outputBand(int band);
+		//! index of the splitter tile a
+		int tileIndex(const renderArea_t &a) const;
+		//! buffer of the contributions of tile a to other tiles, allocated on first use
+		pixel_t* tileApron(const renderArea_t &a);
+		//! add the aprons of all tiles whose neighbours are finished, in tile order
+		void mergeFinishedTiles();
+		void clearAprons();
 		tiledArray2D_t<pixel_t, 3> *image;
 		tiledArray2D_t<color_t, 3> densityImage;
-		std::vector< tiledArray2D_t<float, 3> > channels; //!< storage for custom channels
+		tiledArray2D_t<sampleStat_t, 3> sampleStats; //!< per pixel sample statistics for variance AA and accumulating channels
+		std::vector< tiledArray2D_t<float, 3>* > channels; //!< storage for custom channels
+		std::vector<std::string> channelNames;
+		std::vector<bool> channelAccum; //!< indicates which custom channels accumulate samples
 		tiledBitArray2D_t<3> *flags; //!< flags for adaptive AA;
 		int w, h, cx0, cx1, cy0, cy1;
 		int area_cnt, completed_cnt;
@@ -102,7 +159,18 @@ class YAFRAYCORE_EXPORT imageFilm_t
 		yafthreads::mutex_t imageMutex, splitterMutex, outMutex, densityImageMutex;
 		bool clamp, split, interactive, abort, correctGamma;
 		bool estimateDensity;
+		bool varianceAA, sampleStatsOn;
+		bool streaming;
+		int bufH, rowMask; //!< height of the pixel buffers, and mask mapping image rows to buffer rows
+		int nBands, outBands; //!< number of tile rows, and number of tile rows already passed to the output
+		std::vector<int> bandDone; //!< finished tiles per tile row
+		yafthreads::conditionVar_t bandCV; //!< signalled whenever a tile row is passed to the output
 		int numSamples; //!< number of added samples; important for density estimation
+		bool deterministic;
+		std::vector<pixel_t*> aprons; //!< per tile, pixels around the tile up to the filter width
+		std::vector<char> tileDone; //!< finished tiles of the current pass
+		int apronW, nextMerge; //!< width of the apron border, and first tile whose apron is not added yet
+		int tilesX; //!< tiles per tile row
 		imageSpliter_t *splitter;
 		progressBar_t *pbar;
 		int _n_locked, _n_unlocked; //just debug crap...
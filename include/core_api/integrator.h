@@ -62,6 +62,10 @@ class YAFRAYCORE_EXPORT surfaceIntegrator_t: public integrator_t
 		virtual void cleanup() { };
 //		virtual bool setupSampler(sampler_t &sam);
 		virtual colorA_t integrate(renderState_t &state, diffRay_t &ray/*, sampler_t &sam*/) const = 0;
+		/*! integrate a primary ray whose surface hit sp is already known (see camera_t::sampleSurface).
+			The default just traces the ray again, integrators should override this to skip the intersection */
+		virtual colorA_t integrateSurface(renderState_t &state, diffRay_t &ray, const surfacePoint_t &sp) const
+			{ return integrate(state, ray); }
 	protected:
 		surfaceIntegrator_t(){}; //don't use...
 };
@@ -73,6 +77,9 @@ class YAFRAYCORE_EXPORT volumeIntegrator_t: public integrator_t
 		virtual colorA_t transmittance(renderState_t &state, ray_t &ray) const = 0;
 		virtual colorA_t integrate(renderState_t &state, ray_t &ray) const = 0;
 		virtual bool preprocess() { return true; };
+		/*! true if the integrator only renders the volume regions of the scene, i.e. has no effect
+			without them; scene_t then skips it altogether (see scene_t::volumeEffects()) */
+		virtual bool regionsOnly() const { return false; }
 	
 	protected:
 };
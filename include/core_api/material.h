@@ -61,7 +61,7 @@ struct pSample_t: public sample_t
 class YAFRAYCORE_EXPORT material_t
 {
 	public:
-		material_t(): bsdfFlags(BSDF_NONE), reqMem(0), volI(0), volO(0) {}
+		material_t(): bsdfFlags(BSDF_NONE), reqMem(0), volI(0), volO(0), constDiffuse(false), diffuseAlbedo(0.f) {}
 		virtual ~material_t() {}
 		
 		/*! Initialize the BSDF of a material. You must call this with the current surface point
@@ -130,6 +130,18 @@ class YAFRAYCORE_EXPORT material_t
 			most materials unless there's a less expensive way or smarter scattering approach */
 		virtual bool scatterPhoton(const renderState_t &state, const surfacePoint_t &sp, const vector3d_t &wi, vector3d_t &wo, pSample_t &s) const;
 		
+		/*! true for plain Lambertian reflectors of constant color: no textures, shader nodes or bump mapping,
+			no specular, glossy or transmitting components. Photon tracing and final gathering then use the
+			...ConstDiffuse() functions below, which need neither initBSDF() nor userdata */
+		bool isConstantDiffuse() const { return constDiffuse; }
+		//! the reflectance of a constant diffuse material (i.e. what eval() returns for directions on the same side)
+		const color_t& getDiffuseAlbedo() const { return diffuseAlbedo; }
+		inline color_t evalConstDiffuse(const surfacePoint_t &sp, const vector3d_t &wo, const vector3d_t &wl, BSDF_t types)const;
+		inline color_t sampleConstDiffuse(const surfacePoint_t &sp, const vector3d_t &wo, vector3d_t &wi, sample_t &s)const;
+		inline float pdfConstDiffuse(const surfacePoint_t &sp, const vector3d_t &wo, const vector3d_t &wi, BSDF_t bsdfs)const;
+		//! scatterPhoton() of a constant diffuse material
+		bool scatterPhotonConstDiffuse(const surfacePoint_t &sp, const vector3d_t &wi, vector3d_t &wo, pSample_t &s) const;
+		
 		BSDF_t getFlags() const { return bsdfFlags; }
 		/*! Materials may have to do surface point specific (pre-)calculation that need extra storage.
 			returns the required amount of "userdata" memory for all the functions that require a render state */
@@ -143,8 +155,45 @@ class YAFRAYCORE_EXPORT material_t
 		size_t reqMem; //!< the amount of "temporary" memory required to compute/store surface point specific data
 		volumeHandler_t* volI; //!< volumetric handler for space inside material (opposed to surface normal)
 		volumeHandler_t* volO; //!< volumetric handler for space outside ofmaterial (where surface normal points to)
+		bool constDiffuse; //!< set by materials that qualify for isConstantDiffuse()
+		color_t diffuseAlbedo;
 };
 
+inline color_t material_t::evalConstDiffuse(const surfacePoint_t &sp, const vector3d_t &wo, const vector3d_t &wl, BSDF_t types)const
+{
+	if(!(types & BSDF_DIFFUSE)) return color_t(0.f);
+	PFLOAT cos_Ng_wo = sp.Ng*wo;
+	if(cos_Ng_wo * (sp.Ng*wl) < 0) return color_t(0.f); // no transmission
+	vector3d_t N = (cos_Ng_wo<0) ? -sp.N : sp.N;
+	if(N*wl <= 0.0) return color_t(0.f);
+	return diffuseAlbedo;
+}
+
+inline color_t material_t::sampleConstDiffuse(const surfacePoint_t &sp, const vector3d_t &wo, vector3d_t &wi, sample_t &s)const
+{
+	if((s.flags & (BSDF_DIFFUSE | BSDF_REFLECT)) != (BSDF_DIFFUSE | BSDF_REFLECT))
+	{
+		s.sampledFlags = BSDF_NONE;
+		s.pdf = 0.f;
+		return color_t(1.f);
+	}
+	PFLOAT cos_Ng_wo = sp.Ng*wo;
+	vector3d_t N = (cos_Ng_wo<0) ? -sp.N : sp.N;
+	wi = SampleCosHemisphere(N, sp.NU, sp.NV, s.s1, s.s2);
+	s.pdf = std::fabs(wi*N);
+	s.sampledFlags = BSDF_DIFFUSE | BSDF_REFLECT;
+	return (cos_Ng_wo * (sp.Ng*wi) > 0) ? diffuseAlbedo : color_t(0.f);
+}
+
+inline float material_t::pdfConstDiffuse(const surfacePoint_t &sp, const vector3d_t &wo, const vector3d_t &wi, BSDF_t bsdfs)const
+{
+	if((bsdfs & (BSDF_DIFFUSE | BSDF_REFLECT)) != (BSDF_DIFFUSE | BSDF_REFLECT)) return 0.f;
+	PFLOAT cos_Ng_wo = sp.Ng*wo;
+	if(cos_Ng_wo * (sp.Ng*wi) <= 0) return 0.f;
+	vector3d_t N = (cos_Ng_wo<0) ? -sp.N : sp.N;
+	return std::fabs(wi*N);
+}
+
 	
 
 __END_YAFRAY
@@ -4,32 +4,60 @@
 
 #include<yafray_config.h>
 
-#include "imagesplitter.h"
 #include <vector>
+#include <utility>
 
 __BEGIN_YAFRAY
 
+/*	Batch versions of the scalar sequences in mcqmc.h and scr_halton.h, for consecutive indices
+	start...start+n-1. They return exactly what the scalar functions return for each index, but
+	step from one index to the next instead of decomposing every index again: the base 2 sequences
+	flip the bits that change between i and i+1, scrambled Halton counts its digits up and takes
+	the digit products from a table. */
 
-class sampler_t
+//! scrHalton(dim, start+i) for i < n
+YAFRAYCORE_EXPORT void scrHaltonBatch(int dim, unsigned int start, int n, double *out);
+//! RI_vdC(start+i, r) for i < n
+YAFRAYCORE_EXPORT void RI_vdCBatch(unsigned int start, int n, double *out, unsigned int r=0);
+//! RI_S(start+i, r) for i < n
+YAFRAYCORE_EXPORT void RI_SBatch(unsigned int start, int n, double *out, unsigned int r=0);
+//! RI_LP(start+i, r) for i < n
+YAFRAYCORE_EXPORT void RI_LPBatch(unsigned int start, int n, double *out, unsigned int r=0);
+
+enum qmcSequence_t
+{
+	QMC_VDC = 0,	//!< RI_vdC, parameter is the scramble value
+	QMC_SOBOL,		//!< RI_S, parameter is the scramble value
+	QMC_LP,			//!< RI_LP, parameter is the scramble value
+	QMC_HALTON		//!< scrHalton, parameter is the dimension (at most 50)
+};
+
+/*! holds the samples of several dimensions for a run of consecutive sample indices, e.g. all
+	paths of one final gather point. Register the dimensions once, then generate() a run and read
+	the values; get() of sample i is what the scalar function gives for index start+i.
+*/
+class YAFRAYCORE_EXPORT sampler_t
 {
 	public:
-	sampler_t(int width, int height);
+	sampler_t(): first(0), size(0) {}
 	/*! add dimension to the sampler
-		\return reached dimension, needed to request the samples */
-	int addDimension(int max_samples);
-	/*! set the image area to generate samples for; remember that each thread
-		has its own sampler instance, which gets assigned image areas this way
-		until the whole image has been rendered.
-	*/
-	bool setArea(const renderArea_t &a);
-	//! get the next value in the sequence for dimension
-	float getNext(unsigned int dimension);
-//	bool getSample(sample_t &s);
+		\return index of the dimension, needed to request the samples */
+	int addDimension(qmcSequence_t seq, unsigned int param=0);
+	//! compute the samples start...start+n-1 of all dimensions
+	void generate(unsigned int start, int n);
+	//! sample start+i of dimension d
+	double get(int d, int i) const { return values[d*size + i]; }
+	//! true if index lies in the last generated run
+	bool contains(unsigned int index) const { return index >= first && index - first < (unsigned int)size; }
+	unsigned int start() const { return first; }
+	int samples() const { return size; }
+	int dimensions() const { return (int)dims.size(); }
 	protected:
-	std::vector<sequence_t> dim; //!< strore the sequences for each dimension
-}
-
-
+	std::vector< std::pair<qmcSequence_t, unsigned int> > dims;
+	std::vector<double> values; //!< size values per dimension
+	unsigned int first;
+	int size;
+};
 
 __END_YAFRAY
 
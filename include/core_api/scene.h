@@ -8,6 +8,7 @@
 #include"vector3d.h"
 #include <core_api/volume.h>
 #include <yafraycore/ccthreads.h>
+#include <yafraycore/renderstats.h>
 #include <vector>
 
 
@@ -38,6 +39,7 @@ class imageFilm_t;
 class renderArea_t;
 class random_t;
 class vmap_t;
+class diffRay_t;
 
 typedef unsigned int objID_t;
 
@@ -49,9 +51,9 @@ typedef unsigned int objID_t;
 struct YAFRAYCORE_EXPORT renderState_t
 {
 	renderState_t():raylevel(0), currentPass(0), pixelSample(0), rayDivision(1), rayOffset(0), dc1(0), dc2(0),
-		traveled(0.0), chromatic(true), includeLights(false), userdata(0), lightdata(0), prng(0) {};
+		traveled(0.0), chromatic(true), includeLights(false), userdata(0), lightdata(0), cameraRay(0), coneRay(0), coneSpread(0.0), stats(0), prng(0) {};
 	renderState_t(random_t *rand):raylevel(0), currentPass(0), pixelSample(0), rayDivision(1), rayOffset(0), dc1(0), dc2(0),
-		traveled(0.0), chromatic(true), includeLights(false), userdata(0), lightdata(0), prng(rand) {};
+		traveled(0.0), chromatic(true), includeLights(false), userdata(0), lightdata(0), cameraRay(0), coneRay(0), coneSpread(0.0), stats(0), prng(rand) {};
 	~renderState_t(){};
 
 	int raylevel;
@@ -74,8 +76,14 @@ struct YAFRAYCORE_EXPORT renderState_t
 	PFLOAT time; //!< the current (normalized) frame time
 	mutable void *userdata; //!< a fixed amount of memory where materials may keep data to avoid recalculations...really need better memory management :(
 	void *lightdata; //!< reserved; non-dirac lights may do some surface-point dependant initializations in the future to reduce redundancy...
+	const diffRay_t *cameraRay; //!< the primary ray, if any; its differentials give texture footprints at raylevel 0
+	const ray_t *coneRay; //!< the secondary ray (e.g. of a final gather path) being shaded, if any; see coneSpread
+	PFLOAT coneSpread; //!< angle of the cone around coneRay; the texture footprint at its hit is coneSpread times the hit distance
+	threadStats_t *stats; //!< counters of the render thread, may be null
 	random_t *const prng; //!< a pseudorandom number generator
 	
+	void count(renderCounter_t c, double n=1.0) const { if(stats) stats->count[c] += n; }
+	
 	//! set some initial values that are always the same before integrating a primary ray
 	void setDefaults()
 	{
@@ -85,9 +93,10 @@ struct YAFRAYCORE_EXPORT renderState_t
 		rayOffset = 0;
 		dc1 = dc2 = 0.f;
 		traveled = 0;
+		coneRay = 0;
 	}
 //	protected:
-	explicit renderState_t(const renderState_t &r):prng(r.prng) {}//forbiden
+	explicit renderState_t(const renderState_t &r):stats(r.stats), prng(r.prng) {}//forbiden
 };
 
 __END_YAFRAY
@@ -169,7 +178,10 @@ class YAFRAYCORE_EXPORT scene_t
 		bool addLight(light_t *l);
 		bool addMaterial(material_t *m, const char* name);
 		bool addObject(object3d_t *obj, objID_t &id);
-		void addVolumeRegion(VolumeRegion* vr) { volumes.push_back(vr); }
+		void addVolumeRegion(VolumeRegion* vr) { volumes.push_back(vr); lightsChanged(); }
+		/*! give the lights and volumes a new version; addLight() and addVolumeRegion() do it, call it after
+			changing lights or volumes in place */
+		void lightsChanged();
 		void setCamera(camera_t *cam);
 		void setImageFilm(imageFilm_t *film);
 		void setBackground(background_t *bg);
@@ -177,6 +189,8 @@ class YAFRAYCORE_EXPORT scene_t
 		void setVolIntegrator(volumeIntegrator_t *v);
 		void setAntialiasing(int numSamples, int numPasses, int incSamples, double threshold);
 		void setNumThreads(int threads){ nthreads=threads; }
+		//! key of all random number streams of the render, bakes with the same seed are identical
+		void setSeed(unsigned int s){ seed=s; }
 		void setMode(int m){ mode = m; }
 		void depthChannel(bool enable){ do_depth=enable; }
 
@@ -187,15 +201,23 @@ class YAFRAYCORE_EXPORT scene_t
 		background_t* getBackground() const;
 		triangleObject_t* getMesh(objID_t id) const;
 		object3d_t* getObject(objID_t id) const;
-		std::vector<VolumeRegion*> getVolumes() const { return volumes; }
+		const std::vector<VolumeRegion*>& getVolumes() const { return volumes; }
+		//! false if the volume integrator has nothing to do, resolved by update()
+		bool volumeEffects() const { return doVolumes; }
 		const camera_t* getCamera() const { return camera; }
 		imageFilm_t* getImageFilm() const { return imageFilm; }
 		bound_t getSceneBound() const;
 		int getNumThreads() const { return nthreads; }
+		unsigned int getSeed() const { return seed; }
 		int getSignals() const;
 		//! only for backward compatibility!
 		void getAAParameters(int &samples, int &passes, int &inc_samples, CFLOAT &threshold) const;
 		bool doDepth() const { return do_depth; }
+		//! counters of the last (or the running) render
+		renderStats_t& getStats() const { return stats; }
+		/*! version of the lights and volumes, unique over all scenes, so data derived from them can be
+			cached by version rather than by address (which a new light may reuse) */
+		unsigned int getLightsVersion() const { return lightsVersion; }
 
         // EclipseRay specific:
         // Gets the current light layer. WARNING: Make sure you assign this to
@@ -203,6 +225,8 @@ class YAFRAYCORE_EXPORT scene_t
         std::vector<light_t*>& getCurrentLightLayer(){ return lights[currentLightLayer]; };
 		
 		bool intersect(const ray_t &ray, surfacePoint_t &sp) const;
+		//! same as above, counted in the render statistics of state
+		bool intersect(const renderState_t &state, const ray_t &ray, surfacePoint_t &sp) const;
 		bool isShadowed(renderState_t &state, const ray_t &ray) const;
 		bool isShadowed(renderState_t &state, const ray_t &ray, int maxDepth, color_t &filt) const;
 		
@@ -214,6 +238,7 @@ class YAFRAYCORE_EXPORT scene_t
         volumeIntegrator_t *volIntegrator;
 		
 	protected:
+		bool intersect(const ray_t &ray, surfacePoint_t &sp, threadStats_t *counters) const;
 		
 		struct objData_t
 		{
@@ -252,10 +277,14 @@ class YAFRAYCORE_EXPORT scene_t
 		int AA_inc_samples; //!< sample count for additional passes
 		CFLOAT AA_threshold; 
 		int nthreads;
+		unsigned int seed;
 		int mode; //!< sets the scene mode (triangle-only, virtual primitives)
 		bool do_depth;
+		bool doVolumes;
 		int signals;
+		unsigned int lightsVersion;
 		mutable yafthreads::mutex_t sig_mutex;
+		mutable renderStats_t stats;
 
         // Begin: EclipseRay specific
     private:
@@ -46,6 +46,37 @@ class YAFRAYCORE_EXPORT nodeFinder_t
 
 enum mix_modes{ MN_MIX=0, MN_ADD, MN_MULT, MN_SUB, MN_SCREEN, MN_DIV, MN_DIFF, MN_DARK, MN_LIGHT, MN_OVERLAY };
 
+// texture layer flags
+#define TXF_RGBTOINT    1
+#define TXF_STENCIL     2
+#define TXF_NEGATIVE    4
+#define TXF_ALPHAMIX    8
+
+//! settings of a texture layer node, see layerNodeResult() in yafraycore/nodeops.h
+struct layerParams_t
+{
+	unsigned int texflag;
+	mix_modes mode;
+	CFLOAT colfac, valfac, default_val;
+	colorA_t default_col;
+	bool do_color, do_scalar, color_input, use_alpha;
+};
+
+/*! a shader node translated to one step of a flat node program (see nodeProgram_t).
+	Inputs refer to stack indices, an input of -1 uses col[]/val[] of the same slot instead */
+struct nodeInstr_t
+{
+	enum opcode_e { OP_CALL=0, OP_MIX, OP_LAYER };
+	int op;
+	unsigned int out; //!< stack index of the result
+	int in[3]; //!< mix: input1, input2, factor; layer: input, upper layer
+	colorA_t col[3];
+	CFLOAT val[3];
+	mix_modes mode; //!< OP_MIX only
+	layerParams_t layer; //!< OP_LAYER only
+	const shaderNode_t *node; //!< OP_CALL only, the node is evaluated through eval()
+};
+
 /*!	shader nodes are as the name implies elements of a node based shading tree.
 	Note that a "shader" only associates a color or scalar with a surface point,
 	nothing more and nothing less. The material behaviour is implemented in the
@@ -68,6 +99,13 @@ class YAFRAYCORE_EXPORT shaderNode_t
 			{stack[this->ID] = nodeResult_t(colorA_t(0.f), 0.f);}
 		/*! indicate whether the shader value depends on wi and wo */
 		virtual bool isViewDependant() const { return false; }
+		/*! indicate whether the shader value depends on anything else than the node inputs and parameters
+			(textures, surface point, render state). If not, nodes with only constant inputs are evaluated once
+			when the material is compiled, with dummy state and surface point */
+		virtual bool isPointDependant() const { return true; }
+		/*! translate the node to an instruction of a node program; called after node IDs have been assigned.
+			Returning false (the default) makes the program call eval() on the node */
+		virtual bool compile(nodeInstr_t &instr) const { return false; }
 		/*! configure the inputs. gets the same paramMap the factory functions get, but shader nodes
 			may be created in any order and linked afterwards, so inputs may not exist yet on instantiation */
 		virtual bool configInputs(const paraMap_t &params, const nodeFinder_t &find) = 0;
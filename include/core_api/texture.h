@@ -3,6 +3,7 @@
 
 #include <yafray_config.h>
 #include "surface.h"
+#include <string>
 
 __BEGIN_YAFRAY
 
@@ -18,8 +19,15 @@ class YAFRAYCORE_EXPORT texture_t
 		virtual colorA_t getColor(int x, int y, int z) const { return colorA_t(0.f); }
 		virtual CFLOAT getFloat(const point3d_t &p) const { return getColor(p).energy(); }
 		virtual CFLOAT getFloat(int x, int y, int z) const { return getColor(x, y, z).energy(); }
+		/* prefiltered lookup; width is the size of the lookup footprint in texture space, where 1 covers
+		   the whole texture. Textures without prefiltering simply ignore it */
+		virtual colorA_t getColorFiltered(const point3d_t &p, PFLOAT width) const { return getColor(p); }
+		virtual CFLOAT getFloatFiltered(const point3d_t &p, PFLOAT width) const { return getFloat(p); }
 		/* gives the number of values in each dimension for discrete textures */
 		virtual void resolution(int &x, int &y, int &z) const { x=0, y=0, z=0; }
+		/* identifies what the texture shows (source file and mapping settings), so data derived from it
+		   can be shared between textures. Empty means no stable identity, such data must not be shared */
+		virtual std::string sourceKey() const { return std::string(); }
 		virtual ~texture_t() {}
 };
 
@@ -106,6 +106,8 @@ public:
     virtual int resX() const { return m_nFilmWidth;  }
     virtual int resY() const { return m_nFilmHeight; }
     virtual bool sampleLense() const {return false; }
+    virtual bool surfaceSamples() const { return true; }
+    virtual bool sampleSurface( YRPFloat px, YRPFloat py, YRSurfacePoint &sp, YRRay &ray, YRPFloat &wt ) const;
     Mesh* GetMesh() { return m_pMesh; }
 
     // -------------------------------------------------------------------------
@@ -132,7 +134,7 @@ public:
         float           BMatrix[4];         // Barycentric matrix
         int             Points[3];          // Indexes for the actual points inside the trimesh
         YRuv            UV;                 // UV for one point, in film space
-        YRVector3D      Normal;             // Known normal for this triangle
+        YRVector3D      Normal;             // Known (geometric) normal for this triangle
     };
 
 
@@ -166,10 +168,15 @@ private:
     // Inserts the provided edge into our slab list
     void InsertEdge( int a_nTriangleIndex, int a_nP1, int a_nP2, YRuv a_uv1, YRuv a_uv2, YRuv& a_corner );
 
-    // Queries for the position of a point/normal in the mesh, given its uv coords.
+    // Queries for the position of a point/normal in the mesh, given its uv coords. The normal is the
+    // geometric one, smooth shading normals are interpolated by the triangle itself (getSurface).
     // Returns false if no face is intersected by the provided uv coordinates.
     bool QueryMap( YRPFloat a_fU, YRPFloat a_fV, YRPoint3D& a_vPoint, YRVector3D& a_vNormal ) const;
 
+    // Finds the triangle (index into m_triangles) covering the provided uv coords, and the
+    // barycentric weights of its three points. Returns false if no face is intersected.
+    bool FindTriangle( YRPFloat a_fU, YRPFloat a_fV, int& a_nTriangle, float a_fBarycentric[3] ) const;
+
     std::vector<sSlab>      m_slabs;            ///< List of slabs in our uv map
     std::vector<sTriangle>  m_triangles;        ///< List of triangles, 1-to-1 correspondance to the trimesh
     int                     m_nFilmWidth;       ///< Film width in pixels
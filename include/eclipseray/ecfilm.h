@@ -37,6 +37,10 @@
 #include <eclipseray/eclipse.h>
 #include <eclipseray/yrtypes.h>
 
+#include <yafraycore/ccthreads.h>
+
+#include <vector>
+
 ////////////////////////////////////////////////////////////////////////////
 //
 /// \class Film
@@ -54,6 +58,8 @@
 /// add support for the other, if necessary.
 //
 ////////////////////////////////////////////////////////////////////////////
+class FilmPixels;
+
 class Film : public EclipseObject
 {
     DECLARE_PYTHON_HEADER;
@@ -74,6 +80,15 @@ public:
         FilterType_Gauss
     };
 
+    /*!
+     *  Defines the pixel formats in which film contents can be read back
+     */
+    enum ePixelFormat
+    {
+        PixelFormat_Float32,    ///< One 32 bit float per component, no clamping
+        PixelFormat_UInt8       ///< One byte per component, clamped to 0-1 (packed RGBA8 for color)
+    };
+
     /*!
      *	Construction
      *  @param a_sOutputName Name of the image file to contain the film output, with extension.
@@ -84,9 +99,20 @@ public:
      *  @param a_fGamma Film gamma correction
      *  @param a_bHasDepth If true, add depth channel to the film
      *  @param a_bClampRGB If true, clamp rgb values to 0-1
+     *  @param a_bTexelRefinement If true, additional AA passes only resample covered texels
+     *         whose own sample variance exceeds the AA threshold, or that got only one
+     *         sample so far
+     *  @param a_bStreamTiles If true, finished tile rows are written to the output file while
+     *         rendering and then dropped, for atlases too large to keep in memory. Such a film
+     *         renders a single AA pass and can not be read back.
+     *  @param a_bDeterministic If true, the film adds up the samples in the same order whatever
+     *         the number of threads, so the lightmap bits only depend on the scene and its seed
+     *  @param a_bSaveAlpha If true, the output file gets an alpha channel (32 bit tga)
      */
 	Film( const char* a_sID, int a_nWidth, int a_nHeight, eFilmFilterType a_nFilterType, 
-        float a_fFilterSize, float a_fGamma, bool a_bHasDepth, bool a_bClamp );
+        float a_fFilterSize, float a_fGamma, bool a_bHasDepth, bool a_bClamp,
+        bool a_bTexelRefinement = false, bool a_bStreamTiles = false, bool a_bDeterministic = false,
+        bool a_bSaveAlpha = false );
 
     /*!
      *	Provides access to our film object
@@ -106,6 +132,30 @@ public:
      */
     inline int GetHeight() const { return m_nHeight; }
 
+    /*!
+     *	Reads back the rendered image, as the film output would see it (gamma, clamping)
+     *  @param a_nFormat Format for the returned pixels
+     *  @return A new RGBA pixel block, NULL if the film is invalid
+     */
+    FilmPixels* ReadPixels( ePixelFormat a_nFormat );
+
+    /*!
+     *	Reads back one of the film's extra channels, e.g. Depth or a light mask
+     *  @param a_sChannel Name of the channel
+     *  @param a_nFormat Format for the returned pixels
+     *  @return A new single component pixel block, NULL if there is no such channel
+     */
+    FilmPixels* ReadChannel( const char* a_sChannel, ePixelFormat a_nFormat );
+
+    /// Flags the film as being rendered into. Returns false if it already was
+    bool BeginRender();
+
+    /// Clears the rendering flag
+    void EndRender();
+
+    /// True while a scene renders into this film, possibly on another thread
+    bool IsRendering() const;
+
     // -------------------------------------------------------------------------
     // Python stuff
     // -------------------------------------------------------------------------
@@ -130,6 +180,21 @@ public:
     */
     static void AppendFilmFilterTypes( PYOBJECT a_pPyModule );
 
+    /*!
+    *  Appends pixel format identifiers to the module of the provided dictionary
+    *  @param a_pPyModule A valid python module
+    */
+    static void AppendPixelFormats( PYOBJECT a_pPyModule );
+
+    // Saves one of the film's channels (e.g. a per-light mask) as a greyscale tga file
+    DECLARE_PYTHON_OBJECT_METHOD( Film, saveChannel );
+
+    // Returns the rendered RGBA pixels as a FilmPixels buffer object
+    DECLARE_PYTHON_OBJECT_METHOD( Film, pixels );
+
+    // Returns one of the film's channels as a FilmPixels buffer object
+    DECLARE_PYTHON_OBJECT_METHOD( Film, channelPixels );
+
 
 protected:
 
@@ -146,14 +211,119 @@ protected:
 
 private:
 
-    YRTga*              m_pOutput;      ///< Color output for this film object
+    YRColorOutput*      m_pOutput;      ///< Color output for this film object
     YRFilm*             m_pFilm;        ///< Our actual film
     char*               m_sOutputName;  ///< Name for the output file
     int                 m_nWidth;       ///< Film width
     int                 m_nHeight;      ///< Film height
+    bool                m_bRendering;   ///< True while a scene renders into us
+    mutable yafthreads::mutex_t m_renderMutex; ///< Guards m_bRendering
 
 };
 
+////////////////////////////////////////////////////////////////////////////
+//
+/// \class FilmPixels
+/// \author Dan Torres
+/// \created 6/11/2009
+/// \brief A block of pixels read back from a film
+//
+/// Holds a copy of the film contents in a flat, row-major array, and hands that
+/// memory straight to python through the buffer protocol. Scripts can wrap it with
+/// buffer() (or memoryview(), numpy.frombuffer(), etc.) to pack atlases or write
+/// their own formats without going through a file on disk.
+/// 
+/// A copy is needed anyways, as the film keeps filter-weighted color sums and not
+/// final pixels. But it is the only one: python never converts pixels to objects.
+//
+////////////////////////////////////////////////////////////////////////////
+class FilmPixels : public EclipseObject
+{
+    DECLARE_PYTHON_HEADER;
+
+public:
+
+    /*!
+     *	Constructor
+     *  @param a_nWidth Width in pixels
+     *  @param a_nHeight Height in pixels
+     *  @param a_nComponents Number of components per pixel (4 for RGBA, 1 for channels)
+     *  @param a_nFormat Storage format for each component
+     */
+    FilmPixels( int a_nWidth, int a_nHeight, int a_nComponents, Film::ePixelFormat a_nFormat );
+
+    /*!
+     *	Stores one pixel, converting it to our format
+     *  @param a_nX Column
+     *  @param a_nY Row
+     *  @param a_pComponents At least GetComponents() floats
+     */
+    void SetPixel( int a_nX, int a_nY, const float* a_pComponents );
+
+    /// Returns a pointer to the first pixel
+    inline void* GetData() { return &m_data[0]; }
+
+    /// Returns the size of our data, in bytes
+    inline size_t GetSize() const { return m_data.size(); }
+
+    inline int GetWidth() const { return m_nWidth; }
+    inline int GetHeight() const { return m_nHeight; }
+    inline int GetComponents() const { return m_nComponents; }
+    inline Film::ePixelFormat GetFormat() const { return m_nFormat; }
+
+    // -------------------------------------------------------------------------
+    // Python interface
+    // -------------------------------------------------------------------------
+
+    /*! 
+    *   Python type check
+    *   Verifies that the provided python object encapsulates our class
+    *   @return True if the provided object type is the same as ours
+    */
+    static bool PyTypeCheck( PYOBJECT a_pObject );
+
+    /*!
+    *  Python text representation method
+    *  @return A python string object with a description of ourselves 
+    */
+    virtual PYOBJECT PyAsString();
+
+    // Returns (width, height, components, format)
+    DECLARE_PYTHON_OBJECT_METHOD( FilmPixels, shape );
+
+    /// Buffer protocol implementation
+    static PyBufferProcs m_PyBufferProcs;
+
+protected:
+
+    // Destruction
+    ~FilmPixels();
+
+    /*!
+    *  Child message hook for reference-count based destruction.
+    *  The child class is responsible for deleting any instance to which this
+    *  this function is called.
+    */
+    virtual void DeleteObject();
+
+private:
+
+    // Old style buffer protocol, one single segment
+    static Py_ssize_t PyGetBuffer( PYOBJECT a_pSelf, Py_ssize_t a_nSegment, void** a_ppData );
+    static Py_ssize_t PyGetSegmentCount( PYOBJECT a_pSelf, Py_ssize_t* a_pLength );
+    static Py_ssize_t PyGetCharBuffer( PYOBJECT a_pSelf, Py_ssize_t a_nSegment, char** a_ppData );
+
+#if PY_VERSION_HEX >= 0x02060000
+    // New style buffer protocol, needed for memoryview
+    static int PyGetBufferView( PYOBJECT a_pSelf, Py_buffer* a_pView, int a_nFlags );
+#endif
+
+    std::vector<unsigned char>  m_data;         ///< Pixel storage
+    int                         m_nWidth;       ///< Width in pixels
+    int                         m_nHeight;      ///< Height in pixels
+    int                         m_nComponents;  ///< Components per pixel
+    Film::ePixelFormat          m_nFormat;      ///< Storage format
+};
 
 
 #endif
\ No newline at end of file
@@ -174,10 +174,14 @@ public:
      *  @param a_bUseBackground If true, background contributes to direct lighting
      *  @param a_nFGSamples Number of samples for final gathering
      *  @param a_nFGBounces Allow gather rays to extend to paths of this length
+     *  @param a_nFGMinSamples If greater than zero, final gathering is adaptive: samples are
+     *         shot in batches of this size, until the estimate converges or a_nFGSamples is reached
+     *  @param a_fFGThreshold Relative error below which adaptive final gathering stops
      */
 	PhotonIntegrator( const char* a_sID, int a_nRayDepth, int a_nShadowDepth, int a_nPhotons,
         float a_fDiffuseRadius, int a_nSearch, int a_nCausticMix, int a_nBounces, 
-        bool a_bUseBackground, int a_nFGSamples, int a_nFGBounces );
+        bool a_bUseBackground, int a_nFGSamples, int a_nFGBounces,
+        int a_nFGMinSamples = 0, float a_fFGThreshold = 0.05f );
 
 protected:
 
@@ -205,6 +209,10 @@ private:
 /// \created 1/12/2009
 /// \brief An integrator that generates ambient occlusion information
 //
+/// Uses the dedicated "ambientocclusion" integrator, which traces only
+/// occlusion rays bounded by the sample length; no lights or materials
+/// are evaluated.
+//
 ////////////////////////////////////////////////////////////////////////////
 class AmbientOcclusionIntegrator : public SurfaceIntegrator
 {
@@ -238,5 +246,70 @@ private:
     ~AmbientOcclusionIntegrator();
 };
 
+////////////////////////////////////////////////////////////////////////////
+//
+/// \class OcclusionMaskIntegrator
+/// \author Dan Torres
+/// \created 6/2/2009
+/// \brief An integrator that only evaluates light visibility, for shadow masks
+//
+/// Unlike a monochrome direct lighting integrator, no material is evaluated:
+/// each texel costs one surface query plus shadow rays. In the default mode
+/// the texel gets the visibility of the best visible light; a fully visible
+/// light ends the light loop.
+/// In RGBA mode the visibility of the first four lights of the active light
+/// layer is written into the red, green, blue and alpha channels; the film
+/// must be created with alpha saving, or the fourth mask is not written. In channel
+/// mode each light of the layer gets its own film channel ("Light0", "Light1",
+/// ...), so all masks of a layer are baked from the same camera rays.
+//
+////////////////////////////////////////////////////////////////////////////
+class OcclusionMaskIntegrator : public SurfaceIntegrator
+{
+public:
+
+    /*!
+     *  Defines how light visibility is stored
+     */
+    enum eMaskMode
+    {
+        MaskMode_Any,       ///< White if any light reaches the texel
+        MaskMode_RGBA,      ///< First four lights packed into RGBA
+        MaskMode_Channels   ///< One film channel per light
+    };
+
+    /*!
+     *	Basic constructor
+     *  @param a_sID Unique integrator name
+     *  @param a_nTransparentShadowDepth Depth for transparent shadows. Disabled if zero
+     *  @param a_nMode How per-light visibility is stored
+     */
+	OcclusionMaskIntegrator( const char* a_sID, int a_nTransparentShadowDepth, eMaskMode a_nMode );
+
+    /*!
+    *  Appends mask mode identifiers to the provided module
+    *  @param a_pPyModule A valid python module
+    */
+    static void AppendMaskModes( PYOBJECT a_pPyModule );
+
+protected:
+
+    /*!
+    *  Child message hook for reference-count based destruction.
+    *  The child class is responsible for deleting any instance to which this
+    *  this function is called.
+    */
+    virtual void DeleteObject(){ delete this; }
+
+    // Access the child description as a python object
+    virtual PYOBJECT GetPyStringRep();
+
+
+private:
+
+    // Restringed destructor
+    ~OcclusionMaskIntegrator();
+};
+
 
 #endif
\ No newline at end of file
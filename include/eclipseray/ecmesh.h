@@ -80,12 +80,15 @@ public:
 	 *	@param a_pScene	A valid scene for this mesh to live in
 	 *	@param a_pMaterial A valid material for this mesh to have
      *  @param a_pMatrix An optional transformation matrix to apply over the vertex buffer
+     *  @param a_fSmoothAngle If positive, vertex normals are generated for faces meeting at
+     *         less than this angle (in degrees, 180 smooths everything)
 	 */
 	Mesh( const char* a_sID, 
         Buffer* a_pVertexBuffer, unsigned int a_nVertexOffset, unsigned int a_nVertexCount, 
         Buffer* a_pUVBuffer,     unsigned int a_nUVOffset,     unsigned int a_nUVCount,
         Buffer* a_pIndexBuffer,  unsigned int a_nIndexOffset,  unsigned int a_nTriangleCount,
-		Scene* a_pScene, Material* a_pMaterial, float* a_pBSphere, Matrix* a_pMatrix = NULL);
+		Scene* a_pScene, Material* a_pMaterial, float* a_pBSphere, Matrix* a_pMatrix = NULL,
+        float a_fSmoothAngle = 0.0f );
 
     // -------------------------------------------------------------------------
     // Utilities
@@ -97,6 +100,11 @@ public:
     inline YRTriangleObject* GetYRTrimesh(){
         return m_pScene->GetScenePtr()->getMesh( m_nMeshID );
     }; 
+
+    /*!
+     *	Returns the id of the mesh within its scene
+     */
+    inline YRObjectID GetMeshID() const { return m_nMeshID; }
  
 
 
@@ -131,7 +139,7 @@ protected:
         Buffer* a_pVertices, unsigned int a_nVertexOffset, unsigned int a_nVertexCount, 
         Buffer* a_pUVs,      unsigned int a_nUVOffset,     unsigned int a_nUVCount,
         Buffer* a_pIndices,  unsigned int a_nIndexOffset,  unsigned int a_nTriangleCount, 
-        float* a_pBSphere, const Matrix& a_matrix );
+        float* a_pBSphere, const Matrix& a_matrix, float a_fSmoothAngle );
 
 	/*!
 	*  Child message hook for reference-count based destruction.
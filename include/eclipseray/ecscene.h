@@ -39,11 +39,15 @@
 #include <eclipseray/ecgeometry.h>
 #include <eclipseray/eccamera.h>
 
+#include <yafraycore/ccthreads.h>
+#include <yafraycore/monitor.h>
+
 #include <list>
 
 class SurfaceIntegrator;
 class Light;
 class Film;
+class RenderTask;
 
 ////////////////////////////////////////////////////////////////////////////
 //
@@ -82,19 +86,19 @@ public:
     inline YRScene* GetScenePtr(){ return &m_scene; }
 
     /*!
-     *	Add a surface integrator
+     *	Add a surface integrator. Ignored while the scene is rendering
      *  @param a concrete SurfaceIntergrator object
      */
     void AddIntegrator( SurfaceIntegrator* a_pIntegrator );
 
     /*!
-     *	Adds a light into our scene
+     *	Adds a light into our scene. Ignored while the scene is rendering
      *  @param a_pLight A concrete Light object
      */
     void AddLight( Light* a_pLight );
 
     /*!
-     *	Assigns antialias parameters
+     *	Assigns antialias parameters. Ignored while the scene is rendering
      *  @param a_nSamples Number of samples
      *  @param a_nPasses Number of render passes
      *  @param a_nIncSamples Number of samples for incremental passes
@@ -102,16 +106,41 @@ public:
      */
     void SetAntialias( int a_nSamples, int a_nPasses, int a_nIncSamples, double a_fThreshold );
 
+    /// Outcome of a render call
+    enum eRenderResult
+    {
+        RenderResult_Done,      ///< The scene was rendered
+        RenderResult_Busy,      ///< The scene or the film were still rendering, nothing was done
+        RenderResult_Failed     ///< The renderer gave up on the scene
+    };
+
 
     /*!
      *	Triggers the main render procedure
      *  Triggers all render operations over the registered meshes, using whatever
      *  lights, materials, and surface integrators are available. If a camera is
      *  not provided, a conventional perspective camera is used instead.
+     *  Does nothing if the scene or the film are already rendering. Reports
+     *  nothing either, so it can run without the python interpreter lock; the
+     *  caller reports the result.
      *  @param a_pFilm The film used to render this scene
-     8  @param a_pCamera An optional camera for rendering. 
+     *  @param a_pCamera An optional camera for rendering. 
+     *  @return The outcome of the render
      */
-    void Render( Film* a_pFilm, LightmapCamera* a_pCamera = NULL ); 
+    eRenderResult Render( Film* a_pFilm, LightmapCamera* a_pCamera = NULL ); 
+
+    /*!
+     *	Starts rendering in the background
+     *  Same as Render, but returns immediately. The returned task must be waited for
+     *  before the scene, film or camera are used again.
+     *  @param a_pFilm The film used to render this scene
+     *  @param a_pCamera An optional camera for rendering
+     *  @return A new render task, or NULL if the scene or the film are still rendering
+     */
+    RenderTask* RenderAsync( Film* a_pFilm, LightmapCamera* a_pCamera = NULL );
+
+    /// True while a render operation is in progress
+    bool IsRendering() const;
 
     // -------------------------------------------------------------------------
     // Python interface
@@ -137,6 +166,9 @@ public:
     // Triggers the render operation
     DECLARE_PYTHON_OBJECT_METHOD( Scene, render );
 
+    // Triggers the render operation in the background
+    DECLARE_PYTHON_OBJECT_METHOD( Scene, renderAsync );
+
     // Sets antialias values
     DECLARE_PYTHON_OBJECT_METHOD( Scene, setAntialias );
 
@@ -149,8 +181,13 @@ public:
     // Sets the background color. Must be called BEFORE rendering
     DECLARE_PYTHON_OBJECT_METHOD( Scene, setBackgroundColor );
 
+    // Returns the counters and stage times of the last render
+    DECLARE_PYTHON_OBJECT_METHOD( Scene, getStats );
+
 protected:
 
+    friend class RenderTask;
+
     /// Only our Delete function can destroy a scene
     ~Scene();
 
@@ -163,6 +200,16 @@ protected:
 
 private:
 
+    /// Flags the scene as rendering. Returns false if it already was
+    bool BeginRender();
+
+    /// Clears the rendering flag
+    void EndRender();
+
+    /// The actual render procedure, the caller must have called BeginRender on us and the film.
+    /// Runs on the render thread, so it must not report anything. Returns false if the render failed
+    bool RenderScene( Film* a_pFilm, LightmapCamera* a_pCamera );
+
     YRScene     m_scene;            ///< Our actual scene object
 
     int         m_nAASamples;       ///< Number of samples (for Antialiasing)
@@ -176,12 +223,150 @@ private:
     float       m_fCameraAspect;     ///< Aspect ratio
     bool        m_bFirstRender;      ///< True for the first time we render a scene
     YRColorRGB  m_backgroundColor;   ///< Background color for render operations
+    bool        m_bRendering;        ///< True while Render is running, possibly on another thread
+    mutable yafthreads::mutex_t m_renderMutex; ///< Guards m_bRendering
 
     /// A list of objects that must be released when we are destroyed
     std::list<EclipseObject*> m_lstOwnedReferences;
 
 };
 
+////////////////////////////////////////////////////////////////////////////
+//
+/// \class RenderTask
+/// \author Dan Torres
+/// \created 6/10/2009
+/// \brief Handle to a scene render running in the background
+//
+/// The render runs on its own thread, and never touches the python interpreter
+/// or the error manager; a failed render is reported once the task is waited for.
+/// This lets the calling script do its own work (writing the previous lightmap,
+/// preparing the next mesh) while tracing. The task keeps references to the scene,
+/// film and camera until it is destroyed, and destroying it waits for the render.
+/// 
+/// Progress is measured in finished film areas over all antialias passes. Photon
+/// shooting and other preprocessing happen before the first area, at 0%.
+//
+////////////////////////////////////////////////////////////////////////////
+class RenderTask : public EclipseObject
+{
+    DECLARE_PYTHON_HEADER;
+
+public:
+
+    /*!
+     *	Constructor. Starts rendering right away
+     *  @param a_pScene Scene to render
+     *  @param a_pFilm Film to render into
+     *  @param a_pCamera Optional lightmap camera
+     */
+    RenderTask( Scene* a_pScene, Film* a_pFilm, LightmapCamera* a_pCamera );
+
+    /// Blocks until the render is done, then reports a failed render.
+    /// Must be called with the python interpreter lock, which it releases while blocking
+    void Wait();
+
+    /// Asks the scene to stop as soon as possible. Areas already handed out are still finished
+    void Cancel();
+
+    /// Returns the finished fraction of the render, between 0 and 1
+    float GetProgress();
+
+    /// True once the render thread has finished
+    inline bool IsDone() const { return m_bDone; }
+
+    /// True if the render was cancelled
+    inline bool IsCancelled() const { return m_bCancelled; }
+
+    // -------------------------------------------------------------------------
+    // Python interface
+    // -------------------------------------------------------------------------
+
+    /*! 
+    *   Python type check
+    *   Verifies that the provided python object encapsulates our class
+    *   @return True if the provided object type is the same as ours
+    */
+    static bool PyTypeCheck( PYOBJECT a_pObject );
+
+    /*!
+    *  Python text representation method
+    *  @return A python string object with a description of ourselves 
+    */
+    virtual PYOBJECT PyAsString();
+
+    // Waits for the render to finish
+    DECLARE_PYTHON_OBJECT_METHOD( RenderTask, wait );
+
+    // Returns the finished fraction of the render
+    DECLARE_PYTHON_OBJECT_METHOD( RenderTask, progress );
+
+    // Cancels the render
+    DECLARE_PYTHON_OBJECT_METHOD( RenderTask, cancel );
+
+    // Returns true if the render has finished
+    DECLARE_PYTHON_OBJECT_METHOD( RenderTask, isDone );
+
+protected:
+
+    /// Only our Delete function can destroy a task
+    ~RenderTask();
+
+    /*!
+    *  Child message hook for reference-count based destruction.
+    *  The child class is responsible for deleting any instance to which this
+    *  this function is called.
+    */
+    virtual void DeleteObject();
+
+private:
+
+    // Counts finished areas, one init per antialias pass. Also re-raises a cancel request
+    // at the start of each pass, as scene_t::render clears the abort signal when it begins
+    class Progress : public yafaray::progressBar_t
+    {
+    public:
+        Progress( RenderTask* a_pTask, int a_nPasses );
+        virtual void init( int totalSteps );
+        virtual void update( int steps = 1 );
+        virtual void done();
+        float Get();
+    private:
+        yafthreads::mutex_t m_mutex;
+        RenderTask*         m_pTask;        ///< Owner task
+        int                 m_nPasses;      ///< Expected number of passes
+        int                 m_nPass;        ///< Passes started so far
+        int                 m_nSteps;       ///< Areas in the current pass
+        int                 m_nDoneSteps;   ///< Finished areas in the current pass
+    };
+
+#if HAVE_PTHREAD
+    // Background thread running Scene::Render
+    class Worker : public yafthreads::thread_t
+    {
+    public:
+        Worker( RenderTask* a_pTask ):m_pTask(a_pTask){}
+        virtual void body();
+    private:
+        RenderTask* m_pTask;
+    };
+
+    Worker*             m_pWorker;      ///< Render thread, NULL once joined
+#endif
+
+    // Runs the actual render, on whichever thread we are
+    void Run();
+
+    Scene*              m_pScene;       ///< Scene being rendered
+    Film*               m_pFilm;        ///< Target film
+    LightmapCamera*     m_pCamera;      ///< Optional camera
+    Progress            m_progress;     ///< Progress monitor attached to the film
+    volatile bool       m_bDone;        ///< Set by the render thread when finished
+    volatile bool       m_bFailed;      ///< Set by the render thread if the render failed
+    bool                m_bReported;    ///< True once a failure was reported
+    volatile bool       m_bCancelled;   ///< Set when cancel was requested
+};
+
 
 
 
@@ -80,6 +80,18 @@ typedef PyObject* PYOBJECT;
  *  @param _inheritance Either PYTHON_TYPE_BASE or PYTHON_TYPE_FINAL
  */
 #define DECLARE_PYTHON_TYPE( _myClass, _className, _classDescription, _inheritance )  \
+    DECLARE_PYTHON_BUFFER_TYPE( _myClass, _className, _classDescription, _inheritance, 0 )
+
+/*!
+ *  Declares the Python type object for a class that exposes its memory through the
+ *  python buffer protocol (e.g. for buffer() or memoryview())
+ *  @param _myClass Name of the class
+ *  @param _className Short class name, as a string
+ *  @param _classDescription Brief description of the class, as a string
+ *  @param _inheritance Either PYTHON_TYPE_BASE or PYTHON_TYPE_FINAL, plus buffer flags
+ *  @param _bufferProcs Pointer to the PyBufferProcs of the class
+ */
+#define DECLARE_PYTHON_BUFFER_TYPE( _myClass, _className, _classDescription, _inheritance, _bufferProcs )  \
     PyTypeObject PYTHON_TYPE( _myClass ) = {                            \
         PyObject_HEAD_INIT(&PyType_Type)                                \
         0,                                                              \
@@ -94,7 +106,7 @@ typedef PyObject* PYOBJECT;
         0,					/* tp_str */                                \
         0,					/* tp_getattro */                           \
         0,					/* tp_setattro */                           \
-        0,					/* tp_as_buffer */                          \
+        _bufferProcs,		/* tp_as_buffer */                          \
         _inheritance,       /* tp_flags */                              \
         _classDescription,  /* tp_doc */                                \
         0,					/* tp_traverse */                           \
@@ -111,7 +111,8 @@ public:
     {
         Setting_ProgramName,            ///< Name of this application
         Setting_MainScript,             ///< Name of the program or script to run
-        Setting_PluginDir               ///< Path to the YR plugins
+        Setting_PluginDir,              ///< Path to the YR plugins
+        Setting_TraceFile               ///< PARAM(-trace) Chrome trace of the render phases, NULL if disabled
         // ...
     };
 
@@ -122,7 +123,8 @@ public:
     enum eNumericSetting
     {
         Setting_ErrorHeapSize,          ///< Number of errors to keep in our heap
-        Setting_CPUCores                ///< Number of CPU cores available
+        Setting_CPUCores,               ///< Number of CPU cores available
+        Setting_TextureCacheMB          ///< PARAM(-texcache) Memory budget for decoded textures in MB, 0 is unlimited
         // ...
     };
 
@@ -213,9 +215,11 @@ private:
 
     bool                m_booleanSettings[ Setting_Invalid ];   ///< Contains all of our boolean settings
     int                 m_nCores;                               ///< Number of CPU cores to use for multi-threading
+    int                 m_nTextureCacheMB;                      ///< Texture cache budget in MB, 0 for no limit
     char*               m_sScriptName;                          ///< Name of the main program file to run
     char*               m_sPluginDir;                           ///< Plugin directory
     char*               m_sAppName;                             ///< First argument to this program
+    char*               m_sTraceFile;                           ///< Render trace output file, or NULL
     bool                m_bCanContinue;                         ///< If true, the program has enough data to execute
     static Settings*    m_pGlobalSettings;                      ///< Convenience holder for globally accessible settings
 
@@ -45,6 +45,8 @@
 
 #include <yafraycore/tga_io.h>
 #include <yafraycore/meshtypes.h>
+#include <yafraycore/texcache.h>
+#include <yafraycore/rendertrace.h>
 
 #include <core_api/matrix4.h>
 
@@ -65,12 +67,17 @@ typedef yafaray::surfaceIntegrator_t YRSurfaceIntegrator;    ///< Surface integr
 typedef yafaray::objID_t			 YRObjectID;			 ///< Unique object id
 typedef yafaray::imageFilm_t         YRFilm;                 ///< Image film
 typedef yafaray::outTga_t            YRTga;                  ///< Tga texture
+typedef yafaray::outTgaStream_t      YRTgaStream;            ///< Tga texture, written while rendering
+typedef yafaray::colorOutput_t       YRColorOutput;          ///< Any film output
 typedef yafaray::matrix4x4_t         YRMatrix4x4;            ///< A 4x4 matrix 
 typedef yafaray::camera_t            YRCamera;               ///< A base camera type
 typedef yafaray::ray_t               YRRay;                  ///< A simple ray object 
+typedef yafaray::surfacePoint_t      YRSurfacePoint;         ///< A point on a surface, with all its shading data
 typedef yafaray::PFLOAT              YRPFloat;               ///< Float
 typedef yafaray::triangleObject_t    YRTriangleObject;       ///< A trimesh
 typedef yafaray::uv_t                YRuv;                   ///< UV coordinate pair
+typedef yafaray::textureCache_t      YRTextureCache;         ///< Process wide cache of decoded image files
+typedef yafaray::renderTrace_t       YRRenderTrace;          ///< Process wide timeline of the render phases
 
 
 
@@ -17,6 +17,7 @@
 #include <yafraycore/spectrum.h>
 #include <yafraycore/irradiancecache.h>
 #include <utilities/sample_utils.h>
+#include <core_api/sampling.h>
 #include <integrators/integr_utils.h>
 
 
@@ -35,9 +36,15 @@ class YAFRAYPLUGIN_EXPORT photonIntegrator_t: public tiledIntegrator_t
 		virtual bool render(imageFilm_t *image);
 		virtual bool preprocess();
 		virtual colorA_t integrate(renderState_t &state, diffRay_t &ray/*, sampler_t &sam*/) const;
+		virtual colorA_t integrateSurface(renderState_t &state, diffRay_t &ray, const surfacePoint_t &sp) const;
 		static integrator_t* factory(paraMap_t &params, renderEnvironment_t &render);
 	protected:
+		//! shade the first surface along ray; hit is used instead of intersecting the scene when known
+		colorA_t shade(renderState_t &state, diffRay_t &ray, const surfacePoint_t *hit) const;
 		color_t finalGathering(renderState_t &state, const surfacePoint_t &sp, const vector3d_t &wo) const;
+		/*! s1, s2 are the samples of the first bounce (RI_vdC and scrHalton(2, ...) of offs) */
+		color_t gatherPath(renderState_t &state, const surfacePoint_t &sp, const vector3d_t &wo, unsigned int offs, float s1, float s2,
+							PFLOAT spread, void *n_udat, int &nVerts, int &nFast) const;
 		void sampleIrrad(renderState_t &state, const surfacePoint_t &sp, const vector3d_t &wo, irradSample_t &ir) const;
 		color_t estimateOneDirect(renderState_t &state, const surfacePoint_t &sp, vector3d_t wo, const std::vector<light_t *>  &lights, int d1, int n)const;
 		bool renderIrradPass();
@@ -55,6 +62,9 @@ class YAFRAYPLUGIN_EXPORT photonIntegrator_t: public tiledIntegrator_t
 		unsigned int nPhotons;
 		int sDepth, rDepth, maxBounces, nSearch, nCausSearch;
 		int nPaths, gatherBounces;
+		bool fgAdaptive; //!< stop final gathering early when the gathered radiance estimate converged
+		int fgMinPaths; //!< size of the first (and each further) batch of gather paths in adaptive mode
+		float fgThreshold; //!< relative standard error of the gathered radiance below which adaptive gathering stops
 		PFLOAT dsRadius; //!< diffuse search radius
 		PFLOAT lookupRad; //!< square radius to lookup radiance photons, as infinity is no such good idea ;)
 		PFLOAT gatherDist; //!< minimum distance to terminate path tracing (unless gatherBounces is reached)
@@ -22,16 +22,21 @@
 #define Y_BACKGROUNDLIGHT_H
 
 #include <core_api/light.h>
+#include <string>
 
 __BEGIN_YAFRAY
 
 class background_t;
 class pdf1D_t;
+struct bgDistrib_t;
 
 class bgLight_t : public light_t
 {
 	public:
-		bgLight_t(background_t *bg, int sampl);
+		/*! res is the number of rows of the importance map (twice as many columns at the horizon).
+			Lights with the same non-empty key share one importance map, so the key must identify
+			everything eval() depends on; it is built lazily in init(), with all render threads. */
+		bgLight_t(background_t *bg, int sampl, int res=360, const std::string &key=std::string());
 		virtual ~bgLight_t();
 		virtual void init(scene_t &scene);
 		virtual color_t totalEnergy() const;
@@ -48,10 +53,13 @@ class bgLight_t : public light_t
 		virtual bool intersect(const ray_t &ray, PFLOAT &t, color_t &col, float &ipdf) const;
 //	static light_t *factory(paraMap_t &params, renderEnvironment_t &render);
 	protected:
-		void initIS();
+		void initIS(int threads);
 		void sample_dir(float s1, float s2, vector3d_t &dir, float &pdf) const;
 		float dir_pdf(const vector3d_t dir) const;
-		pdf1D_t *uDist, *vDist;
+		pdf1D_t *uDist, *vDist; //!< point into distrib
+		bgDistrib_t *distrib;
+		std::string isKey;
+		int resolution;
 		int samples;
 		int nv; //!< gives the array size of uDist
 		point3d_t worldCenter;
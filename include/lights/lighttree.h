@@ -0,0 +1,78 @@
+/****************************************************************************
+ * 			lighttree.h: spatial sampling hierarchy over the triangles of a mesh light
+ *      This is part of the yafray package
+ *      Copyright (C) 2009 BioWare
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#ifndef Y_LIGHTTREE_H
+#define Y_LIGHTTREE_H
+
+#include <core_api/bound.h>
+#include <vector>
+#include <utility>
+
+__BEGIN_YAFRAY
+
+class triangle_t;
+
+/*!	Bounding volume hierarchy over the triangles of an emitter. Every node knows the area
+	below it, its bounding sphere and a cone around the normals of its triangles; a sample
+	walks down from the root choosing each child by area over squared distance to the shading
+	point, zero if the cone faces away from it. Inside a leaf triangles are picked by area.
+	Only the position of the shading point is used, so the pdf of a light point found by
+	intersecting the light can be evaluated again with pdf().
+*/
+class lightTree_t
+{
+	public:
+		lightTree_t(const triangle_t **tris, int n, bool doubleSided);
+		/*! choose a triangle for shading point p; s is replaced by a new uniform sample in [0,1)
+			for sampling inside the triangle and pdf is the probability of the choice */
+		int sample(const point3d_t &p, float &s, float &pdf) const;
+		//! probability that sample() chooses triangle t at p
+		float pdf(const point3d_t &p, int t) const;
+		//! index of a triangle in the array given on construction, -1 if it is not part of the tree
+		int index(const triangle_t *t) const;
+		float area(int t) const { return areas[t]; }
+	protected:
+		struct node_t
+		{
+			point3d_t center;
+			PFLOAT radius;
+			vector3d_t axis; //!< mean normal
+			float cosSpread, sinSpread; //!< angle between axis and the normal farthest away from it, cosSpread -1 for any direction
+			float area;
+			int parent;
+			int left, right; //!< child nodes, -1 for leaves
+			int first, count; //!< triangles of a leaf in order
+		};
+		int build(int first, int count, int parent, const std::vector<bound_t> &bounds);
+		float importance(const node_t &n, const point3d_t &p) const;
+		//! probability of going to the left child of n
+		float leftProb(const node_t &n, const point3d_t &p) const;
+		std::vector<node_t> nodes;
+		std::vector<int> order; //!< triangle indices grouped by leaf
+		std::vector<int> leafOf; //!< leaf node of each triangle
+		std::vector<float> areas;
+		std::vector<vector3d_t> normals;
+		std::vector< std::pair<const triangle_t*, int> > lookup; //!< sorted by address for index()
+		bool dblSided;
+};
+
+__END_YAFRAY
+
+#endif // Y_LIGHTTREE_H
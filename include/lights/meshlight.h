@@ -27,7 +27,8 @@ __BEGIN_YAFRAY
 
 class triangleObject_t;
 class triangle_t;
-class pdf1D_t;
+class aliasTable_t;
+class lightTree_t;
 class paraMap_t;
 class renderEnvironment_t;
 class triKdTree_t;
@@ -35,7 +36,7 @@ class triKdTree_t;
 class meshLight_t : public light_t
 {
 	public:
-		meshLight_t(unsigned int msh, const color_t &col, int sampl, bool dbl_s=false);
+		meshLight_t(unsigned int msh, const color_t &col, int sampl, bool dbl_s=false, bool spatial=false);
 		virtual ~meshLight_t();
 		virtual void init(scene_t &scene);
 		virtual color_t totalEnergy() const;
@@ -54,10 +55,18 @@ class meshLight_t : public light_t
 	protected:
 		void initIS();
 		void sampleSurface(point3d_t &p, vector3d_t &n, float u, float v) const;
+		//! sample a light point for shading point from, sArea is the area to use in the pdf
+		void sampleSurface(const point3d_t &from, point3d_t &p, vector3d_t &n, float u, float v, float &sArea) const;
+		//! area to use in the pdf of a light point on triangle t seen from shading point from; 0 if it can't be sampled
+		float sampleArea(const point3d_t &from, const triangle_t *t) const;
+		//! sampleArea() for a light point given by position only
+		float lightPointArea(const surfacePoint_t &sp, const surfacePoint_t &sp_light) const;
 		unsigned int objID;
 		bool doubleSided;
 		color_t color;
-		pdf1D_t *areaDist;
+		aliasTable_t *areaDist;
+		lightTree_t *lTree; //!< picks triangles by the shading point instead of area only, optional
+		bool spatialSampling;
 		const triangle_t **tris;
 		int samples;
 		int nTris; //!< gives the array size of uDist
@@ -43,6 +43,7 @@ class valueNode_t: public shaderNode_t
 		valueNode_t(colorA_t col, float val): color(col), value(val) {}
 		virtual void eval(nodeStack_t &stack, const renderState_t &state, const surfacePoint_t &sp)const;
 		virtual void eval(nodeStack_t &stack, const renderState_t &state, const surfacePoint_t &sp, const vector3d_t &wo, const vector3d_t &wi)const;
+		virtual bool isPointDependant() const { return false; }
 		virtual bool configInputs(const paraMap_t &params, const nodeFinder_t &find) { return true; };
 		static shaderNode_t* factory(const paraMap_t &params,renderEnvironment_t &render);
 	protected:
@@ -68,9 +69,11 @@ class mixNode_t: public shaderNode_t
 {
 	public:
 		mixNode_t();
-		mixNode_t(float val);
+		mixNode_t(float val, mix_modes mmode=MN_MIX);
 		virtual void eval(nodeStack_t &stack, const renderState_t &state, const surfacePoint_t &sp)const;
 		virtual void eval(nodeStack_t &stack, const renderState_t &state, const surfacePoint_t &sp, const vector3d_t &wo, const vector3d_t &wi)const;
+		virtual bool isPointDependant() const { return false; }
+		virtual bool compile(nodeInstr_t &instr) const;
 		virtual bool configInputs(const paraMap_t &params, const nodeFinder_t &find);
 		virtual bool getDependencies(std::vector<const shaderNode_t*> &dep) const;
 		static shaderNode_t* factory(const paraMap_t &params,renderEnvironment_t &render);
@@ -81,6 +84,7 @@ class mixNode_t: public shaderNode_t
 		const shaderNode_t *input1;
 		const shaderNode_t *input2;
 		const shaderNode_t *factor;
+		mix_modes mode;
 };
 
 inline void mixNode_t::getInputs(nodeStack_t &stack, colorA_t &cin1, colorA_t &cin2, CFLOAT &fin1, CFLOAT &fin2, CFLOAT &f2) const
@@ -26,6 +26,8 @@
 #include <core_api/texture.h>
 #include <core_api/environment.h>
 #include <utilities/buffer.h>
+#include <textures/mipmap.h>
+#include <yafraycore/texcache.h>
 
 __BEGIN_YAFRAY
 
@@ -77,28 +79,38 @@ class RGBEtexture_t: public textureImage_t
 class gammaLUT_t;
 
 // ============================================================================
-/*! image texture supporting 8bit integer and 32bit float format  */
+/*! image texture supporting 8bit integer and 32bit float format.
+	The image is kept in a tiled mip pyramid; filtered lookups blend the two levels
+	closest to the footprint width (trilinear when interpolation is bilinear).
+	The pyramid itself lives in the texture cache and is shared with all textures
+	using the same file */
 // ============================================================================
 
 class textureImageIF_t : public textureImage_t
 {
 	public:
 //		textureImageIF_t(const char *filename, const std::string &intp);
-		textureImageIF_t(cBuffer_t *im, fcBuffer_t *f_im, INTERPOLATE_TYPE intp);
+		/*! takes over a reference to img (from textureCache_t::acquire), released on destruction */
+		textureImageIF_t(cachedImage_t *img, INTERPOLATE_TYPE intp);
 		virtual ~textureImageIF_t();
 
 		virtual colorA_t getColor(const point3d_t &sp) const;
 		virtual colorA_t getColor(int x, int y, int z) const;
 		virtual CFLOAT getFloat(const point3d_t &p) const;
+		virtual colorA_t getColorFiltered(const point3d_t &p, PFLOAT width) const;
+		virtual CFLOAT getFloatFiltered(const point3d_t &p, PFLOAT width) const;
 
 		virtual bool loadFailed() const { return failed; }
 		virtual bool discrete() const { return true; }
 		virtual void resolution(int &x, int &y, int &z) const;
+		//! file name, size and modification time of the image plus all lookup settings
+		virtual std::string sourceKey() const;
 		void setGammaLUT(gammaLUT_t *lut);
 //		static texture_t *factory(paraMap_t &params,renderEnvironment_t &render);
 	protected:
-		cBuffer_t *image;
-		fcBuffer_t *float_image;
+		//! lookup at a fractional mip level, level 0 is the original image
+		colorA_t lookup(const point3d_t &p, float lod) const;
+		cachedImage_t *cached;
 		bool failed;
 		gammaLUT_t *gammaLUT;
 };
@@ -167,6 +179,22 @@ colorA_t interpolateImage(T image, textureImage_t::INTERPOLATE_TYPE intp, const
 	return cubicInterpolate(c0, c8, cA, cC, dy);
 }
 
+/*! interpolate between the two mip levels around lod; at integer levels this is a single
+	interpolateImage() call on that level */
+template<class T, class GetPix>
+colorA_t interpolateMipMap(const mipMap_t<T> &mip, textureImage_t::INTERPOLATE_TYPE intp, const point3d_t &p, float lod, GetPix &getPixel)
+{
+	int l = (int)lod;
+	typename mipMap_t<T>::levelView_t lv = mip.level(l);
+	colorA_t c = interpolateImage(&lv, intp, p, getPixel);
+	float f = lod - (float)l;
+	if(f > 0.f && l+1 < mip.numLevels())
+	{
+		typename mipMap_t<T>::levelView_t lv2 = mip.level(l+1);
+		c = (1.f-f)*c + f*interpolateImage(&lv2, intp, p, getPixel);
+	}
+	return c;
+}
 
 __END_YAFRAY
 
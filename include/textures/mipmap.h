@@ -0,0 +1,146 @@
+/****************************************************************************
+ *
+ *          mipmap.h: tiled mip pyramid for image textures
+ *      This is part of the yafray package
+ *      Copyright (C) 2009 BioWare
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+
+#ifndef Y_MIPMAP_H
+#define Y_MIPMAP_H
+
+#include <utilities/buffer.h>
+#include <utilities/tiled_array.h>
+#include <vector>
+#include <cmath>
+
+__BEGIN_YAFRAY
+
+static inline void mipConvert(float f, unsigned char &out){ out = (unsigned char)(f + 0.5f); }
+static inline void mipConvert(float f, float &out){ out = f; }
+
+/*! source texels and weights of texel i of a level with m texels along an axis, reduced from n texels.
+	Even sizes use a 2 texel box; odd sizes a 3 texel footprint whose weights give every source texel
+	the same total weight, so the last row/column is not dropped.
+	\return number of taps */
+static inline int mipTaps(int i, int n, int m, int *idx, float *wt)
+{
+	if(n == 1){ idx[0] = 0; wt[0] = 1.f; return 1; }
+	idx[0] = 2*i; idx[1] = 2*i+1;
+	if(!(n & 1)){ wt[0] = wt[1] = 0.5f; return 2; }
+	float inv = 1.f / (float)n;
+	idx[2] = 2*i+2;
+	wt[0] = (float)(m-i) * inv; wt[1] = (float)m * inv; wt[2] = (float)(i+1) * inv;
+	return 3;
+}
+
+/*! RGBA image pyramid; every level is half the size (rounded down) of the previous one down to 1x1,
+	box filtered, or with a 3 texel footprint along odd sized axes (see mipTaps()).
+	Levels are stored in 4x4 texel blocks, so the 2x2 (or 4x4 for bicubic) footprint of a lookup
+	mostly hits a single cache line instead of 2-4 image rows. Level 0 holds the original texels,
+	lookups on it give the same results as on the source buffer. */
+template<class T> class mipMap_t
+{
+	public:
+		struct texel_t { T c[4]; };
+		typedef tiledArray2D_t<texel_t, 2> level_t;
+
+		//! a single level, with the interface interpolateImage() expects from an image
+		class levelView_t
+		{
+			public:
+				levelView_t(level_t *l): lvl(l) {}
+				int resx() const { return lvl->xSize(); }
+				int resy() const { return lvl->ySize(); }
+				T* operator()(int x, int y) const { return (*lvl)(x, y).c; }
+			protected:
+				level_t *lvl;
+		};
+
+		/*! copy the base image into tiled storage and, if buildLevels is set, filter the smaller levels */
+		mipMap_t(gBuf_t<T, 4> &base, bool buildLevels)
+		{
+			int w = base.resx(), h = base.resy();
+			level_t *l0 = new level_t(w, h);
+			for(int y=0; y<h; ++y)
+				for(int x=0; x<w; ++x)
+				{
+					T *src = base(x, y);
+					T *dst = (*l0)(x, y).c;
+					dst[0] = src[0]; dst[1] = src[1]; dst[2] = src[2]; dst[3] = src[3];
+				}
+			levels.push_back(l0);
+			while(buildLevels && (w > 1 || h > 1))
+			{
+				level_t &prev = *levels.back();
+				int pw = w, ph = h;
+				w = std::max(1, w/2); h = std::max(1, h/2);
+				level_t *l = new level_t(w, h);
+				int yi[3], xi[3];
+				float yw[3], xw[3];
+				for(int y=0; y<h; ++y)
+				{
+					int ny = mipTaps(y, ph, h, yi, yw);
+					for(int x=0; x<w; ++x)
+					{
+						int nx = mipTaps(x, pw, w, xi, xw);
+						float sum[4] = { 0.f, 0.f, 0.f, 0.f };
+						for(int j=0; j<ny; ++j)
+							for(int i=0; i<nx; ++i)
+							{
+								const T *s = prev(xi[i], yi[j]).c;
+								float f = yw[j] * xw[i];
+								for(int k=0; k<4; ++k) sum[k] += f * (float)s[k];
+							}
+						T *dst = (*l)(x, y).c;
+						for(int k=0; k<4; ++k) mipConvert(sum[k], dst[k]);
+					}
+				}
+				levels.push_back(l);
+			}
+		}
+		~mipMap_t()
+		{
+			for(unsigned int i=0; i<levels.size(); ++i) delete levels[i];
+		}
+		int numLevels() const { return levels.size(); }
+		int resx() const { return levels[0]->xSize(); }
+		int resy() const { return levels[0]->ySize(); }
+		levelView_t level(int l) const { return levelView_t(levels[l]); }
+		/*! fractional level whose texels match a lookup footprint of the given width,
+			in texture space (1 is the whole texture) */
+		float lod(float width) const
+		{
+			float texels = width * (float)std::max(resx(), resy());
+			if(!(texels > 1.f)) return 0.f; // also catches NaN from bad differentials
+			return std::min( (float)(levels.size()-1), (float)(std::log(texels) * 1.44269504f) );
+		}
+		//! bytes used by all levels
+		unsigned int memSize() const
+		{
+			unsigned int s = 0;
+			for(unsigned int i=0; i<levels.size(); ++i) s += levels[i]->size() * sizeof(texel_t);
+			return s;
+		}
+	protected:
+		mipMap_t(const mipMap_t &m); //forbidden
+		std::vector<level_t *> levels;
+};
+
+__END_YAFRAY
+
+#endif // Y_MIPMAP_H
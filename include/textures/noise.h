@@ -15,6 +15,12 @@ public:
 	noiseGenerator_t() {}
 	virtual ~noiseGenerator_t() {}
 	virtual PFLOAT operator() (const point3d_t &pt) const=0;
+	/*! evaluate n points at once, res[i] = (*this)(pt[i]). Generators with a SIMD version
+		process 4 points per step, calls with 4 or 8 points are the intended use */
+	virtual void batch(const point3d_t *pt, PFLOAT *res, int n) const
+	{
+		for(int i=0; i<n; ++i) res[i] = (*this)(pt[i]);
+	}
 	// offset only added by blendernoise
 	virtual point3d_t offset(const point3d_t &pt) const { return pt; }
 };
@@ -27,6 +33,7 @@ public:
 	newPerlin_t() {}
 	virtual ~newPerlin_t() {}
 	virtual PFLOAT operator() (const point3d_t &pt) const;
+	virtual void batch(const point3d_t *pt, PFLOAT *res, int n) const;
 private:
 	PFLOAT fade(PFLOAT t) const { return t*t*t*(t*(t*6 - 15) + 10); }
 	PFLOAT grad(int hash, PFLOAT x, PFLOAT y, PFLOAT z) const
@@ -55,6 +62,7 @@ public:
 	blenderNoise_t() {}
 	virtual ~blenderNoise_t() {}
 	virtual PFLOAT operator() (const point3d_t &pt) const;
+	virtual void batch(const point3d_t *pt, PFLOAT *res, int n) const;
 	// offset texture point coordinates by one
 	virtual point3d_t offset(const point3d_t &pt) const { return pt+point3d_t(1.0, 1.0, 1.0); }
 };
@@ -139,12 +147,16 @@ public:
 		//if (distfunc) { delete distfunc;  distfunc=NULL; }
 	}
 	virtual PFLOAT operator() (const point3d_t &pt) const;
+	//! only distances are needed here, real, squared and chebychev metrics have a SIMD version
+	virtual void batch(const point3d_t *pt, PFLOAT *res, int n) const;
 	PFLOAT getDistance(int x, PFLOAT da[4]) const { return da[x & 3]; }
 	point3d_t getPoint(int x, point3d_t pa[4]) const { return pa[x & 3]; }
 	void setMinkovskyExponent(PFLOAT me) { mk_exp=me; }
 	void getFeatures(const point3d_t &pt, PFLOAT da[4], point3d_t pa[4]) const;
 	void setDistM(dMetricType dm);
 protected:
+	//! noise value of the selected voronoi type from the feature distances
+	PFLOAT featureValue(const PFLOAT da[4]) const;
 	voronoiType vType;
 	dMetricType dmType;
 	PFLOAT mk_exp, w1, w2, w3,w4;
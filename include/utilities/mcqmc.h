@@ -129,40 +129,39 @@ inline Fnv32_t fnv_32a_buf(Fnv32_t value)
 	return hash;
 }
 
-/* multiply-with-carry generator x(n) = a*x(n-1) + carry mod 2^32.
-   period = (a*2^31)-1 */
-
-/* Choose a value for a from this list
-   1791398085 1929682203 1683268614 1965537969 1675393560
-   1967773755 1517746329 1447497129 1655692410 1606218150
-   2051013963 1075433238 1557985959 1781943330 1893513180
-   1631296680 2131995753 2083801278 1873196400 1554115554
+/*	Counter based generator: number i of a stream is a hash of i plus an offset that is a hash
+	of seed and stream. The numbers only depend on seed, stream and position, so a thread can
+	start any stream without shared state and the result does not depend on what other threads
+	drew before. The hash is a bijection of 32 bit integers (Wellons' "triple32"), so a stream
+	repeats only after 2^32 numbers.
 */
-#define y_a 1791398085
-#define y_ah (y_a >> 16)
-#define y_al (y_a & 65535)
-
 class random_t
 {
 	public:
-		random_t(): x(30903), c(0) {}
-		random_t(unsigned int seed): x(30903), c(seed) {}
-		double operator()()
+		random_t(): key(0), ctr(0) { setStream(0); }
+		random_t(unsigned int seed, unsigned int s=0): key(seed), ctr(0) { setStream(s); }
+		//! restart at the first number of stream s
+		void setStream(unsigned int s)
 		{
-			unsigned int xh = x>>16, xl = x & 65535;
-			x = x * y_a + c;
-			c = xh*y_ah + ((xh*y_al) >> 16) + ((xl*y_ah) >> 16);
-			if (xl*y_al >= ~c + 1) c++;
-			return (double)x/4294967296.0;
+			stream = s;
+			offset = hash(hash(s) ^ key);
+			ctr = 0;
+		}
+		unsigned int getStream() const { return stream; }
+		unsigned int nextI(){ return hash(offset + 0x9e3779b9 * ctr++); }
+		double operator()(){ return (double)nextI()/4294967296.0; }
+		static unsigned int hash(unsigned int x)
+		{
+			x ^= x >> 17; x *= 0xed5ad4bb;
+			x ^= x >> 11; x *= 0xac4c1b51;
+			x ^= x >> 15; x *= 0x31848bab;
+			x ^= x >> 14;
+			return x;
 		}
 	protected:
-		unsigned int x, c;
+		unsigned int key, stream, offset, ctr;
 };
 
-#undef y_a
-#undef y_ah
-#undef y_al
-
 __END_YAFRAY
 
 #endif	//__MCQMC_H
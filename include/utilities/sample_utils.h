@@ -110,6 +110,72 @@ class pdf1D_t
 	int count;
 };
 
+/*! discrete distribution sampled in constant time with Walker's alias method.
+	Draws index i with probability f[i]/sum(f), like pdf1D_t::DSample(), but a given u
+	does not map to the same index, neighbouring u values may land far apart.
+*/
+class aliasTable_t
+{
+	public:
+	aliasTable_t(const float *f, int n): count(n)
+	{
+		prob = new float[n];
+		alias = new int[n];
+		pdfs = new float[n];
+		double sum = 0.0;
+		for(int i=0; i<n; ++i) sum += f[i];
+		integral = (float)sum;
+		double *scaled = new double[n];
+		int *under = new int[n], *over = new int[n];
+		int nu = 0, no = 0;
+		for(int i=0; i<n; ++i)
+		{
+			pdfs[i] = (sum > 0.0) ? (float)(f[i] / sum) : 1.f/(float)n;
+			scaled[i] = (sum > 0.0) ? (double)f[i] * (double)n / sum : 1.0;
+			alias[i] = i;
+			if(scaled[i] < 1.0) under[nu++] = i;
+			else over[no++] = i;
+		}
+		while(nu > 0 && no > 0)
+		{
+			int s = under[--nu], l = over[no-1];
+			prob[s] = (float)scaled[s];
+			alias[s] = l;
+			scaled[l] = (scaled[l] + scaled[s]) - 1.0;
+			if(scaled[l] < 1.0){ --no; under[nu++] = l; }
+		}
+		// what is left is 1 up to rounding errors
+		while(no > 0) prob[over[--no]] = 1.f;
+		while(nu > 0) prob[under[--nu]] = 1.f;
+		delete[] scaled;
+		delete[] under;
+		delete[] over;
+	}
+	~aliasTable_t(){ delete[] prob; delete[] alias; delete[] pdfs; }
+	/*! take a discrete sample, u in [0,1) is replaced by a new uniform sample in [0,1)
+		that can be used to sample inside the chosen item */
+	int Sample(float &u, float *pdf)const
+	{
+		float s = u * count;
+		int i = std::min((int)s, count-1);
+		float f = s - (float)i;
+		if(f < prob[i]) u = f / prob[i];
+		else
+		{
+			u = (f - prob[i]) / (1.f - prob[i]);
+			i = alias[i];
+		}
+		u = std::min(u, 0.99999994f);
+		if(pdf) *pdf = pdfs[i];
+		return i;
+	}
+	float *prob; //!< probability to keep the index of the bucket
+	int *alias; //!< index taken otherwise
+	float *pdfs; //!< normalized probability of each index
+	float integral;
+	int count;
+};
+
 // rotate the coord-system D, U, V with minimum rotation so that D gets
 // mapped to D2, i.e. rotate around D^D2.
 // V is assumed to be D^U, accordingly V2 is D2^U2; all input vectors must be normalized!
@@ -70,6 +70,9 @@ public:
 		return data[offset];
 	}
 protected:
+	// the array owns its memory, copies would free it twice
+	tiledArray2D_t(const tiledArray2D_t &);
+	tiledArray2D_t& operator=(const tiledArray2D_t &);
 	int block(int a) const { return (a >> logBlockSize); }
 	int offset(int a) const { return (a & blockMask); }
 	// BlockedArray Private Data
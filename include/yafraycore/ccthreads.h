@@ -12,8 +12,24 @@
 #include<semaphore.h>
 #endif
 
+#if defined(_MSC_VER)
+#include<intrin.h>
+#endif
+
 namespace yafthreads {
 
+/*! Memory barrier for data that is published through a flag instead of a lock: the writer calls it
+	after writing the data and before setting the flag, readers after seeing the flag set. */
+inline void memoryBarrier()
+{
+#if defined(__GNUC__)
+	__sync_synchronize();
+#elif defined(_MSC_VER)
+	// msvc gives volatile accesses acquire/release semantics, only keep the compiler from reordering
+	_ReadWriteBarrier();
+#endif
+}
+
 /*! The try to provide a platform independant mutex, as a matter of fact
 	it is simply a pthread wrapper now...
 */
@@ -46,6 +62,8 @@ class YAFRAYCORE_EXPORT conditionVar_t
 		void lock();
 		void unlock();
 		void signal();
+		//! wake all waiting threads, not just one
+		void broadcast();
 		void wait();
 	protected:
 		conditionVar_t(const conditionVar_t &m);
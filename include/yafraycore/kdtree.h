@@ -129,10 +129,11 @@ class YAFRAYCORE_EXPORT triKdTree_t
 public:
 	triKdTree_t(const triangle_t **v, int np, int depth=-1, int leafSize=2,
 			float cost_ratio=0.35, float emptyBonus=0.33);
-	bool Intersect(const ray_t &ray, PFLOAT dist, triangle_t **tr, PFLOAT &Z, void *udat) const;
+	//! nodeCount, if given, gets the number of visited nodes added
+	bool Intersect(const ray_t &ray, PFLOAT dist, triangle_t **tr, PFLOAT &Z, void *udat, unsigned int *nodeCount=0) const;
 //	bool IntersectDBG(const ray_t &ray, PFLOAT dist, triangle_t **tr, PFLOAT &Z) const;
-	bool IntersectS(const ray_t &ray, PFLOAT dist, triangle_t **tr) const;
-	bool IntersectTS(renderState_t &state, const ray_t &ray, int maxDepth, PFLOAT dist, triangle_t **tr, color_t &filt) const;
+	bool IntersectS(const ray_t &ray, PFLOAT dist, triangle_t **tr, unsigned int *nodeCount=0) const;
+	bool IntersectTS(renderState_t &state, const ray_t &ray, int maxDepth, PFLOAT dist, triangle_t **tr, color_t &filt, unsigned int *nodeCount=0) const;
 //	bool IntersectO(const point3d_t &from, const vector3d_t &ray, PFLOAT dist, triangle_t **tr, PFLOAT &Z) const;
 	bound_t getBound(){ return treeBound; }
 	~triKdTree_t();
@@ -12,6 +12,24 @@ class renderEnvironment_t;
 
 enum nodeType_e { VIEW_DEP=1, VIEW_INDEP=1<<1 };
 
+/*! a node list compiled to a flat instruction array (see nodeMaterial_t::compileNodes()).
+	Mix and layer nodes are evaluated inline, all other nodes through their virtual eval().
+	Nodes that only depend on constant inputs have been evaluated at compile time; their results
+	are either baked into the instructions reading them or copied to the stack if the material reads them */
+class YAFRAYCORE_EXPORT nodeProgram_t
+{
+	friend class nodeMaterial_t;
+	public:
+		void eval(nodeStack_t &stack, const renderState_t &state, const surfacePoint_t &sp) const
+			{ run(stack, state, sp, 0, 0); }
+		void eval(nodeStack_t &stack, const renderState_t &state, const surfacePoint_t &sp, const vector3d_t &wo, const vector3d_t &wi) const
+			{ run(stack, state, sp, &wo, &wi); }
+	protected:
+		void run(nodeStack_t &stack, const renderState_t &state, const surfacePoint_t &sp, const vector3d_t *wo, const vector3d_t *wi) const;
+		std::vector<nodeInstr_t> code;
+		std::vector< std::pair<unsigned int, nodeResult_t> > consts; //!< folded results the material reads from the stack
+};
+
 class YAFRAYCORE_EXPORT nodeMaterial_t: public material_t
 {
 	public:
@@ -28,12 +46,20 @@ class YAFRAYCORE_EXPORT nodeMaterial_t: public material_t
 			std::vector<shaderNode_t *>::const_iterator iter, end=nodes.end();
 			for(iter = nodes.begin(); iter!=end; ++iter) (*iter)->eval(stack, state, sp);
 		}
+		/*! compile allSorted, allViewdep and allViewindep into sortedCode, viewdepCode and viewindepCode;
+			call once the node lists are complete */
+		void compileNodes();
+		void compileNodeList(const std::vector<shaderNode_t *> &nodes, nodeProgram_t &prog) const;
 		void evalBump(nodeStack_t &stack, const renderState_t &state, const surfacePoint_t &sp, const shaderNode_t *bumpS)const;
 		/*! filter out nodes with specific properties */
 		void filterNodes(const std::vector<shaderNode_t *> &input, std::vector<shaderNode_t *> &output, int flags);
 		virtual ~nodeMaterial_t();
 		
 		std::vector<shaderNode_t *> allNodes, allSorted, allViewdep, allViewindep, bumpNodes;
+		std::vector<shaderNode_t *> rootNodes; //!< the nodes the material reads, as given to solveNodesOrder()
+		nodeProgram_t sortedCode, viewdepCode, viewindepCode;
+		std::vector<nodeResult_t> constResults; //!< results of folded nodes, indexed by node ID
+		std::vector<char> isConst, constRead;
 		std::map<std::string,shaderNode_t *> shader_table;
 		size_t reqNodeMem;
 };
@@ -0,0 +1,278 @@
+/****************************************************************************
+ *
+ *          nodeops.h: the math of the basic shader nodes
+ *      This is part of the yafray package
+ *      Copyright (C) 2009 BioWare
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+
+#ifndef Y_NODEOPS_H
+#define Y_NODEOPS_H
+
+#include <core_api/shader.h>
+#include <cmath>
+#include <algorithm>
+
+/*	Shared by the mix and layer node plugins and the node program interpreter of nodeMaterial_t,
+	so compiled and plain node evaluation give the same results. */
+
+__BEGIN_YAFRAY
+
+inline color_t texture_rgb_blend(const color_t &tex, const color_t &out, CFLOAT fact, CFLOAT facg, mix_modes blendtype)
+{
+	switch(blendtype) {
+		case MN_MULT:
+			fact *= facg;
+			return (color_t(1.f-facg) + fact*tex)*out;
+
+		case MN_SCREEN: {
+			color_t white(1.0);
+			fact *= facg;
+			return white - (color_t(1.f-facg) + fact*(white-tex)) * (white-out);
+		}
+
+		case MN_SUB:
+			fact = -fact;
+		case MN_ADD:
+			fact *= facg;
+			return fact*tex + out;
+
+		case MN_DIV: {
+			fact *= facg;
+			color_t itex(tex);
+			itex.invertRGB();
+			return (1.f-fact)*out + fact*out*itex;
+		}
+
+		case MN_DIFF: {
+			fact *= facg;
+			color_t tmo(tex-out);
+			tmo.absRGB();
+			return (1.f-fact)*out + fact*tmo;
+		}
+
+		case MN_DARK: {
+			fact *= facg;
+			color_t col(fact*tex);
+			col.darkenRGB(out);
+			return col;
+		}
+
+		case MN_LIGHT: {
+			fact *= facg;
+			color_t col(fact*tex);
+			col.lightenRGB(out);
+			return col;
+		}
+
+		default:
+		case MN_MIX:
+			fact *= facg;
+			return fact*tex + (1.f-fact)*out;
+	}
+}
+
+inline CFLOAT texture_value_blend(CFLOAT tex, CFLOAT out, CFLOAT fact, CFLOAT facg, mix_modes blendtype, bool flip)
+{
+	fact *= facg;
+	CFLOAT facm = 1.f-fact;
+	if (flip) std::swap(fact, facm);
+
+	switch(blendtype) {
+		case MN_MULT:
+			facm = 1.f-facg;
+			return (facm+fact*tex)*out;
+
+		case MN_SCREEN:
+			facm = 1.f-facg;
+			return 1.f-(facm+fact*(1.f-tex))*(1.f-out);
+
+		case MN_SUB:
+			fact = -fact;
+		case MN_ADD:
+			return fact*tex + out;
+
+		case MN_DIV:
+			if (tex==0.f) return 0.f;
+			return facm*out + fact*out/tex;
+
+		case MN_DIFF:
+			return facm*out + fact*fabs(tex-out);
+
+		case MN_DARK: {
+			CFLOAT col = fact*tex;
+			if (col<out) return col;
+			return out;
+		}
+
+		case MN_LIGHT: {
+			CFLOAT col = fact*tex;
+			if (col>out) return col;
+			return out;
+		}
+
+		default:
+		case MN_MIX:
+			return fact*tex + facm*out;
+	}
+}
+
+//! result of a mix node; f2 is the weight of the second input
+inline nodeResult_t mixNodeResult(mix_modes mode, CFLOAT f2, colorA_t cin1, colorA_t cin2, CFLOAT fin1, CFLOAT fin2)
+{
+	CFLOAT f1 = 1.f - f2;
+	switch(mode)
+	{
+		case MN_ADD:
+			cin1 += f2 * cin2;
+			fin1 += f2 * fin2;
+			return nodeResult_t(cin1, fin1);
+
+		case MN_MULT:
+			// the scalar passes input 1 unchanged
+			cin1 *= colorA_t(f1) + f2 * cin2;
+			return nodeResult_t(cin1, fin1);
+
+		case MN_SUB:
+			cin1 -= f2 * cin2;
+			fin1 -= f2 * fin2;
+			return nodeResult_t(cin1, fin1);
+
+		case MN_SCREEN: {
+			colorA_t color = colorA_t(1.f) - (colorA_t(f1) + f2 * (1.f - cin2)) * (1.f - cin1);
+			CFLOAT scalar   = 1.0 - (f1 + f2*(1.f - fin2)) * (1.f -  fin1);
+			return nodeResult_t(color, scalar);
+		}
+
+		case MN_DIFF:
+			cin1.R = f1*cin1.R + f2*std::fabs(cin1.R - cin2.R);
+			cin1.G = f1*cin1.G + f2*std::fabs(cin1.G - cin2.G);
+			cin1.B = f1*cin1.B + f2*std::fabs(cin1.B - cin2.B);
+			cin1.A = f1*cin1.A + f2*std::fabs(cin1.A - cin2.A);
+			fin1   = f1*fin1 + f2*std::fabs(fin1 - fin2);
+			return nodeResult_t(cin1, fin1);
+
+		case MN_DARK:
+			cin2 *= f2;
+			if(cin2.R < cin1.R) cin1.R = cin2.R;
+			if(cin2.G < cin1.G) cin1.G = cin2.G;
+			if(cin2.B < cin1.B) cin1.B = cin2.B;
+			if(cin2.A < cin1.A) cin1.A = cin2.A;
+			fin2 *= f2;
+			if(fin2 < fin1) fin1 = fin2;
+			return nodeResult_t(cin1, fin1);
+
+		case MN_LIGHT:
+			cin2 *= f2;
+			if(cin2.R > cin1.R) cin1.R = cin2.R;
+			if(cin2.G > cin1.G) cin1.G = cin2.G;
+			if(cin2.B > cin1.B) cin1.B = cin2.B;
+			if(cin2.A > cin1.A) cin1.A = cin2.A;
+			fin2 *= f2;
+			if(fin2 > fin1) fin1 = fin2;
+			return nodeResult_t(cin1, fin1);
+
+		case MN_OVERLAY: {
+			colorA_t color;
+			color.R = (cin1.R < 0.5f) ? cin1.R * (f1 + 2.0f*f2*cin2.R) : 1.0 - (f1 + 2.0f*f2*(1.0 - cin2.R)) * (1.0 - cin1.R);
+			color.G = (cin1.G < 0.5f) ? cin1.G * (f1 + 2.0f*f2*cin2.G) : 1.0 - (f1 + 2.0f*f2*(1.0 - cin2.G)) * (1.0 - cin1.G);
+			color.B = (cin1.B < 0.5f) ? cin1.B * (f1 + 2.0f*f2*cin2.B) : 1.0 - (f1 + 2.0f*f2*(1.0 - cin2.B)) * (1.0 - cin1.B);
+			color.A = (cin1.A < 0.5f) ? cin1.A * (f1 + 2.0f*f2*cin2.A) : 1.0 - (f1 + 2.0f*f2*(1.0 - cin2.A)) * (1.0 - cin1.A);
+			CFLOAT scalar = (fin1 < 0.5f) ? fin1 * (f1 + 2.0f*f2*fin2) : 1.0 - (f1 + 2.0f*f2*(1.0 - fin2)) * (1.0 - fin1);
+			return nodeResult_t(color, scalar);
+		}
+
+		default:
+		case MN_MIX:
+			return nodeResult_t(f1 * cin1 + f2 * cin2, f1 * fin1 + f2 * fin2);
+	}
+}
+
+/*! result of a texture layer node: blends the input (usually a texture mapper) onto the
+	result of the upper layer (or the base values) */
+inline nodeResult_t layerNodeResult(const layerParams_t &p, colorA_t rcol, CFLOAT rval, const nodeResult_t &input)
+{
+	colorA_t texcolor;
+	CFLOAT Tin=0.f, Ta=1.f, stencilTin = rcol.A;
+
+	// == get texture input color ==
+	bool TEX_RGB = p.color_input;
+	if(p.color_input)
+	{
+		texcolor = input.col;
+		Ta=texcolor.A;
+	}
+	else Tin = input.f;
+
+	if(p.texflag & TXF_RGBTOINT){
+		Tin = 0.35f*texcolor.getR() + 0.45f*texcolor.getG() + 0.2f*texcolor.getB();
+		TEX_RGB = false;
+	}
+	if(p.texflag & TXF_NEGATIVE){
+		if (TEX_RGB) texcolor = colorA_t(1.f)-texcolor;
+		Tin = 1.f-Tin;
+	}
+	CFLOAT fact;
+	if(p.texflag & TXF_STENCIL)
+	{
+		if(TEX_RGB) // only scalar input affects stencil...?
+		{
+			fact = Ta;
+			Ta *= stencilTin;
+			stencilTin *= fact;
+		}
+		else
+		{
+			fact = Tin;
+			Tin *= stencilTin;
+			stencilTin *= fact;
+		}
+	}
+
+	// color type modulation
+	if (p.do_color)
+	{
+		if(!TEX_RGB)	texcolor = p.default_col;
+		else			Tin = Ta;
+
+		rcol = texture_rgb_blend(texcolor, rcol, Tin, stencilTin * p.colfac, p.mode);
+		rcol.clampRGB0();
+	}
+
+	// intensity type modulation
+	if (p.do_scalar)
+	{
+		if(TEX_RGB)
+		{
+			if(p.use_alpha)
+			{
+				Tin = Ta;
+				if(p.texflag & TXF_NEGATIVE) Tin = 1.f - Tin;
+			}
+			else Tin = 0.35f*texcolor.getR() + 0.45f*texcolor.getG() + 0.2f*texcolor.getB();
+		}
+
+		rval = texture_value_blend(p.default_val, rval, Tin, stencilTin * p.valfac, p.mode, false);
+		if(rval<0.f) rval=0.f;
+	}
+	rcol.A = stencilTin;
+	return nodeResult_t(rcol, rval);
+}
+
+__END_YAFRAY
+
+#endif // Y_NODEOPS_H
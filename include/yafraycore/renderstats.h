@@ -0,0 +1,94 @@
+/****************************************************************************
+ *
+ *          renderstats.h: per thread counters of the render hot paths
+ *      This is part of the yafray package
+ *      Copyright (C) 2009 BioWare
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+
+#ifndef Y_RENDERSTATS_H
+#define Y_RENDERSTATS_H
+
+#include <yafray_config.h>
+#include <vector>
+
+__BEGIN_YAFRAY
+
+/*	Every render thread counts into its own threadStats_t (reached through renderState_t::stats),
+	so counting needs no locks; scene_t::render() sums them up once all threads are done.
+	Since a lightmap bake renders one mesh, the totals of a render are the cost of that mesh. */
+
+enum renderCounter_t
+{
+	RS_RAYS = 0,		//!< closest hit rays traced (scene_t::intersect)
+	RS_SHADOW_RAYS,		//!< occlusion rays (scene_t::isShadowed)
+	RS_KD_NODES,		//!< kd-tree nodes visited by both ray types
+	RS_PHOTON_LOOKUPS,	//!< photon map and radiance map queries
+	RS_FG_RAYS,			//!< final gather rays
+	RS_FG_POINTS,		//!< final gather points, i.e. gathers of several paths
+	RS_FG_VERTICES,		//!< shaded vertices of final gather paths
+	RS_FG_FAST_VERTICES,	//!< those of them on constant diffuse materials
+	RS_SAMPLES,			//!< pixel/texel samples integrated
+	RS_TEXELS_SKIPPED,	//!< texels not integrated in a pass: no surface under any sample or no adaptive resampling needed
+	RS_NUM_COUNTERS
+};
+
+enum renderStage_t
+{
+	RS_STAGE_TREE = 0,	//!< build of the kd-tree the render used, which may have happened in an earlier update()
+	RS_STAGE_PREPROCESS,	//!< light init and integrator preprocessing (photon shooting etc.)
+	RS_STAGE_RENDER,	//!< integrator render() including all passes
+	RS_STAGE_TILES,		//!< time spent inside renderTile(), summed over all threads
+	RS_NUM_STAGES
+};
+
+struct YAFRAYCORE_EXPORT threadStats_t
+{
+	threadStats_t(){ reset(); }
+	void reset();
+	double count[RS_NUM_COUNTERS];
+	double busy; //!< seconds spent rendering tiles
+	char pad[64]; //!< keep threads from sharing cache lines
+};
+
+class YAFRAYCORE_EXPORT renderStats_t
+{
+	public:
+		renderStats_t();
+		//! drop the counts of the last render, one threadStats_t per render thread. The tree build time is
+		//! kept, it is only replaced when update() builds a new tree
+		void reset(int nthreads);
+		threadStats_t* thread(int id);
+		//! sum up all thread counters, only call when no render thread runs
+		void aggregate();
+		double total(renderCounter_t c) const { return totals[c]; }
+		double stageTime(renderStage_t s) const { return stages[s]; }
+		void setStageTime(renderStage_t s, double t) { stages[s] = t; }
+		int numThreads() const { return (int)threads.size(); }
+		static const char* counterName(renderCounter_t c);
+		static const char* stageName(renderStage_t s);
+		//! wall clock seconds, only meaningful as a difference
+		static double clock();
+	protected:
+		std::vector<threadStats_t> threads;
+		double totals[RS_NUM_COUNTERS];
+		double stages[RS_NUM_STAGES];
+};
+
+__END_YAFRAY
+
+#endif // Y_RENDERSTATS_H
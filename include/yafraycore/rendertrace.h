@@ -0,0 +1,96 @@
+/****************************************************************************
+ *
+ *          rendertrace.h: timeline of the render phases in chrome trace format
+ *      This is part of the yafray package
+ *      Copyright (C) 2009 BioWare
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+
+#ifndef Y_RENDERTRACE_H
+#define Y_RENDERTRACE_H
+
+#include <yafray_config.h>
+#include <yafraycore/ccthreads.h>
+#include <cstdio>
+#include <string>
+
+__BEGIN_YAFRAY
+
+/*	Process wide trace of the render phases (tree build, photon shooting, tiles, film flush...),
+	written as a JSON array of complete events that chrome://tracing and perfetto load directly.
+	Events are written as soon as they end, so the trace of an aborted bake is still readable.
+	While no trace file is open, traceScope_t only tests a flag. */
+
+class YAFRAYCORE_EXPORT renderTrace_t
+{
+	public:
+		static renderTrace_t& instance();
+		//! start a new trace file, closes the current one
+		bool open(const std::string &filename);
+		//! terminate the JSON array and close the file
+		void close();
+		bool enabled() const { return file != 0; }
+		/*! mesh id attached to the following events of the calling thread, -1 for none. Kept per thread,
+			so scenes rendering at the same time each tag their own events; render threads take the id
+			of the thread that started the pass */
+		void setMesh(int id);
+		int getMesh() const;
+		//! microseconds since the trace was opened
+		double now() const;
+		/*! write one event that started at begin (see now()) and ends now;
+			tid 0 is the main thread, render thread i is i+1. tile is x, y, width, height or null */
+		void complete(const char *name, int tid, double begin, const int *tile=0);
+		void flush();
+	protected:
+		renderTrace_t();
+		~renderTrace_t();
+		std::FILE *file;
+#if HAVE_PTHREAD
+		pthread_key_t meshKey; //!< mesh id + 1 of each thread, so 0 (the initial value) means none
+#else
+		int mesh;
+#endif
+		double start;
+		yafthreads::mutex_t mutex;
+};
+
+//! traces the lifetime of the object as one event
+class traceScope_t
+{
+	public:
+		traceScope_t(const char *n, int t=0, const int *area=0): name(0), tid(t), tile(area), begin(0.0)
+		{
+			renderTrace_t &trace = renderTrace_t::instance();
+			if(trace.enabled()){ name = n; begin = trace.now(); }
+		}
+		~traceScope_t(){ end(); }
+		//! finish the event before the object goes out of scope
+		void end()
+		{
+			if(name) renderTrace_t::instance().complete(name, tid, begin, tile);
+			name = 0;
+		}
+	protected:
+		const char *name;
+		int tid;
+		const int *tile;
+		double begin;
+};
+
+__END_YAFRAY
+
+#endif // Y_RENDERTRACE_H
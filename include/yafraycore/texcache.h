@@ -0,0 +1,153 @@
+/****************************************************************************
+ *
+ *          texcache.h: process wide cache of decoded image files
+ *      This is part of the yafray package
+ *      Copyright (C) 2009 BioWare
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ */
+
+#ifndef Y_TEXCACHE_H
+#define Y_TEXCACHE_H
+
+#include <yafray_config.h>
+#include <yafraycore/ccthreads.h>
+#include <textures/mipmap.h>
+#include <string>
+#include <map>
+#include <vector>
+#include <ctime>
+
+__BEGIN_YAFRAY
+
+class textureCache_t;
+
+/*! A decoded image file shared by all textures that reference it. The file is only decoded
+	(and its mip pyramid built) the first time a texture actually looks it up, so images that
+	are never hit by a ray cost nothing. Once decoded, the data stays until no texture references
+	the image any more. */
+class YAFRAYCORE_EXPORT cachedImage_t
+{
+	friend class textureCache_t;
+	public:
+		/*! decodes filename into either an 8bit or a float buffer, returns false on failure */
+		typedef bool (imageLoader_t)(const char *filename, cBuffer_t *&image, fcBuffer_t *&float_image);
+
+		/*! make sure the image is decoded and mark it as used by the current render.
+			Call before any access to image()/floatImage(), safe from all render threads */
+		inline void use();
+		//! 8bit pyramid, 0 if the file holds float data or could not be decoded
+		const mipMap_t<unsigned char>* image() const { return uchar_img; }
+		//! float pyramid, 0 if the file holds 8bit data or could not be decoded
+		const mipMap_t<float>* floatImage() const { return float_img; }
+		const std::string& fileName() const { return file; }
+	protected:
+		cachedImage_t(textureCache_t *c, const std::string &filename, bool mip, long size, time_t mtime);
+		~cachedImage_t();
+		void load();
+		void setBuffers(cBuffer_t *im, fcBuffer_t *f_im);
+
+		textureCache_t *cache;
+		std::string file;
+		bool mipmap;
+		long fileSize; //!< size of the file when the entry was created, -1 if it could not be read
+		time_t fileTime; //!< modification time of the file when the entry was created
+		imageLoader_t *loader;
+		mipMap_t<unsigned char> *uchar_img;
+		mipMap_t<float> *float_img;
+		volatile bool loaded; //!< only set once the pyramids are complete, never cleared while referenced
+		volatile bool failed;
+		size_t bytes; //!< memory held by the decoded pyramid
+		int refs;
+		volatile int stamp; //!< last render that used the image
+		yafthreads::mutex_t mutex;
+	private:
+		cachedImage_t(const cachedImage_t &c); //forbidden
+};
+
+/*! Process wide table of decoded image files, keyed by file name, whether a mip pyramid is
+	wanted, and the size and modification time of the file, so a file that changed on disk gets a new
+	entry (the old one is freed like any other unreferenced image). Textures acquire() their file once
+	and release() it on destruction.
+	With a memory budget set, images no texture references any longer are kept for reuse by
+	later scenes, and trim() frees the least recently used of them at the start of every render until
+	the budget is met. Images still referenced are never freed, a render may run on another thread
+	(or another scene) and look them up at any time, so their memory can exceed the budget.
+	Without a budget (the default), unreferenced images are freed right away. */
+class YAFRAYCORE_EXPORT textureCache_t
+{
+	friend class cachedImage_t;
+	public:
+		static textureCache_t& instance();
+
+		/*! find or create the entry for filename and add a reference. Nothing is decoded here,
+			loader is called on the first lookup */
+		cachedImage_t* acquire(const std::string &filename, bool mipmap, cachedImage_t::imageLoader_t *loader);
+		/*! like acquire(), but for buffers that already had to be decoded (e.g. to find out the file
+			format). Takes ownership of the buffers; they are dropped if the file is cached already */
+		cachedImage_t* insert(const std::string &filename, bool mipmap, cBuffer_t *im, fcBuffer_t *f_im);
+		void release(cachedImage_t *img);
+
+		//! memory budget in bytes for decoded images, 0 means no limit
+		void setBudget(size_t bytes);
+		size_t getBudget() const { return budget; }
+		size_t memUsed() const { return used; }
+
+		/*! free least recently used unreferenced images until the budget is met and start a new
+			usage period; scene_t::render() calls it before anything else happens */
+		void trim();
+	protected:
+		textureCache_t();
+		~textureCache_t();
+		void account(long delta);
+		static bool lruLess(const cachedImage_t *a, const cachedImage_t *b);
+
+		struct key_t
+		{
+			key_t(const std::string &f, bool m, long s, time_t t): file(f), mipmap(m), size(s), mtime(t) {}
+			bool operator<(const key_t &k) const;
+			std::string file;
+			bool mipmap;
+			long size;
+			time_t mtime;
+		};
+		//! stat filename to build its current key
+		static key_t fileKey(const std::string &filename, bool mipmap);
+		static key_t keyOf(const cachedImage_t *img) { return key_t(img->file, img->mipmap, img->fileSize, img->fileTime); }
+		//! remove unreferenced entries of key.file made from an older version of the file; mutex must be held
+		void dropStale(const key_t &key, std::vector<cachedImage_t*> &dropped);
+
+		std::map<key_t, cachedImage_t*> images;
+		size_t budget, used;
+		volatile int stamp;
+		int decodes, reuses;
+		yafthreads::mutex_t mutex;
+	private:
+		textureCache_t(const textureCache_t &c); //forbidden
+};
+
+inline void cachedImage_t::use()
+{
+	// only the first lookups (and those of a file that fails to decode) take the mutex
+	if(loaded) yafthreads::memoryBarrier();
+	else if(!failed) load();
+	// compare first, so render threads don't keep writing the same cache line
+	if(stamp != cache->stamp) stamp = cache->stamp;
+}
+
+__END_YAFRAY
+
+#endif // Y_TEXCACHE_H
@@ -6,6 +6,9 @@
 
 #include <core_api/output.h>
 #include <string>
+#include <vector>
+#include <map>
+#include <cstdio>
 
 
 __BEGIN_YAFRAY
@@ -32,6 +35,28 @@ class YAFRAYCORE_EXPORT outTga_t : public colorOutput_t
 		std::string outfile;
 };
 
+/*! color output that writes the tga file while rendering: rows are only kept until they get flushed
+	with flushArea() and are then written to their place in the file, so memory use does not depend on
+	the image height. flush() writes remaining rows and the footer and closes the file.
+*/
+class YAFRAYCORE_EXPORT outTgaStream_t : public colorOutput_t
+{
+	public:
+		outTgaStream_t(int resx, int resy, const char *fname, bool sv_alpha=false);
+		virtual bool putPixel(int x, int y, const float *c, int channels);
+		virtual void flush();
+		virtual void flushArea(int x0, int y0, int x1, int y1);
+		virtual ~outTgaStream_t();
+	protected:
+		outTgaStream_t(const outTgaStream_t &o) {}; //forbidden
+		bool openFile();
+		bool save_alpha;
+		int sizex, sizey, bpp;
+		std::string outfile;
+		FILE *fp;
+		std::map<int, std::vector<unsigned char> > rows; //!< rows not yet written, BGR(A)
+};
+
 __END_YAFRAY
 
 
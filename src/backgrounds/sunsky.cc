@@ -24,6 +24,7 @@
 #include <core_api/background.h>
 #include <core_api/params.h>
 #include <lights/bglight.h>
+#include <sstream>
 
 __BEGIN_YAFRAY
 
@@ -39,7 +40,7 @@ class sunskyBackground_t: public background_t
 	public:
 		sunskyBackground_t(const point3d_t dir, PFLOAT turb,
 			PFLOAT a_var, PFLOAT b_var, PFLOAT c_var, PFLOAT d_var, PFLOAT e_var,
-			bool bgl, int bgsamples, CFLOAT pwr);
+			bool bgl, int bgsamples, CFLOAT pwr, int bgres=360, const std::string &bgkey=std::string());
 		virtual color_t operator() (const ray_t &ray, renderState_t &state, bool filtered=false) const;
 		virtual color_t eval(const ray_t &ray, bool filtered=false) const;
 		virtual light_t* getLight() const { return envLight; }
@@ -60,7 +61,8 @@ class sunskyBackground_t: public background_t
 };
 
 sunskyBackground_t::sunskyBackground_t(const point3d_t dir, PFLOAT turb,
-		PFLOAT a_var, PFLOAT b_var, PFLOAT c_var, PFLOAT d_var, PFLOAT e_var, bool bgl, int bgsamples, CFLOAT pwr):
+		PFLOAT a_var, PFLOAT b_var, PFLOAT c_var, PFLOAT d_var, PFLOAT e_var, bool bgl, int bgsamples, CFLOAT pwr,
+		int bgres, const std::string &bgkey):
 		envLight(0), power(pwr)
 {
 	sunDir.set(dir.x, dir.y, dir.z);
@@ -101,7 +103,7 @@ sunskyBackground_t::sunskyBackground_t(const point3d_t dir, PFLOAT turb,
 	perez_y[3] = (-0.04405 * T - 1.65369) * d_var;
 	perez_y[4] = (-0.01092 * T + 0.05291) * e_var;
 	
-	if(bgl) envLight = new bgLight_t(this, bgsamples);
+	if(bgl) envLight = new bgLight_t(this, bgsamples, bgres, bgkey);
 };
 
 sunskyBackground_t::~sunskyBackground_t()
@@ -208,6 +210,7 @@ background_t *sunskyBackground_t::factory(paraMap_t &params,renderEnvironment_t
 	bool add_sun = false;	// automatically add real sunlight
 	bool bgl = false;
 	int bgl_samples = 8;
+	int bgl_res = 360;
 	double power = 1.0;
 	PFLOAT pw = 1.0;	// sunlight power
 	PFLOAT av, bv, cv, dv, ev;
@@ -230,8 +233,15 @@ background_t *sunskyBackground_t::factory(paraMap_t &params,renderEnvironment_t
 	
 	params.getParam("background_light", bgl);
 	params.getParam("light_samples", bgl_samples);
+	params.getParam("light_resolution", bgl_res);
 
-	background_t * new_sunsky = new sunskyBackground_t(dir, turb, av, bv, cv, dv, ev, bgl, bgl_samples, power);
+	// the sky is fully defined by its parameters
+	std::ostringstream key;
+	key.precision(9);
+	key << "sunsky " << dir.x << " " << dir.y << " " << dir.z << " " << turb << " " << power << " "
+		<< av << " " << bv << " " << cv << " " << dv << " " << ev;
+
+	background_t * new_sunsky = new sunskyBackground_t(dir, turb, av, bv, cv, dv, ev, bgl, bgl_samples, power, bgl_res, key.str());
 	
 	if (add_sun)
 	{
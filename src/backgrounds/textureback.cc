@@ -26,6 +26,7 @@
 #include <core_api/light.h>
 #include <utilities/sample_utils.h>
 #include <lights/bglight.h>
+#include <sstream>
 
 __BEGIN_YAFRAY
 
@@ -33,7 +34,8 @@ class textureBackground_t: public background_t
 {
 	public:
 		enum PROJECTION { spherical=0, angular };
-		textureBackground_t(const texture_t *texture, PROJECTION proj, bool doIBL, int nsam, CFLOAT bpower, float rot);
+		textureBackground_t(const texture_t *texture, PROJECTION proj, bool doIBL, int nsam, CFLOAT bpower, float rot,
+			int iblRes=360, const std::string &iblKey=std::string());
 		virtual color_t operator() (const ray_t &ray, renderState_t &state, bool filtered=false) const;
 		virtual color_t eval(const ray_t &ray, bool filtered=false) const;
 		virtual light_t* getLight() const { return envLight; }
@@ -48,6 +50,8 @@ class textureBackground_t: public background_t
 		PROJECTION project;
 		pdf1D_t *uDist, *vDist;
 		int nu, nv, iblSam;
+		int iblRes; //!< importance map rows of the bgLight_t used for angular maps
+		std::string iblKey;
 		light_t *envLight;
 		CFLOAT power;
 		float rotation;
@@ -94,8 +98,9 @@ class envLight_t : public light_t
 	float rotation;
 };
 
-textureBackground_t::textureBackground_t(const texture_t *texture, PROJECTION proj, bool IBL, int nsam, CFLOAT bpower, float rot):
-	tex(texture), ibl(IBL), project(proj), uDist(0), vDist(0), nu(0), nv(0), iblSam(nsam), envLight(0), power(bpower)
+textureBackground_t::textureBackground_t(const texture_t *texture, PROJECTION proj, bool IBL, int nsam, CFLOAT bpower, float rot,
+	int iRes, const std::string &iKey):
+	tex(texture), ibl(IBL), project(proj), uDist(0), vDist(0), nu(0), nv(0), iblSam(nsam), iblRes(iRes), iblKey(iKey), envLight(0), power(bpower)
 {
 	rotation = rot / 360.f;
 	sin_r = sin(2*M_PI*rot);
@@ -161,7 +166,7 @@ void textureBackground_t::initIS()
 {
 	if(project != spherical)
 	{
-		envLight = new bgLight_t(this, iblSam);
+		envLight = new bgLight_t(this, iblSam, iblRes, iblKey);
 		return;
 	}
 	if(tex->discrete())
@@ -255,6 +260,7 @@ background_t* textureBackground_t::factory(paraMap_t &params,renderEnvironment_t
 	double power = 1.0, rot=0.0;
 	bool IBL = false;
 	int IBL_sam = 8; //quite arbitrary really...
+	int IBL_res = 360;
 	
 	if( !params.getParam("texture", texname) )
 	{
@@ -275,7 +281,13 @@ background_t* textureBackground_t::factory(paraMap_t &params,renderEnvironment_t
 	params.getParam("ibl_samples", IBL_sam);
 	params.getParam("power", power);
 	params.getParam("rotation", rot);
-	return new textureBackground_t(tex, pr, IBL, IBL_sam, (CFLOAT)power, float(rot));
+	params.getParam("ibl_resolution", IBL_res);
+	// key on what the texture shows rather than its name or address, those get reused for other images;
+	// textures without a source key get a private importance map
+	std::string source = tex->sourceKey();
+	std::ostringstream key;
+	if(!source.empty()) key << "textureback " << source << " " << pr << " " << power << " " << rot;
+	return new textureBackground_t(tex, pr, IBL, IBL_sam, (CFLOAT)power, float(rot), IBL_res, key.str());
 }
 
 /*==================================================
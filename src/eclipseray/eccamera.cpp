@@ -205,6 +205,8 @@ YRRay LightmapCamera::shootRay(YRPFloat px, YRPFloat py, float u, float v, YRPFl
         {        
             LMC_DEBUG_CODE( Utils::PrintMessage("\t\t\tHITS");, false );
 
+            // Offset along the face normal: an interpolated normal may point the ray at a
+            // neighbouring face. The hit triangle interpolates the smooth shading normal itself.
             ray.from = point + LMC_RAY_SURFACE_TOLERANCE * normal;
             ray.dir  = -normal;
             wt       = 1;
@@ -230,6 +232,45 @@ YRRay LightmapCamera::shootRay(YRPFloat px, YRPFloat py, float u, float v, YRPFl
 
 }
 
+////////////////////////////////////////////////////////////////////////////////
+/// \author Dan Torres
+/// \date 6/8/2009
+////////////////////////////////////////////////////////////////////////////////
+bool LightmapCamera::sampleSurface( YRPFloat px, YRPFloat py, YRSurfacePoint &sp, YRRay &ray, YRPFloat &wt ) const
+{
+    // The texel already tells us which triangle we are on, so instead of shooting a ray at
+    // the mesh and intersecting the whole scene, fill in the surface point directly.
+    int nTriangle;
+    float fL[3];
+    if( !IsValid() || !FindTriangle( px, LMC_ALIGNED_V(py,m_nFilmHeight), nTriangle, fL ) )
+    {
+        wt = 0;
+        return false;
+    }
+
+    const sTriangle& t = m_triangles[nTriangle];
+    YRTriangleObject* pTrimesh = m_pMesh->GetYRTrimesh();      
+    std::vector<YRPoint3D>::const_iterator points = pTrimesh->getPointsIterator();
+    YRPoint3D point = *(points + t.Points[0]) * fL[0] + *(points + t.Points[1]) * fL[1] + *(points + t.Points[2]) * fL[2];
+
+    // The triangle expects the weights of its second and third point, same as its intersection code.
+    // It also interpolates the vertex normals of smooth meshes for the shading normal
+    yafaray::triangle_t& triangle = pTrimesh->getTriangles()[nTriangle];
+    YRPFloat udat[2] = { fL[1], fL[2] };
+    triangle.getSurface( sp, point, (void*)udat );
+    sp.origin = (void*)&triangle;
+
+    // Integrators still need the primary ray for the outgoing direction, keep it the same as shootRay,
+    // i.e. along the geometric normal
+    ray.from = point + LMC_RAY_SURFACE_TOLERANCE * t.Normal;
+    ray.dir  = -t.Normal;
+    ray.tmin = 0;
+    ray.tmax = LMC_RAY_SURFACE_TOLERANCE;
+    wt       = 1;
+
+    return true;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 /// \author Dan Torres
 /// \date 1/14/2009
@@ -564,13 +605,40 @@ LightmapCamera::sTriangle LightmapCamera::CalculateBarycentricTriangle( YRVector
 /// \author Dan Torres
 /// \date 1/15/2009
 ////////////////////////////////////////////////////////////////////////////////
-bool LightmapCamera::QueryMap( YRPFloat a_fU, YRPFloat a_fV, YRPoint3D& a_vPoint, YRVector3D& a_vNormal) const 
+bool LightmapCamera::QueryMap( YRPFloat a_fU, YRPFloat a_fV, YRPoint3D& a_vPoint, YRVector3D& a_vNormal ) const 
+{
+    int nTriangle;
+    float fL[3];
+    if( FindTriangle( a_fU, a_fV, nTriangle, fL ) )
+    {
+        // Calculate the actual point in 3D space
+        const sTriangle& t = m_triangles[nTriangle];
+        YRTriangleObject* pTrimesh = m_pMesh->GetYRTrimesh();      
+        std::vector<YRPoint3D>::const_iterator points = pTrimesh->getPointsIterator();
+
+        YRPoint3D p1 = *(points + t.Points[0]);
+        YRPoint3D p2 = *(points + t.Points[1]);
+        YRPoint3D p3 = *(points + t.Points[2]);
+
+        a_vPoint  = p1 * fL[0] + p2 * fL[1] + p3 * fL[2];
+        a_vNormal = t.Normal;
+
+        return true;
+    }
+
+    return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \author Dan Torres
+/// \date 6/8/2009
+////////////////////////////////////////////////////////////////////////////////
+bool LightmapCamera::FindTriangle( YRPFloat a_fU, YRPFloat a_fV, int& a_nTriangle, float a_fBarycentric[3] ) const
 {
     // Get a slab index based on u
     int nSlab = GetSlab( a_fU );
     if( nSlab != INVALID_ID )
     {
-
         //LMC_DEBUG_CODE
         //(
         //    int i = 0;
@@ -605,16 +673,10 @@ bool LightmapCamera::QueryMap( YRPFloat a_fU, YRPFloat a_fV, YRPoint3D& a_vPoint
                 float fL2 = t.BMatrix[2]*fU + t.BMatrix[3]*fV;
                 float fL3 = 1.0f - fL1 - fL2;
 
-                // Calculate the actual point in 3D space
-                YRTriangleObject* pTrimesh = m_pMesh->GetYRTrimesh();      
-                std::vector<YRPoint3D>::const_iterator points = pTrimesh->getPointsIterator();
-
-                YRPoint3D p1 = *(points + t.Points[0]);
-                YRPoint3D p2 = *(points + t.Points[1]);
-                YRPoint3D p3 = *(points + t.Points[2]);
-
-                a_vPoint  = p1 * fL1 + p2 * fL2 + p3 * fL3;
-                a_vNormal = t.Normal;
+                a_nTriangle       = edge->Triangle;
+                a_fBarycentric[0] = fL1;
+                a_fBarycentric[1] = fL2;
+                a_fBarycentric[2] = fL3;
 
                 return true;
             }
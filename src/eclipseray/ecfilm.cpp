@@ -43,17 +43,22 @@
 /// \date 1/6/2009
 ////////////////////////////////////////////////////////////////////////////////
 Film::Film( const char* a_sID, int a_nWidth, int a_nHeight, eFilmFilterType a_nFilterType, 
-           float a_fFilterSize, float a_fGamma, bool a_bHasDepth, bool a_bClamp )
+           float a_fFilterSize, float a_fGamma, bool a_bHasDepth, bool a_bClamp,
+           bool a_bTexelRefinement, bool a_bStreamTiles, bool a_bDeterministic, bool a_bSaveAlpha )
 :EclipseObject( &m_PythonType ),
  m_pOutput( NULL ),
  m_pFilm( NULL ),
  m_sOutputName( NULL ),
  m_nWidth( a_nWidth ),
- m_nHeight(a_nHeight)
+ m_nHeight(a_nHeight),
+ m_bRendering(false)
 {
     // Create the output object
     m_sOutputName = strdup( a_sID );
-    m_pOutput     = new yafaray::outTga_t( a_nWidth, a_nHeight, m_sOutputName );
+    if( a_bStreamTiles )
+        m_pOutput = new YRTgaStream( a_nWidth, a_nHeight, m_sOutputName, a_bSaveAlpha );
+    else
+        m_pOutput = new YRTga( a_nWidth, a_nHeight, m_sOutputName, a_bSaveAlpha );
 
     // Create the film itself. Use the render environment's function to keep compatibility
     YRParameterMap params;
@@ -63,6 +68,9 @@ Film::Film( const char* a_sID, int a_nWidth, int a_nHeight, eFilmFilterType a_nF
     params[ "AA_pixelwidth" ] = YRParameter( a_fFilterSize );
     params[ "width"         ] = YRParameter( a_nWidth );
     params[ "height"        ] = YRParameter( a_nHeight );
+    params[ "AA_variance"   ] = YRParameter( a_bTexelRefinement );
+    params[ "stream_tiles"  ] = YRParameter( a_bStreamTiles );
+    params[ "deterministic" ] = YRParameter( a_bDeterministic );
     
     switch( a_nFilterType )
     {
@@ -159,12 +167,403 @@ void Film::AppendFilmFilterTypes( PYOBJECT a_pPyModule )
     }
 }
 
+////////////////////////////////////////////////////////////////////////////////
+/// \author Dan Torres
+/// \date 6/11/2009
+////////////////////////////////////////////////////////////////////////////////
+void Film::AppendPixelFormats( PYOBJECT a_pPyModule )
+{
+    if( PyModule_Check(a_pPyModule) )
+    {
+        PYOBJECT pDictionary = PyModule_GetDict( a_pPyModule );
+
+        PYTHON_ADD_ENUMERATION_TO_DICTIONARY( pDictionary, PixelFormat_Float32, "PixelFormat_Float32" );
+        PYTHON_ADD_ENUMERATION_TO_DICTIONARY( pDictionary, PixelFormat_UInt8,   "PixelFormat_UInt8"   );
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \author Dan Torres
+/// \date 6/11/2009
+////////////////////////////////////////////////////////////////////////////////
+FilmPixels* Film::ReadPixels( ePixelFormat a_nFormat )
+{
+    // A streaming film only keeps the rows still being rendered
+    if( !IsValid() || m_pFilm->isStreaming() )
+        return NULL;
+
+    // Let the film do its own normalization and gamma. Unlike flush, this neither
+    // draws the render settings into the image nor touches the film's output
+    std::vector<float> vBuffer( (size_t)m_nWidth * m_nHeight * 4 );
+    m_pFilm->readImage( &vBuffer[0] );
+
+    FilmPixels* pPixels = new FilmPixels( m_nWidth, m_nHeight, 4, a_nFormat );
+    const float* pSrc = &vBuffer[0];
+    for( int y = 0; y < m_nHeight; ++y )
+    {
+        for( int x = 0; x < m_nWidth; ++x, pSrc += 4 )
+            pPixels->SetPixel( x, y, pSrc );
+    }
+
+    return pPixels;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \author Dan Torres
+/// \date 6/11/2009
+////////////////////////////////////////////////////////////////////////////////
+FilmPixels* Film::ReadChannel( const char* a_sChannel, ePixelFormat a_nFormat )
+{
+    int nChannel = (IsValid() && !m_pFilm->isStreaming())? m_pFilm->getChannel( a_sChannel ) : -1;
+    if( nChannel < 0 )
+        return NULL;
+
+    // Accumulating channels come back averaged
+    std::vector<float> vBuffer( (size_t)m_nWidth * m_nHeight );
+    m_pFilm->readChannel( nChannel, &vBuffer[0] );
+
+    FilmPixels* pPixels = new FilmPixels( m_nWidth, m_nHeight, 1, a_nFormat );
+    const float* pSrc = &vBuffer[0];
+    for( int y = 0; y < m_nHeight; ++y )
+    {
+        for( int x = 0; x < m_nWidth; ++x, ++pSrc )
+            pPixels->SetPixel( x, y, pSrc );
+    }
+
+    return pPixels;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \author Dan Torres
+/// \date 6/12/2009
+////////////////////////////////////////////////////////////////////////////////
+bool Film::BeginRender()
+{
+    m_renderMutex.lock();
+    bool bFree = !m_bRendering;
+    m_bRendering = true;
+    m_renderMutex.unlock();
+    return bFree;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \author Dan Torres
+/// \date 6/12/2009
+////////////////////////////////////////////////////////////////////////////////
+void Film::EndRender()
+{
+    m_renderMutex.lock();
+    m_bRendering = false;
+    m_renderMutex.unlock();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \author Dan Torres
+/// \date 6/12/2009
+////////////////////////////////////////////////////////////////////////////////
+bool Film::IsRendering() const
+{
+    m_renderMutex.lock();
+    bool bRendering = m_bRendering;
+    m_renderMutex.unlock();
+    return bRendering;
+}
+
+// -----------------------------------------------------------------------------
+// Film pixels implementation
+// -----------------------------------------------------------------------------
+
+////////////////////////////////////////////////////////////////////////////////
+/// \author Dan Torres
+/// \date 6/11/2009
+////////////////////////////////////////////////////////////////////////////////
+FilmPixels::FilmPixels( int a_nWidth, int a_nHeight, int a_nComponents, Film::ePixelFormat a_nFormat )
+:EclipseObject( &m_PythonType ),
+ m_nWidth( a_nWidth ),
+ m_nHeight( a_nHeight ),
+ m_nComponents( a_nComponents ),
+ m_nFormat( a_nFormat )
+{
+    size_t nComponentSize = (m_nFormat == Film::PixelFormat_Float32)? sizeof(float) : 1;
+    m_data.resize( std::max( (size_t)1, (size_t)m_nWidth * m_nHeight * m_nComponents * nComponentSize ), 0 );
+    SetIsValid( true );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \author Dan Torres
+/// \date 6/11/2009
+////////////////////////////////////////////////////////////////////////////////
+FilmPixels::~FilmPixels()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \author Dan Torres
+/// \date 6/11/2009
+////////////////////////////////////////////////////////////////////////////////
+void FilmPixels::DeleteObject()
+{
+    delete this;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \author Dan Torres
+/// \date 6/11/2009
+////////////////////////////////////////////////////////////////////////////////
+void FilmPixels::SetPixel( int a_nX, int a_nY, const float* a_pComponents )
+{
+    size_t nIndex = ((size_t)a_nY * m_nWidth + a_nX) * m_nComponents;
+    if( m_nFormat == Film::PixelFormat_Float32 )
+    {
+        float* pDest = (float*)&m_data[0] + nIndex;
+        for( int i = 0; i < m_nComponents; ++i )
+            pDest[i] = a_pComponents[i];
+    }
+    else
+    {
+        // Same conversion as the tga output
+        unsigned char* pDest = &m_data[0] + nIndex;
+        for( int i = 0; i < m_nComponents; ++i )
+        {
+            float c = a_pComponents[i];
+            pDest[i] = (c < 0.f)? 0 : ((c >= 1.f)? 255 : (unsigned char)(255.f * c));
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \author Dan Torres
+/// \date 6/11/2009
+////////////////////////////////////////////////////////////////////////////////
+bool FilmPixels::PyTypeCheck( PYOBJECT a_pObject )
+{
+    if( a_pObject->ob_type == &PYTHON_TYPE(FilmPixels) )
+        return true;
+    else
+        return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \author Dan Torres
+/// \date 6/11/2009
+////////////////////////////////////////////////////////////////////////////////
+PYOBJECT FilmPixels::PyAsString()
+{
+    return PyString_FromFormat( "Film pixels [%dx%dx%d %s]", m_nWidth, m_nHeight, m_nComponents,
+        (m_nFormat == Film::PixelFormat_Float32)? "float32" : "uint8" );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \author Dan Torres
+/// \date 6/11/2009
+////////////////////////////////////////////////////////////////////////////////
+Py_ssize_t FilmPixels::PyGetBuffer( PYOBJECT a_pSelf, Py_ssize_t a_nSegment, void** a_ppData )
+{
+    if( a_nSegment != 0 )
+    {
+        PyErr_SetString( PyExc_SystemError, "Accessing non-existent buffer segment" );
+        return -1;
+    }
+
+    FilmPixels* pSelf = (FilmPixels*)a_pSelf;
+    *a_ppData = pSelf->GetData();
+    return (Py_ssize_t)pSelf->GetSize();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \author Dan Torres
+/// \date 6/11/2009
+////////////////////////////////////////////////////////////////////////////////
+Py_ssize_t FilmPixels::PyGetSegmentCount( PYOBJECT a_pSelf, Py_ssize_t* a_pLength )
+{
+    if( a_pLength )
+        *a_pLength = (Py_ssize_t)((FilmPixels*)a_pSelf)->GetSize();
+    return 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \author Dan Torres
+/// \date 6/11/2009
+////////////////////////////////////////////////////////////////////////////////
+Py_ssize_t FilmPixels::PyGetCharBuffer( PYOBJECT a_pSelf, Py_ssize_t a_nSegment, char** a_ppData )
+{
+    return PyGetBuffer( a_pSelf, a_nSegment, (void**)a_ppData );
+}
+
+#if PY_VERSION_HEX >= 0x02060000
+////////////////////////////////////////////////////////////////////////////////
+/// \author Dan Torres
+/// \date 6/11/2009
+////////////////////////////////////////////////////////////////////////////////
+int FilmPixels::PyGetBufferView( PYOBJECT a_pSelf, Py_buffer* a_pView, int a_nFlags )
+{
+    FilmPixels* pSelf = (FilmPixels*)a_pSelf;
+    return PyBuffer_FillInfo( a_pView, a_pSelf, pSelf->GetData(), (Py_ssize_t)pSelf->GetSize(), 0, a_nFlags );
+}
+#endif
+
 // -----------------------------------------------------------------------------
 // Python stuff
 // -----------------------------------------------------------------------------
 
 START_PYTHON_OBJECT_METHODS( Film )
-    // ...
+    ADD_OBJECT_METHOD( Film, saveChannel   ),
+    ADD_OBJECT_METHOD( Film, pixels        ),
+    ADD_OBJECT_METHOD( Film, channelPixels ),
+END_PYTHON_OBJECT_METHODS();
+
+DECLARE_PYTHON_TYPE( Film, "Film", "Film object", PYTHON_TYPE_FINAL );
+
+////////////////////////////////////////////////////////////////////////////////
+/// \author Dan Torres
+/// \date 6/4/2009
+//
+//  Expected:
+//      - (string) channel name, e.g. "Light0"
+//      - (string) output file name
+//
+////////////////////////////////////////////////////////////////////////////////
+IMPLEMENT_PYTHON_OBJECT_METHOD( Film, saveChannel, "Saves a film channel as a greyscale image")
+{
+    Film* pSelf = (Film*)a_pSelf;
+    char* sChannel = NULL;
+    char* sFileName = NULL;
+
+    if(!PyArg_ParseTuple(a_pArgs,"ss",&sChannel,&sFileName)){
+        PYTHON_ERROR("Expected <channel name> <file name>");
+    }
+
+    if( pSelf->IsRendering() ){
+        PYTHON_ERROR("The film is still rendering");
+    }
+
+    if( pSelf->m_pFilm->isStreaming() ){
+        PYTHON_ERROR("Channels of a streaming film can not be read back");
+    }
+
+    int nChannel = pSelf->m_pFilm->getChannel( sChannel );
+    if( nChannel < 0 ){
+        PYTHON_ERROR("Film has no channel with the provided name");
+    }
+
+    YRTga output( pSelf->m_nWidth, pSelf->m_nHeight, sFileName );
+    float fb[4];
+    for( int y = 0; y < pSelf->m_nHeight; ++y )
+    {
+        for( int x = 0; x < pSelf->m_nWidth; ++x )
+        {
+            fb[0] = fb[1] = fb[2] = pSelf->m_pFilm->getChanPixel( nChannel, x, y );
+            fb[3] = 1.0f;
+            output.putPixel( x, y, fb, 4 );
+        }
+    }
+    output.flush();
+
+    return PythonReturnValue( PythonReturn_None );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \author Dan Torres
+/// \date 6/11/2009
+//
+//  Expected:
+//      - (int, optional) pixel format, defaults to PixelFormat_Float32
+//
+////////////////////////////////////////////////////////////////////////////////
+IMPLEMENT_PYTHON_OBJECT_METHOD( Film, pixels, "Returns the rendered RGBA pixels as a buffer object")
+{
+    Film* pSelf = (Film*)a_pSelf;
+    int nFormat = PixelFormat_Float32;
+
+    if(!PyArg_ParseTuple(a_pArgs,"|i",&nFormat)){
+        PYTHON_ERROR("Expected [pixel format]");
+    }
+
+    if( nFormat != PixelFormat_Float32 && nFormat != PixelFormat_UInt8 ){
+        PYTHON_ERROR("Unknown pixel format");
+    }
+
+    if( pSelf->IsRendering() ){
+        PYTHON_ERROR("The film is still rendering");
+    }
+
+    FilmPixels* pPixels = pSelf->ReadPixels( (ePixelFormat)nFormat );
+    if( pPixels == NULL ){
+        PYTHON_ERROR("Can't read pixels from an invalid or streaming film");
+    }
+
+    return pPixels;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \author Dan Torres
+/// \date 6/11/2009
+//
+//  Expected:
+//      - (string) channel name, e.g. "Depth" or "Light0"
+//      - (int, optional) pixel format, defaults to PixelFormat_Float32
+//
+////////////////////////////////////////////////////////////////////////////////
+IMPLEMENT_PYTHON_OBJECT_METHOD( Film, channelPixels, "Returns a film channel as a buffer object")
+{
+    Film* pSelf = (Film*)a_pSelf;
+    char* sChannel = NULL;
+    int nFormat = PixelFormat_Float32;
+
+    if(!PyArg_ParseTuple(a_pArgs,"s|i",&sChannel,&nFormat)){
+        PYTHON_ERROR("Expected <channel name> [pixel format]");
+    }
+
+    if( nFormat != PixelFormat_Float32 && nFormat != PixelFormat_UInt8 ){
+        PYTHON_ERROR("Unknown pixel format");
+    }
+
+    if( pSelf->IsRendering() ){
+        PYTHON_ERROR("The film is still rendering");
+    }
+
+    FilmPixels* pPixels = pSelf->ReadChannel( sChannel, (ePixelFormat)nFormat );
+    if( pPixels == NULL ){
+        PYTHON_ERROR("Film has no channel with the provided name, or is streaming");
+    }
+
+    return pPixels;
+}
+
+// -----------------------------------------------------------------------------
+// Film pixels python stuff
+// -----------------------------------------------------------------------------
+
+PyBufferProcs FilmPixels::m_PyBufferProcs = {
+    (readbufferproc)FilmPixels::PyGetBuffer,
+    (writebufferproc)FilmPixels::PyGetBuffer,
+    (segcountproc)FilmPixels::PyGetSegmentCount,
+    (charbufferproc)FilmPixels::PyGetCharBuffer,
+#if PY_VERSION_HEX >= 0x02060000
+    (getbufferproc)FilmPixels::PyGetBufferView,
+    0,
+#endif
+};
+
+#if PY_VERSION_HEX >= 0x02060000
+#define FILMPIXELS_TYPE_FLAGS   PYTHON_TYPE_FINAL | Py_TPFLAGS_HAVE_NEWBUFFER
+#else
+#define FILMPIXELS_TYPE_FLAGS   PYTHON_TYPE_FINAL
+#endif
+
+START_PYTHON_OBJECT_METHODS( FilmPixels )
+    ADD_OBJECT_METHOD( FilmPixels, shape ),
 END_PYTHON_OBJECT_METHODS();
 
-DECLARE_PYTHON_TYPE( Film, "Film", "Film object", PYTHON_TYPE_FINAL );
\ No newline at end of file
+DECLARE_PYTHON_BUFFER_TYPE( FilmPixels, "FilmPixels", "Pixels read back from a film, supports the buffer interface",
+    FILMPIXELS_TYPE_FLAGS, &FilmPixels::m_PyBufferProcs );
+
+////////////////////////////////////////////////////////////////////////////////
+/// \author Dan Torres
+/// \date 6/11/2009
+////////////////////////////////////////////////////////////////////////////////
+IMPLEMENT_PYTHON_OBJECT_METHOD( FilmPixels, shape, "Returns (width, height, components, pixel format)")
+{
+    FilmPixels* pSelf = (FilmPixels*)a_pSelf;
+    return Py_BuildValue( "(iiii)", pSelf->m_nWidth, pSelf->m_nHeight, pSelf->m_nComponents, (int)pSelf->m_nFormat );
+}
\ No newline at end of file
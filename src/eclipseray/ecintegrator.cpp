@@ -45,6 +45,7 @@
 PYTHON_MODULE_METHOD_VARARGS( integrators, directlight      );
 PYTHON_MODULE_METHOD_VARARGS( integrators, photon           );
 PYTHON_MODULE_METHOD_VARARGS( integrators, ambientocclusion );
+PYTHON_MODULE_METHOD_VARARGS( integrators, occlusionmask    );
 // ...
 
 // Method dictionary
@@ -52,6 +53,7 @@ START_PYTHON_MODULE_METHODS( integrators )
     ADD_MODULE_METHOD( integrators, directlight,      "Creates a direct lighting integrator",    METH_VARARGS ),
     ADD_MODULE_METHOD( integrators, photon,           "Creates a photon mapping integrator",     METH_VARARGS ),
     ADD_MODULE_METHOD( integrators, ambientocclusion, "Craates an ambient occlusion integrator", METH_VARARGS ),
+    ADD_MODULE_METHOD( integrators, occlusionmask,    "Creates a light visibility mask integrator", METH_VARARGS ),
     // ...
 END_PYTHON_MODULE_METHODS();
 
@@ -59,6 +61,7 @@ END_PYTHON_MODULE_METHODS();
 DECLARE_PYTHON_MODULE_INITIALIZATION( integrators, "Integrators" )
 {
     CREATE_PYTHON_MODULE( integrators, "Surface integrators", pIntegratorsModule );
+    OcclusionMaskIntegrator::AppendMaskModes( pIntegratorsModule );
     return pIntegratorsModule;
 }
 
@@ -197,7 +200,8 @@ PhotonIntegrator::PhotonIntegrator( const char* a_sID,
                                    float a_fDiffuseRadius, int a_nSearch, 
                                    int a_nCausticMix, int a_nBounces, 
                                    bool a_bUseBackground, 
-                                   int a_nFGSamples, int a_nFGBounces )
+                                   int a_nFGSamples, int a_nFGBounces,
+                                   int a_nFGMinSamples, float a_fFGThreshold )
 {
     YRParameterMap params;
 
@@ -220,6 +224,13 @@ PhotonIntegrator::PhotonIntegrator( const char* a_sID,
     params[ "fg_samples"     ] = YRParameter( a_nFGSamples );
     params[ "fg_bounces"     ] = YRParameter( a_nFGBounces );
 
+    if( a_nFGMinSamples > 0 )
+    {
+        params[ "fg_adaptive"    ] = YRParameter( true );
+        params[ "fg_min_samples" ] = YRParameter( a_nFGMinSamples );
+        params[ "fg_threshold"   ] = YRParameter( a_fFGThreshold );
+    }
+
     GetYRIntegrator() = (YRSurfaceIntegrator*)RenderEnvironment::GetREObject()->createIntegrator( a_sID, params );
 
     if( GetYRIntegrator() )
@@ -275,8 +286,7 @@ AmbientOcclusionIntegrator::AmbientOcclusionIntegrator( const char* a_sID, int a
 {
     YRParameterMap params;
 
-    params[ "type"        ] = YRParameter( std::string("directlighting") );
-    params[ "do_AO"       ] = YRParameter( true );
+    params[ "type"        ] = YRParameter( std::string("ambientocclusion") );
     params[ "AO_samples"  ] = YRParameter( a_nSamples );
     params[ "AO_distance" ] = YRParameter( a_fDistance );
     params[ "AO_color"    ] = YRParameter( a_color );
@@ -313,6 +323,90 @@ PYOBJECT AmbientOcclusionIntegrator::GetPyStringRep()
     return PyString_FromString("Ambient occlusion integrator");
 }
 
+// -----------------------------------------------------------------------------
+// Occlusion mask integrator
+// -----------------------------------------------------------------------------
+
+////////////////////////////////////////////////////////////////////////////////
+/// \author Dan Torres
+/// \date 6/2/2009
+////////////////////////////////////////////////////////////////////////////////
+OcclusionMaskIntegrator::OcclusionMaskIntegrator( const char* a_sID, int a_nTransparentShadowDepth, 
+    eMaskMode a_nMode )
+{
+    YRParameterMap params;
+
+    params[ "type"      ] = YRParameter( std::string("occlusionmask") );
+
+    switch( a_nMode )
+    {
+    case MaskMode_RGBA:
+        params[ "mask_mode" ] = YRParameter( std::string("rgba") );
+        break;
+
+    case MaskMode_Channels:
+        params[ "mask_mode" ] = YRParameter( std::string("channels") );
+        break;
+
+    default:
+        params[ "mask_mode" ] = YRParameter( std::string("any") );
+        break;
+    };
+
+    if( a_nTransparentShadowDepth > 0 )
+    {
+        params[ "transpShad"  ] = YRParameter( true );
+        params[ "shadowDepth" ] = YRParameter( a_nTransparentShadowDepth );
+    }
+
+    GetYRIntegrator() = (YRSurfaceIntegrator*)RenderEnvironment::GetREObject()->createIntegrator( a_sID, params );
+
+    if( GetYRIntegrator() )
+    {
+        Utils::PrintMessage( "Creating occlusion mask integrator [%s] ", a_sID );
+        SetIsValid( true );
+    }
+    else
+    {
+        Utils::ErrorManager::Report( Utils::ErrorManager::ErrorType_Params, this, 
+            "Failed to create occlusion mask integrator [%s]", a_sID );
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \author Dan Torres
+/// \date 6/2/2009
+////////////////////////////////////////////////////////////////////////////////
+OcclusionMaskIntegrator::~OcclusionMaskIntegrator()
+{
+    Utils::PrintMessage("Deleting occlusion mask integrator");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \author Dan Torres
+/// \date 6/2/2009
+////////////////////////////////////////////////////////////////////////////////
+PYOBJECT OcclusionMaskIntegrator::GetPyStringRep()
+{
+    return PyString_FromString("Occlusion mask integrator");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \author Dan Torres
+/// \date 6/4/2009
+////////////////////////////////////////////////////////////////////////////////
+void OcclusionMaskIntegrator::AppendMaskModes( PYOBJECT a_pPyModule )
+{
+    if( PyModule_Check(a_pPyModule) )
+    {
+        PYOBJECT pDictionary = PyModule_GetDict( a_pPyModule );
+
+        PYTHON_ADD_ENUMERATION_TO_DICTIONARY( pDictionary, MaskMode_Any,      "MaskMode_Any"      );
+        PYTHON_ADD_ENUMERATION_TO_DICTIONARY( pDictionary, MaskMode_RGBA,     "MaskMode_RGBA"     );
+        PYTHON_ADD_ENUMERATION_TO_DICTIONARY( pDictionary, MaskMode_Channels, "MaskMode_Channels" );
+    }
+}
+
 // -----------------------------------------------------------------------------
 // Python SurfaceIntegrator interface
 // -----------------------------------------------------------------------------
@@ -354,6 +448,8 @@ PYTHON_MODULE_METHOD_VARARGS( integrators, directlight )
 //      - (int) search, caustic_mix, bounces
 //      - (int 0/1) use background
 //      - (int) fg_samples, fg_bounces
+//      - (optional int) fg_min_samples. Enables adaptive final gathering if > 0
+//      - (optional float) fg_threshold
 //
 ////////////////////////////////////////////////////////////////////////////////
 PYTHON_MODULE_METHOD_VARARGS( integrators, photon )
@@ -362,10 +458,13 @@ PYTHON_MODULE_METHOD_VARARGS( integrators, photon )
     int nRayDepth, nShadowDepth, nPhotons, nSearch, nCausticMix, nBounces, nFGSamp, nFGBounces;
     float fDiffuseRadius;
     int nUseBackground;
+    int nFGMinSamp = 0;
+    float fFGThreshold = 0.05f;
 
     // Parse (a lot of) arguments
-    if( !PyArg_ParseTuple(args,"siiifiiiiii",&sID,&nRayDepth,&nShadowDepth,&nPhotons,
-        &fDiffuseRadius,&nSearch,&nCausticMix,&nBounces,&nUseBackground,&nFGSamp,&nFGBounces))
+    if( !PyArg_ParseTuple(args,"siiifiiiiii|if",&sID,&nRayDepth,&nShadowDepth,&nPhotons,
+        &fDiffuseRadius,&nSearch,&nCausticMix,&nBounces,&nUseBackground,&nFGSamp,&nFGBounces,
+        &nFGMinSamp,&fFGThreshold))
     {
         PYTHON_ERROR("Wrong number of parameters. Check function documentation");
     }
@@ -373,7 +472,7 @@ PYTHON_MODULE_METHOD_VARARGS( integrators, photon )
     // Create the new object, and return
     return new PhotonIntegrator( sID, nRayDepth,nShadowDepth, nPhotons, 
         fDiffuseRadius,nSearch,nCausticMix,nBounces, (nUseBackground==1)?true:false,
-        nFGSamp,nFGBounces);
+        nFGSamp,nFGBounces,nFGMinSamp,fFGThreshold);
 
 }
 
@@ -406,3 +505,28 @@ PYTHON_MODULE_METHOD_VARARGS( integrators, ambientocclusion )
     // Create and return the new integrator
     return new AmbientOcclusionIntegrator( sID, nSamples, fLength, color );
 }
+
+////////////////////////////////////////////////////////////////////////////////
+/// \author Dan Torres
+/// \date 6/2/2009
+//
+//  Expected parameters
+//      - (string) id
+//      - (int) transparent shadow depth
+//      - (optional eMaskMode, via integrators.MaskMode_*) mask mode
+//
+////////////////////////////////////////////////////////////////////////////////
+PYTHON_MODULE_METHOD_VARARGS( integrators, occlusionmask )
+{
+    char* sID = NULL;
+    int nTShadowDepth = 0;
+    int nMode = OcclusionMaskIntegrator::MaskMode_Any;
+
+    // Parse parameters
+    if( !PyArg_ParseTuple( args, "si|i", &sID, &nTShadowDepth, &nMode ) ){
+        PYTHON_ERROR( "Wrong parameters. Expected <id> <shadow depth> [mask mode]" );
+    }
+
+    // Create the new object, and return
+    return new OcclusionMaskIntegrator( sID, nTShadowDepth, (OcclusionMaskIntegrator::eMaskMode)nMode );
+}
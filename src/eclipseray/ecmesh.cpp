@@ -48,7 +48,8 @@ Mesh::Mesh( const char* a_sID,
            Buffer* a_pVertexBuffer, unsigned int a_nVertexOffset, unsigned int a_nVertexCount, 
            Buffer* a_pUVBuffer,     unsigned int a_nUVOffset,     unsigned int a_nUVCount, 
            Buffer* a_pIndexBuffer,  unsigned int a_nIndexOffset,  unsigned int a_nTriangleCount, 
-           Scene* a_pScene, Material* a_pMaterial, float* a_pBSphere, Matrix* a_pMatrix /* = NULL */)
+           Scene* a_pScene, Material* a_pMaterial, float* a_pBSphere, Matrix* a_pMatrix /* = NULL */,
+           float a_fSmoothAngle /* = 0.0f */)
 :EclipseObject( &m_PythonType ),
  m_pMaterial( a_pMaterial ),
  m_pScene(a_pScene),
@@ -67,7 +68,7 @@ Mesh::Mesh( const char* a_sID,
             a_pVertexBuffer, a_nVertexOffset, a_nVertexCount, 
             a_pUVBuffer,     a_nUVOffset,     a_nUVCount,  
             a_pIndexBuffer,  a_nIndexOffset,  a_nTriangleCount,
-            a_pBSphere, *pMatrix))
+            a_pBSphere, *pMatrix, a_fSmoothAngle))
 		{
 			Utils::PrintMessage( "Creating mesh with id [%s] ", a_sID );
 		}
@@ -107,7 +108,7 @@ bool Mesh::CreateMesh( const char* a_sID, Scene* a_pScene,
     Buffer* a_pVertices, unsigned int a_nVertexOffset,  unsigned int a_nVertexCount, 
     Buffer* a_pUVs,      unsigned int a_nUVOffset,      unsigned int a_nUVCount, 
     Buffer* a_pIndices,  unsigned int a_nIndexOffset,   unsigned int a_nTriangleCount,
-    float* a_pBSphere, const Matrix& a_matrix)
+    float* a_pBSphere, const Matrix& a_matrix, float a_fSmoothAngle)
 {
     
     // Some tests
@@ -193,6 +194,13 @@ bool Mesh::CreateMesh( const char* a_sID, Scene* a_pScene,
                     if( pScene->endTriMesh() )
                     {
                         SetIsValid( true );
+
+                        // Vertex normals, for smooth shading and lightmap texel normals
+                        if( a_fSmoothAngle > 0.0f && !pScene->smoothMesh( m_nMeshID, a_fSmoothAngle ) )
+                        {
+                            Utils::ErrorManager::Report( Utils::ErrorManager::ErrorType_Instance, this,
+                                "Failed to smooth mesh with id [%s]", a_sID );
+                        }
                     }
                 }
 
@@ -57,6 +57,17 @@ void RenderEnvironment::Start()
         {
             m_pEnvironment = new YRRenderEnvironment();
             m_pEnvironment->loadPlugins( pSettings->Get(Settings::Setting_PluginDir) );
+
+            // Decoded textures are shared by all scenes; keep them within the requested budget
+            int nCacheMB = pSettings->Get(Settings::Setting_TextureCacheMB);
+            YRTextureCache::instance().setBudget( (size_t)nCacheMB << 20 );
+
+            // Timeline of all renders of this run, see --trace
+            char* sTraceFile = pSettings->Get(Settings::Setting_TraceFile);
+            if( sTraceFile )
+            {
+                YRRenderTrace::instance().open( sTraceFile );
+            }
             Utils::PrintMessage("Creating render environment");
             m_bInit = true;
         }
@@ -82,6 +93,7 @@ void RenderEnvironment::Stop()
     if( m_bInit )
     {
         Utils::PrintMessage("Destroying render environment");
+        YRRenderTrace::instance().close();
         delete m_pEnvironment;
         m_pEnvironment = NULL;
         m_bInit        = false;
@@ -58,7 +58,8 @@ Scene::Scene()
  m_nAAPasses( 1 ),
  m_nAAIncSamples( 1 ),
  m_fAAThreshold( 0.05 ),
- m_bFirstRender(true)
+ m_bFirstRender(true),
+ m_bRendering(false)
 {
     m_backgroundColor.set( 0.0f, 0.0f, 0.8f );
 
@@ -121,7 +122,12 @@ void Scene::DeleteObject()
 ////////////////////////////////////////////////////////////////////////////////
 void Scene::AddIntegrator( SurfaceIntegrator* a_pIntegrator )
 {
-    if( a_pIntegrator->IsValid() )
+    if( IsRendering() )
+    {
+        Utils::ErrorManager::Report( Utils::ErrorManager::ErrorType_Internal, this,
+            "Can't add integrator to scene: The scene is still rendering" );
+    }
+    else if( a_pIntegrator->IsValid() )
     {
         m_scene.setSurfIntegrator( a_pIntegrator->GetIntegrator() );
         Utils::PrintMessage("Added surface integrator to scene");
@@ -139,7 +145,12 @@ void Scene::AddIntegrator( SurfaceIntegrator* a_pIntegrator )
 ////////////////////////////////////////////////////////////////////////////////
 void Scene::AddLight( Light* a_pLight )
 {
-    if( a_pLight->IsValid() )
+    if( IsRendering() )
+    {
+        Utils::ErrorManager::Report( Utils::ErrorManager::ErrorType_Internal, this,
+            "Can't add light to scene: The scene is still rendering" );
+    }
+    else if( a_pLight->IsValid() )
     {
         m_scene.addLight( a_pLight->GetLight() );
         Utils::PrintMessage("Added light to scene");
@@ -161,6 +172,14 @@ void Scene::AddLight( Light* a_pLight )
 ////////////////////////////////////////////////////////////////////////////////
 void Scene::SetAntialias( int a_nSamples, int a_nPasses, int a_nIncSamples, double a_fThreshold )
 {
+    // The render threads read these
+    if( IsRendering() )
+    {
+        Utils::ErrorManager::Report( Utils::ErrorManager::ErrorType_Internal, this,
+            "Can't set antialias parameters: The scene is still rendering" );
+        return;
+    }
+
     m_nAASamples    = a_nSamples;
     m_nAAPasses     = a_nPasses;
     m_nAAIncSamples = a_nIncSamples;
@@ -171,7 +190,29 @@ void Scene::SetAntialias( int a_nSamples, int a_nPasses, int a_nIncSamples, doub
 /// \author Dan Torres
 /// \date 12/18/2008
 ////////////////////////////////////////////////////////////////////////////////
-void Scene::Render( Film* a_pFilm, LightmapCamera* a_pCamera /* = NULL */ )
+Scene::eRenderResult Scene::Render( Film* a_pFilm, LightmapCamera* a_pCamera /* = NULL */ )
+{
+    if( !BeginRender() )
+        return RenderResult_Busy;
+
+    if( !a_pFilm->BeginRender() )
+    {
+        EndRender();
+        return RenderResult_Busy;
+    }
+
+    bool bRendered = RenderScene( a_pFilm, a_pCamera );
+    a_pFilm->EndRender();
+    EndRender();
+
+    return bRendered? RenderResult_Done : RenderResult_Failed;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \author Dan Torres
+/// \date 12/18/2008
+////////////////////////////////////////////////////////////////////////////////
+bool Scene::RenderScene( Film* a_pFilm, LightmapCamera* a_pCamera )
 {
     YRCamera* pCamera = a_pCamera;
     std::vector<yafaray::light_t*> vAllLights = m_scene.getCurrentLightLayer(); // Copy
@@ -273,13 +314,11 @@ void Scene::Render( Film* a_pFilm, LightmapCamera* a_pCamera /* = NULL */ )
     //    m_bFirstRender = false;
     //}
 
+    // Tag the trace events of this render with the baked mesh
+    YRRenderTrace::instance().setMesh( a_pCamera ? (int)a_pCamera->GetMesh()->GetMeshID() : -1 );
+
     // Render
-    Utils::PrintMessage("Rendering scene...");
-    if( !m_scene.render() )
-    {
-        Utils::ErrorManager::Report( Utils::ErrorManager::ErrorType_Internal, NULL, 
-            "failed to render scene" );
-    }
+    bool bRendered = m_scene.render();
 
     // If we used our own camera, deal with it
     if( a_pCamera == NULL )
@@ -295,6 +334,288 @@ void Scene::Render( Film* a_pFilm, LightmapCamera* a_pCamera /* = NULL */ )
     // save the tga file:
     a_pFilm->GetYRFilm()->flush();
 
+    return bRendered;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \author Dan Torres
+/// \date 6/10/2009
+////////////////////////////////////////////////////////////////////////////////
+RenderTask* Scene::RenderAsync( Film* a_pFilm, LightmapCamera* a_pCamera /* = NULL */ )
+{
+    // Flag it here already, the render thread might not have started when we return
+    if( !BeginRender() )
+        return NULL;
+
+    if( !a_pFilm->BeginRender() )
+    {
+        EndRender();
+        return NULL;
+    }
+
+    Utils::PrintMessage("Rendering scene...");
+    return new RenderTask( this, a_pFilm, a_pCamera );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \author Dan Torres
+/// \date 6/10/2009
+////////////////////////////////////////////////////////////////////////////////
+bool Scene::IsRendering() const
+{
+    m_renderMutex.lock();
+    bool bRendering = m_bRendering;
+    m_renderMutex.unlock();
+    return bRendering;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \author Dan Torres
+/// \date 6/10/2009
+////////////////////////////////////////////////////////////////////////////////
+bool Scene::BeginRender()
+{
+    // Test and set in one go, two threads could both see a free scene otherwise
+    m_renderMutex.lock();
+    bool bFree = !m_bRendering;
+    m_bRendering = true;
+    m_renderMutex.unlock();
+    return bFree;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \author Dan Torres
+/// \date 6/10/2009
+////////////////////////////////////////////////////////////////////////////////
+void Scene::EndRender()
+{
+    m_renderMutex.lock();
+    m_bRendering = false;
+    m_renderMutex.unlock();
+}
+
+// -----------------------------------------------------------------------------
+// Render task implementation
+// -----------------------------------------------------------------------------
+
+////////////////////////////////////////////////////////////////////////////////
+/// \author Dan Torres
+/// \date 6/10/2009
+////////////////////////////////////////////////////////////////////////////////
+RenderTask::RenderTask( Scene* a_pScene, Film* a_pFilm, LightmapCamera* a_pCamera )
+:EclipseObject( &m_PythonType ),
+#if HAVE_PTHREAD
+ m_pWorker( NULL ),
+#endif
+ m_pScene( a_pScene ),
+ m_pFilm( a_pFilm ),
+ m_pCamera( a_pCamera ),
+ m_progress( this, a_pScene->m_nAAPasses ),
+ m_bDone( false ),
+ m_bFailed( false ),
+ m_bReported( false ),
+ m_bCancelled( false )
+{
+    // Keep everything the render needs alive, even if the script drops it
+    m_pScene->AddRef();
+    m_pFilm->AddRef();
+    if( m_pCamera )
+        m_pCamera->AddRef();
+
+    m_pFilm->GetYRFilm()->setProgressBar( &m_progress );
+    SetIsValid(true);
+
+#if HAVE_PTHREAD
+    m_pWorker = new Worker( this );
+    m_pWorker->run();
+#else
+    // No threads available, so at least keep the same interface
+    Run();
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \author Dan Torres
+/// \date 6/10/2009
+////////////////////////////////////////////////////////////////////////////////
+RenderTask::~RenderTask()
+{
+    Wait();
+
+    m_pFilm->GetYRFilm()->setProgressBar( NULL );
+    if( m_pCamera )
+        m_pCamera->ReleaseRef();
+    m_pFilm->ReleaseRef();
+    m_pScene->ReleaseRef();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \author Dan Torres
+/// \date 6/10/2009
+////////////////////////////////////////////////////////////////////////////////
+void RenderTask::DeleteObject()
+{
+    delete this;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \author Dan Torres
+/// \date 6/10/2009
+////////////////////////////////////////////////////////////////////////////////
+bool RenderTask::PyTypeCheck( PYOBJECT a_pObject )
+{
+    if( a_pObject->ob_type == &PYTHON_TYPE(RenderTask) )
+        return true;
+    else
+        return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \author Dan Torres
+/// \date 6/10/2009
+////////////////////////////////////////////////////////////////////////////////
+PYOBJECT RenderTask::PyAsString()
+{
+    return PyString_FromString( "Render task object" );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \author Dan Torres
+/// \date 6/10/2009
+////////////////////////////////////////////////////////////////////////////////
+void RenderTask::Run()
+{
+    // A cancel before we even started skips the render altogether
+    if( !m_bCancelled )
+        m_bFailed = !m_pScene->RenderScene( m_pFilm, m_pCamera );
+
+    m_pFilm->EndRender();
+    m_pScene->EndRender();
+    m_bDone = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \author Dan Torres
+/// \date 6/10/2009
+////////////////////////////////////////////////////////////////////////////////
+void RenderTask::Wait()
+{
+#if HAVE_PTHREAD
+    if( m_pWorker )
+    {
+        // Let other python threads run while we block
+        Py_BEGIN_ALLOW_THREADS
+        m_pWorker->wait();
+        Py_END_ALLOW_THREADS
+
+        delete m_pWorker;
+        m_pWorker = NULL;
+    }
+#endif
+
+    // Back on the python thread, where the error manager can be used
+    if( m_bFailed && !m_bReported )
+    {
+        m_bReported = true;
+        Utils::ErrorManager::Report( Utils::ErrorManager::ErrorType_Internal, m_pScene,
+            "failed to render scene" );
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \author Dan Torres
+/// \date 6/10/2009
+////////////////////////////////////////////////////////////////////////////////
+void RenderTask::Cancel()
+{
+    m_bCancelled = true;
+    m_pScene->GetScenePtr()->abort();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \author Dan Torres
+/// \date 6/10/2009
+////////////////////////////////////////////////////////////////////////////////
+float RenderTask::GetProgress()
+{
+    return m_bDone? 1.0f : m_progress.Get();
+}
+
+#if HAVE_PTHREAD
+////////////////////////////////////////////////////////////////////////////////
+/// \author Dan Torres
+/// \date 6/10/2009
+////////////////////////////////////////////////////////////////////////////////
+void RenderTask::Worker::body()
+{
+    m_pTask->Run();
+}
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+/// \author Dan Torres
+/// \date 6/10/2009
+////////////////////////////////////////////////////////////////////////////////
+RenderTask::Progress::Progress( RenderTask* a_pTask, int a_nPasses )
+:m_pTask( a_pTask ),
+ m_nPasses( a_nPasses > 0? a_nPasses : 1 ),
+ m_nPass( 0 ),
+ m_nSteps( 0 ),
+ m_nDoneSteps( 0 )
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \author Dan Torres
+/// \date 6/10/2009
+////////////////////////////////////////////////////////////////////////////////
+void RenderTask::Progress::init( int totalSteps )
+{
+    // The film is initialized after scene_t::render reset its signals, so a cancel
+    // that came in between would be lost. Raise it again.
+    if( m_pTask->IsCancelled() )
+        m_pTask->Cancel();
+
+    m_mutex.lock();
+    m_nPass      = std::min( m_nPass + 1, m_nPasses );
+    m_nSteps     = totalSteps;
+    m_nDoneSteps = 0;
+    m_mutex.unlock();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \author Dan Torres
+/// \date 6/10/2009
+////////////////////////////////////////////////////////////////////////////////
+void RenderTask::Progress::update( int steps )
+{
+    m_mutex.lock();
+    m_nDoneSteps += steps;
+    m_mutex.unlock();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \author Dan Torres
+/// \date 6/10/2009
+////////////////////////////////////////////////////////////////////////////////
+void RenderTask::Progress::done()
+{
+    m_mutex.lock();
+    m_nDoneSteps = m_nSteps;
+    m_mutex.unlock();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \author Dan Torres
+/// \date 6/10/2009
+////////////////////////////////////////////////////////////////////////////////
+float RenderTask::Progress::Get()
+{
+    m_mutex.lock();
+    float fPass = (m_nSteps > 0)? (float)m_nDoneSteps / (float)m_nSteps : 0.0f;
+    float fProgress = (m_nPass > 0)? ((float)(m_nPass - 1) + fPass) / (float)m_nPasses : 0.0f;
+    m_mutex.unlock();
+    return fProgress;
 }
 
 // -----------------------------------------------------------------------------
@@ -304,10 +625,12 @@ void Scene::Render( Film* a_pFilm, LightmapCamera* a_pCamera /* = NULL */ )
 START_PYTHON_OBJECT_METHODS( Scene )
     ADD_OBJECT_METHOD( Scene, addObject             ),
     ADD_OBJECT_METHOD( Scene, render                ),
+    ADD_OBJECT_METHOD( Scene, renderAsync           ),
     ADD_OBJECT_METHOD( Scene, setAntialias          ),
     ADD_OBJECT_METHOD( Scene, setCamera             ),
     ADD_OBJECT_METHOD( Scene, setActiveLightLayer   ),
     ADD_OBJECT_METHOD( Scene, setBackgroundColor    ),
+    ADD_OBJECT_METHOD( Scene, getStats              ),
 END_PYTHON_OBJECT_METHODS();
 
 DECLARE_PYTHON_TYPE( Scene, "Scene", "A container of geometry and render components", 
@@ -331,6 +654,10 @@ IMPLEMENT_PYTHON_OBJECT_METHOD( Scene, addObject, "Appends an object into our sc
 
     Scene* pSelf = (Scene*)a_pSelf;
 
+    if( pSelf->IsRendering() ){
+        PYTHON_ERROR("The scene is still rendering");
+    }
+
     // Attempt to add a surface integrator
     if( SurfaceIntegrator::PyTypeCheck( pObject ) )
     {
@@ -382,10 +709,67 @@ IMPLEMENT_PYTHON_OBJECT_METHOD( Scene, render, "Triggers the main render procedu
         PYTHON_ERROR("Expected a lightmap camera object");
     }
 
-    pSelf->Render( (Film*)pFilm, (LightmapCamera*)pCamera );
+    if( pSelf->IsRendering() ){
+        PYTHON_ERROR("The scene is still rendering");
+    }
+
+    Utils::PrintMessage("Rendering scene...");
+
+    // Tracing never calls back into python, so let other python threads run meanwhile
+    Scene::eRenderResult nResult;
+    Py_BEGIN_ALLOW_THREADS
+    nResult = pSelf->Render( (Film*)pFilm, (LightmapCamera*)pCamera );
+    Py_END_ALLOW_THREADS
+
+    // Report on this thread, the error manager is not thread safe
+    if( nResult == Scene::RenderResult_Busy ){
+        PYTHON_ERROR("The scene or the film are still rendering");
+    }
+    if( nResult == Scene::RenderResult_Failed ){
+        Utils::ErrorManager::Report( Utils::ErrorManager::ErrorType_Internal, pSelf,
+            "failed to render scene" );
+    }
+
     return PythonReturnValue( PythonReturn_None );
 }
 
+////////////////////////////////////////////////////////////////////////////////
+/// \author Dan Torres
+/// \date 6/10/2009
+// 
+//  Expects:
+//      - film object
+//      - (optional) camera
+//
+//  Returns a RenderTask object
+//
+////////////////////////////////////////////////////////////////////////////////
+IMPLEMENT_PYTHON_OBJECT_METHOD( Scene, renderAsync, "Starts rendering in the background, returns a task object" )
+{
+    PYOBJECT pFilm   = NULL;
+    PYOBJECT pCamera = NULL;
+    Scene* pSelf     = (Scene*)a_pSelf;
+
+    if(!PyArg_ParseTuple( a_pArgs, "O|O", &pFilm, &pCamera )){
+        PYTHON_ERROR( "Expected <film> [camera]" );
+    }
+
+    if( !Film::PyTypeCheck(pFilm)){
+        PYTHON_ERROR("Expected a film object");
+    }
+
+    if( pCamera && !LightmapCamera::PyTypeCheck( pCamera ) ){
+        PYTHON_ERROR("Expected a lightmap camera object");
+    }
+
+    RenderTask* pTask = pSelf->RenderAsync( (Film*)pFilm, (LightmapCamera*)pCamera );
+    if( pTask == NULL ){
+        PYTHON_ERROR("The scene or the film are still rendering");
+    }
+
+    return pTask;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 /// \author Dan Torres
 /// \date 1/7/2009
@@ -410,6 +794,10 @@ IMPLEMENT_PYTHON_OBJECT_METHOD( Scene, setAntialias, "Sets antialias parameters"
         PYTHON_ERROR("Expected <samples> <passes> <inc. samples> <threshold>");
     }
 
+    if( pSelf->IsRendering() ){
+        PYTHON_ERROR("The scene is still rendering");
+    }
+
     pSelf->SetAntialias(nSamples, nPasses, nIncSamples, fThreshold );
 
     return PythonReturnValue( PythonReturn_None );
@@ -440,6 +828,10 @@ IMPLEMENT_PYTHON_OBJECT_METHOD( Scene, setCamera, "Sets perspective camera param
         PYTHON_ERROR("All three parameters must be vector3D objects");
     }
 
+    if( pSelf->IsRendering() ){
+        PYTHON_ERROR("The scene is still rendering");
+    }
+
     // Re-assign
     pSelf->m_vCameraPosition = *(Vector3D*)pPos;
     pSelf->m_vCameraLookAt   = *(Vector3D*)pLookAt;
@@ -472,6 +864,10 @@ IMPLEMENT_PYTHON_OBJECT_METHOD( Scene, setActiveLightLayer, "Sets the currently
         PYTHON_ERROR("Expected light layer of type aergia.lights.Layer_*");
     }
 
+    if( pSelf->IsRendering() ){
+        PYTHON_ERROR("The scene is still rendering");
+    }
+
     pSelf->GetScenePtr()->setCurrentLightLayer((yafaray::scene_t::lightLayers)newLayer);
     return PythonReturnValue( PythonReturn_None );
 }
@@ -493,8 +889,118 @@ IMPLEMENT_PYTHON_OBJECT_METHOD( Scene, setBackgroundColor, "Sets the background
         PYTHON_ERROR("Expected a vector3d");
     }
 
+    if( pSelf->IsRendering() ){
+        PYTHON_ERROR("The scene is still rendering");
+    }
+
     YRColorRGB color( ((Vector3D*)pColor)->GetComponentsPtr() );
     pSelf->m_backgroundColor = color;
 
     return PythonReturnValue( PythonReturn_None );
 }
+
+////////////////////////////////////////////////////////////////////////////////
+/// \author Dan Torres
+/// \date 10/18/2009
+//
+//  Returns a dictionary with the totals of the last render: rays, shadow_rays,
+//  kd_nodes, photon_lookups, fg_rays, fg_points, fg_vertices, fg_fast_vertices,
+//  samples, texels_skipped, the stage
+//  times in seconds and the thread count. A bake renders a single mesh, so
+//  this is what that mesh cost.
+//
+////////////////////////////////////////////////////////////////////////////////
+IMPLEMENT_PYTHON_OBJECT_METHOD( Scene, getStats, "Returns the counters of the last render as a dictionary" )
+{
+    Scene* pSelf = (Scene*)a_pSelf;
+
+    // The render threads are still counting
+    if( pSelf->IsRendering() ){
+        PYTHON_ERROR("The scene is still rendering");
+    }
+
+    const yafaray::renderStats_t& stats = pSelf->GetScenePtr()->getStats();
+    PYOBJECT pDict = PyDict_New();
+
+    for( int i = 0; i < yafaray::RS_NUM_COUNTERS; i++ )
+    {
+        yafaray::renderCounter_t c = (yafaray::renderCounter_t)i;
+        PYOBJECT pValue = PyFloat_FromDouble( stats.total(c) );
+        PyDict_SetItemString( pDict, yafaray::renderStats_t::counterName(c), pValue );
+        Py_DECREF( pValue );
+    }
+
+    for( int i = 0; i < yafaray::RS_NUM_STAGES; i++ )
+    {
+        yafaray::renderStage_t s = (yafaray::renderStage_t)i;
+        PYOBJECT pValue = PyFloat_FromDouble( stats.stageTime(s) );
+        PyDict_SetItemString( pDict, yafaray::renderStats_t::stageName(s), pValue );
+        Py_DECREF( pValue );
+    }
+
+    PYOBJECT pThreads = PyInt_FromLong( stats.numThreads() );
+    PyDict_SetItemString( pDict, "threads", pThreads );
+    Py_DECREF( pThreads );
+
+    return pDict;
+}
+
+// -----------------------------------------------------------------------------
+// Render task python implementation
+// -----------------------------------------------------------------------------
+
+START_PYTHON_OBJECT_METHODS( RenderTask )
+    ADD_OBJECT_METHOD( RenderTask, wait     ),
+    ADD_OBJECT_METHOD( RenderTask, progress ),
+    ADD_OBJECT_METHOD( RenderTask, cancel   ),
+    ADD_OBJECT_METHOD( RenderTask, isDone   ),
+END_PYTHON_OBJECT_METHODS();
+
+DECLARE_PYTHON_TYPE( RenderTask, "RenderTask", "Handle to a background render", 
+    PYTHON_TYPE_FINAL );
+
+////////////////////////////////////////////////////////////////////////////////
+/// \author Dan Torres
+/// \date 6/10/2009
+////////////////////////////////////////////////////////////////////////////////
+IMPLEMENT_PYTHON_OBJECT_METHOD( RenderTask, wait, "Waits until the render is done" )
+{
+    ((RenderTask*)a_pSelf)->Wait();
+    return PythonReturnValue( PythonReturn_None );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \author Dan Torres
+/// \date 6/10/2009
+////////////////////////////////////////////////////////////////////////////////
+IMPLEMENT_PYTHON_OBJECT_METHOD( RenderTask, progress, "Returns the finished fraction of the render [0-1]" )
+{
+    return PyFloat_FromDouble( ((RenderTask*)a_pSelf)->GetProgress() );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \author Dan Torres
+/// \date 6/10/2009
+////////////////////////////////////////////////////////////////////////////////
+IMPLEMENT_PYTHON_OBJECT_METHOD( RenderTask, cancel, "Stops the render as soon as possible" )
+{
+    ((RenderTask*)a_pSelf)->Cancel();
+    return PythonReturnValue( PythonReturn_None );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// \author Dan Torres
+/// \date 6/10/2009
+////////////////////////////////////////////////////////////////////////////////
+IMPLEMENT_PYTHON_OBJECT_METHOD( RenderTask, isDone, "Returns true once the render has finished" )
+{
+    RenderTask* pSelf = (RenderTask*)a_pSelf;
+    if( pSelf->IsDone() )
+    {
+        // Join the finished thread, which also reports a failed render
+        pSelf->Wait();
+        return PythonReturnValue( PythonReturn_True );
+    }
+    else
+        return PythonReturnValue( PythonReturn_False );
+}
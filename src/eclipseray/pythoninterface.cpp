@@ -362,6 +362,7 @@ PYTHON_MODULE_METHOD_VARARGS( aergia, buffer )
 //      - (matrix) world matrix for the mesh
 //      - (Scene) scene
 //      - (Material) Material for the mesh
+//      - (optional float) smoothing angle in degrees, 0 for flat faces
 //
 ////////////////////////////////////////////////////////////////////////////////
 PYTHON_MODULE_METHOD_VARARGS( aergia, mesh )
@@ -375,12 +376,13 @@ PYTHON_MODULE_METHOD_VARARGS( aergia, mesh )
     PYOBJECT pMatrix  = NULL;
     PYOBJECT pBSphere = NULL;
     int nVertexOffset, nVertexCount,nUVOffset,nUVCount,nIndexOffset,nTriangleCount;
+    float fSmoothAngle = 0.0f;
 
     // Obtain all necessary parameters
-    if( !PyArg_ParseTuple( args, "sOiiOiiOiiOOOO", &sID, 
+    if( !PyArg_ParseTuple( args, "sOiiOiiOiiOOOO|f", &sID, 
         &pVBuffer, &nVertexOffset,&nVertexCount, 
         &pTBuffer, &nUVOffset,    &nUVCount,
-        &pIBuffer, &nIndexOffset, &nTriangleCount, &pMatrix, &pBSphere, &pScene, &pMat )) {
+        &pIBuffer, &nIndexOffset, &nTriangleCount, &pMatrix, &pBSphere, &pScene, &pMat, &fSmoothAngle )) {
             PYTHON_ERROR( "Wrong parameters. Check function documentation" );
     }
 
@@ -402,7 +404,7 @@ PYTHON_MODULE_METHOD_VARARGS( aergia, mesh )
         (Buffer*)pVBuffer, nVertexOffset, nVertexCount, 
         (Buffer*)pTBuffer, nUVOffset,     nUVCount,
         (Buffer*)pIBuffer, nIndexOffset,  nTriangleCount,
-        (Scene*)pScene, (Material*)pMat, sp, (Matrix*)pMatrix);
+        (Scene*)pScene, (Material*)pMat, sp, (Matrix*)pMatrix, fSmoothAngle);
 
     return pNewMesh;
 }
@@ -420,23 +422,34 @@ PYTHON_MODULE_METHOD_VARARGS( aergia, mesh )
 //      - (float) gamma
 //      - (1/0) has depth
 //      - (1/0) clamp color ranges
+//      - (optional 1/0) texel refinement: adaptive passes driven by per-texel variance
+//      - (optional 1/0) stream tiles: write finished tile rows while rendering, single pass only
+//      - (optional 1/0) deterministic: bit identical output for any number of threads
+//      - (optional 1/0) save alpha: write the alpha channel into the output file
 //
 ////////////////////////////////////////////////////////////////////////////////
 PYTHON_MODULE_METHOD_VARARGS( aergia, film )
 {
     char* sID = NULL;
     int nWidth, nHeight, nType,nDepth,nClamp;
+    int nTexelRefinement = 0;
+    int nStreamTiles = 0;
+    int nDeterministic = 0;
+    int nSaveAlpha = 0;
     float fFilterSize, fGamma;
 
     // Parameters
-    if( !PyArg_ParseTuple( args, "siiiffii", &sID, &nWidth, &nHeight, 
-        &nType, &fFilterSize, &fGamma, &nDepth, &nClamp) ){
+    if( !PyArg_ParseTuple( args, "siiiffii|iiii", &sID, &nWidth, &nHeight, 
+        &nType, &fFilterSize, &fGamma, &nDepth, &nClamp, &nTexelRefinement, &nStreamTiles, &nDeterministic,
+        &nSaveAlpha) ){
             PYTHON_ERROR("Wrong number or type of parameters on film creation call. Check documentation");
     }
 
     // Create the new piece of film
     Film* pNewFilm = new Film( sID, nWidth, nHeight, (Film::eFilmFilterType)nType,
-        fFilterSize, fGamma, (nDepth == 1)?true:false, (nClamp == 1)?true: false);
+        fFilterSize, fGamma, (nDepth == 1)?true:false, (nClamp == 1)?true: false,
+        (nTexelRefinement == 1)?true:false, (nStreamTiles == 1)?true:false, (nDeterministic == 1)?true:false,
+        (nSaveAlpha == 1)?true:false);
 
     return pNewFilm;
 }
@@ -500,6 +513,7 @@ void InitializeModules()
         // Append several constant types to our main dictionary
         Buffer::AppendBufferUsageTypes( pMainModule );
         Film::AppendFilmFilterTypes( pMainModule );
+        Film::AppendPixelFormats( pMainModule );
 
         Utils::PrintMessage("Initialized python modules");
     }
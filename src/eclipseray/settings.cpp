@@ -78,6 +78,7 @@ Settings::~Settings()
 {
     SAFE_FREE_STRING( m_sScriptName );
     SAFE_FREE_STRING( m_sAppName    );
+    SAFE_FREE_STRING( m_sTraceFile  );
 
 }
 
@@ -134,6 +135,9 @@ char* Settings::Get(eStringSetting a_nSetting )
     case Setting_PluginDir:
         return m_sPluginDir;
 
+    case Setting_TraceFile:
+        return m_sTraceFile;
+
         // ...
 
 
@@ -159,6 +163,10 @@ int Settings::Get( eNumericSetting a_nSetting )
         return m_nCores;
         break;
 
+    case Setting_TextureCacheMB:
+        return m_nTextureCacheMB;
+        break;
+
         //...
 
     default:
@@ -183,12 +191,14 @@ void Settings::LoadDefaults()
     m_sScriptName = NULL;
     m_sAppName    = NULL;
     m_sPluginDir  = "plugins";
+    m_sTraceFile  = NULL;
 
     // ...
 
     // Default values for other variables
     m_bCanContinue = false;
     m_nCores = 1;
+    m_nTextureCacheMB = 0;
     // JamesG 18/6/2009: Killing multi-thread for now. There seems to be a problem with
     // deadlocks in the Yafray kdtree code under some circumstances. Procexp thinks it's
     // trying to upcase a unicode string (??). It seems to occur when there is geometry
@@ -270,6 +280,22 @@ Settings::eBooleanSetting Settings::GetSettingFromString(char* a_sSetting )
         }
     }
 
+    if( !strncmp( a_sSetting, "-texcache=", 10 ) )
+    {
+        m_nTextureCacheMB = atoi((const char*)&a_sSetting[10]);
+        if( m_nTextureCacheMB < 0 )
+        {
+            std::cout << "Invalid texture cache size. Defaulting to no limit.\n";
+            m_nTextureCacheMB = 0;
+        }
+    }
+
+    if( !strncmp( a_sSetting, "-trace=", 7 ) && a_sSetting[7] )
+    {
+        SAFE_FREE_STRING( m_sTraceFile );
+        m_sTraceFile = strdup( &a_sSetting[7] );
+    }
+
     // This is just a dummy result
     return Setting_Invalid;
 }
@@ -284,6 +310,8 @@ void Settings::PrintSettingsHelp()
         "Syntax is: [SETTINGS] filename, where settings can be:\n"                  \
         "   -v, -verbose:   Print verbose information of what's going on\n"         \
         "   -l, -logs:      Print python output into logfiles instead of stdout\n"  \
+        "   --texcache=MB:  Memory budget for decoded textures (default: no limit)\n" \
+        "   --trace=file:   Write a timeline of the render phases for chrome://tracing\n" \
         "\n"                                                                        \
         "   filename is the name of the python script to run. Must be a valid file.\n";
 
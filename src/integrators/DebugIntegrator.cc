@@ -67,7 +67,7 @@ colorA_t DebugIntegrator::integrate(renderState_t &state, diffRay_t &ray/*, samp
 	static int dbg=0;
 //	std::cout << "directLighting::integrate()\n";
 	//shoot ray into scene
-	if(scene->intersect(ray, sp))
+	if(scene->intersect(state, ray, sp))
 	{
 		if (debugType == N)
 			col = color_t((sp.N.x + 1.f) * .5f, (sp.N.y + 1.f) * .5f, (sp.N.z + 1.f) * .5f);
@@ -17,13 +17,15 @@ class YAFRAYPLUGIN_EXPORT EmissionIntegrator : public volumeIntegrator_t {
 	public:
 	EmissionIntegrator() {}
 
+	virtual bool regionsOnly() const { return true; }
+
 	// optical thickness, absorption, attenuation, extinction
 	virtual colorA_t transmittance(renderState_t &state, ray_t &ray) const {
 		colorA_t result(1.f);
 		
 		bool hit = ray.tmax > 0.f;
 		
-		std::vector<VolumeRegion*> listVR = scene->getVolumes();
+		const std::vector<VolumeRegion*> &listVR = scene->getVolumes();
 		
 		//std::cout << "ray.tmax: " << ray.tmax << std::endl;
 		
@@ -56,7 +58,7 @@ class YAFRAYPLUGIN_EXPORT EmissionIntegrator : public volumeIntegrator_t {
 		
 		bool hit = ray.tmax > 0.f;
 		
-		std::vector<VolumeRegion*> listVR = scene->getVolumes();
+		const std::vector<VolumeRegion*> &listVR = scene->getVolumes();
 				
 		for (unsigned int i = 0; i < listVR.size(); i++) {
 			//std::cout << "using vr" << std::endl;
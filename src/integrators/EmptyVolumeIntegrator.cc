@@ -27,6 +27,8 @@ class YAFRAYPLUGIN_EXPORT EmptyVolumeIntegrator : public volumeIntegrator_t {
 		return colorA_t(0.f);
 	}
 	
+	virtual bool regionsOnly() const { return true; }
+	
 	static integrator_t* factory(paraMap_t &params, renderEnvironment_t &render)
 	{
 		return new EmptyVolumeIntegrator();
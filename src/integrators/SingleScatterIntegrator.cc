@@ -8,132 +8,248 @@
 #include <yafraycore/photon.h>
 #include <utilities/mcqmc.h>
 #include <yafraycore/scr_halton.h>
+#include <yafraycore/ccthreads.h>
+#include <yafraycore/rendertrace.h>
 #include <vector>
 #include <cmath>
 #include <stack>
+#include <map>
+#include <algorithm>
 
 __BEGIN_YAFRAY
 
-class YAFRAYPLUGIN_EXPORT SingleScatterIntegrator : public volumeIntegrator_t {
-	private:
-		bool adaptive;
-		bool optimize;
+/*! one z-slice of the attenuation grid of a volume for one light;
+	the slices of all grids are the tasks of the grid workers */
+struct attGridSlice_t
+{
+	VolumeRegion *vr;
+	light_t *light;
+	float *grid;
+	int z;
+};
 
-	public:
-	SingleScatterIntegrator(float sSize, bool adapt, bool opt) {	
-		adaptive = adapt;
-		stepSize = sSize;
-		optimize = opt;
-		std::cout << "scatterint, ss: " << stepSize << " adaptive: " << adaptive << " optimize: " << optimize << std::endl;
-	}
+struct attGridData_t
+{
+	attGridData_t(const std::vector<VolumeRegion*> &vols, float step): listVR(vols), stepSize(step), fetched(0) {}
+	const std::vector<VolumeRegion*> &listVR;
+	std::vector<attGridSlice_t> slices;
+	float stepSize;
+	volatile int fetched;
+	yafthreads::mutex_t mutex;
+};
 
-	virtual bool preprocess() {
-		std::cout << "Preprocessing SingleScatterIntegrator" << std::endl;
-		
-		if (optimize) {
-			std::vector<VolumeRegion*> listVR = scene->getVolumes();
-			for (unsigned int i = 0; i < listVR.size(); i++) {
-			//std::cout << "using vr" << std::endl;
-				VolumeRegion* vr = listVR.at(i);
-				bound_t bb = vr->getBB();
+//! transmittance from every voxel center of the slice to the light
+static void fillAttGridSlice(const attGridSlice_t &slice, const std::vector<VolumeRegion*> &listVR, float stepSize)
+{
+	VolumeRegion* vr = slice.vr;
+	light_t *light = slice.light;
+	bound_t bb = vr->getBB();
 
-				int xSize = vr->attGridX;
-				int ySize = vr->attGridY;
-				int zSize = vr->attGridZ;
+	int xSize = vr->attGridX;
+	int ySize = vr->attGridY;
+	int zSize = vr->attGridZ;
 
-				float xSizeInv = 1.f/(float)xSize;
-				float ySizeInv = 1.f/(float)ySize;
-				float zSizeInv = 1.f/(float)zSize;
+	float xSizeInv = 1.f/(float)xSize;
+	float ySizeInv = 1.f/(float)ySize;
+	float zSizeInv = 1.f/(float)zSize;
 
-				std::cout << "volume, attGridMaps with size: " << xSize << " " << ySize << " " << xSize << std::endl;
-                std::vector<light_t*>& sceneLights = scene->getCurrentLightLayer();
-			
-				for(std::vector<light_t *>::const_iterator l=sceneLights.begin(); l!=sceneLights.end(); ++l) {
-					color_t lcol(0.0);
+	int z = slice.z;
+	float *attenuationGrid = slice.grid + ySize * xSize * z;
+	color_t lcol(0.0);
 
-					float* attenuationGrid = (float*)malloc(xSize * ySize * zSize * sizeof(float));
-					vr->attenuationGridMap[(*l)] = attenuationGrid;
+	for (int y = 0; y < ySize; ++y) {
+		for (int x = 0; x < xSize; ++x) {
+			// generate the world position inside the grid
+			point3d_t p(bb.longX() * xSizeInv * x + bb.a.x,
+						bb.longY() * ySizeInv * y + bb.a.y,
+						bb.longZ() * zSizeInv * z + bb.a.z);
 
-					for (int z = 0; z < zSize; ++z) {
-						for (int y = 0; y < ySize; ++y) {
-							for (int x = 0; x < xSize; ++x) {
-								std::cout << "volume " << x << " " << y << " " << x << std::endl;
-								// generate the world position inside the grid
-								point3d_t p(bb.longX() * xSizeInv * x + bb.a.x,
-											bb.longY() * ySizeInv * y + bb.a.y,
-											bb.longZ() * zSizeInv * z + bb.a.z);
+			surfacePoint_t sp;
+			sp.P = p;
 
-								surfacePoint_t sp;
-								sp.P = p;
-								
-								ray_t lightRay;
+			ray_t lightRay;
 
-								lightRay.from = sp.P;
+			lightRay.from = sp.P;
 
-								// handle lights with delta distribution, e.g. point and directional lights
-								if( (*l)->diracLight() ) {
-									bool ill = (*l)->illuminate(sp, lcol, lightRay);
-									lightRay.tmin = 0.0005; // < better add some _smart_ self-bias value...this is bad.
+			// handle lights with delta distribution, e.g. point and directional lights
+			if( light->diracLight() ) {
+				bool ill = light->illuminate(sp, lcol, lightRay);
+				lightRay.tmin = 0.0005; // < better add some _smart_ self-bias value...this is bad.
 
-									// transmittance from the point p in the volume to the light (i.e. how much light reaches p)
-									//color_t lightstepTau = vr->tau(lightRay, stepSize, 0.5f /* (*state.prng)() */);
+				// transmittance from the point p in the volume to the light (i.e. how much light reaches p)
+				color_t lightstepTau(0.f);
+				if (ill) {
+					for (unsigned int j = 0; j < listVR.size(); j++) {
+						lightstepTau += listVR[j]->tau(lightRay, stepSize, 0.0f);
+					}
+				}
 
-									color_t lightstepTau(0.f);
-									if (ill) {
-										for (unsigned int j = 0; j < listVR.size(); j++) {
-											VolumeRegion* vr2 = listVR.at(j);
-											//float t0Tmp = -1, t1Tmp = -1;
-											//if (vr2->intersect(lightRay, t0Tmp, t1Tmp)) {
-											std::cout << "tau " << lightRay.dir << " " << lightRay.from << " ill: " << ill << std::endl;
-											lightstepTau += vr2->tau(lightRay, stepSize, 0.0f);
-											//}
-										}
-									}
+				attenuationGrid[x + y * xSize] = exp(-lightstepTau.energy());
+			}
+			else // area light and suchlike
+			{
+				float lightTr = 0;
+				int n = (int)(light->nSamples() / 2) + 1;
+				lSample_t ls;
+				for(int i=0; i<n; ++i)
+				{
+					ls.s1 = 0.5f;
+					ls.s2 = 0.5f;
+
+					light->illumSample(sp, ls, lightRay);
+					lightRay.tmin = 0.0005;
+
+					// transmittance from the point p in the volume to the light (i.e. how much light reaches p)
+					color_t lightstepTau(0.f);
+					for (unsigned int j = 0; j < listVR.size(); j++) {
+						lightstepTau += listVR[j]->tau(lightRay, stepSize, 0.0f);
+					}
+					lightTr += exp(-lightstepTau.energy());
+				}
 
-									float lightTr = exp(-lightstepTau.energy());
-									attenuationGrid[x + y * xSize + ySize * xSize * z] = lightTr;
+				attenuationGrid[x + y * xSize] = lightTr / (float)n;
+			}
+		}
+	}
+}
 
-									//std::cout << "gridpos: " << (x + y * xSize + ySize * xSize * z) << " " << lightstepTau.energy() << " " << lightRay.dir << " " << lightRay.tmax << " lightTr: " << lightTr << std::endl;
+class attGridWorker_t: public yafthreads::thread_t
+{
+	public:
+		attGridWorker_t(attGridData_t *dat): gdata(dat) {}
+		virtual void body();
+	protected:
+		attGridData_t *gdata;
+};
 
-								}
-								else // area light and suchlike
-								{
-									float lightPdf;
-									float lightTr = 0;
-									int n = (int)((*l)->nSamples() / 2) + 1;
-									lSample_t ls;
-									for(int i=0; i<n; ++i)
-									{
-										ls.s1 = 0.5f; //(*state.prng)();
-										ls.s2 = 0.5f; //(*state.prng)();
-
-										(*l)->illumSample(sp, ls, lightRay);
-										lightRay.tmin = 0.0005;
+void attGridWorker_t::body()
+{
+	int total = (int)gdata->slices.size();
+	while(true)
+	{
+		gdata->mutex.lock();
+		int n = gdata->fetched;
+		if(n < total) gdata->fetched = n + 1;
+		gdata->mutex.unlock();
+		if(n >= total) break;
+		fillAttGridSlice(gdata->slices[n], gdata->listVR, gdata->stepSize);
+	}
+}
 
-										// transmittance from the point p in the volume to the light (i.e. how much light reaches p)
-										//color_t lightstepTau = vr->tau(lightRay, stepSize, 0.5f);
-										color_t lightstepTau(0.f);
-										for (unsigned int j = 0; j < listVR.size(); j++) {
-											VolumeRegion* vr2 = listVR.at(j);
-											//float t0Tmp = -1, t1Tmp = -1;
-											//if (vr2->intersect(lightRay, t0Tmp, t1Tmp)) {
-												lightstepTau += vr2->tau(lightRay, stepSize, 0.0f);
-											//}
-										}
-										lightTr += exp(-lightstepTau.energy());
-									}
+//! what an attenuation grid was computed from, to tell if the grids of the last render can be reused
+struct attGridKey_t
+{
+	unsigned int version; //!< scene_t::getLightsVersion(), so a new light at the address of a deleted one does not match
+	VolumeRegion *vr;
+	light_t *light;
+	float *grid;
+	point3d_t a, g;
+	int x, y, z;
+	bool sameInput(const attGridKey_t &k) const
+	{
+		return version == k.version && vr == k.vr && light == k.light && x == k.x && y == k.y && z == k.z &&
+			a.x == k.a.x && a.y == k.a.y && a.z == k.a.z && g.x == k.g.x && g.y == k.g.y && g.z == k.g.z;
+	}
+};
 
-									attenuationGrid[x + y * xSize + ySize * xSize * z] = lightTr / (float)n;
-								}
-							}
-						}
-					}
-				}
+class YAFRAYPLUGIN_EXPORT SingleScatterIntegrator : public volumeIntegrator_t {
+	private:
+		bool adaptive;
+		bool optimize;
+		bool cacheGrids;
+		std::vector<attGridKey_t> grids;
+
+	public:
+	SingleScatterIntegrator(float sSize, bool adapt, bool opt, bool cache) {	
+		adaptive = adapt;
+		stepSize = sSize;
+		optimize = opt;
+		cacheGrids = cache;
+		std::cout << "scatterint, ss: " << stepSize << " adaptive: " << adaptive << " optimize: " << optimize << std::endl;
+	}
+
+	virtual ~SingleScatterIntegrator() { freeGrids(); }
+
+	virtual bool regionsOnly() const { return true; }
+
+	/*! the grids depend on the volumes and the lights only, so with cacheGrids set
+		they are kept as long as the same volumes and lights are in the scene.
+		Lights and volumes are compared by the scene's lights version, then by address and bound
+		(the light layer may hold a different subset of the lights every render). Changing a light
+		or volume in place needs scene_t::lightsChanged(). */
+	virtual bool preprocess() {
+		std::cout << "Preprocessing SingleScatterIntegrator" << std::endl;
+		
+		if (!optimize) return true;
+
+		const std::vector<VolumeRegion*> &listVR = scene->getVolumes();
+		std::vector<light_t*>& sceneLights = scene->getCurrentLightLayer();
+
+		std::vector<attGridKey_t> keys;
+		for (unsigned int i = 0; i < listVR.size(); i++) {
+			VolumeRegion* vr = listVR.at(i);
+			bound_t bb = vr->getBB();
+			for(std::vector<light_t *>::const_iterator l=sceneLights.begin(); l!=sceneLights.end(); ++l) {
+				attGridKey_t k;
+				k.version = scene->getLightsVersion();
+				k.vr = vr; k.light = *l; k.grid = 0;
+				k.a = bb.a; k.g = bb.g;
+				k.x = vr->attGridX; k.y = vr->attGridY; k.z = vr->attGridZ;
+				keys.push_back(k);
 			}
 		}
 
+		if (cacheGrids && keys.size() == grids.size()) {
+			bool same = true;
+			for (unsigned int i = 0; i < keys.size() && same; i++) same = keys[i].sameInput(grids[i]);
+			if (same) {
+				std::cout << "SingleScatterIntegrator: volumes and lights unchanged, reusing " << grids.size() << " attenuation grids" << std::endl;
+				return true;
+			}
+		}
+		freeGrids(&listVR);
+
+		traceScope_t gridTrace("attenuation grids");
+		attGridData_t gdata(listVR, stepSize);
+		for (unsigned int i = 0; i < keys.size(); i++) {
+			attGridKey_t &k = keys[i];
+			k.grid = new float[k.x * k.y * k.z];
+			k.vr->attenuationGridMap[k.light] = k.grid;
+			for (int z = 0; z < k.z; ++z) {
+				attGridSlice_t slice;
+				slice.vr = k.vr; slice.light = k.light; slice.grid = k.grid; slice.z = z;
+				gdata.slices.push_back(slice);
+			}
+		}
+		grids.swap(keys);
+
+		int nThreads = std::max(1, scene->getNumThreads());
+		std::cout << "SingleScatterIntegrator: " << grids.size() << " attenuation grids, " << gdata.slices.size() << " slices on " << nThreads << " threads" << std::endl;
+#if HAVE_PTHREAD
+		std::vector<attGridWorker_t *> workers;
+		for(int i=0; i<nThreads; ++i) workers.push_back(new attGridWorker_t(&gdata));
+		for(int i=0;i<nThreads;++i) workers[i]->run();
+		for(int i=0;i<nThreads;++i) workers[i]->wait();
+		for(int i=0;i<nThreads;++i) delete workers[i];
+#else
+		for (unsigned int i = 0; i < gdata.slices.size(); i++) fillAttGridSlice(gdata.slices[i], listVR, stepSize);
+#endif
 		return true;
 	}
+
+	/*! release the grids of the last preprocess; the maps of volumes that left the scene
+		since are not touched, listVR is null when the scene may be gone already */
+	void freeGrids(const std::vector<VolumeRegion*> *listVR = 0) {
+		for (unsigned int i = 0; i < grids.size(); i++) {
+			if (listVR && std::find(listVR->begin(), listVR->end(), grids[i].vr) != listVR->end()) {
+				std::map<light_t *, float*>::iterator it = grids[i].vr->attenuationGridMap.find(grids[i].light);
+				if (it != grids[i].vr->attenuationGridMap.end() && it->second == grids[i].grid)
+					grids[i].vr->attenuationGridMap.erase(it);
+			}
+			delete[] grids[i].grid;
+		}
+		grids.clear();
+	}
 	
 
 	// optical thickness, absorption, attenuation, extinction
@@ -141,7 +257,7 @@ class YAFRAYPLUGIN_EXPORT SingleScatterIntegrator : public volumeIntegrator_t {
 		colorA_t Tr(1.f);
 		//return result;
 		
-		std::vector<VolumeRegion*> listVR = scene->getVolumes();
+		const std::vector<VolumeRegion*> &listVR = scene->getVolumes();
 		
 		if (listVR.size() == 0) return Tr;
 		
@@ -171,7 +287,7 @@ class YAFRAYPLUGIN_EXPORT SingleScatterIntegrator : public volumeIntegrator_t {
 		colorA_t result(0.f);
 		//return result;
 				
-		std::vector<VolumeRegion*> listVR = scene->getVolumes();
+		const std::vector<VolumeRegion*> &listVR = scene->getVolumes();
 		
 		if (listVR.size() == 0) return result;
 		
@@ -448,11 +564,13 @@ class YAFRAYPLUGIN_EXPORT SingleScatterIntegrator : public volumeIntegrator_t {
 	{
 		bool adapt = false;
 		bool opt = false;
+		bool cache = false;
 		float sSize = 1.f;
 		params.getParam("stepSize", sSize);
 		params.getParam("adaptive", adapt);
 		params.getParam("optimize", opt);
-		SingleScatterIntegrator* inte = new SingleScatterIntegrator(sSize, adapt, opt);
+		params.getParam("cacheGrids", cache);
+		SingleScatterIntegrator* inte = new SingleScatterIntegrator(sSize, adapt, opt, cache);
 		return inte;
 	}
 
@@ -0,0 +1,125 @@
+/****************************************************************************
+ * 			ambientocclusion.cc: an integrator for ambient occlusion only
+ *      This is part of the yafray package
+ *      Copyright (C) 2009 BioWare
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include <yafray_config.h>
+#include <core_api/environment.h>
+#include <core_api/material.h>
+#include <yafraycore/tiledintegrator.h>
+#include <utilities/mcqmc.h>
+#include <utilities/sample_utils.h>
+
+__BEGIN_YAFRAY
+
+/*! Ambient occlusion only: no lights, no material evaluation.
+	The cosine weighted hemisphere directions are stratified once in preprocess() and shared by all
+	tiles; each pixel sample only rotates this set around the normal. Occlusion rays are bounded by
+	AO_distance, so the kd-tree traversal never leaves that range, and stop at the first hit. */
+class YAFRAYPLUGIN_EXPORT ambientOcclusion_t: public tiledIntegrator_t
+{
+	public:
+		ambientOcclusion_t(int samples, PFLOAT dist, const color_t &col);
+		virtual bool preprocess();
+		virtual colorA_t integrate(renderState_t &state, diffRay_t &ray) const;
+		virtual colorA_t integrateSurface(renderState_t &state, diffRay_t &ray, const surfacePoint_t &sp) const;
+		static integrator_t* factory(paraMap_t &params, renderEnvironment_t &render);
+	protected:
+		int AO_samples;
+		PFLOAT AO_dist;
+		color_t AO_col;
+		std::vector<vector3d_t> dirTable; //!< stratified cosine distributed directions in tangent space (z = normal)
+};
+
+ambientOcclusion_t::ambientOcclusion_t(int samples, PFLOAT dist, const color_t &col):
+	AO_samples(std::max(1, samples)), AO_dist(dist), AO_col(col)
+{
+	type = SURFACE;
+}
+
+bool ambientOcclusion_t::preprocess()
+{
+	dirTable.resize(AO_samples);
+	float d = 1.f / (float)AO_samples;
+	for(int i=0; i<AO_samples; ++i)
+	{
+		// Hammersley point set, mapped to the cosine weighted hemisphere
+		PFLOAT z1 = (0.5f + (float)i) * d;
+		PFLOAT z2 = RI_vdC(i) * 2.f * M_PI;
+		PFLOAT r = sqrt(1.f - z1);
+		dirTable[i] = vector3d_t(r * cos(z2), r * sin(z2), sqrt(z1));
+	}
+	return true;
+}
+
+colorA_t ambientOcclusion_t::integrate(renderState_t &state, diffRay_t &ray) const
+{
+	surfacePoint_t sp;
+	if(!scene->intersect(state, ray, sp)) return colorA_t(0.f);
+	return integrateSurface(state, ray, sp);
+}
+
+colorA_t ambientOcclusion_t::integrateSurface(renderState_t &state, diffRay_t &ray, const surfacePoint_t &sp) const
+{
+	vector3d_t N = FACE_FORWARD(sp.Ng, sp.N, -ray.dir);
+	vector3d_t Ru, Rv;
+	createCS(N, Ru, Rv);
+	// rotate the shared direction set around N, different for every pixel sample
+	PFLOAT phi = RI_vdC(state.pixelSample, state.samplingOffs) * 2.f * M_PI;
+	PFLOAT cosPhi = cos(phi), sinPhi = sin(phi);
+	vector3d_t U = Ru*cosPhi + Rv*sinPhi;
+	vector3d_t V = Rv*cosPhi - Ru*sinPhi;
+
+	ray_t occRay;
+	occRay.from = sp.P;
+	int unoccluded = 0;
+	for(int i=0; i<AO_samples; ++i)
+	{
+		const vector3d_t &d = dirTable[i];
+		occRay.dir = U*d.x + V*d.y + N*d.z;
+		occRay.tmin = 0.0005f;
+		occRay.tmax = AO_dist;
+		if(!scene->isShadowed(state, occRay)) ++unoccluded;
+	}
+	return colorA_t(AO_col * ((CFLOAT)unoccluded / (CFLOAT)AO_samples), 1.f);
+}
+
+integrator_t* ambientOcclusion_t::factory(paraMap_t &params, renderEnvironment_t &render)
+{
+	int AO_samples = 32;
+	double AO_dist = 1.0;
+	color_t AO_col(1.f);
+
+	params.getParam("AO_samples", AO_samples);
+	params.getParam("AO_distance", AO_dist);
+	params.getParam("AO_color", AO_col);
+
+	return new ambientOcclusion_t(AO_samples, (PFLOAT)AO_dist, AO_col);
+}
+
+extern "C"
+{
+
+	YAFRAYPLUGIN_EXPORT void registerPlugin(renderEnvironment_t &render)
+	{
+		render.registerFactory("ambientocclusion", ambientOcclusion_t::factory);
+	}
+
+}
+
+__END_YAFRAY
@@ -432,7 +432,7 @@ int biDirIntegrator_t::createPath(renderState_t &state, ray_t &start, std::vecto
 	{
 		pathVertex_t &v = path[nVert];
 		const pathVertex_t &v_prev = path[nVert-1];
-		if(!scene->intersect(ray, v.sp)) break;
+		if(!scene->intersect(state, ray, v.sp)) break;
 		const material_t *mat = v.sp.material;
 		// compute alpha_i+1 = alpha_i * fs(wi, wo) / P_proj(wo), where P_proj = bsdf_pdf(wo) / cos(wo*N)
 		v.alpha = v_prev.alpha * v_prev.f_s * v_prev.cos_wo / (v_prev.pdf_wo * v_prev.qi_wo);
@@ -27,6 +27,7 @@
 #include <yafraycore/photon.h>
 #include <utilities/mcqmc.h>
 #include <utilities/sample_utils.h>
+#include <core_api/sampling.h>
 #include <yafraycore/spectrum.h>
 
 __BEGIN_YAFRAY
@@ -163,8 +164,8 @@ color_t estimateDirect_PH(renderState_t &state, const surfacePoint_t &sp, const
 				{
 					if(trShad) lcol *= scol;
 					color_t surfCol = material->eval(state, sp, wo, lightRay.dir, BSDF_ALL);
-					color_t transmitCol = scene->volIntegrator->transmittance(state, lightRay); // FIXME: add also to the other lightsources!
-					col += surfCol * lcol * std::fabs(sp.N*lightRay.dir) * transmitCol;
+					if(scene->volumeEffects()) lcol *= scene->volIntegrator->transmittance(state, lightRay); // FIXME: add also to the other lightsources!
+					col += surfCol * lcol * std::fabs(sp.N*lightRay.dir);
 				}
 				//else
 				//	col = color_t(1, 0, 0); // make areas visible which are not lit due to being shadowed
@@ -209,8 +210,7 @@ color_t estimateDirect_PH(renderState_t &state, const surfacePoint_t &sp, const
 					if(!shadowed && ls.pdf > 1e-6f)
 					{
 						if(trShad) ls.col *= scol;
-						color_t transmitCol = scene->volIntegrator->transmittance(state, lightRay);
-						lcol *= transmitCol;
+						if(scene->volumeEffects()) lcol *= scene->volIntegrator->transmittance(state, lightRay);
 						color_t surfCol = material->eval(state, sp, wo, lightRay.dir, BSDF_ALL);
 						if( canIntersect)
 						{
@@ -248,8 +248,7 @@ color_t estimateDirect_PH(renderState_t &state, const surfacePoint_t &sp, const
 						if(!shadowed)
 						{
 							if(trShad) lcol *= scol;
-							color_t transmitCol = scene->volIntegrator->transmittance(state, lightRay);
-							lcol *= transmitCol;
+							if(scene->volumeEffects()) lcol *= scene->volIntegrator->transmittance(state, lightRay);
 							float lPdf = 1.f/lightPdf;
 							float l2 = lPdf * lPdf;
 							float m2 = s.pdf * s.pdf;
@@ -286,6 +285,7 @@ color_t estimatePhotons(renderState_t &state, const surfacePoint_t &sp, const ph
 	int nGathered=0;
 	PFLOAT gRadiusSquare = radius;
 	nGathered = map.gather(sp.P, gathered, nSearch, gRadiusSquare);
+	state.count(RS_PHOTON_LOOKUPS);
 	color_t sum(0.0);
 	if(nGathered > 0)
 	{
@@ -333,17 +333,29 @@ bool createCausticMap(const scene_t &scene, const std::vector<light_t *> &lights
 	unsigned int curr=0;
 	surfacePoint_t sp1, sp2;
 	surfacePoint_t *hit=&sp1, *hit2=&sp2;
-	renderState_t state;
+	// every photon has its own random number stream, the map does not depend on what ran before
+	random_t prng(scene.getSeed());
+	renderState_t state(&prng);
 	unsigned char userdata[USER_DATA_SIZE+7];
 	state.userdata = (void *)( &userdata[7] - ( ((size_t)&userdata[7])&7 ) ); // pad userdata to 8 bytes
+	// the light sampling dimensions of consecutive photons are generated in runs
+	sampler_t photonSam;
+	int dimW = photonSam.addDimension(QMC_SOBOL);
+	int dim1 = photonSam.addDimension(QMC_VDC);
+	int dim2 = photonSam.addDimension(QMC_HALTON, 2);
+	int dim3 = photonSam.addDimension(QMC_HALTON, 3);
+	int dim4 = photonSam.addDimension(QMC_HALTON, 4);
 	while(!done)
 	{
+		prng.setStream(curr);
+		if(!photonSam.contains(curr)) photonSam.generate(curr, std::max(1, std::min(4096, (int)nPhotons - (int)curr)));
+		int k = curr - photonSam.start();
 		state.chromatic = true;
-		state.wavelength = RI_S(curr);
-		s1 = RI_vdC(curr);
-		s2 = scrHalton(2, curr);
-		s3 = scrHalton(3, curr);
-		s4 = scrHalton(4, curr);
+		state.wavelength = photonSam.get(dimW, k);
+		s1 = photonSam.get(dim1, k);
+		s2 = photonSam.get(dim2, k);
+		s3 = photonSam.get(dim3, k);
+		s4 = photonSam.get(dim4, k);
 		//sL = RI_S(curr);
 		sL = float(curr) / float(nPhotons);
 		int lightNum = lightPowerD->DSample(sL, &lightNumPdf);
@@ -404,9 +416,9 @@ bool createCausticMap(const scene_t &scene, const std::vector<light_t *> &lights
 			}
 			else
 			{
-				s5 = ourRandom();
-				s6 = ourRandom();
-				s7 = ourRandom();
+				s5 = prng();
+				s6 = prng();
+				s7 = prng();
 			}
 			pSample_t sample(s5, s6, s7, BSDF_ALL_SPECULAR | BSDF_FILTER | BSDF_DISPERSIVE, pcol, transm);
 			bool scattered = material->scatterPhoton(state, *hit, wi, wo, sample);
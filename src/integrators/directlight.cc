@@ -39,8 +39,11 @@ class YAFRAYPLUGIN_EXPORT directLighting_t: public tiledIntegrator_t
 		directLighting_t(bool transpShad=false, int shadowDepth=4, int rayDepth=6);
 		virtual bool preprocess();
 		virtual colorA_t integrate(renderState_t &state, diffRay_t &ray/*, sampler_t &sam*/) const;
+		virtual colorA_t integrateSurface(renderState_t &state, diffRay_t &ray, const surfacePoint_t &sp) const;
 		static integrator_t* factory(paraMap_t &params, renderEnvironment_t &render);
 	protected:
+		//! shade the first surface along ray; hit is used instead of intersecting the scene when known
+		colorA_t shade(renderState_t &state, diffRay_t &ray, const surfacePoint_t *hit) const;
 		color_t sampleAO(renderState_t &state, const surfacePoint_t &sp, const vector3d_t &wo) const;
 		background_t *background;
 		bool trShad, caustics, do_AO;
@@ -83,16 +86,27 @@ bool directLighting_t::preprocess()
 }
 
 colorA_t directLighting_t::integrate(renderState_t &state, diffRay_t &ray/*, sampler_t &sam*/) const
+{
+	return shade(state, ray, 0);
+}
+
+colorA_t directLighting_t::integrateSurface(renderState_t &state, diffRay_t &ray, const surfacePoint_t &sp) const
+{
+	return shade(state, ray, &sp);
+}
+
+colorA_t directLighting_t::shade(renderState_t &state, diffRay_t &ray, const surfacePoint_t *hit) const
 {
 	color_t col(0.0);
 	CFLOAT alpha=0.0;
 	surfacePoint_t sp;
+	if(hit) sp = *hit;
 	void *o_udat = state.userdata;
 	bool oldIncludeLights = state.includeLights;
 	static int dbg=0;
 //	std::cout << "directLighting::integrate()\n";
 	//shoot ray into scene
-	if(scene->intersect(ray, sp))
+	if(hit || scene->intersect(state, ray, sp))
 	{
 		// if camera ray:
 		if(state.raylevel == 0)
@@ -227,8 +241,11 @@ colorA_t directLighting_t::integrate(renderState_t &state, diffRay_t &ray/*, sam
 			{
 				diffRay_t refRay(sp.P, dir[0], 0.0005);
 				color_t integ = color_t(integrate(state, refRay) );
-				integ *= scene->volIntegrator->transmittance(state, refRay); // T
-				integ += scene->volIntegrator->integrate(state, refRay); // L_v
+				if(scene->volumeEffects())
+				{
+					integ *= scene->volIntegrator->transmittance(state, refRay); // T
+					integ += scene->volIntegrator->integrate(state, refRay); // L_v
+				}
 				// account for volumetric effects:
 				if(bsdfs&BSDF_VOLUMETRIC && material->volumeTransmittance(state, sp, refRay, vcol))
 				{	integ *= vcol;	}
@@ -0,0 +1,205 @@
+/****************************************************************************
+ * 			occlusionmask.cc: an integrator for light visibility masks only
+ *      This is part of the yafray package
+ *      Copyright (C) 2009 BioWare
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include <yafray_config.h>
+#include <core_api/environment.h>
+#include <core_api/material.h>
+#include <core_api/imagefilm.h>
+#include <yafraycore/tiledintegrator.h>
+#include <core_api/light.h>
+#include <utilities/mcqmc.h>
+#include <sstream>
+
+__BEGIN_YAFRAY
+
+/*! Shadow mask integrator: only evaluates light visibility, no shading at all.
+	In "any" mode a texel gets the visibility of the light that reaches it best, so penumbrae stay
+	soft; the light loop ends once a light is fully visible. In "rgba" mode the visibility of the first four lights is packed into R, G, B and A
+	(the output needs an alpha channel to keep the fourth one).
+	In "channels" mode every light gets its own accumulating film channel "Light<n>", so one render
+	bakes all masks of a light layer, while the image holds the combined "any" mask.
+	Ambient lights cast no shadows and are ignored. */
+class YAFRAYPLUGIN_EXPORT occlusionMask_t: public tiledIntegrator_t
+{
+	public:
+		enum maskMode { MASK_ANY, MASK_RGBA, MASK_CHANNELS };
+		occlusionMask_t(bool transpShad=false, int shadowDepth=4, maskMode m=MASK_ANY);
+		virtual bool preprocess();
+		virtual bool render(imageFilm_t *imageFilm);
+		virtual colorA_t integrate(renderState_t &state, diffRay_t &ray) const;
+		virtual colorA_t integrateSurface(renderState_t &state, diffRay_t &ray, const surfacePoint_t &sp) const;
+		static integrator_t* factory(paraMap_t &params, renderEnvironment_t &render);
+	protected:
+		//! fraction of light samples from l that reach sp
+		float lightVisibility(renderState_t &state, const surfacePoint_t &sp, const vector3d_t &N,
+							const light_t *l, unsigned int l_offs) const;
+		bool trShad;
+		int sDepth;
+		maskMode mode;
+		std::vector<light_t*> lights;
+		std::vector<int> lightChannels; //!< film channel of each light in channel mode
+};
+
+occlusionMask_t::occlusionMask_t(bool transpShad, int shadowDepth, maskMode m):
+	trShad(transpShad), sDepth(shadowDepth), mode(m)
+{
+	type = SURFACE;
+}
+
+bool occlusionMask_t::preprocess()
+{
+	lights.clear();
+	const std::vector<light_t*> &layer = scene->getCurrentLightLayer();
+	for(unsigned int i=0; i<layer.size(); ++i)
+	{
+		if(!layer[i]->ambientLight()) lights.push_back(layer[i]);
+	}
+	if(mode == MASK_RGBA && lights.size() > 4)
+		std::cout << "occlusionMask: only the first 4 of " << lights.size() << " lights fit into RGBA!\n";
+	return true;
+}
+
+float occlusionMask_t::lightVisibility(renderState_t &state, const surfacePoint_t &sp, const vector3d_t &N,
+										const light_t *l, unsigned int l_offs) const
+{
+	ray_t lightRay;
+	lightRay.from = sp.P;
+	color_t lcol, scol;
+	if(l->diracLight())
+	{
+		if( !l->illuminate(sp, lcol, lightRay) || (N * lightRay.dir) <= 0.f ) return 0.f;
+		lightRay.tmin = 0.0005f;
+		if(trShad)
+		{
+			if(scene->isShadowed(state, lightRay, sDepth, scol)) return 0.f;
+			return scol.energy();
+		}
+		return scene->isShadowed(state, lightRay) ? 0.f : 1.f;
+	}
+	// area light and suchlike, same sample sequence as estimateDirect_PH
+	int n = l->nSamples();
+	unsigned int offs = n * state.pixelSample + state.samplingOffs + l_offs;
+	Halton hal3(3);
+	hal3.setStart(offs-1);
+	lSample_t ls;
+	float vis = 0.f;
+	for(int i=0; i<n; ++i)
+	{
+		ls.s1 = RI_vdC(offs+i);
+		ls.s2 = hal3.getNext();
+		if( !l->illumSample(sp, ls, lightRay) || ls.pdf <= 1e-6f || (N * lightRay.dir) <= 0.f ) continue;
+		lightRay.tmin = 0.0005f;
+		if(trShad)
+		{
+			if(scene->isShadowed(state, lightRay, sDepth, scol)) continue;
+			vis += scol.energy();
+		}
+		else if(scene->isShadowed(state, lightRay)) continue;
+		else vis += 1.f;
+	}
+	return vis / (float)n;
+}
+
+bool occlusionMask_t::render(imageFilm_t *image)
+{
+	if(mode == MASK_CHANNELS)
+	{
+		lightChannels.resize(lights.size());
+		for(unsigned int i=0; i<lights.size(); ++i)
+		{
+			std::ostringstream name;
+			name << "Light" << i;
+			int chan = image->getChannel(name.str());
+			if(chan < 0) chan = image->addChannel(name.str(), true);
+			lightChannels[i] = chan;
+		}
+	}
+	return tiledIntegrator_t::render(image);
+}
+
+colorA_t occlusionMask_t::integrate(renderState_t &state, diffRay_t &ray) const
+{
+	surfacePoint_t sp;
+	if(!scene->intersect(state, ray, sp)) return colorA_t(0.f);
+	return integrateSurface(state, ray, sp);
+}
+
+colorA_t occlusionMask_t::integrateSurface(renderState_t &state, diffRay_t &ray, const surfacePoint_t &sp) const
+{
+	vector3d_t N = FACE_FORWARD(sp.Ng, sp.N, -ray.dir);
+	unsigned int l_offs = 0;
+	if(mode == MASK_ANY)
+	{
+		float maxVis = 0.f;
+		for(unsigned int i=0; i<lights.size() && maxVis < 1.f; ++i, l_offs += 4567)
+		{
+			maxVis = std::max(maxVis, lightVisibility(state, sp, N, lights[i], l_offs));
+		}
+		return colorA_t(maxVis, maxVis, maxVis, 1.f);
+	}
+	if(mode == MASK_CHANNELS)
+	{
+		int x = (int)state.screenpos.x, y = (int)state.screenpos.y;
+		float maxVis = 0.f;
+		for(unsigned int i=0; i<lights.size(); ++i, l_offs += 4567)
+		{
+			float vis = lightVisibility(state, sp, N, lights[i], l_offs);
+			imageFilm->addChanSample(vis, lightChannels[i], x, y);
+			maxVis = std::max(maxVis, vis);
+		}
+		return colorA_t(maxVis, maxVis, maxVis, 1.f);
+	}
+	float vis[4] = { 0.f, 0.f, 0.f, 0.f };
+	int nLights = std::min(4, (int)lights.size());
+	for(int i=0; i<nLights; ++i, l_offs += 4567)
+	{
+		vis[i] = lightVisibility(state, sp, N, lights[i], l_offs);
+	}
+	return colorA_t(vis[0], vis[1], vis[2], vis[3]);
+}
+
+integrator_t* occlusionMask_t::factory(paraMap_t &params, renderEnvironment_t &render)
+{
+	bool transpShad=false;
+	int shadowDepth=4;
+	const std::string *modeName=0;
+
+	params.getParam("transpShad", transpShad);
+	params.getParam("shadowDepth", shadowDepth);
+	params.getParam("mask_mode", modeName);
+
+	maskMode mode = MASK_ANY;
+	if(modeName && *modeName == "rgba") mode = MASK_RGBA;
+	else if(modeName && *modeName == "channels") mode = MASK_CHANNELS;
+
+	return new occlusionMask_t(transpShad, shadowDepth, mode);
+}
+
+extern "C"
+{
+
+	YAFRAYPLUGIN_EXPORT void registerPlugin(renderEnvironment_t &render)
+	{
+		render.registerFactory("occlusionmask", occlusionMask_t::factory);
+	}
+
+}
+
+__END_YAFRAY
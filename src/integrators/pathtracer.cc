@@ -284,7 +284,7 @@ colorA_t pathIntegrator_t::integrate(renderState_t &state, diffRay_t &ray/*, sam
 	surfacePoint_t sp;
 	void *o_udat = state.userdata;
 	//shoot ray into scene
-	if(scene->intersect(ray, sp))
+	if(scene->intersect(state, ray, sp))
 	{
 		// if camera ray initialize sampling offset:
 		if(state.raylevel == 0)
@@ -320,6 +320,8 @@ colorA_t pathIntegrator_t::integrate(renderState_t &state, diffRay_t &ray/*, sam
 		{
 			color_t pathCol(0.0), wl_col;
 			path_flags |= (BSDF_REFLECT | BSDF_TRANSMIT);
+			// each path covers 1/n of the (cosine weighted) hemisphere, a cone with the same solid angle opens by 2/sqrt(n)
+			PFLOAT spread = 2.f / std::sqrt((PFLOAT)nPaths);
 			for(int i=0; i<nPaths; ++i)
 			{
 				void *first_udat = state.userdata;
@@ -355,7 +357,10 @@ colorA_t pathIntegrator_t::integrate(renderState_t &state, diffRay_t &ray/*, sam
 				pRay.tmin = 0.0005;
 				pRay.tmax = -1.0;
 				pRay.from = sp.P;
-				if(!scene->intersect(pRay, *hit)) //hit background
+				// texture lookups at the path vertices filter over the ray cone, if the bounce was diffuse
+				state.coneRay = &pRay;
+				state.coneSpread = (s.sampledFlags & BSDF_DIFFUSE) ? spread : 0.f;
+				if(!scene->intersect(state, pRay, *hit)) //hit background
 				{
 					if(include_bg) pathCol += throughput * (*background)(pRay, state, true);
 					continue;
@@ -417,8 +422,10 @@ colorA_t pathIntegrator_t::integrate(renderState_t &state, diffRay_t &ray/*, sam
 					pRay.tmin = 0.0005;
 					pRay.tmax = -1.0;
 					pRay.from = hit->P;
+					// a single path from here on
+					state.coneSpread = (s.sampledFlags & BSDF_DIFFUSE) ? 2.f : 0.f;
 
-					if(!scene->intersect(pRay, *hit2)) //hit background
+					if(!scene->intersect(state, pRay, *hit2)) //hit background
 					{
 						if(include_bg || (state.includeLights && ibl)) pathCol += throughput * (*background)(pRay, state, true);
 						break;
@@ -449,6 +456,7 @@ colorA_t pathIntegrator_t::integrate(renderState_t &state, diffRay_t &ray/*, sam
 				state.userdata = first_udat;
 				
 			}
+			state.coneRay = 0;
 			col += pathCol * ( (CFLOAT)1.0 / (CFLOAT)nPaths );
 		}
 		//reset chromatic state:
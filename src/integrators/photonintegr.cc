@@ -20,6 +20,7 @@
 
 //#include <mcqmc.h>
 #include <integrators/photonintegr.h>
+#include <yafraycore/rendertrace.h>
 
 __BEGIN_YAFRAY
 
@@ -29,6 +30,9 @@ photonIntegrator_t::photonIntegrator_t(int photons, bool transpShad, int shadowD
 	type = SURFACE;
 	rDepth = 6;
 	maxBounces = 5;
+	fgAdaptive = false;
+	fgMinPaths = 8;
+	fgThreshold = 0.05f;
 #if OLD_PMAP > 0
 	diffuseMap.setMaxRadius(sqrt(dsRad)); causticMap.setMaxRadius(sqrt(dsRad));
 #endif
@@ -118,6 +122,8 @@ inline color_t photonIntegrator_t::estimateOneDirect(renderState_t &state, const
 	float lightPdf;
 	bool shadowed;
 	const material_t *oneMat = sp.material;
+	// constant diffuse materials need no initBSDF() data
+	const bool constDiff = oneMat->isConstantDiffuse();
 	lightRay.from = sp.P;
 	int nLightsI = lights.size();
 	if(nLightsI == 0) return color_t(0.f);
@@ -142,7 +148,7 @@ inline color_t photonIntegrator_t::estimateOneDirect(renderState_t &state, const
 			if(!shadowed)
 			{
 				if(trShad) lcol *= scol;
-				color_t surfCol = oneMat->eval(state, sp, wo, lightRay.dir, BSDF_ALL);
+				color_t surfCol = constDiff ? oneMat->evalConstDiffuse(sp, wo, lightRay.dir, BSDF_ALL) : oneMat->eval(state, sp, wo, lightRay.dir, BSDF_ALL);
 				col = surfCol * lcol * std::fabs(sp.N*lightRay.dir);
 			}
 		}
@@ -166,11 +172,12 @@ inline color_t photonIntegrator_t::estimateOneDirect(renderState_t &state, const
 			{
 				if(trShad) ls.col *= scol;
 				//color_t surfCol = bsdf->eval(sp, wo, lightRay.dir, userdata);
-				color_t surfCol = oneMat->eval(state, sp, wo, lightRay.dir, BSDF_ALL);
+				color_t surfCol = constDiff ? oneMat->evalConstDiffuse(sp, wo, lightRay.dir, BSDF_ALL) : oneMat->eval(state, sp, wo, lightRay.dir, BSDF_ALL);
 				
 				if( canIntersect ) // bound samples and compensate by sampling from BSDF later
 				{
-					float mPdf = oneMat->pdf(state, sp, wo, lightRay.dir, BSDF_GLOSSY | BSDF_DIFFUSE | BSDF_DISPERSIVE | BSDF_REFLECT | BSDF_TRANSMIT);
+					const BSDF_t mBSDFs = BSDF_GLOSSY | BSDF_DIFFUSE | BSDF_DISPERSIVE | BSDF_REFLECT | BSDF_TRANSMIT;
+					float mPdf = constDiff ? oneMat->pdfConstDiffuse(sp, wo, lightRay.dir, mBSDFs) : oneMat->pdf(state, sp, wo, lightRay.dir, mBSDFs);
 					float l2 = ls.pdf * ls.pdf;
 					float m2 = mPdf * mPdf + 0.01f;
 					float w = l2 / (l2 + m2);
@@ -193,7 +200,7 @@ inline color_t photonIntegrator_t::estimateOneDirect(renderState_t &state, const
 			ray_t bRay;
 			bRay.tmin = 0.0005; bRay.from = sp.P;
 			sample_t s(ls.s1, ls.s2, BSDF_GLOSSY | BSDF_DIFFUSE | BSDF_DISPERSIVE | BSDF_REFLECT | BSDF_TRANSMIT);
-			color_t surfCol = oneMat->sample(state, sp, wo, bRay.dir, s);
+			color_t surfCol = constDiff ? oneMat->sampleConstDiffuse(sp, wo, bRay.dir, s) : oneMat->sample(state, sp, wo, bRay.dir, s);
 			if( s.pdf>1e-6f && light->intersect(bRay, bRay.tmax, lcol, lightPdf) )
 			{
 				shadowed = (trShad) ? scene->isShadowed(state, bRay, sDepth, scol) : scene->isShadowed(state, bRay);
@@ -222,7 +229,6 @@ bool photonIntegrator_t::render(imageFilm_t *image)
 	gTimer.addEvent("rendert");
 	gTimer.start("rendert");
 	imageFilm->init();
-	
 	this->prepass = false;
 	if(cacheIrrad)
 	{
@@ -243,6 +249,14 @@ bool photonIntegrator_t::render(imageFilm_t *image)
 	}
 	gTimer.stop("rendert");
 	std::cout << "overall rendertime: "<< gTimer.getTime("rendert")<<"s\n";
+	// the render threads are done, their counters can be summed up already
+	renderStats_t &stats = scene->getStats();
+	stats.aggregate();
+	if(finalGather && stats.total(RS_FG_POINTS) > 0.0)
+	{
+		std::cout << "final gather: " << stats.total(RS_FG_RAYS)/stats.total(RS_FG_POINTS) << " paths per gather point on average (max " << nPaths << ")\n";
+		std::cout << "final gather: " << stats.total(RS_FG_FAST_VERTICES) << " of " << stats.total(RS_FG_VERTICES) << " path vertices on constant diffuse materials\n";
+	}
 //	surfIntegrator->cleanup();
 //	imageFilm->flush();
 	return true;
@@ -260,7 +274,7 @@ bool photonIntegrator_t::preprocess()
 		if(bgl) lights.push_back(bgl);
 	}
 	//stats:
-	int _nIntersect=0, _nDiffuse=0;
+	int _nIntersect=0, _nDiffuse=0, _nConstDiffuse=0;
 	//end stats:
 	ray_t ray;
 	float lightNumPdf, lightPdf, s1, s2, s3, s4, s5, s6, s7, sL;
@@ -279,23 +293,38 @@ bool photonIntegrator_t::preprocess()
 	}
 	delete[] energies;
 	//shoot photons
+	traceScope_t shootTrace("photon shooting");
 	bool done=false;
 	unsigned int curr=0, nDiffuse=0, nCaustic=0;
 	// for radiance map:
 	preGatherData_t pgdat(&diffuseMap, &causticMap);
 	
 	surfacePoint_t sp;
-	renderState_t state;
+	// every photon has its own random number stream, the maps do not depend on what ran before
+	random_t prng(scene->getSeed());
+	renderState_t state(&prng);
+	// photon shooting is single threaded
+	state.stats = scene->getStats().thread(0);
 	unsigned char userdata[USER_DATA_SIZE+7];
 	state.userdata = (void *)( &userdata[7] - ( ((size_t)&userdata[7])&7 ) ); // pad userdata to 8 bytes
+	// the light sampling dimensions of consecutive photons are generated in runs
+	sampler_t photonSam;
+	int dimW = photonSam.addDimension(QMC_SOBOL);
+	int dim1 = photonSam.addDimension(QMC_VDC);
+	int dim2 = photonSam.addDimension(QMC_HALTON, 2);
+	int dim3 = photonSam.addDimension(QMC_HALTON, 3);
+	int dim4 = photonSam.addDimension(QMC_HALTON, 4);
 	while(!done)
 	{
+		prng.setStream(curr);
+		if(!photonSam.contains(curr)) photonSam.generate(curr, std::max(1, std::min(4096, (int)nPhotons - (int)curr)));
+		int k = curr - photonSam.start();
 		state.chromatic = true;
-		state.wavelength = RI_S(curr);
-		s1 = RI_vdC(curr);
-		s2 = scrHalton(2, curr);
-		s3 = scrHalton(3, curr);
-		s4 = scrHalton(4, curr);
+		state.wavelength = photonSam.get(dimW, k);
+		s1 = photonSam.get(dim1, k);
+		s2 = photonSam.get(dim2, k);
+		s3 = photonSam.get(dim3, k);
+		s4 = photonSam.get(dim4, k);
 		//sL = RI_S(curr);
 		sL = float(curr) / float(nPhotons);
 		int lightNum = lightPowerD->DSample(sL, &lightNumPdf);
@@ -309,15 +338,21 @@ bool photonIntegrator_t::preprocess()
 		int nBounces=0;
 		bool causticPhoton = false;
 		bool directPhoton = true;
-		while( scene->intersect(ray, sp) )
+		while( scene->intersect(state, ray, sp) )
 		{
 			++_nIntersect;
 			if(isnan(pcol.R) || isnan(pcol.G) || isnan(pcol.B))
 			{ std::cout << "NaN WARNING (photon color)" << std::endl; break; }
 			vector3d_t wi = -ray.dir, wo;
 			const material_t *material = sp.material;
+			const bool constDiff = material->isConstantDiffuse();
 			BSDF_t bsdfs;
-			material->initBSDF(state, sp, bsdfs);
+			if(constDiff)
+			{
+				bsdfs = material->getFlags();
+				++_nConstDiffuse;
+			}
+			else material->initBSDF(state, sp, bsdfs);
 			if(bsdfs & (BSDF_DIFFUSE | BSDF_GLOSSY))
 			{
 				++_nDiffuse;
@@ -336,13 +371,21 @@ bool photonIntegrator_t::preprocess()
 				}
 				// create entry for radiance photon:
 				// don't forget to choose subset only, face normal forward; geometric vs. smooth normal?
-				if(finalGather && ourRandom() < 0.125 )
+				if(finalGather && prng() < 0.125 )
 				{
 					vector3d_t N = FACE_FORWARD(sp.Ng, sp.N, wi);
 					radData_t rd(sp.P, N);
 					//pgdat.rad_mats.push_back(sp.material);
-					rd.refl = material->getReflectivity(state, sp, BSDF_DIFFUSE | BSDF_GLOSSY | BSDF_REFLECT);
-					rd.transm = material->getReflectivity(state, sp, BSDF_DIFFUSE | BSDF_GLOSSY | BSDF_TRANSMIT);
+					if(constDiff)
+					{
+						rd.refl = material->getDiffuseAlbedo();
+						rd.transm = color_t(0.f);
+					}
+					else
+					{
+						rd.refl = material->getReflectivity(state, sp, BSDF_DIFFUSE | BSDF_GLOSSY | BSDF_REFLECT);
+						rd.transm = material->getReflectivity(state, sp, BSDF_DIFFUSE | BSDF_GLOSSY | BSDF_TRANSMIT);
+					}
 					//if(rad_refl.size() < 10) std::cout << "reflectivity: " << rad_refl.back() <<
 					//			"transmissivity: " <<  rad_transm.back() << std::endl;
 					pgdat.rad_points.push_back(rd);
@@ -364,14 +407,14 @@ bool photonIntegrator_t::preprocess()
 			}
 			else
 			{
-				s5 = ourRandom();
-				s6 = ourRandom();
-				s7 = ourRandom();
+				s5 = prng();
+				s6 = prng();
+				s7 = prng();
 			}
 			pSample_t sample(s5, s6, s7, BSDF_ALL, pcol);
 			//color_t fcol;
 			//bool scattered = material->scatterPhoton(sp, wi, wo, s5, s6, BSDF_ALL, bsdfs, fcol);
-			bool scattered = material->scatterPhoton(state, sp, wi, wo, sample);
+			bool scattered = constDiff ? material->scatterPhotonConstDiffuse(sp, wi, wo, sample) : material->scatterPhoton(state, sp, wi, wo, sample);
 			if(!scattered) break; //photon was absorped.
 			//pcol *= fcol;
 			pcol = sample.color;
@@ -398,13 +441,15 @@ bool photonIntegrator_t::preprocess()
 		done = (curr >= nPhotons) ? true : false;
 	}
 	delete lightPowerD;
-	std::cout << "shot "<<curr<<" photons, "<<_nIntersect<<" hits, "<<_nDiffuse<<" of them on diffuse srf.\n";
+	std::cout << "shot "<<curr<<" photons, "<<_nIntersect<<" hits, "<<_nDiffuse<<" of them on diffuse srf., "
+		<<_nConstDiffuse<<" on constant diffuse materials.\n";
 	std::cout << "stored caustic photons: "<<causticMap.nPhotons()<<"\n";
 	std::cout << "stored diffuse photons: "<<diffuseMap.nPhotons()<<"\n";
 	std::cout << "building photon kd-trees...\n";
 	if(causticMap.nPhotons() > 0) causticMap.updateTree();
 	if(diffuseMap.nPhotons() > 0) diffuseMap.updateTree();
 	std::cout << "done!\n";
+	shootTrace.end();
 	if(diffuseMap.nPhotons() < 50)
 	{ std::cout<<"too few photons! Stop.\n"; return false; }
 	
@@ -412,6 +457,7 @@ bool photonIntegrator_t::preprocess()
 	lookupRad = 4*dsRadius*dsRadius;
 	if(finalGather) //create radiance map:
 	{
+		traceScope_t gatherTrace("pre-gather");
 		gTimer.start("pregather");
 #if HAVE_PTHREAD
 		// == remove too close radiance points ==//
@@ -441,6 +487,7 @@ bool photonIntegrator_t::preprocess()
 		for(int i=0;i<nThreads;++i) delete workers[i];
 		
 		radianceMap.swapVector(pgdat.radianceVec);
+		state.count(RS_PHOTON_LOOKUPS, pgdat.rad_points.size());
 		pgdat.pbar->done();
 		delete pgdat.pbar;
 #else
@@ -497,121 +544,177 @@ bool photonIntegrator_t::preprocess()
 color_t photonIntegrator_t::finalGathering(renderState_t &state, const surfacePoint_t &sp, const vector3d_t &wo) const
 {
 	color_t pathCol(0.0);
-	void *first_udat = state.userdata;
 	unsigned char userdata[USER_DATA_SIZE+7];
 	void *n_udat = (void *)( &userdata[7] - ( ((size_t)&userdata[7])&7 ) ); // pad userdata to 8 bytes
 	
 	int nSampl = std::max(1, nPaths/state.rayDivision);
-	for(int i=0; i<nSampl; ++i)
+	int nBatch = nSampl;
+	if(fgAdaptive) nBatch = std::min(nSampl, std::max(2, fgMinPaths/state.rayDivision));
+	// running sums of the path energies to estimate the variance of the gathered radiance;
+	// the sample offsets only depend on the path index, so any prefix of the sequence is well stratified
+	double sum=0.0, sumSq=0.0;
+	int i=0, nVerts=0, nFast=0;
+	unsigned int offs0 = nPaths * state.pixelSample + state.samplingOffs; // some redundancy here...
+	// each path covers 1/n of the (cosine weighted) hemisphere, a cone with the same solid angle opens by 2/sqrt(n)
+	PFLOAT spread = 2.f / std::sqrt((PFLOAT)nSampl);
+	sampler_t sam;
+	int dimU = sam.addDimension(QMC_VDC), dimV = sam.addDimension(QMC_HALTON, 2);
+	while(i < nSampl)
 	{
-		color_t throughput( 1.0 );
-		PFLOAT length=0;
-		surfacePoint_t hit=sp;
-		vector3d_t pwo = wo;
-		ray_t pRay;
-		BSDF_t matBSDFs;
-		bool did_hit;
-		const material_t *p_mat = sp.material;
-		unsigned int offs = nPaths * state.pixelSample + state.samplingOffs + i; // some redundancy here...
-		color_t lcol, scol;
-		// "zero'th" FG bounce:
-		float s1 = RI_vdC(offs);
-		float s2 = scrHalton(2, offs);
+		int batchEnd = std::min(nSampl, i + nBatch);
+		sam.generate(offs0 + i, batchEnd - i);
+		for(; i<batchEnd; ++i)
+		{
+			unsigned int offs = offs0 + i;
+			int si = offs - sam.start();
+			color_t col = gatherPath(state, sp, wo, offs, sam.get(dimU, si), sam.get(dimV, si), spread, n_udat, nVerts, nFast);
+			double e = col.energy();
+			sum += e;
+			sumSq += e*e;
+			pathCol += col;
+		}
+		if(!fgAdaptive || i >= nSampl) break;
+		// stop when the standard error of the mean is within fgThreshold of the mean:
+		// var/n <= (t*mean)^2 <=> n*sumSq - sum^2 <= t^2 * sum^2 * (n-1)
+		double n = (double)i;
+		double var = n*sumSq - sum*sum;
+		double tol = (double)fgThreshold * (double)fgThreshold * sum*sum * (n - 1.0);
+		if(var <= tol) break;
+	}
+	state.count(RS_FG_RAYS, i);
+	state.count(RS_FG_POINTS);
+	state.count(RS_FG_VERTICES, nVerts);
+	state.count(RS_FG_FAST_VERTICES, nFast);
+	return pathCol / (CFLOAT)i;
+}
+
+/*! trace a single final gather path starting at sp, using sample offset offs. spread is the angle of the
+	ray cone of the first path segment (see renderState_t::coneRay). nVerts and nFast count the path vertices that were shaded, and how many of them took the constant diffuse path */
+color_t photonIntegrator_t::gatherPath(renderState_t &state, const surfacePoint_t &sp, const vector3d_t &wo, unsigned int offs, float s1, float s2,
+										PFLOAT spread, void *n_udat, int &nVerts, int &nFast) const
+{
+	color_t pathCol(0.0);
+	void *first_udat = state.userdata;
+	color_t throughput( 1.0 );
+	PFLOAT length=0;
+	surfacePoint_t hit=sp;
+	vector3d_t pwo = wo;
+	ray_t pRay;
+	BSDF_t matBSDFs;
+	bool did_hit;
+	const material_t *p_mat = sp.material;
+	color_t lcol, scol;
+	// "zero'th" FG bounce:
+	if(state.rayDivision > 1)
+	{
+		s1 = addMod1(s1, state.dc1);
+		s2 = addMod1(s2, state.dc2);
+	}
+	//sample_t s(s1, s2, BSDF_ALL&~BSDF_SPECULAR); // specular done via recursive raytracing
+	sample_t s(s1, s2, BSDF_DIFFUSE|BSDF_REFLECT|BSDF_TRANSMIT); // specular/glossy done via recursive raytracing
+	scol = p_mat->sample(state, hit, pwo, pRay.dir, s);
+	if(s.pdf > 1.0e-6f) scol *= (std::fabs(pRay.dir*sp.N)/s.pdf);
+	else return pathCol;
+	//scol = p_mat->sample(state, hit, pwo, pRay.dir, s1, s2); //ya no pdf yet...assume lambertian
+	if(scol.isBlack()) return pathCol;
+	pRay.tmin = 0.0005;
+	pRay.tmax = -1.0;
+	pRay.from = hit.P;
+	throughput = scol;
+	// texture lookups at the path vertices filter over the ray cone
+	state.coneRay = &pRay;
+	state.coneSpread = spread;
+	
+	if( !(did_hit = scene->intersect(state, pRay, hit)) ) //hit background
+	{
+		if(background && use_bg) pathCol += throughput * (*background)(pRay, state, true);
+		state.coneRay = 0;
+		return pathCol;
+	}
+	p_mat = hit.material;
+	length = pRay.tmax;
+	state.userdata = n_udat;
+	matBSDFs = p_mat->getFlags();
+	bool has_spec = matBSDFs & BSDF_SPECULAR;
+	bool caustic = false;
+	bool close = length < gatherDist;
+	bool do_bounce = close || has_spec;
+	// further bounces construct a path just as with path tracing:
+	for(int depth=0; depth<gatherBounces && do_bounce; ++depth)
+	{
+		pwo = -pRay.dir;
+		const bool constDiff = p_mat->isConstantDiffuse();
+		++nVerts;
+		if(constDiff)
+		{
+			matBSDFs = p_mat->getFlags();
+			++nFast;
+		}
+		else p_mat->initBSDF(state, hit, matBSDFs);
+		//lcol = estimateOneDirect(state, scene, hit, pwo, scene->lights, trShad, sDepth, 4*depth+5, offs);
+		if(matBSDFs & (BSDF_DIFFUSE | BSDF_GLOSSY))
+		{
+			if(close)
+			{
+				lcol = estimateOneDirect(state, hit, pwo, lights, 4*depth+5, offs);
+				//lcol += estimatePhotons(state, hit, causticMap, pwo, nCausSearch, dsRadius);
+				pathCol += lcol*throughput;
+			}
+			else if(caustic)
+			{
+				vector3d_t sf = FACE_FORWARD(hit.Ng, hit.N, pwo);//hit.N;
+				state.count(RS_PHOTON_LOOKUPS);
+				const photon_t *nearest = radianceMap.findNearest(hit.P, sf, lookupRad);
+				if(nearest) pathCol += throughput * nearest->color();
+			}
+		}
+		
+		s1 = scrHalton(4*depth+3, offs); //ourRandom();//
+		s2 = scrHalton(4*depth+4, offs); //ourRandom();//;
 		if(state.rayDivision > 1)
 		{
 			s1 = addMod1(s1, state.dc1);
 			s2 = addMod1(s2, state.dc2);
 		}
-		//sample_t s(s1, s2, BSDF_ALL&~BSDF_SPECULAR); // specular done via recursive raytracing
-		sample_t s(s1, s2, BSDF_DIFFUSE|BSDF_REFLECT|BSDF_TRANSMIT); // specular/glossy done via recursive raytracing
-		scol = p_mat->sample(state, hit, pwo, pRay.dir, s);
-		if(s.pdf > 1.0e-6f) scol *= (std::fabs(pRay.dir*sp.N)/s.pdf);
-		else continue;
+		sample_t sb(s1, s2, (close) ? BSDF_ALL : BSDF_ALL_SPECULAR | BSDF_FILTER);
 		//scol = p_mat->sample(state, hit, pwo, pRay.dir, s1, s2); //ya no pdf yet...assume lambertian
-		if(scol.isBlack()) continue;
+		//if(scol.isBlack()) break;
+		scol = constDiff ? p_mat->sampleConstDiffuse(hit, pwo, pRay.dir, sb) : p_mat->sample(state, hit, pwo, pRay.dir, sb);
+		if( sb.pdf > 1.0e-6f) scol *= (std::fabs(pRay.dir*hit.N)/sb.pdf);
+		else { did_hit=false; break; }
 		pRay.tmin = 0.0005;
 		pRay.tmax = -1.0;
 		pRay.from = hit.P;
-		throughput = scol;
-		
-		if( !(did_hit = scene->intersect(pRay, hit)) ) //hit background
+		throughput *= scol;
+		// a single path from here on; specular bounces keep no usable cone
+		state.coneSpread = (sb.sampledFlags & BSDF_DIFFUSE) ? 2.f : 0.f;
+		did_hit = scene->intersect(state, pRay, hit);
+		if(!did_hit) //hit background
 		{
 			if(background && use_bg) pathCol += throughput * (*background)(pRay, state, true);
-			continue;
+			break;
+//				std::cout <<"!";
 		}
 		p_mat = hit.material;
-		length = pRay.tmax;
-		state.userdata = n_udat;
+		length += pRay.tmax;
+		caustic = (caustic || !depth) && (sb.sampledFlags & (BSDF_SPECULAR | BSDF_FILTER));
+		close =  length < gatherDist;
+		do_bounce = caustic || close;
+	}
+	if(did_hit)
+	{
 		matBSDFs = p_mat->getFlags();
-		bool has_spec = matBSDFs & BSDF_SPECULAR;
-		bool caustic = false;
-		bool close = length < gatherDist;
-		bool do_bounce = close || has_spec;
-		// further bounces construct a path just as with path tracing:
-		for(int depth=0; depth<gatherBounces && do_bounce; ++depth)
+		if(matBSDFs & (BSDF_DIFFUSE | BSDF_GLOSSY))
 		{
-			pwo = -pRay.dir;
-			p_mat->initBSDF(state, hit, matBSDFs);
-			//lcol = estimateOneDirect(state, scene, hit, pwo, scene->lights, trShad, sDepth, 4*depth+5, offs);
-			if(matBSDFs & (BSDF_DIFFUSE | BSDF_GLOSSY))
-			{
-				if(close)
-				{
-					lcol = estimateOneDirect(state, hit, pwo, lights, 4*depth+5, offs);
-					//lcol += estimatePhotons(state, hit, causticMap, pwo, nCausSearch, dsRadius);
-					pathCol += lcol*throughput;
-				}
-				else if(caustic)
-				{
-					vector3d_t sf = FACE_FORWARD(hit.Ng, hit.N, pwo);//hit.N;
-					const photon_t *nearest = radianceMap.findNearest(hit.P, sf, lookupRad);
-					if(nearest) pathCol += throughput * nearest->color();
-				}
-			}
-			
-			s1 = scrHalton(4*depth+3, offs); //ourRandom();//
-			s2 = scrHalton(4*depth+4, offs); //ourRandom();//;
-			if(state.rayDivision > 1)
-			{
-				s1 = addMod1(s1, state.dc1);
-				s2 = addMod1(s2, state.dc2);
-			}
-			sample_t sb(s1, s2, (close) ? BSDF_ALL : BSDF_ALL_SPECULAR | BSDF_FILTER);
-			//scol = p_mat->sample(state, hit, pwo, pRay.dir, s1, s2); //ya no pdf yet...assume lambertian
-			//if(scol.isBlack()) break;
-			scol = p_mat->sample(state, hit, pwo, pRay.dir, sb);
-			if( sb.pdf > 1.0e-6f) scol *= (std::fabs(pRay.dir*hit.N)/sb.pdf);
-			else { did_hit=false; break; }
-			pRay.tmin = 0.0005;
-			pRay.tmax = -1.0;
-			pRay.from = hit.P;
-			throughput *= scol;
-			did_hit = scene->intersect(pRay, hit);
-			if(!did_hit) //hit background
-			{
-				if(background && use_bg) pathCol += throughput * (*background)(pRay, state, true);
-				break;
-//				std::cout <<"!";
-			}
-			p_mat = hit.material;
-			length += pRay.tmax;
-			caustic = (caustic || !depth) && (sb.sampledFlags & (BSDF_SPECULAR | BSDF_FILTER));
-			close =  length < gatherDist;
-			do_bounce = caustic || close;
-		}
-		if(did_hit)
-		{
-			matBSDFs = p_mat->getFlags();
-			if(matBSDFs & (BSDF_DIFFUSE | BSDF_GLOSSY))
-			{
-				vector3d_t sf = FACE_FORWARD(hit.Ng, hit.N, -pRay.dir);//hit.N;
-				const photon_t *nearest = radianceMap.findNearest(hit.P, sf, lookupRad);
-				if(nearest) pathCol += throughput * nearest->color();
-			}
+			vector3d_t sf = FACE_FORWARD(hit.Ng, hit.N, -pRay.dir);//hit.N;
+			state.count(RS_PHOTON_LOOKUPS);
+			const photon_t *nearest = radianceMap.findNearest(hit.P, sf, lookupRad);
+			if(nearest) pathCol += throughput * nearest->color();
 		}
-		state.userdata = first_udat;
 	}
-	return pathCol / (CFLOAT)nSampl;
+	state.userdata = first_udat;
+	state.coneRay = 0;
+	return pathCol;
 }
 
 void photonIntegrator_t::sampleIrrad(renderState_t &state, const surfacePoint_t &sp, const vector3d_t &wo, irradSample_t &ir) const
@@ -624,8 +727,14 @@ void photonIntegrator_t::sampleIrrad(renderState_t &state, const surfacePoint_t
 	unsigned char userdata[USER_DATA_SIZE+7];
 	void *n_udat = (void *)( &userdata[7] - ( ((size_t)&userdata[7])&7 ) ); // pad userdata to 8 bytes
 	vector3d_t wi_0;
+	int nVerts=0, nFast=0;
 	
 	int nSampl = nPaths;
+	unsigned int offs0 = nPaths * state.pixelSample + state.samplingOffs; // some redundancy here...
+	PFLOAT spread = 2.f / std::sqrt((PFLOAT)nSampl); // see finalGathering()
+	sampler_t sam;
+	int dimU = sam.addDimension(QMC_VDC), dimV = sam.addDimension(QMC_HALTON, 2);
+	sam.generate(offs0, nSampl);
 	for(int i=0; i<nSampl; ++i)
 	{
 		color_t throughput( 1.0 );
@@ -637,11 +746,11 @@ void photonIntegrator_t::sampleIrrad(renderState_t &state, const surfacePoint_t
 		BSDF_t matBSDFs;
 		bool did_hit;
 		//const material_t *p_mat = sp.material;
-		unsigned int offs = nPaths * state.pixelSample + state.samplingOffs + i; // some redundancy here...
+		unsigned int offs = offs0 + i;
 		color_t lcol, scol;
 		// "zero'th" FG bounce:
-		float s1 = RI_vdC(offs);
-		float s2 = scrHalton(2, offs);
+		float s1 = sam.get(dimU, i);
+		float s2 = sam.get(dimV, i);
 		//sample_t s(s1, s2, BSDF_DIFFUSE|BSDF_REFLECT|BSDF_TRANSMIT); // specular/glossy done via recursive raytracing
 		//scol = p_mat->sample(state, hit, pwo, pRay.dir, s);
 		//if(s.pdf > 1.0e-6f) scol *= (std::fabs(pRay.dir*sp.N)/s.pdf);
@@ -655,8 +764,10 @@ void photonIntegrator_t::sampleIrrad(renderState_t &state, const surfacePoint_t
 		pRay.tmax = -1.0;
 		pRay.from = hit.P;
 		//throughput = scol;
+		state.coneRay = &pRay;
+		state.coneSpread = spread;
 		
-		if( (did_hit = scene->intersect(pRay, hit)) )
+		if( (did_hit = scene->intersect(state, pRay, hit)) )
 		{
 			if(ir.Rmin < 0.f) ir.Rmin = pRay.tmax;
 			else ir.Rmin = std::min(ir.Rmin, pRay.tmax);
@@ -685,7 +796,14 @@ void photonIntegrator_t::sampleIrrad(renderState_t &state, const surfacePoint_t
 		for(int depth=0; depth<gatherBounces && do_bounce; ++depth)
 		{
 			pwo = -pRay.dir;
-			p_mat->initBSDF(state, hit, matBSDFs);
+			const bool constDiff = p_mat->isConstantDiffuse();
+			++nVerts;
+			if(constDiff)
+			{
+				matBSDFs = p_mat->getFlags();
+				++nFast;
+			}
+			else p_mat->initBSDF(state, hit, matBSDFs);
 			//lcol = estimateOneDirect(state, scene, hit, pwo, scene->lights, trShad, sDepth, 4*depth+5, offs);
 			if(matBSDFs & (BSDF_DIFFUSE | BSDF_GLOSSY))
 			{
@@ -698,6 +816,7 @@ void photonIntegrator_t::sampleIrrad(renderState_t &state, const surfacePoint_t
 				else if(caustic)
 				{
 					vector3d_t sf = FACE_FORWARD(hit.Ng, hit.N, pwo);//hit.N;
+					state.count(RS_PHOTON_LOOKUPS);
 					const photon_t *nearest = radianceMap.findNearest(hit.P, sf, lookupRad);
 					if(nearest) pathCol += throughput * nearest->color();
 				}
@@ -708,14 +827,16 @@ void photonIntegrator_t::sampleIrrad(renderState_t &state, const surfacePoint_t
 			sample_t sb(s1, s2, (close) ? BSDF_ALL : BSDF_ALL_SPECULAR | BSDF_FILTER);
 			//scol = p_mat->sample(state, hit, pwo, pRay.dir, s1, s2); //ya no pdf yet...assume lambertian
 			//if(scol.isBlack()) break;
-			scol = p_mat->sample(state, hit, pwo, pRay.dir, sb);
+			scol = constDiff ? p_mat->sampleConstDiffuse(hit, pwo, pRay.dir, sb) : p_mat->sample(state, hit, pwo, pRay.dir, sb);
 			if( sb.pdf > 1.0e-6f) scol *= (std::fabs(pRay.dir*hit.N)/sb.pdf);
 			else { did_hit=false; break; }
 			pRay.tmin = 0.0005;
 			pRay.tmax = -1.0;
 			pRay.from = hit.P;
 			throughput *= scol;
-			did_hit = scene->intersect(pRay, hit);
+			// a single path from here on; specular bounces keep no usable cone
+			state.coneSpread = (sb.sampledFlags & BSDF_DIFFUSE) ? 2.f : 0.f;
+			did_hit = scene->intersect(state, pRay, hit);
 			if(!did_hit) //hit background
 			{
 				if(background && use_bg) pathCol += throughput * (*background)(pRay, state, true);
@@ -734,6 +855,7 @@ void photonIntegrator_t::sampleIrrad(renderState_t &state, const surfacePoint_t
 			if(matBSDFs & (BSDF_DIFFUSE | BSDF_GLOSSY))
 			{
 				vector3d_t sf = FACE_FORWARD(hit.Ng, hit.N, -pRay.dir);//hit.N;
+				state.count(RS_PHOTON_LOOKUPS);
 				const photon_t *nearest = radianceMap.findNearest(hit.P, sf, lookupRad);
 				if(nearest) pathCol += throughput * nearest->color();
 			}
@@ -744,13 +866,28 @@ void photonIntegrator_t::sampleIrrad(renderState_t &state, const surfacePoint_t
 		ir.w_b += pathCol.B * wi_0;
 		state.userdata = first_udat;
 	}
+	state.coneRay = 0;
 	ir.col *= 1.f / (CFLOAT)nSampl;
+	state.count(RS_FG_RAYS, nSampl);
+	state.count(RS_FG_POINTS);
+	state.count(RS_FG_VERTICES, nVerts);
+	state.count(RS_FG_FAST_VERTICES, nFast);
 	ir.w_r.normalize();
 	ir.w_g.normalize();
 	ir.w_b.normalize();
 }
 
 colorA_t photonIntegrator_t::integrate(renderState_t &state, diffRay_t &ray) const
+{
+	return shade(state, ray, 0);
+}
+
+colorA_t photonIntegrator_t::integrateSurface(renderState_t &state, diffRay_t &ray, const surfacePoint_t &sp) const
+{
+	return shade(state, ray, &sp);
+}
+
+colorA_t photonIntegrator_t::shade(renderState_t &state, diffRay_t &ray, const surfacePoint_t *hit) const
 {
 	static int _nMax=0;
 	static int calls=0;
@@ -758,10 +895,11 @@ colorA_t photonIntegrator_t::integrate(renderState_t &state, diffRay_t &ray) con
 	color_t col(0.0);
 	CFLOAT alpha=0.0;
 	surfacePoint_t sp;
+	if(hit) sp = *hit;
 	
 	void *o_udat = state.userdata;
 	bool oldIncludeLights = state.includeLights;
-	if(scene->intersect(ray, sp))
+	if(hit || scene->intersect(state, ray, sp))
 	{
 		unsigned char userdata[USER_DATA_SIZE+7];
 		state.userdata = (void *)( &userdata[7] - ( ((size_t)&userdata[7])&7 ) ); // pad userdata to 8 bytes
@@ -851,6 +989,7 @@ colorA_t photonIntegrator_t::integrate(renderState_t &state, diffRay_t &ray) con
 			if(showMap)
 			{
 				vector3d_t N = FACE_FORWARD(sp.Ng, sp.N, wo);
+				state.count(RS_PHOTON_LOOKUPS);
 				const photon_t *nearest = radianceMap.findNearest(sp.P, N, lookupRad);
 				if(nearest) col += nearest->color();
 			}
@@ -879,7 +1018,11 @@ colorA_t photonIntegrator_t::integrate(renderState_t &state, diffRay_t &ray) con
 			if(diffuseMap.nPhotons() > 0) diffuseMap.gather(sp.P, sp.N, gathered, nSearch, radius);
 			nGathered = gathered.size();
 	#else
-			if(diffuseMap.nPhotons() > 0) nGathered = diffuseMap.gather(sp.P, gathered, nSearch, radius);
+			if(diffuseMap.nPhotons() > 0)
+			{
+				nGathered = diffuseMap.gather(sp.P, gathered, nSearch, radius);
+				state.count(RS_PHOTON_LOOKUPS);
+			}
 	#endif
 			color_t sum(0.0);
 			if(nGathered > 0)
@@ -1062,6 +1205,9 @@ integrator_t* photonIntegrator_t::factory(paraMap_t &params, renderEnvironment_t
 	int bounces = 5;
 	int fgPaths = 32;
 	int fgBounces = 2;
+	bool fgAdaptive = false;
+	int fgMinPaths = 8;
+	float fgThreshold = 0.05f;
 	float dsRad=0.1;
 	float gatherDist=0.2;
 	
@@ -1078,6 +1224,9 @@ integrator_t* photonIntegrator_t::factory(paraMap_t &params, renderEnvironment_t
 	params.getParam("finalGather", finalGather);
 	params.getParam("fg_samples", fgPaths);
 	params.getParam("fg_bounces", fgBounces);
+	params.getParam("fg_adaptive", fgAdaptive);
+	params.getParam("fg_min_samples", fgMinPaths);
+	params.getParam("fg_threshold", fgThreshold);
 	gatherDist = /* 2.f* */dsRad;
 	params.getParam("fg_min_pathlen", gatherDist);
 	params.getParam("show_map", show_map);
@@ -1091,6 +1240,9 @@ integrator_t* photonIntegrator_t::factory(paraMap_t &params, renderEnvironment_t
 	ite->maxBounces = bounces;
 	ite->nPaths = fgPaths;
 	ite->gatherBounces = fgBounces;
+	ite->fgAdaptive = fgAdaptive;
+	ite->fgMinPaths = fgMinPaths;
+	ite->fgThreshold = fgThreshold;
 	ite->use_bg = use_bg;
 	ite->showMap = show_map;
 	ite->gatherDist = gatherDist;
@@ -123,7 +123,7 @@ bool photonIntegrator_t::progressiveTile(renderArea_t &a, int log_spacing, bool
 	
 	//!TODO!
 	int resx = scene->getCamera()->resX();
-	random_t prng(/* offset* */(resx*a.Y+a.X)+123);
+	random_t prng(scene->getSeed(), resx*a.Y+a.X);
 	renderState_t state(&prng);
 	state.threadID = threadID;
 	state.samplingOffs = 0; //TODO...
@@ -158,7 +158,7 @@ bool photonIntegrator_t::progressiveTile2(renderArea_t &a, int log_spacing, bool
 	
 	//!TODO!
 	int resx = scene->getCamera()->resX();
-	random_t prng(/* offset* */(resx*a.Y+a.X)+123);
+	random_t prng(scene->getSeed(), resx*a.Y+a.X);
 	renderState_t state(&prng);
 	state.threadID = threadID;
 	state.samplingOffs = 0; //TODO...
@@ -201,7 +201,7 @@ colorA_t photonIntegrator_t::recFillCache(renderState_t &state, diffRay_t &c_ray
 	color_t col(0.0);
 	surfacePoint_t sp;
 	
-	if(scene->intersect(c_ray, sp))
+	if(scene->intersect(state, c_ray, sp))
 	{
 		state.userdata = alloca(USER_DATA_SIZE);
 		spDifferentials_t spDiff(sp, c_ray);
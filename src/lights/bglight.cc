@@ -21,56 +21,181 @@
 #include <lights/bglight.h>
 #include <core_api/background.h>
 #include <core_api/texture.h>
+#include <core_api/scene.h>
 #include <utilities/sample_utils.h>
+#include <yafraycore/ccthreads.h>
+#include <yafraycore/rendertrace.h>
+#include <map>
+#include <sstream>
+#include <algorithm>
 
 __BEGIN_YAFRAY
 
-bgLight_t::bgLight_t(background_t *bg, int sampl): samples(sampl), background(bg)
+//! importance map of a background, shared by all lights with the same key
+struct bgDistrib_t
 {
-	initIS();
+	bgDistrib_t(int n): uDist(new pdf1D_t[n]), vDist(0), nv(n), users(0) {}
+	~bgDistrib_t(){ delete[] uDist; delete vDist; }
+	pdf1D_t *uDist, *vDist;
+	int nv;
+	int users;
+};
+
+// maps of backgrounds no light uses anymore are kept, so a background recreated
+// for the next bake finds its map; past this many the unused ones are dropped
+#define BG_IS_CACHE_SIZE 8
+
+static std::map<std::string, bgDistrib_t*> isCache;
+static yafthreads::mutex_t isCacheMutex;
+
+struct bgRowData_t
+{
+	bgRowData_t(background_t *bg, bgDistrib_t *d, int res): background(bg), distrib(d), nuMax(2 + 2*res), fetched(0) {}
+	background_t *background;
+	bgDistrib_t *distrib;
+	int nuMax;
+	volatile int fetched;
+	yafthreads::mutex_t mutex;
+};
+
+//! evaluate the background along row y of the importance map
+static void bgImportanceRow(const bgRowData_t &dat, int y, float *func)
+{
+	int nv = dat.distrib->nv;
+	float inv = 1.f/(float)nv;
+	float theta = (y+0.5f) * inv * M_PI;
+	float costheta = cos(theta), sintheta = sin(theta);
+	float circumf = sintheta;
+	int nu = 2 + int(circumf*(dat.nuMax - 2));
+	float inu = 1.f/(float)nu;
+	for(int x=0; x<nu; ++x)
+	{
+		ray_t ray;
+		ray.from = point3d_t(0.f);
+		
+		float phi = (x+0.5f) * inu * 2.0 * M_PI;
+		float cosphi = cos(phi), sinphi = sin(phi);
+		ray.dir.y = -1.0 * sintheta * cosphi;
+		ray.dir.x = sintheta * sinphi;
+		ray.dir.z = -costheta;
+		func[x] = dat.background->eval(ray).energy() * sintheta;
+	}
+	new (dat.distrib->uDist+y) pdf1D_t(func, nu);
+}
+
+class bgRowWorker_t: public yafthreads::thread_t
+{
+	public:
+		bgRowWorker_t(bgRowData_t *dat): rdata(dat) {}
+		virtual void body();
+	protected:
+		bgRowData_t *rdata;
+};
+
+void bgRowWorker_t::body()
+{
+	int start, end, total = rdata->distrib->nv;
+	float *func = new float[rdata->nuMax];
+	while(true)
+	{
+		rdata->mutex.lock();
+		start = rdata->fetched;
+		end = rdata->fetched = std::min(total, start + 8);
+		rdata->mutex.unlock();
+		if(start >= total) break;
+		for(int y=start; y<end; ++y) bgImportanceRow(*rdata, y, func);
+	}
+	delete[] func;
+}
+
+bgLight_t::bgLight_t(background_t *bg, int sampl, int res, const std::string &key):
+	uDist(0), vDist(0), distrib(0), resolution(res), samples(sampl), nv(0), background(bg)
+{
+	if(resolution < 2) resolution = 2;
+	if(!key.empty())
+	{
+		std::ostringstream k;
+		k << key << " res " << resolution;
+		isKey = k.str();
+	}
 }
 
 bgLight_t::~bgLight_t()
 {
-	delete[] uDist;
-	delete vDist;
+	if(!distrib) return;
+	if(isKey.empty()) { delete distrib; return; }
+	isCacheMutex.lock();
+	--distrib->users;
+	isCacheMutex.unlock();
 }
 
-void bgLight_t::initIS()
+void bgLight_t::initIS(int threads)
 {
-	nv= 360;
-	float *func = new float[1024];
-	float inu, inv = 1.f/(float)nv;
-	uDist = new pdf1D_t[nv];
-	
-	// Compute sampling distribution for lines
-	for (int y=0; y<nv; ++y)
+	if(!isKey.empty())
 	{
-		float theta = (y+0.5f) * inv * M_PI;
-		float costheta = cos(theta), sintheta = sin(theta);
-		float circumf = sintheta;
-		int nu = 2 + int(circumf*720);
-		inu = 1.f/(float)nu;
-		for(int x=0; x<nu; ++x)
+		isCacheMutex.lock();
+		std::map<std::string, bgDistrib_t*>::iterator i = isCache.find(isKey);
+		if(i != isCache.end())
 		{
-			ray_t ray;
-			ray.from = point3d_t(0.f);
-			
-			float phi = (x+0.5f) * inu * 2.0 * M_PI;
-			float cosphi = cos(phi), sinphi = sin(phi);
-			ray.dir.y = -1.0 * sintheta * cosphi;
-			ray.dir.x = sintheta * sinphi;
-			ray.dir.z = -costheta;
-			func[x] = background->eval(ray).energy() * sintheta;
+			distrib = i->second;
+			++distrib->users;
 		}
-		new (uDist+y) pdf1D_t(func, nu);
+		isCacheMutex.unlock();
 	}
-	// compute sampling distribution of image lines
-	for (int y=0; y<nv; ++y)
-		func[y] = uDist[y].integral;
-	vDist = new pdf1D_t(func, nv);
-	
-	delete[] func;
+	if(!distrib)
+	{
+		traceScope_t isTrace("background importance");
+		distrib = new bgDistrib_t(resolution);
+		bgRowData_t rdata(background, distrib, resolution);
+#if HAVE_PTHREAD
+		if(threads < 1) threads = 1;
+		std::vector<bgRowWorker_t *> workers;
+		for(int i=0; i<threads; ++i) workers.push_back(new bgRowWorker_t(&rdata));
+		for(int i=0; i<threads; ++i) workers[i]->run();
+		for(int i=0; i<threads; ++i) workers[i]->wait();
+		for(int i=0; i<threads; ++i) delete workers[i];
+#else
+		float *func = new float[rdata.nuMax];
+		for(int y=0; y<resolution; ++y) bgImportanceRow(rdata, y, func);
+		delete[] func;
+#endif
+		// compute sampling distribution of image lines
+		float *func = new float[resolution];
+		for (int y=0; y<resolution; ++y)
+			func[y] = distrib->uDist[y].integral;
+		distrib->vDist = new pdf1D_t(func, resolution);
+		delete[] func;
+		
+		if(!isKey.empty())
+		{
+			isCacheMutex.lock();
+			// another light with the same key may have finished first, keep its map and drop ours
+			std::map<std::string, bgDistrib_t*>::iterator found = isCache.find(isKey);
+			if(found != isCache.end())
+			{
+				delete distrib;
+				distrib = found->second;
+				++distrib->users;
+			}
+			else
+			{
+				if(isCache.size() >= BG_IS_CACHE_SIZE)
+				{
+					for(std::map<std::string, bgDistrib_t*>::iterator i = isCache.begin(); i != isCache.end(); )
+					{
+						if(i->second->users == 0) { delete i->second; isCache.erase(i++); }
+						else ++i;
+					}
+				}
+				distrib->users = 1;
+				isCache[isKey] = distrib;
+			}
+			isCacheMutex.unlock();
+		}
+	}
+	uDist = distrib->uDist;
+	vDist = distrib->vDist;
+	nv = distrib->nv;
 }
 
 void bgLight_t::sample_dir(float s1, float s2, vector3d_t &dir, float &pdf) const
@@ -245,6 +370,8 @@ void bgLight_t::emitPdf(const surfacePoint_t &sp, const vector3d_t &wo, float &a
 
 void bgLight_t::init(scene_t &scene)
 {
+	// the map only depends on the background, build it once
+	if(!distrib) initIS(scene.getNumThreads());
 	bound_t w=scene.getSceneBound();
 	worldCenter = 0.5 * (w.a + w.g);
 	worldRadius = 0.5 * (w.g - w.a).length();
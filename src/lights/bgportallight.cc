@@ -26,11 +26,12 @@
 #include <utilities/sample_utils.h>
 #include <utilities/mcqmc.h>
 #include <yafraycore/kdtree.h>
+#include <lights/lighttree.h>
 
 __BEGIN_YAFRAY
 
-bgPortalLight_t::bgPortalLight_t(unsigned int msh, int sampl):
-	objID(msh), samples(sampl), tree(0)
+bgPortalLight_t::bgPortalLight_t(unsigned int msh, int sampl, bool spatial):
+	objID(msh), areaDist(0), lTree(0), spatialSampling(spatial), tris(0), samples(sampl), tree(0)
 {
 	mesh = 0;
 	//initIS();
@@ -41,11 +42,16 @@ bgPortalLight_t::~bgPortalLight_t()
 	delete areaDist;
 	areaDist = 0;
 	delete[] tris;
+	delete lTree;
 	if(tree) delete tree;
 }
 
 void bgPortalLight_t::initIS()
 {
+	delete areaDist;
+	delete[] tris;
+	delete lTree;
+	lTree = 0;
 	nTris = mesh->numPrimitives();
 	tris = new const triangle_t*[nTris];
 	mesh->getPrimitives(tris);
@@ -56,13 +62,14 @@ void bgPortalLight_t::initIS()
 		areas[i] = tris[i]->surfaceArea();
 		totalArea += areas[i];
 	}
-	areaDist = new pdf1D_t(areas, nTris);
+	areaDist = new aliasTable_t(areas, nTris);
 	area = (float)totalArea;
 	invArea = (float)(1.0/totalArea);
 	//delete[] tris;
 	delete[] areas;
 	if(tree) delete tree;
 	tree = new triKdTree_t(tris, nTris, -1, 1, 0.8, 0.33);
+	if(spatialSampling && nTris > 1) lTree = new lightTree_t(tris, nTris, false);
 }
 
 void bgPortalLight_t::init(scene_t &scene)
@@ -80,18 +87,46 @@ void bgPortalLight_t::init(scene_t &scene)
 
 void bgPortalLight_t::sampleSurface(point3d_t &p, vector3d_t &n, float s1, float s2) const
 {
-	float primPdf;
-	int primNum = areaDist->DSample(s1, &primPdf);
-	if(primNum >= areaDist->count){ std::cout << "meshLight sampling error!\n"; return; }
-	float ss1, delta = areaDist->cdf[primNum+1];
-	if(primNum > 0)
+	int primNum = areaDist->Sample(s1, 0);
+	tris[primNum]->sample(s1, s2, p, n);
+}
+
+void bgPortalLight_t::sampleSurface(const point3d_t &from, point3d_t &p, vector3d_t &n, float s1, float s2, float &sArea) const
+{
+	if(!lTree)
 	{
-		delta -= areaDist->cdf[primNum];
-		ss1 = (s1 - areaDist->cdf[primNum]) / delta;
+		sampleSurface(p, n, s1, s2);
+		sArea = area;
+		return;
 	}
-	else ss1 = s1 / delta;
-	tris[primNum]->sample(ss1, s2, p, n);
-//	++stats[primNum];
+	float primPdf;
+	int primNum = lTree->sample(from, s1, primPdf);
+	tris[primNum]->sample(s1, s2, p, n);
+	sArea = lTree->area(primNum) / primPdf;
+}
+
+float bgPortalLight_t::sampleArea(const point3d_t &from, const triangle_t *t) const
+{
+	if(!lTree) return area;
+	int primNum = lTree->index(t);
+	if(primNum < 0) return 0.f;
+	float primPdf = lTree->pdf(from, primNum);
+	return (primPdf > 0.f) ? lTree->area(primNum) / primPdf : 0.f;
+}
+
+float bgPortalLight_t::lightPointArea(const surfacePoint_t &sp, const surfacePoint_t &sp_light) const
+{
+	// find the triangle under sp_light with the intersection tree, on concave lights
+	// another triangle in front of it may be found instead
+	vector3d_t dir = sp_light.P - sp.P;
+	PFLOAT dist = dir.normLen();
+	if(dist <= 0.0) return area;
+	ray_t ray(sp.P, dir);
+	PFLOAT t, dis = dist * 1.001f;
+	unsigned char udat[PRIM_DAT_SIZE];
+	triangle_t *hitt=0;
+	if( !tree->Intersect(ray, dis, &hitt, t, (void*)&udat[0]) ) return area;
+	return sampleArea(sp.P, hitt);
 }
 
 color_t bgPortalLight_t::totalEnergy() const
@@ -117,7 +152,8 @@ bool bgPortalLight_t::illumSample(const surfacePoint_t &sp, float s1, float s2,
 {
 	vector3d_t n;
 	point3d_t p;
-	sampleSurface(p, n, s1, s2);
+	float sArea;
+	sampleSurface(sp.P, p, n, s1, s2, sArea);
 	
 	vector3d_t ldir = p - sp.P;
 	PFLOAT dist_sqr = ldir.lengthSqr();
@@ -135,7 +171,7 @@ bool bgPortalLight_t::illumSample(const surfacePoint_t &sp, float s1, float s2,
 	
 	col = bg->eval(wi);
 	// pdf = distance^2 / area * cos(norm, ldir); ipdf = 1/pdf;
-	ipdf = idist_sqr * area * cos_angle * (1.f/M_PI);
+	ipdf = idist_sqr * sArea * cos_angle * (1.f/M_PI);
 	
 	return true;
 }
@@ -144,7 +180,8 @@ bool bgPortalLight_t::illumSample(const surfacePoint_t &sp, lSample_t &s, ray_t
 {
 	vector3d_t n;
 	point3d_t p;
-	sampleSurface(p, n, s.s1, s.s2);
+	float sArea;
+	sampleSurface(sp.P, p, n, s.s1, s.s2, sArea);
 	
 	vector3d_t ldir = p - sp.P;
 	//normalize vec and compute inverse square distance
@@ -162,7 +199,7 @@ bool bgPortalLight_t::illumSample(const surfacePoint_t &sp, lSample_t &s, ray_t
 	
 	color_t col = bg->eval(wi);
 	// pdf = distance^2 / area * cos(norm, ldir);
-	s.pdf = dist_sqr*M_PI / (area * cos_angle);
+	s.pdf = dist_sqr*M_PI / (sArea * cos_angle);
 	s.flags = flags;
 	if(s.sp)
 	{
@@ -214,8 +251,10 @@ bool bgPortalLight_t::intersect(const ray_t &ray, PFLOAT &t, color_t &col, float
 	vector3d_t n = hitt->getNormal();
 	PFLOAT cos_angle = ray.dir*(-n);
 	if(cos_angle <= 0) return false;
+	float sArea = sampleArea(ray.from, hitt);
+	if(sArea <= 0.f) return false;
 	PFLOAT idist_sqr = 1.f / (t*t);
-	ipdf = idist_sqr * area * cos_angle * (1.f/M_PI);
+	ipdf = idist_sqr * sArea * cos_angle * (1.f/M_PI);
 	col = bg->eval(ray);
 	
 	return true;
@@ -226,7 +265,9 @@ float bgPortalLight_t::illumPdf(const surfacePoint_t &sp, const surfacePoint_t &
 	vector3d_t wo = sp.P - sp_light.P;
 	PFLOAT r2 = wo.normLenSqr();
 	float cos_n = wo * sp_light.Ng;
-	return cos_n > 0 ? ( r2 * M_PI / (area * cos_n) ) : 0.f;
+	float sArea = lTree ? lightPointArea(sp, sp_light) : area;
+	if(sArea <= 0.f) return 0.f;
+	return cos_n > 0 ? ( r2 * M_PI / (sArea * cos_n) ) : 0.f;
 }
 
 void bgPortalLight_t::emitPdf(const surfacePoint_t &sp, const vector3d_t &wo, float &areaPdf, float &dirPdf, float &cos_wo) const
@@ -242,11 +283,13 @@ light_t* bgPortalLight_t::factory(paraMap_t &params,renderEnvironment_t &render)
 {
 	int samples = 4;
 	int object = 0;
+	bool spatial = false;
 
 	params.getParam("object", object);
 	params.getParam("samples", samples);
+	params.getParam("spatial_sampling", spatial);
 	
-	return new bgPortalLight_t(object, samples);
+	return new bgPortalLight_t(object, samples, spatial);
 }
 
 __END_YAFRAY
@@ -0,0 +1,219 @@
+/****************************************************************************
+ * 			lighttree.cc: spatial sampling hierarchy over the triangles of a mesh light
+ *      This is part of the yafray package
+ *      Copyright (C) 2009 BioWare
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include <lights/lighttree.h>
+#include <yafraycore/meshtypes.h>
+#include <algorithm>
+
+__BEGIN_YAFRAY
+
+#define LIGHTTREE_LEAF_SIZE 4
+
+//! orders triangle indices by the center of their bound along one axis
+struct lightCenterCmp_t
+{
+	lightCenterCmp_t(const std::vector<bound_t> &b, int a): bounds(b), axis(a) {}
+	bool operator()(int i, int j) const
+	{
+		const bound_t &bi = bounds[i], &bj = bounds[j];
+		return (bi.a[axis] + bi.g[axis]) < (bj.a[axis] + bj.g[axis]);
+	}
+	const std::vector<bound_t> &bounds;
+	int axis;
+};
+
+lightTree_t::lightTree_t(const triangle_t **tris, int n, bool doubleSided): dblSided(doubleSided)
+{
+	std::vector<bound_t> bounds(n);
+	order.resize(n);
+	leafOf.resize(n);
+	areas.resize(n);
+	normals.resize(n);
+	lookup.resize(n);
+	for(int i=0; i<n; ++i)
+	{
+		bounds[i] = tris[i]->getBound();
+		areas[i] = tris[i]->surfaceArea();
+		normals[i] = tris[i]->getNormal();
+		order[i] = i;
+		lookup[i] = std::make_pair(tris[i], i);
+	}
+	std::sort(lookup.begin(), lookup.end());
+	nodes.reserve(2 * (n / LIGHTTREE_LEAF_SIZE + 1));
+	if(n > 0) build(0, n, -1, bounds);
+}
+
+int lightTree_t::build(int first, int count, int parent, const std::vector<bound_t> &bounds)
+{
+	int num = (int)nodes.size();
+	nodes.push_back(node_t());
+	node_t n;
+	n.parent = parent;
+	n.left = n.right = -1;
+	n.first = first;
+	n.count = count;
+	
+	bound_t bb = bounds[order[first]], cb;
+	point3d_t c0 = bb.center();
+	cb.set(c0, c0);
+	n.area = 0.f;
+	vector3d_t nsum(0.f);
+	for(int i=first; i<first+count; ++i)
+	{
+		const bound_t &b = bounds[order[i]];
+		bb.include(b.a);
+		bb.include(b.g);
+		cb.include(b.center());
+		n.area += areas[order[i]];
+		nsum += areas[order[i]] * normals[order[i]];
+	}
+	n.center = bb.center();
+	n.radius = 0.5f * (bb.g - bb.a).length();
+	
+	PFLOAT nlen = nsum.length();
+	n.cosSpread = -1.f;
+	n.axis = vector3d_t(0.f, 0.f, 1.f);
+	if(!dblSided && nlen > 1e-6f * n.area)
+	{
+		n.axis = nsum * (1.f/nlen);
+		n.cosSpread = 1.f;
+		for(int i=first; i<first+count; ++i) n.cosSpread = std::min(n.cosSpread, (float)(n.axis * normals[order[i]]));
+		n.cosSpread = std::max(-1.f, n.cosSpread);
+	}
+	n.sinSpread = sqrt(std::max(0.f, 1.f - n.cosSpread*n.cosSpread));
+	
+	if(count > LIGHTTREE_LEAF_SIZE)
+	{
+		// median split of the triangle centers along the longest axis
+		int axis = cb.largestAxis();
+		int half = count / 2;
+		std::nth_element(order.begin()+first, order.begin()+first+half, order.begin()+first+count, lightCenterCmp_t(bounds, axis));
+		n.left = build(first, half, num, bounds);
+		n.right = build(first+half, count-half, num, bounds);
+	}
+	else
+	{
+		for(int i=first; i<first+count; ++i) leafOf[order[i]] = num;
+	}
+	nodes[num] = n;
+	return num;
+}
+
+float lightTree_t::importance(const node_t &n, const point3d_t &p) const
+{
+	vector3d_t d = p - n.center;
+	PFLOAT dist2 = d.lengthSqr();
+	PFLOAT r2 = n.radius * n.radius;
+	float orient = 1.f;
+	if(n.cosSpread > -1.f && dist2 > r2)
+	{
+		/* cosine of the smallest angle any emitter normal in the node can make with the direction
+		   to p: theta (axis to p) minus the spread of the normals minus the angle the bounding
+		   sphere covers, done with cosines and sines only */
+		PFLOAT dist = sqrt(dist2);
+		float cosT = std::max(-1.f, std::min(1.f, (float)(d * n.axis) / dist));
+		if(cosT < n.cosSpread)
+		{
+			float sinT = sqrt(std::max(0.f, 1.f - cosT*cosT));
+			float cos1 = cosT * n.cosSpread + sinT * n.sinSpread;
+			float sin1 = sinT * n.cosSpread - cosT * n.sinSpread;
+			float sinU = n.radius / dist;
+			float cosU = sqrt(std::max(0.f, 1.f - sinU*sinU));
+			if(cos1 < cosU)
+			{
+				orient = cos1 * cosU + sin1 * sinU;
+				if(orient <= 0.f) return 0.f;
+			}
+		}
+	}
+	return n.area * orient / std::max(dist2, r2);
+}
+
+float lightTree_t::leftProb(const node_t &n, const point3d_t &p) const
+{
+	const node_t &l = nodes[n.left], &r = nodes[n.right];
+	float il = importance(l, p), ir = importance(r, p);
+	if(il + ir <= 0.f) return l.area / (l.area + r.area);
+	return il / (il + ir);
+}
+
+int lightTree_t::sample(const point3d_t &p, float &s, float &pdf) const
+{
+	int num = 0;
+	pdf = 1.f;
+	while(nodes[num].left >= 0)
+	{
+		const node_t &n = nodes[num];
+		float pl = leftProb(n, p);
+		if(s < pl)
+		{
+			s = s / pl;
+			pdf *= pl;
+			num = n.left;
+		}
+		else
+		{
+			s = (s - pl) / (1.f - pl);
+			pdf *= 1.f - pl;
+			num = n.right;
+		}
+		s = std::min(s, 0.99999994f);
+	}
+	const node_t &leaf = nodes[num];
+	float target = s * leaf.area, sum = 0.f;
+	int last = leaf.first + leaf.count - 1;
+	for(int i=leaf.first; i<last; ++i)
+	{
+		float a = areas[order[i]];
+		if(target < sum + a)
+		{
+			s = std::min((target - sum) / a, 0.99999994f);
+			pdf *= a / leaf.area;
+			return order[i];
+		}
+		sum += a;
+	}
+	float a = areas[order[last]];
+	s = (a > 0.f) ? std::max(0.f, std::min((target - sum) / a, 0.99999994f)) : s;
+	pdf *= a / leaf.area;
+	return order[last];
+}
+
+float lightTree_t::pdf(const point3d_t &p, int t) const
+{
+	int child = leafOf[t];
+	float prob = areas[t] / nodes[child].area;
+	for(int num = nodes[child].parent; num >= 0; child = num, num = nodes[num].parent)
+	{
+		float pl = leftProb(nodes[num], p);
+		prob *= (nodes[num].left == child) ? pl : 1.f - pl;
+	}
+	return prob;
+}
+
+int lightTree_t::index(const triangle_t *t) const
+{
+	std::vector< std::pair<const triangle_t*, int> >::const_iterator i =
+		std::lower_bound(lookup.begin(), lookup.end(), std::make_pair(t, -1));
+	if(i == lookup.end() || i->first != t) return -1;
+	return i->second;
+}
+
+__END_YAFRAY
@@ -26,11 +26,12 @@
 #include <core_api/environment.h>
 #include <utilities/sample_utils.h>
 #include <yafraycore/kdtree.h>
+#include <lights/lighttree.h>
 
 __BEGIN_YAFRAY
 
-meshLight_t::meshLight_t(unsigned int msh, const color_t &col, int sampl, bool dbl_s):
-	objID(msh), doubleSided(dbl_s), color(col), samples(sampl), tree(0)
+meshLight_t::meshLight_t(unsigned int msh, const color_t &col, int sampl, bool dbl_s, bool spatial):
+	objID(msh), doubleSided(dbl_s), color(col), areaDist(0), lTree(0), spatialSampling(spatial), tris(0), samples(sampl), tree(0)
 {
 	mesh = 0;
 	//initIS();
@@ -41,6 +42,7 @@ meshLight_t::~meshLight_t()
 	delete areaDist;
 	areaDist = 0;
 	delete[] tris;
+	delete lTree;
 //	std::cout << "meshLight stats:\n";
 //	for(int i=0; i<nTris; ++i) std::cout << stats[i] << " ";
 //	delete[] stats;
@@ -49,6 +51,10 @@ meshLight_t::~meshLight_t()
 
 void meshLight_t::initIS()
 {
+	delete areaDist;
+	delete[] tris;
+	delete lTree;
+	lTree = 0;
 	nTris = mesh->numPrimitives();
 	tris = new const triangle_t*[nTris];
 	mesh->getPrimitives(tris);
@@ -59,13 +65,14 @@ void meshLight_t::initIS()
 		areas[i] = tris[i]->surfaceArea();
 		totalArea += areas[i];
 	}
-	areaDist = new pdf1D_t(areas, nTris);
+	areaDist = new aliasTable_t(areas, nTris);
 	area = (float)totalArea;
 	invArea = (float)(1.0/totalArea);
 	//delete[] tris;
 	delete[] areas;
 	if(tree) delete tree;
 	tree = new triKdTree_t(tris, nTris, -1, 1, 0.8, 0.33);
+	if(spatialSampling && nTris > 1) lTree = new lightTree_t(tris, nTris, doubleSided);
 }
 
 void meshLight_t::init(scene_t &scene)
@@ -82,18 +89,46 @@ void meshLight_t::init(scene_t &scene)
 
 void meshLight_t::sampleSurface(point3d_t &p, vector3d_t &n, float s1, float s2) const
 {
-	float primPdf;
-	int primNum = areaDist->DSample(s1, &primPdf);
-	if(primNum >= areaDist->count){ std::cout << "meshLight sampling error!\n"; return; }
-	float ss1, delta = areaDist->cdf[primNum+1];
-	if(primNum > 0)
+	int primNum = areaDist->Sample(s1, 0);
+	tris[primNum]->sample(s1, s2, p, n);
+}
+
+void meshLight_t::sampleSurface(const point3d_t &from, point3d_t &p, vector3d_t &n, float s1, float s2, float &sArea) const
+{
+	if(!lTree)
 	{
-		delta -= areaDist->cdf[primNum];
-		ss1 = (s1 - areaDist->cdf[primNum]) / delta;
+		sampleSurface(p, n, s1, s2);
+		sArea = area;
+		return;
 	}
-	else ss1 = s1 / delta;
-	tris[primNum]->sample(ss1, s2, p, n);
-//	++stats[primNum];
+	float primPdf;
+	int primNum = lTree->sample(from, s1, primPdf);
+	tris[primNum]->sample(s1, s2, p, n);
+	sArea = lTree->area(primNum) / primPdf;
+}
+
+float meshLight_t::sampleArea(const point3d_t &from, const triangle_t *t) const
+{
+	if(!lTree) return area;
+	int primNum = lTree->index(t);
+	if(primNum < 0) return 0.f;
+	float primPdf = lTree->pdf(from, primNum);
+	return (primPdf > 0.f) ? lTree->area(primNum) / primPdf : 0.f;
+}
+
+float meshLight_t::lightPointArea(const surfacePoint_t &sp, const surfacePoint_t &sp_light) const
+{
+	// find the triangle under sp_light with the intersection tree, on concave lights
+	// another triangle in front of it may be found instead
+	vector3d_t dir = sp_light.P - sp.P;
+	PFLOAT dist = dir.normLen();
+	if(dist <= 0.0) return area;
+	ray_t ray(sp.P, dir);
+	PFLOAT t, dis = dist * 1.001f;
+	unsigned char udat[PRIM_DAT_SIZE];
+	triangle_t *hitt=0;
+	if( !tree->Intersect(ray, dis, &hitt, t, (void*)&udat[0]) ) return area;
+	return sampleArea(sp.P, hitt);
 }
 
 color_t meshLight_t::totalEnergy() const { return doubleSided ? 2.f*color*area : color*area; }
@@ -102,7 +137,8 @@ bool meshLight_t::illumSample(const surfacePoint_t &sp, lSample_t &s, ray_t &wi)
 {
 	vector3d_t n;
 	point3d_t p;
-	sampleSurface(p, n, s.s1, s.s2);
+	float sArea;
+	sampleSurface(sp.P, p, n, s.s1, s.s2, sArea);
 	
 	vector3d_t ldir = p - sp.P;
 	//normalize vec and compute inverse square distance
@@ -124,7 +160,7 @@ bool meshLight_t::illumSample(const surfacePoint_t &sp, lSample_t &s, ray_t &wi)
 	
 	s.col = color;
 	// pdf = distance^2 / area * cos(norm, ldir);
-	s.pdf = dist_sqr*M_PI / (area * cos_angle);
+	s.pdf = dist_sqr*M_PI / (sArea * cos_angle);
 	s.flags = flags;
 	if(s.sp)
 	{
@@ -190,8 +226,10 @@ bool meshLight_t::intersect(const ray_t &ray, PFLOAT &t, color_t &col, float &ip
 	if(cos_angle <= 0)
 		if(doubleSided) cos_angle = std::fabs(cos_angle);
 		else return false;
+	float sArea = sampleArea(ray.from, hitt);
+	if(sArea <= 0.f) return false;
 	PFLOAT idist_sqr = 1.f / (t*t);
-	ipdf = idist_sqr * area * cos_angle * (1.f/M_PI);
+	ipdf = idist_sqr * sArea * cos_angle * (1.f/M_PI);
 	col = color;
 	
 	return true;
@@ -204,7 +242,9 @@ float meshLight_t::illumPdf(const surfacePoint_t &sp, const surfacePoint_t &sp_l
 	vector3d_t wo = sp.P - sp_light.P;
 	PFLOAT r2 = wo.normLenSqr();
 	float cos_n = wo * sp_light.Ng;
-	return cos_n > 0 ? r2 * M_PI / (area * cos_n) : (doubleSided ? r2 * M_PI / (area * -cos_n)  : 0.f);
+	float sArea = lTree ? lightPointArea(sp, sp_light) : area;
+	if(sArea <= 0.f) return 0.f;
+	return cos_n > 0 ? r2 * M_PI / (sArea * cos_n) : (doubleSided ? r2 * M_PI / (sArea * -cos_n)  : 0.f);
 }
 
 void meshLight_t::emitPdf(const surfacePoint_t &sp, const vector3d_t &wo, float &areaPdf, float &dirPdf, float &cos_wo) const
@@ -219,6 +259,7 @@ void meshLight_t::emitPdf(const surfacePoint_t &sp, const vector3d_t &wo, float
 light_t* meshLight_t::factory(paraMap_t &params,renderEnvironment_t &render)
 {
 	bool doubleS = false;
+	bool spatial = false;
 	color_t color(1.0);
 	double power = 1.0;
 	int samples = 4;
@@ -229,8 +270,9 @@ light_t* meshLight_t::factory(paraMap_t &params,renderEnvironment_t &render)
 	params.getParam("power", power);
 	params.getParam("samples", samples);
 	params.getParam("double_sided", doubleS);
+	params.getParam("spatial_sampling", spatial);
 
-	return new meshLight_t(object, color*(CFLOAT)power, samples, doubleS);
+	return new meshLight_t(object, color*(CFLOAT)power, samples, doubleS, spatial);
 }
 
 __END_YAFRAY
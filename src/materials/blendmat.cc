@@ -40,7 +40,7 @@ void blendMat_t::initBSDF(const renderState_t &state, const surfacePoint_t &sp,
 {
 	//create our "stack" to save node results
 	nodeStack_t stack(state.userdata);
-	evalNodes(state, sp, allSorted, stack);
+	sortedCode.eval(stack, state, sp);
 	CFLOAT val = (blendS) ? blendS->getScalar(stack) : blendVal;
 	val = std::max(std::min(val,1.f), 0.f);
 	*(CFLOAT*)state.userdata = val;
@@ -180,7 +180,7 @@ color_t blendMat_t::getTransparency(const renderState_t &state, const surfacePoi
 {
 	//create our "stack" to save node results
 	nodeStack_t stack(state.userdata);
-	evalNodes(state, sp, allNodes, stack);
+	sortedCode.eval(stack, state, sp);
 	CFLOAT val = (blendS) ? blendS->getScalar(stack) : blendVal;
 	val = std::max(std::min(val,1.f), 0.f);
 	*(CFLOAT*)state.userdata = val;
@@ -253,6 +253,7 @@ material_t* blendMat_t::factory(paraMap_t &params, std::list<paraMap_t> &eparams
 		return 0;
 	}
 	mat->solveNodesOrder(roots);
+	mat->compileNodes();
 	size_t inputReq = std::max(m1->getReqMem(), m2->getReqMem());
 	mat->reqMem = std::max( mat->reqNodeMem, sizeof(bool) + inputReq);
 	return mat;
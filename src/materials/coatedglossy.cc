@@ -101,8 +101,7 @@ void coatedGlossyMat_t::initBSDF(const renderState_t &state, const surfacePoint_
 	nodeStack_t stack(dat->stack);
 	if(bumpS) evalBump(stack, state, sp, bumpS);
 	
-	std::vector<shaderNode_t *>::const_iterator iter, end=allViewindep.end();
-	for(iter = allViewindep.begin(); iter!=end; ++iter) (*iter)->eval(stack, state, sp);
+	viewindepCode.eval(stack, state, sp);
 	bsdfTypes=bsdfFlags;
 	dat->mDiffuse = mDiffuse;
 	dat->mGlossy = glossyRefS ? glossyRefS->getScalar(stack) : reflectivity;
@@ -452,6 +451,7 @@ material_t* coatedGlossyMat_t::factory(paraMap_t &params, std::list< paraMap_t >
 		mat->filterNodes(colorNodes, mat->allViewindep, VIEW_INDEP);
 		if(mat->bumpS) mat->getNodeList(mat->bumpS, mat->bumpNodes);
 	}
+	mat->compileNodes();
 	mat->reqMem = mat->reqNodeMem + sizeof(MDat_t);
 	return mat;
 }
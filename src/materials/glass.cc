@@ -77,8 +77,7 @@ void glassMat_t::initBSDF(const renderState_t &state, const surfacePoint_t &sp,
 	if(bumpS) evalBump(stack, state, sp, bumpS);
 	
 	//eval viewindependent nodes
-	std::vector<shaderNode_t *>::const_iterator iter, end=allViewindep.end();
-	for(iter = allViewindep.begin(); iter!=end; ++iter) (*iter)->eval(stack, state, sp);
+	viewindepCode.eval(stack, state, sp);
 	bsdfTypes=bsdfFlags;
 }
 
@@ -382,6 +381,7 @@ material_t* glassMat_t::factory(paraMap_t &params, std::list< paraMap_t > &param
 			mat->getNodeList(mat->bumpS, mat->bumpNodes);
 		}
 	}
+	mat->compileNodes();
 	mat->reqMem = mat->reqNodeMem;
 	return mat;
 }
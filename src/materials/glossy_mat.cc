@@ -84,8 +84,7 @@ void glossyMat_t::initBSDF(const renderState_t &state, const surfacePoint_t &sp,
 	if(bumpS) evalBump(stack, state, sp, bumpS);
 	
 	//eval viewindependent nodes
-	std::vector<shaderNode_t *>::const_iterator iter, end=allViewindep.end();
-	for(iter = allViewindep.begin(); iter!=end; ++iter) (*iter)->eval(stack, state, sp);
+	viewindepCode.eval(stack, state, sp);
 	bsdfTypes=bsdfFlags;
 	dat->mDiffuse = mDiffuse;
 	dat->mGlossy = glossyRefS ? glossyRefS->getScalar(stack) : reflectivity;
@@ -110,8 +109,7 @@ void glossyMat_t::initBSDF(const renderState_t &state, const surfacePoint_t &sp,
 
 inline void glossyMat_t::evalVdNodes(const renderState_t &state, const surfacePoint_t &sp, const vector3d_t &wo, const vector3d_t &wl, nodeStack_t &stack)const
 {
-	std::vector<shaderNode_t *>::const_iterator iter, end=allViewdep.end();
-	for(iter = allViewdep.begin(); iter!=end; ++iter) (*iter)->eval(stack, state, sp, wo, wl);
+	viewdepCode.eval(stack, state, sp, wo, wl);
 }
 
 //===========================================================================
@@ -445,6 +443,7 @@ material_t* glossyMat_t::factory(paraMap_t &params, std::list< paraMap_t > &para
 		mat->filterNodes(colorNodes, mat->allViewindep, VIEW_INDEP);
 		if(mat->bumpS) mat->getNodeList(mat->bumpS, mat->bumpNodes);
 	}
+	mat->compileNodes();
 	mat->reqMem = mat->reqNodeMem + sizeof(MDat_t);
 	return mat;
 }
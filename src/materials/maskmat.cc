@@ -39,7 +39,7 @@ maskMat_t::maskMat_t(const material_t *m1, const material_t *m2, CFLOAT thresh):
 void maskMat_t::initBSDF(const renderState_t &state, const surfacePoint_t &sp, BSDF_t &bsdfTypes)const
 {
 	nodeStack_t stack(state.userdata);
-	evalNodes(state, sp, allNodes, stack);
+	sortedCode.eval(stack, state, sp);
 	CFLOAT val = mask->getScalar(stack); //mask->getFloat(sp.P);
 	bool mv = val > threshold;
 	*(bool*)state.userdata = mv;
@@ -90,7 +90,7 @@ bool maskMat_t::isTransparent() const
 color_t maskMat_t::getTransparency(const renderState_t &state, const surfacePoint_t &sp, const vector3d_t &wo)const
 {
 	nodeStack_t stack(state.userdata);
-	evalNodes(state, sp, allNodes, stack);
+	sortedCode.eval(stack, state, sp);
 	CFLOAT val = mask->getScalar(stack);
 	bool mv = val > 0.5;
 	if(mv) return mat2->getTransparency(state, sp, wo);
@@ -169,6 +169,7 @@ material_t* maskMat_t::factory(paraMap_t &params, std::list< paraMap_t > &eparam
 		return 0;
 	}
 	mat->solveNodesOrder(roots);
+	mat->compileNodes();
 	size_t inputReq = std::max(m1->getReqMem(), m2->getReqMem());
 	mat->reqMem = std::max( mat->reqNodeMem, sizeof(bool) + inputReq);
 	return mat;
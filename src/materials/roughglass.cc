@@ -98,8 +98,7 @@ void roughGlassMat_t::initBSDF(const renderState_t &state, const surfacePoint_t
 	if(bumpS) evalBump(stack, state, sp, bumpS);
 	
 	//eval viewindependent nodes
-	std::vector<shaderNode_t *>::const_iterator iter, end=allViewindep.end();
-	for(iter = allViewindep.begin(); iter!=end; ++iter) (*iter)->eval(stack, state, sp);
+	viewindepCode.eval(stack, state, sp);
 	bsdfTypes=bsdfFlags;
 }
 
@@ -318,6 +317,7 @@ material_t* roughGlassMat_t::factory(paraMap_t &params, std::list< paraMap_t > &
 			mat->getNodeList(mat->bumpS, mat->bumpNodes);
 		}
 	}
+	mat->compileNodes();
 	mat->reqMem = mat->reqNodeMem;
 	//mat->func();
 	return mat;
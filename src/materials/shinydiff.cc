@@ -81,6 +81,9 @@ void shinyDiffuseMat_t::config(shaderNode_t *diff, shaderNode_t *refl, shaderNod
 		++nBSDF;
 	}
 	reqMem = reqNodeMem + sizeof(SDDat_t);
+	// a plain lambertian surface of constant color, see material_t::isConstantDiffuse()
+	constDiffuse = (bsdfFlags == (BSDF_DIFFUSE | BSDF_REFLECT)) && !diffuseS && !bumpS && !mirColS && !orenNayar;
+	diffuseAlbedo = constDiffuse ? mDiffuse * color : color_t(0.f);
 //	std::cout << std::endl;
 }
 
@@ -149,8 +152,7 @@ void shinyDiffuseMat_t::initBSDF(const renderState_t &state, const surfacePoint_
 	}
 	
 	//eval viewindependent nodes
-	std::vector<shaderNode_t *>::const_iterator iter, end=allViewindep.end();
-	for(iter = allViewindep.begin(); iter!=end; ++iter) (*iter)->eval(stack, state, sp);
+	viewindepCode.eval(stack, state, sp);
 	bsdfTypes=bsdfFlags;
 	
 	getComponents(viNodes, stack, dat->component);
@@ -389,8 +391,7 @@ void shinyDiffuseMat_t::getSpecular(const renderState_t &state, const surfacePoi
 color_t shinyDiffuseMat_t::getTransparency(const renderState_t &state, const surfacePoint_t &sp, const vector3d_t &wo)const
 {
 	nodeStack_t stack(state.userdata);
-	std::vector<shaderNode_t *>::const_iterator iter, end=allSorted.end();
-	for(iter = allSorted.begin(); iter!=end; ++iter) (*iter)->eval(stack, state, sp);
+	sortedCode.eval(stack, state, sp);
 	float accum=1.f;
 	if(isReflective)
 	{
@@ -543,6 +544,7 @@ material_t* shinyDiffuseMat_t::factory(paraMap_t &params, std::list<paraMap_t> &
 			mat->getNodeList(bumpS, mat->bumpNodes);
 		}
 	}
+	mat->compileNodes();
 	mat->config(diffuseS, specReflS, transpS, translS, bumpS);
 	//===!!!=== test
 	if(params.getParam("name", name))
@@ -557,6 +559,7 @@ material_t* shinyDiffuseMat_t::factory(paraMap_t &params, std::list<paraMap_t> &
 			map["scatter_col"] = color_t(0.9f);
 			mat->volI = render.createVolumeH(*name, map);
 			mat->bsdfFlags |= BSDF_VOLUMETRIC;
+			mat->constDiffuse = false;
 		}
 		//else std::cout << "not creating volume\n";
 	}
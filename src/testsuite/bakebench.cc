@@ -0,0 +1,707 @@
+
+#include <yafray_config.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <list>
+#include <map>
+#include <algorithm>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+#include <core_api/scene.h>
+#include <core_api/environment.h>
+#include <core_api/surface.h>
+#include <core_api/integrator.h>
+#include <core_api/imagefilm.h>
+#include <core_api/output.h>
+#include <core_api/camera.h>
+#include <yafraycore/meshtypes.h>
+#include <yafraycore/triangle.h>
+#include <yafraycore/timer.h>
+#include <yafraycore/ccthreads.h>
+#include <yafraycore/rendertrace.h>
+#include <utilities/sample_utils.h>
+
+using namespace::yafaray;
+
+/*	Lightmap bake benchmark: builds synthetic scenes (and optionally one loaded from a PLY file),
+	bakes a lightmap of them with the direct lighting, ambient occlusion and photon mapping
+	integrators and prints one line of key=value pairs per bake:
+		case          scene/integrator
+		threads, res, triangles, texels (texels covered by the lightmap)
+		kdtree_s      kd-tree build time
+		photon_s      preprocessing inside the render, i.e. photon shooting and radiance map for the photon integrator
+		bake_s        time from the first texel to the end of the render
+		texels_per_s  covered texels / bake_s
+		rays_per_s    single threaded scene_t::intersect() rate for rays leaving the baked surfaces
+		peak_rss_kb   peak resident memory of the process so far
+		volume_ns     cost of one volume integrator transmittance() call, which the integrators skip
+		              for every shadow ray when the scene has no volumes (volumes=0)
+		followed by the render counters of scene_t::getStats() (rays, shadow_rays, kd_nodes, ...)
+		and image_hash, a hash of the baked pixels: runs with the same seed and thread count
+		must give the same hash
+	All random numbers are seeded with a fixed value per case. With --baseline=file the results
+	are compared against an earlier output of the program; it exits with 1 if any case got slower
+	than the tolerance allows. --trace=file writes a chrome://tracing timeline of all bakes.
+
+	usage: bakebench [--scenes=cornell,cubes,ply] [--integrators=direct,ao,photon] [--ply=file] [--ply-scale=1.0]
+		[--res=256] [--samples=1] [--threads=1] [--photons=200000] [--cubes=24] [--rays=1000000]
+		[--seed=123212] [--filter=1.0] [--deterministic=0] [--out=file] [--baseline=file] [--tolerance=0.05]
+		[--trace=file]
+	--filter above 1 selects a gauss filter of that width, whose samples reach into the neighbour tiles;
+	--deterministic=1 makes the film add them in tile order, so image_hash does not depend on --threads. */
+
+bool loadPly(scene_t *s, material_t *mat, const char *plyfile, double scale, objID_t &id);
+
+//! peak resident set size of the process in KB
+static long peakRSS()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS pmc;
+	if(GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) return (long)(pmc.PeakWorkingSetSize >> 10);
+	return 0;
+#else
+	rusage ru;
+	if(getrusage(RUSAGE_SELF, &ru) != 0) return 0;
+#ifdef __APPLE__
+	return ru.ru_maxrss >> 10; // bytes on OS X
+#else
+	return ru.ru_maxrss;
+#endif
+#endif
+}
+
+static inline float lcgFloat(unsigned int &seed)
+{
+	seed = seed*1664525 + 1013904223;
+	return (float)(seed >> 8) / 16777216.f;
+}
+
+/*! the film output of the benchmark, the pixels are only hashed so runs can be checked for
+	bit identical bakes. Tiles arrive in the order threads finish them, so every pixel is hashed
+	on its own (FNV-1a over position and the bits of the floats) and the hashes are summed. */
+class hashOutput_t: public colorOutput_t
+{
+	public:
+		hashOutput_t(): hash(0) {}
+		virtual bool putPixel(int x, int y, const float *c, int channels)
+		{
+			unsigned int h = 2166136261u;
+			int pos[2] = { x, y };
+			const unsigned char *b = (const unsigned char *)pos;
+			for(unsigned int i=0; i<sizeof(pos); ++i) h = (h ^ b[i]) * 16777619u;
+			b = (const unsigned char *)c;
+			for(unsigned int i=0; i<channels*sizeof(float); ++i) h = (h ^ b[i]) * 16777619u;
+			hash += h;
+			return true;
+		}
+		virtual void flush(){}
+		virtual void flushArea(int x0, int y0, int x1, int y1){}
+		unsigned int hash;
+};
+
+/*! Stand-in for the EclipseRay LightmapCamera that does not need the python object layer:
+	every triangle of the baked meshes gets a square cell of the film, the texels in the lower
+	left half of the cell map onto the triangle. Like the lightmap camera it hands the surface
+	point of each texel to the integrator, so no primary rays are traced.
+	The first texel request starts the "bake" event of the timer. */
+class bakeCam_t: public camera_t
+{
+	public:
+		bakeCam_t(const std::vector<triangleObject_t*> &meshes, int res, yafaray::timer_t &t);
+		virtual ray_t shootRay(PFLOAT px, PFLOAT py, float u, float v, PFLOAT &wt) const;
+		virtual int resX() const { return resx; }
+		virtual int resY() const { return resy; }
+		virtual bool sampleLense() const { return false; }
+		virtual bool surfaceSamples() const { return true; }
+		virtual bool sampleSurface(PFLOAT px, PFLOAT py, surfacePoint_t &sp, ray_t &ray, PFLOAT &wt) const;
+		int coveredTexels() const { return covered; }
+		int numTriangles() const { return (int)tris.size(); }
+		bool bakeStarted() const { return started; }
+	protected:
+		struct tri_t
+		{
+			triangle_t *tri;
+			point3d_t a, b, c;
+			vector3d_t N;
+		};
+		bool locate(PFLOAT px, PFLOAT py, const tri_t *&t, PFLOAT &u, PFLOAT &v) const;
+		std::vector<tri_t> tris;
+		int resx, resy, cells, covered;
+		PFLOAT cellW, cellH;
+		yafaray::timer_t &timer;
+		mutable volatile bool started;
+		mutable yafthreads::mutex_t mutex;
+};
+
+static const PFLOAT BAKE_RAY_TOLERANCE = 0.05f;
+
+bakeCam_t::bakeCam_t(const std::vector<triangleObject_t*> &meshes, int res, yafaray::timer_t &t):
+	resx(res), resy(res), cells(1), covered(0), timer(t), started(false)
+{
+	for(unsigned int m=0; m<meshes.size(); ++m)
+	{
+		std::vector<triangle_t> &mtris = meshes[m]->getTriangles();
+		std::vector<point3d_t>::const_iterator points = meshes[m]->getPointsIterator();
+		for(unsigned int i=0; i<mtris.size(); ++i)
+		{
+			int a, b, c;
+			mtris[i].getTrianglePointIndices(a, b, c);
+			tri_t t;
+			t.tri = &mtris[i];
+			t.a = *(points + a);
+			t.b = *(points + b);
+			t.c = *(points + c);
+			t.N = mtris[i].getNormal();
+			tris.push_back(t);
+		}
+	}
+	while(cells*cells < (int)tris.size()) ++cells;
+	cellW = (PFLOAT)resx / (PFLOAT)cells;
+	cellH = (PFLOAT)resy / (PFLOAT)cells;
+	const tri_t *tr;
+	PFLOAT u, v;
+	for(int y=0; y<resy; ++y)
+		for(int x=0; x<resx; ++x)
+			if(locate(x+0.5, y+0.5, tr, u, v)) ++covered;
+}
+
+inline bool bakeCam_t::locate(PFLOAT px, PFLOAT py, const tri_t *&t, PFLOAT &u, PFLOAT &v) const
+{
+	int cx = (int)(px / cellW), cy = (int)(py / cellH);
+	if(cx < 0 || cy < 0 || cx >= cells || cy >= cells) return false;
+	int idx = cy*cells + cx;
+	if(idx >= (int)tris.size()) return false;
+	u = px/cellW - (PFLOAT)cx;
+	v = py/cellH - (PFLOAT)cy;
+	if(u + v > 1.0) return false;
+	t = &tris[idx];
+	return true;
+}
+
+ray_t bakeCam_t::shootRay(PFLOAT px, PFLOAT py, float lu, float lv, PFLOAT &wt) const
+{
+	const tri_t *t;
+	PFLOAT u, v;
+	if(!locate(px, py, t, u, v))
+	{
+		wt = 0;
+		return ray_t(point3d_t(0.0), vector3d_t(0.0, 0.0, 1.0));
+	}
+	point3d_t P = t->a * (1.0-u-v) + t->b * u + t->c * v;
+	wt = 1;
+	return ray_t(P + BAKE_RAY_TOLERANCE * t->N, -t->N, 0, BAKE_RAY_TOLERANCE);
+}
+
+bool bakeCam_t::sampleSurface(PFLOAT px, PFLOAT py, surfacePoint_t &sp, ray_t &ray, PFLOAT &wt) const
+{
+	if(!started)
+	{
+		mutex.lock();
+		if(!started)
+		{
+			timer.start("bake");
+			started = true;
+		}
+		mutex.unlock();
+	}
+	const tri_t *t;
+	PFLOAT u, v;
+	if(!locate(px, py, t, u, v))
+	{
+		wt = 0;
+		return false;
+	}
+	point3d_t P = t->a * (1.0-u-v) + t->b * u + t->c * v;
+	// the triangle expects the weights of its second and third point
+	PFLOAT udat[2] = { u, v };
+	t->tri->getSurface(sp, P, (void*)udat);
+	sp.origin = (void*)t->tri;
+	ray.from = P + BAKE_RAY_TOLERANCE * t->N;
+	ray.dir = -t->N;
+	ray.tmin = 0;
+	ray.tmax = BAKE_RAY_TOLERANCE;
+	wt = 1;
+	return true;
+}
+
+//-----------------------------------------------------------------------------------------
+// scenes
+//-----------------------------------------------------------------------------------------
+
+static void cuboid(scene_t &scene, const point3d_t &p1, const point3d_t &p2, material_t *mat)
+{
+	int a,b,c,d,e,f,g,h;
+
+	a = scene.addVertex(point3d_t(p2.x, p2.y, p2.z) );
+	b = scene.addVertex(point3d_t(p2.x, p1.y, p2.z) );
+	c = scene.addVertex(point3d_t(p2.x, p1.y, p1.z) );
+	d = scene.addVertex(point3d_t(p2.x, p2.y, p1.z) );
+
+	e = scene.addVertex(point3d_t(p1.x, p2.y, p1.z) );
+	f = scene.addVertex(point3d_t(p1.x, p1.y, p1.z) );
+	g = scene.addVertex(point3d_t(p1.x, p1.y, p2.z) );
+	h = scene.addVertex(point3d_t(p1.x, p2.y, p2.z) );
+
+	scene.addTriangle(a, b, c, mat);
+	scene.addTriangle(c, d, a, mat);
+	scene.addTriangle(e, f, g, mat);
+	scene.addTriangle(g, h, e, mat);
+	scene.addTriangle(g, f, c, mat);
+	scene.addTriangle(g, c, b, mat);
+	scene.addTriangle(a, e, h, mat);
+	scene.addTriangle(e, a, d, mat);
+	scene.addTriangle(a, g, b, mat);
+	scene.addTriangle(g, a, h, mat);
+	scene.addTriangle(d, c, f, mat);
+	scene.addTriangle(f, e, d, mat);
+}
+
+//! the room of testphoton.cc, without the dark patch below the light
+static void room(scene_t &scene, material_t *base_mat, material_t *left_wall, material_t *right_wall)
+{
+	int a,b,c,d,e,f,g,h;
+	a = scene.addVertex(point3d_t(2.1, 2.1, 2.1) );
+	b = scene.addVertex(point3d_t(2.1,-4.1, 2.1) );
+	c = scene.addVertex(point3d_t(2.1,-4.1,-2.1) );
+	d = scene.addVertex(point3d_t(2.1, 2.1,-2.1) );
+
+	e = scene.addVertex(point3d_t(-2.1, 2.1,-2.1) );
+	f = scene.addVertex(point3d_t(-2.1,-4.1,-2.1) );
+	g = scene.addVertex(point3d_t(-2.1,-4.1, 2.1) );
+	h = scene.addVertex(point3d_t(-2.1, 2.1, 2.1) );
+	//right wall (when viewing in positive y-dir):
+	scene.addTriangle(a, c, b, right_wall);
+	scene.addTriangle(c, a, d, right_wall);
+	//left wall
+	scene.addTriangle(e, g, f, left_wall);
+	scene.addTriangle(g, e, h, left_wall);
+	//front wall
+	scene.addTriangle(g, c, f, base_mat);
+	scene.addTriangle(g, b, c, base_mat);
+	//back wall
+	scene.addTriangle(a, h, e, base_mat);
+	scene.addTriangle(a, e, d, base_mat);
+	//ceiling
+	scene.addTriangle(a, b, g, base_mat);
+	scene.addTriangle(a, g, h, base_mat);
+	// floor
+	scene.addTriangle(d, f, c, base_mat);
+	scene.addTriangle(d, e, f, base_mat);
+}
+
+struct benchOptions_t
+{
+	benchOptions_t(): plyScale(1.0), res(256), samples(1), threads(1), photons(200000), cubes(24),
+		rays(1000000), seed(123212), filterSize(1.0), deterministic(0), tolerance(0.05) {}
+	std::vector<std::string> scenes, integrators;
+	std::string plyFile, outFile, baseline, traceFile;
+	double plyScale;
+	int res, samples, threads, photons, cubes, rays, seed;
+	double filterSize;
+	int deterministic;
+	double tolerance;
+};
+
+struct benchMaterials_t
+{
+	material_t *grey, *red, *blue;
+};
+
+//! fill the scene with geometry, the meshes to bake are returned in bake
+static bool buildGeometry(scene_t &scene, const std::string &kind, const benchOptions_t &opt,
+						  const benchMaterials_t &mat, std::vector<objID_t> &bake)
+{
+	if(!scene.startGeometry()) return false;
+	objID_t id;
+	if(!scene.startTriMesh(id, 8, 12, false, false)) return false;
+	room(scene, mat.grey, mat.blue, mat.red);
+	if(kind == "cornell")
+	{
+		cuboid(scene, point3d_t(-1.4, -1.0, -2.1), point3d_t(-0.2, 0.2, -0.3), mat.grey);
+		cuboid(scene, point3d_t(0.2, -2.6, -2.1), point3d_t(1.3, -1.5, -1.2), mat.grey);
+	}
+	if(!scene.endTriMesh()) return false;
+	bake.push_back(id);
+
+	if(kind == "cubes")
+	{
+		// a field of small boxes on the floor, lots of triangles and occlusion
+		if(!scene.startTriMesh(id, 8*opt.cubes*opt.cubes, 12*opt.cubes*opt.cubes, false, false)) return false;
+		PFLOAT sx = 4.0 / opt.cubes, sy = 6.0 / opt.cubes;
+		unsigned int seed = opt.seed;
+		for(int j=0; j<opt.cubes; ++j)
+			for(int i=0; i<opt.cubes; ++i)
+			{
+				PFLOAT x = -2.0 + (i+0.5)*sx, y = -4.0 + (j+0.5)*sy;
+				PFLOAT h = 0.1 + 0.9*lcgFloat(seed);
+				cuboid(scene, point3d_t(x-0.3*sx, y-0.3*sy, -2.1), point3d_t(x+0.3*sx, y+0.3*sy, -2.1+h), mat.grey);
+			}
+		if(!scene.endTriMesh()) return false;
+		bake.push_back(id);
+	}
+	else if(kind == "ply")
+	{
+		if(!loadPly(&scene, mat.grey, opt.plyFile.c_str(), opt.plyScale, id))
+		{
+			std::cout << "bakebench: could not load " << opt.plyFile << "\n";
+			return false;
+		}
+		// bake only the loaded model, the room is there for occlusion and bounce light
+		bake[0] = id;
+	}
+	return scene.endGeometry();
+}
+
+static integrator_t* createIntegrator(renderEnvironment_t &env, const std::string &kind, const benchOptions_t &opt, int caseNum)
+{
+	paraMap_t params;
+	if(kind == "direct")
+	{
+		params["type"] = parameter_t(std::string("directlighting"));
+	}
+	else if(kind == "ao")
+	{
+		params["type"] = parameter_t(std::string("ambientocclusion"));
+		params["AO_samples"] = parameter_t(16);
+		params["AO_distance"] = parameter_t(1.0f);
+		params["AO_color"] = parameter_t(colorA_t(1.f));
+	}
+	else if(kind == "photon")
+	{
+		params["type"] = parameter_t(std::string("photonmapping"));
+		params["photons"] = parameter_t(opt.photons);
+		params["search"] = parameter_t(75);
+		params["diffuseRadius"] = parameter_t(0.2f);
+		params["finalGather"] = parameter_t(true);
+		params["fg_samples"] = parameter_t(16);
+	}
+	else return 0;
+	std::ostringstream name;
+	name << "bench_" << kind << "_" << caseNum;
+	return env.createIntegrator(name.str(), params);
+}
+
+//-----------------------------------------------------------------------------------------
+// results
+//-----------------------------------------------------------------------------------------
+
+typedef std::map<std::string, double> benchValues_t;
+
+static bool readResults(const std::string &file, std::map<std::string, benchValues_t> &results)
+{
+	std::ifstream in(file.c_str());
+	if(!in) return false;
+	std::string line;
+	while(std::getline(in, line))
+	{
+		std::istringstream tokens(line);
+		std::string tok, name;
+		benchValues_t values;
+		while(tokens >> tok)
+		{
+			std::string::size_type eq = tok.find('=');
+			if(eq == std::string::npos) continue;
+			if(tok.substr(0, eq) == "case") name = tok.substr(eq+1);
+			else values[tok.substr(0, eq)] = std::atof(tok.substr(eq+1).c_str());
+		}
+		if(!name.empty()) results[name] = values;
+	}
+	return true;
+}
+
+//! compare with the baseline, returns the number of regressions beyond the tolerance
+static int compareResults(const std::string &name, benchValues_t &cur, benchValues_t &base, double tolerance)
+{
+	// metrics and whether more is better
+	static const char *metrics[] = { "kdtree_s", "photon_s", "bake_s", "texels_per_s", "rays_per_s", "peak_rss_kb" };
+	static const bool higherBetter[] = { false, false, false, true, true, false };
+	int regressions = 0;
+	for(int m=0; m<6; ++m)
+	{
+		if(base.find(metrics[m]) == base.end() || cur.find(metrics[m]) == cur.end()) continue;
+		double b = base[metrics[m]], c = cur[metrics[m]];
+		// times below 10ms are too noisy to compare
+		if(!higherBetter[m] && m < 3 && b < 0.01 && c < 0.01) continue;
+		if(b <= 0.0) continue;
+		double change = (c - b) / b;
+		bool worse = higherBetter[m] ? (change < -tolerance) : (change > tolerance);
+		if(worse) ++regressions;
+		std::cout << "compare case=" << name << " metric=" << metrics[m] << " baseline=" << b << " current=" << c
+			<< " change=" << 100.0*change << "%" << (worse ? " REGRESSION" : "") << "\n";
+	}
+	return regressions;
+}
+
+static void splitList(const std::string &s, std::vector<std::string> &list)
+{
+	list.clear();
+	std::string::size_type start = 0;
+	while(start <= s.size())
+	{
+		std::string::size_type end = s.find(',', start);
+		if(end == std::string::npos) end = s.size();
+		if(end > start) list.push_back(s.substr(start, end-start));
+		start = end + 1;
+	}
+}
+
+static bool parseOptions(int argc, char **argv, benchOptions_t &opt)
+{
+	splitList("cornell,cubes", opt.scenes);
+	splitList("direct,ao,photon", opt.integrators);
+	for(int i=1; i<argc; ++i)
+	{
+		std::string arg(argv[i]);
+		std::string::size_type eq = arg.find('=');
+		if(arg.substr(0, 2) != "--" || eq == std::string::npos)
+		{
+			std::cout << "bakebench: unknown argument " << arg << "\n";
+			return false;
+		}
+		std::string key = arg.substr(2, eq-2), val = arg.substr(eq+1);
+		if(key == "scenes") splitList(val, opt.scenes);
+		else if(key == "integrators") splitList(val, opt.integrators);
+		else if(key == "ply") opt.plyFile = val;
+		else if(key == "ply-scale") opt.plyScale = std::atof(val.c_str());
+		else if(key == "res") opt.res = std::atoi(val.c_str());
+		else if(key == "samples") opt.samples = std::atoi(val.c_str());
+		else if(key == "threads") opt.threads = std::atoi(val.c_str());
+		else if(key == "photons") opt.photons = std::atoi(val.c_str());
+		else if(key == "cubes") opt.cubes = std::atoi(val.c_str());
+		else if(key == "rays") opt.rays = std::atoi(val.c_str());
+		else if(key == "seed") opt.seed = std::atoi(val.c_str());
+		else if(key == "filter") opt.filterSize = std::atof(val.c_str());
+		else if(key == "deterministic") opt.deterministic = std::atoi(val.c_str());
+		else if(key == "out") opt.outFile = val;
+		else if(key == "baseline") opt.baseline = val;
+		else if(key == "tolerance") opt.tolerance = std::atof(val.c_str());
+		else if(key == "trace") opt.traceFile = val;
+		else
+		{
+			std::cout << "bakebench: unknown option " << key << "\n";
+			return false;
+		}
+	}
+	// a ply file alone means the ply scene is wanted too
+	if(!opt.plyFile.empty())
+	{
+		bool found = false;
+		for(unsigned int i=0; i<opt.scenes.size(); ++i) found = found || (opt.scenes[i] == "ply");
+		if(!found) opt.scenes.push_back("ply");
+	}
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	benchOptions_t opt;
+	if(!parseOptions(argc, argv, opt)) return 2;
+
+	renderEnvironment_t *env = new renderEnvironment_t();
+	std::string ppath;
+	if(env->getPluginPath(ppath)) env->loadPlugins(ppath);
+	else std::cout << "getting plugin path from render environment failed!\n";
+
+	paraMap_t params;
+	std::list<paraMap_t> eparams;
+	benchMaterials_t mat;
+	material_t **mats[] = { &mat.grey, &mat.red, &mat.blue };
+	const char *matNames[] = { "bench_grey", "bench_red", "bench_blue" };
+	colorA_t matCols[] = { colorA_t(0.66f, 0.66f, 0.66f, 1.f), colorA_t(0.75f, 0.15f, 0.15f, 1.f), colorA_t(0.15f, 0.15f, 0.75f, 1.f) };
+	for(int i=0; i<3; ++i)
+	{
+		params.clear();
+		params["type"] = parameter_t(std::string("shinydiffusemat"));
+		params["color"] = parameter_t(matCols[i]);
+		params["diffuse_reflect"] = parameter_t(1.0f);
+		*mats[i] = env->createMaterial(matNames[i], params, eparams);
+		if(!*mats[i]){ std::cout << "bakebench: could not create materials, check the plugin path\n"; return 1; }
+	}
+	params.clear();
+	params["type"] = parameter_t(std::string("constant"));
+	params["color"] = parameter_t(colorA_t(0.f));
+	background_t *back = env->createBackground("bench_back", params);
+	params.clear();
+	params["type"] = parameter_t(std::string("EmissionIntegrator"));
+	volumeIntegrator_t *volInt = (volumeIntegrator_t*)env->createIntegrator("bench_vol", params);
+	// the kd-tree gets built (and timed) during an update with a cheap integrator
+	params.clear();
+	params["type"] = parameter_t(std::string("directlighting"));
+	surfaceIntegrator_t *treeInt = (surfaceIntegrator_t*)env->createIntegrator("bench_tree", params);
+	if(!volInt || !treeInt){ std::cout << "bakebench: could not create integrators, check the plugin path\n"; return 1; }
+
+	std::ofstream outFile;
+	if(!opt.outFile.empty())
+	{
+		outFile.open(opt.outFile.c_str());
+		if(!outFile){ std::cout << "bakebench: could not write " << opt.outFile << "\n"; return 2; }
+	}
+	if(!opt.traceFile.empty() && !renderTrace_t::instance().open(opt.traceFile)) return 2;
+	std::map<std::string, benchValues_t> results;
+	std::vector<std::string> order;
+	yafaray::timer_t timer;
+	timer.addEvent("kdtree");
+	timer.addEvent("render");
+	timer.addEvent("bake");
+	timer.addEvent("rays");
+	timer.addEvent("volume");
+	int caseNum = 0;
+
+	for(unsigned int s=0; s<opt.scenes.size(); ++s)
+	{
+		for(unsigned int in=0; in<opt.integrators.size(); ++in, ++caseNum)
+		{
+			const std::string &sceneKind = opt.scenes[s], &intKind = opt.integrators[in];
+			std::string name = sceneKind + "/" + intKind;
+			std::cout << "bakebench: running " << name << "\n";
+			myseed = opt.seed;
+
+			surfaceIntegrator_t *integrator = (surfaceIntegrator_t*)createIntegrator(*env, intKind, opt, caseNum);
+			if(!integrator){ std::cout << "bakebench: unknown integrator " << intKind << "\n"; continue; }
+			scene_t *scene = new scene_t();
+			scene->setAntialiasing(opt.samples, 1, 1, 0.05);
+			scene->setNumThreads(opt.threads);
+			scene->setSeed(opt.seed);
+			std::vector<objID_t> bakeIDs;
+			// the trace has no meshes to tell apart, so its events carry the case number instead
+			renderTrace_t::instance().setMesh(caseNum);
+			if(!buildGeometry(*scene, sceneKind, opt, mat, bakeIDs))
+			{
+				std::cout << "bakebench: could not build scene " << sceneKind << "\n";
+				delete scene;
+				continue;
+			}
+			std::vector<triangleObject_t*> bakeMeshes;
+			for(unsigned int i=0; i<bakeIDs.size(); ++i) bakeMeshes.push_back(scene->getMesh(bakeIDs[i]));
+
+			params.clear();
+			params["type"] = parameter_t(std::string("arealight"));
+			params["corner"] = parameter_t(point3d_t(-0.5, -0.5, 2.0));
+			params["point1"] = parameter_t(point3d_t(-0.5, 0.5, 2.0));
+			params["point2"] = parameter_t(point3d_t(0.5, -0.5, 2.0));
+			params["color"] = parameter_t(colorA_t(1.f));
+			params["power"] = parameter_t(15.f);
+			params["samples"] = parameter_t(8);
+			std::ostringstream lightName;
+			lightName << "bench_light_" << caseNum;
+			light_t *light = env->createLight(lightName.str(), params);
+			if(light) scene->addLight(light);
+
+			bakeCam_t *camera = new bakeCam_t(bakeMeshes, opt.res, timer);
+			hashOutput_t out;
+			imageFilm_t *film = new imageFilm_t(opt.res, opt.res, 0, 0, out, opt.filterSize,
+				opt.filterSize > 1.0 ? imageFilm_t::GAUSS : imageFilm_t::BOX);
+			film->setDeterministic(opt.deterministic != 0);
+			scene->setCamera(camera);
+			scene->setImageFilm(film);
+			scene->setBackground(back);
+			scene->setVolIntegrator(volInt);
+			scene->setSurfIntegrator(treeInt);
+
+			timer.reset("kdtree"); timer.start("kdtree");
+			bool ok = scene->update();
+			timer.stop("kdtree");
+			scene->setSurfIntegrator(integrator);
+			timer.reset("bake");
+			timer.reset("render"); timer.start("render");
+			ok = ok && scene->render();
+			timer.stop("render");
+			timer.stop("bake");
+			if(!ok){ std::cout << "bakebench: render of " << name << " failed\n"; }
+
+			// trace rays from the baked surfaces into the scene
+			unsigned int seed = opt.seed;
+			int nRays = 0, nHits = 0;
+			std::vector<ray_t> shadowRays;
+			timer.reset("rays"); timer.start("rays");
+			for(int tries=0; nRays < opt.rays && tries < 4*opt.rays; ++tries)
+			{
+				surfacePoint_t sp, hit;
+				ray_t ray;
+				PFLOAT wt;
+				PFLOAT px = opt.res * lcgFloat(seed), py = opt.res * lcgFloat(seed);
+				float s1 = lcgFloat(seed), s2 = lcgFloat(seed);
+				if(!camera->sampleSurface(px, py, sp, ray, wt)) continue;
+				ray.from = sp.P;
+				ray.dir = SampleCosHemisphere(sp.Ng, sp.NU, sp.NV, s1, s2);
+				ray.tmin = 0.0005;
+				ray.tmax = -1.0;
+				if(scene->intersect(ray, hit)) ++nHits;
+				++nRays;
+				if(shadowRays.size() < 65536) shadowRays.push_back(ray);
+			}
+			timer.stop("rays");
+
+			// what a shadow ray paid for the volume integrator before update() learned to skip it
+			renderState_t vstate;
+			timer.reset("volume"); timer.start("volume");
+			for(unsigned int i=0; i<shadowRays.size(); ++i) volInt->transmittance(vstate, shadowRays[i]);
+			timer.stop("volume");
+
+			double bakeTime = camera->bakeStarted() ? timer.getTime("bake") : 0.0, renderTime = timer.getTime("render");
+			benchValues_t &v = results[name];
+			v["threads"] = opt.threads;
+			v["res"] = opt.res;
+			v["triangles"] = camera->numTriangles();
+			v["texels"] = camera->coveredTexels();
+			v["kdtree_s"] = timer.getTime("kdtree");
+			v["photon_s"] = std::max(0.0, renderTime - bakeTime);
+			v["bake_s"] = bakeTime;
+			v["texels_per_s"] = (bakeTime > 0.0) ? camera->coveredTexels() / bakeTime : 0.0;
+			v["rays_per_s"] = (timer.getTime("rays") > 0.0) ? nRays / timer.getTime("rays") : 0.0;
+			v["peak_rss_kb"] = (double)peakRSS();
+			v["volumes"] = scene->volumeEffects() ? 1 : 0;
+			v["volume_ns"] = shadowRays.empty() ? 0.0 : 1e9 * timer.getTime("volume") / shadowRays.size();
+			const renderStats_t &stats = scene->getStats();
+			order.push_back(name);
+
+			std::ostringstream line;
+			line << "case=" << name;
+			static const char *keys[] = { "threads", "res", "triangles", "texels", "kdtree_s", "photon_s", "bake_s",
+										"texels_per_s", "rays_per_s", "peak_rss_kb", "volumes", "volume_ns" };
+			for(int k=0; k<12; ++k) line << " " << keys[k] << "=" << v[keys[k]];
+			for(int c=0; c<RS_NUM_COUNTERS; ++c)
+				line << " " << renderStats_t::counterName((renderCounter_t)c) << "=" << stats.total((renderCounter_t)c);
+			line << " image_hash=" << std::hex << out.hash << std::dec;
+			std::cout << line.str() << std::endl;
+			if(outFile.is_open()) outFile << line.str() << std::endl;
+
+			delete scene;
+			delete film;
+			delete camera;
+		}
+	}
+
+	renderTrace_t::instance().close();
+	int regressions = 0;
+	if(!opt.baseline.empty())
+	{
+		std::map<std::string, benchValues_t> base;
+		if(!readResults(opt.baseline, base))
+		{
+			std::cout << "bakebench: could not read baseline " << opt.baseline << "\n";
+			return 2;
+		}
+		for(unsigned int i=0; i<order.size(); ++i)
+		{
+			std::map<std::string, benchValues_t>::iterator b = base.find(order[i]);
+			if(b == base.end()) std::cout << "compare case=" << order[i] << " missing in baseline\n";
+			else regressions += compareResults(order[i], results[order[i]], b->second, opt.tolerance);
+		}
+		std::cout << "compare regressions=" << regressions << "\n";
+	}
+	return regressions ? 1 : 0;
+}
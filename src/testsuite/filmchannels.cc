@@ -0,0 +1,60 @@
+#include <yafray_config.h>
+#include <iostream>
+
+#include <core_api/imagefilm.h>
+#include <core_api/output.h>
+
+using namespace::yafaray;
+
+/*	Custom channel regression test: adds several channels to an image film, so the channel
+	list has to grow a few times, then writes a distinct value to every pixel of every channel
+	and reads all of them back.
+	usage: filmchannels (returns 0 on success) */
+
+class nullOutput_t: public colorOutput_t
+{
+	public:
+		virtual bool putPixel(int x, int y, const float *c, int channels){ return true; }
+		virtual void flush(){}
+		virtual void flushArea(int x0, int y0, int x1, int y1){}
+};
+
+static float value(int chan, int x, int y){ return (float)(chan*1000 + y*100 + x); }
+
+int main(int argc, char **argv)
+{
+	const int size = 32;
+	const int nChannels = 5;
+	nullOutput_t out;
+	imageFilm_t *film = new imageFilm_t(size, size, 0, 0, out);
+	
+	int chans[nChannels];
+	const char *names[nChannels] = { "Depth", "Occlusion", "Bounces", "Alpha", "Coverage" };
+	for(int k=0; k<nChannels; ++k) chans[k] = film->addChannel(names[k]);
+	film->init();
+	
+	for(int k=0; k<nChannels; ++k)
+		for(int y=0; y<size; ++y)
+			for(int x=0; x<size; ++x) film->setChanPixel(value(k, x, y), chans[k], x, y);
+	
+	int errors = 0;
+	for(int k=0; k<nChannels; ++k)
+	{
+		if(film->getChannel(names[k]) != chans[k])
+		{
+			std::cout << "channel \"" << names[k] << "\" not found\n";
+			++errors;
+		}
+		for(int y=0; y<size; ++y)
+			for(int x=0; x<size; ++x)
+			{
+				float v = film->getChanPixel(chans[k], x, y);
+				if(v != value(k, x, y) && errors++ < 10)
+					std::cout << "channel " << k << " pixel (" << x << "," << y << "): " << v << " expected " << value(k, x, y) << "\n";
+			}
+	}
+	delete film;
+	
+	std::cout << (errors ? "FAILED" : "passed") << ": " << nChannels << " channels, " << errors << " errors\n";
+	return errors ? 1 : 0;
+}
@@ -0,0 +1,98 @@
+
+#include <yafray_config.h>
+#include <iostream>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+
+#include <textures/noise.h>
+#include <yafraycore/timer.h>
+
+using namespace::yafaray;
+
+/*	Procedural noise benchmark: evaluates every noise type at the same random points one
+	at a time through operator() and 8 points per call through batch(), and reports the time
+	per point and the largest difference between both. Afterwards fractal noise (turbulence
+	and the musgrave types) is timed, these batch their octaves internally.
+	usage: noisebench [points] [octaves] */
+
+static const int BATCH = 8;
+
+struct noiseCase_t
+{
+	const char *name;
+	noiseGenerator_t *gen;
+};
+
+int main(int argc, char **argv)
+{
+	int n = (argc > 1) ? std::atoi(argv[1]) : 1000000;
+	int octaves = (argc > 2) ? std::atoi(argv[2]) : 6;
+	n -= n % BATCH;
+	std::vector<point3d_t> pts(n);
+	std::vector<PFLOAT> ref(n), res(n);
+	unsigned int seed = 12345;
+	for(int i=0; i<n; ++i)
+	{
+		PFLOAT c[3];
+		for(int k=0; k<3; ++k)
+		{
+			seed = seed*1664525 + 1013904223;
+			c[k] = 200.f * ((PFLOAT)(seed >> 8) / 16777216.f) - 100.f;
+		}
+		pts[i] = point3d_t(c[0], c[1], c[2]);
+	}
+
+	noiseCase_t cases[] = {
+		{ "newperlin", new newPerlin_t() },
+		{ "stdperlin", new stdPerlin_t() },
+		{ "blender", new blenderNoise_t() },
+		{ "voronoi_f1", new voronoi_t(voronoi_t::V_F1) },
+		{ "voronoi_crackle", new voronoi_t(voronoi_t::V_CRACKLE) },
+		{ "voronoi_f2_squared", new voronoi_t(voronoi_t::V_F2, voronoi_t::DIST_SQUARED) },
+		{ "cellnoise", new cellNoise_t() }
+	};
+	int nCases = sizeof(cases) / sizeof(noiseCase_t);
+
+	yafaray::timer_t timer;
+	timer.addEvent("scalar");
+	timer.addEvent("batch");
+	double sum = 0;
+	for(int c=0; c<nCases; ++c)
+	{
+		const noiseGenerator_t &gen = *cases[c].gen;
+		timer.reset("scalar"); timer.start("scalar");
+		for(int i=0; i<n; ++i) ref[i] = gen(pts[i]);
+		timer.stop("scalar");
+		timer.reset("batch"); timer.start("batch");
+		for(int i=0; i<n; i+=BATCH) gen.batch(&pts[i], &res[i], BATCH);
+		timer.stop("batch");
+		PFLOAT maxDiff = 0.f;
+		for(int i=0; i<n; ++i)
+		{
+			maxDiff = std::max(maxDiff, (PFLOAT)std::fabs(ref[i] - res[i]));
+			sum += res[i];
+		}
+		std::cout << cases[c].name << ": scalar " << 1e9 * timer.getTime("scalar") / n << " ns/point, batch "
+			<< 1e9 * timer.getTime("batch") / n << " ns/point, max difference " << maxDiff << "\n";
+	}
+
+	for(int c=0; c<nCases; ++c)
+	{
+		const noiseGenerator_t *gen = cases[c].gen;
+		fBm_t fbm(1.0, 2.0, octaves, gen);
+		ridgedMFractal_t ridged(1.0, 2.0, octaves, 1.0, 2.0, gen);
+		timer.reset("scalar"); timer.start("scalar");
+		for(int i=0; i<n; ++i) sum += turbulence(gen, pts[i], octaves, 1.f, true);
+		timer.stop("scalar");
+		timer.reset("batch"); timer.start("batch");
+		for(int i=0; i<n; ++i) sum += fbm(pts[i]) + ridged(pts[i]);
+		timer.stop("batch");
+		std::cout << cases[c].name << ", " << octaves << " octaves: turbulence " << 1e9 * timer.getTime("scalar") / n
+			<< " ns/point, fBm + ridged " << 1e9 * timer.getTime("batch") / n << " ns/point\n";
+	}
+	// keep the compiler from dropping the evaluations
+	std::cout << "checksum " << sum << "\n";
+	for(int c=0; c<nCases; ++c) delete cases[c].gen;
+	return 0;
+}
@@ -4,7 +4,7 @@
 
 #include <core_api/scene.h>
 
-using namespace::yafray;
+using namespace::yafaray;
 
 struct ply_dat_t
 {
@@ -53,7 +53,8 @@ static int face_cb(p_ply_argument argument) {
 
 }
 
-bool loadPly(scene_t *s, material_t *mat, const char *plyfile, double scale)
+//! load a ply file as a new triangle mesh, its object ID is returned in id
+bool loadPly(scene_t *s, material_t *mat, const char *plyfile, double scale, objID_t &id)
 {
 	long nvertices, ntriangles;
 	bool success=false;
@@ -70,7 +71,6 @@ bool loadPly(scene_t *s, material_t *mat, const char *plyfile, double scale)
 	ply_set_read_cb(ply, "vertex", "z", vertex_cb, &dat, 2);
 	ntriangles = ply_set_read_cb(ply, "face", "vertex_indices", face_cb, &dat, 0);
 	
-	objID_t id;
 	if(s->startTriMesh(id,nvertices, ntriangles,false,false))
 	{
 		success = (ply_read(ply)) ? true : false;
@@ -80,4 +80,8 @@ bool loadPly(scene_t *s, material_t *mat, const char *plyfile, double scale)
 	return success;
 }
 
-
+bool loadPly(scene_t *s, material_t *mat, const char *plyfile, double scale)
+{
+	objID_t id;
+	return loadPly(s, mat, plyfile, scale, id);
+}
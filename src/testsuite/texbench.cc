@@ -0,0 +1,82 @@
+
+#include <yafray_config.h>
+#include <iostream>
+#include <cstdlib>
+
+#include <textures/imagetex.h>
+#include <yafraycore/timer.h>
+
+using namespace::yafaray;
+
+/*	Texture fetch benchmark: a screen of 512x512 pixels looks at a minified image texture,
+	every pixel covering "footprint" texels. Compares plain bilinear lookups on the source
+	buffer (what image textures did without mip maps) with trilinear lookups on the tiled
+	mip pyramid at the level matching the footprint.
+	usage: texbench [texture size] [repetitions] */
+
+static void getPixel(unsigned char *data, colorA_t &col){ data >> col; }
+
+static void fill(cBuffer_t &buf)
+{
+	// some high frequency content, so both paths touch "real" data
+	unsigned int seed = 12345;
+	for(int y=0; y<buf.resy(); ++y)
+		for(int x=0; x<buf.resx(); ++x)
+		{
+			unsigned char *p = buf(x, y);
+			for(int k=0; k<4; ++k)
+			{
+				seed = seed*1664525 + 1013904223;
+				p[k] = (unsigned char)(seed >> 24);
+			}
+		}
+}
+
+int main(int argc, char **argv)
+{
+	int size = (argc > 1) ? std::atoi(argv[1]) : 4096;
+	int reps = (argc > 2) ? std::atoi(argv[2]) : 4;
+	const int screen = 512;
+	cBuffer_t image(size, size);
+	fill(image);
+	mipMap_t<unsigned char> mip(image, true);
+	std::cout << "texture " << size << "x" << size << ", " << mip.numLevels() << " mip levels, "
+		<< mip.memSize()/1024 << "kB\n";
+	yafaray::timer_t timer;
+	timer.addEvent("base");
+	timer.addEvent("mip");
+	colorA_t sum(0.f);
+	for(float footprint = 0.5f; footprint <= 64.f; footprint *= 2.f)
+	{
+		// texture space covered by the screen, wrapped like TCL_REPEAT
+		float width = footprint / (float)size;
+		float lod = mip.lod(width);
+		timer.reset("base"); timer.start("base");
+		for(int r=0; r<reps; ++r)
+			for(int y=0; y<screen; ++y)
+				for(int x=0; x<screen; ++x)
+				{
+					point3d_t p(x*width, y*width, 0.f);
+					p.x -= (int)p.x; p.y -= (int)p.y;
+					sum += interpolateImage(&image, textureImage_t::BILINEAR, p, getPixel);
+				}
+		timer.stop("base");
+		timer.reset("mip"); timer.start("mip");
+		for(int r=0; r<reps; ++r)
+			for(int y=0; y<screen; ++y)
+				for(int x=0; x<screen; ++x)
+				{
+					point3d_t p(x*width, y*width, 0.f);
+					p.x -= (int)p.x; p.y -= (int)p.y;
+					sum += interpolateMipMap(mip, textureImage_t::BILINEAR, p, lod, getPixel);
+				}
+		timer.stop("mip");
+		double n = (double)reps * screen * screen;
+		std::cout << "footprint " << footprint << " texels (lod " << lod << "): base "
+			<< 1e9 * timer.getTime("base") / n << " ns/lookup, mip "
+			<< 1e9 * timer.getTime("mip") / n << " ns/lookup\n";
+	}
+	// keep the compiler from dropping the lookups
+	std::cout << "checksum " << sum.energy() << "\n";
+	return 0;
+}
@@ -1,7 +1,9 @@
 
 #include <textures/basicnodes.h>
 #include <textures/layernode.h>
+#include <yafraycore/nodeops.h>
 #include <core_api/object3d.h>
+#include <core_api/ray.h>
 
 __BEGIN_YAFRAY
 
@@ -120,6 +122,62 @@ point3d_t eval_uv(const surfacePoint_t &sp, int vmap)
 	}
 }
 
+//! true if sp is the closest hit of ray, and not e.g. an occluder found by a shadow ray
+static bool isHitOf(const ray_t &ray, const surfacePoint_t &sp)
+{
+	if(ray.tmax < 0.f) return false;
+	vector3d_t toHit = (ray.from + ray.tmax * ray.dir) - sp.P;
+	return toHit*toHit <= 1e-6f * (1.f + ray.tmax*ray.tmax);
+}
+
+/*! width of the area in uv space seen by one pixel; 0 if unknown.
+	Where the camera ray hit, it follows from the ray differentials. Where a secondary ray with a cone hit
+	(see renderState_t::coneRay), the cone cuts a disc of width spread*distance, stretched along the ray
+	by the incidence angle. */
+static PFLOAT uvFootprint(const renderState_t &state, const surfacePoint_t &sp)
+{
+	vector3d_t dP[2];
+	const diffRay_t *ray = state.cameraRay;
+	const ray_t *cone = state.coneRay;
+	if(state.raylevel == 0 && ray && ray->hasDifferentials && isHitOf(*ray, sp))
+	{
+		spDifferentials_t diff(sp, *ray);
+		dP[0] = diff.dPdx;
+		dP[1] = diff.dPdy;
+	}
+	else if(cone && state.coneSpread > 0.f && isHitOf(*cone, sp))
+	{
+		PFLOAT w = state.coneSpread * cone->tmax;
+		PFLOAT cosi = cone->dir * sp.Ng;
+		vector3d_t along = cone->dir - cosi * sp.Ng;
+		PFLOAT len = along.length();
+		if(len > 1e-4f)
+		{
+			along *= 1.f/len;
+			dP[0] = (w / std::max(std::fabs(cosi), (PFLOAT)0.1f)) * along;
+			dP[1] = w * (sp.Ng ^ along);
+		}
+		else
+		{
+			dP[0] = w * sp.NU;
+			dP[1] = w * sp.NV;
+		}
+	}
+	else return 0.f;
+	// least squares solution of dP = du*dPdU + dv*dPdV
+	PFLOAT a = sp.dPdU*sp.dPdU, b = sp.dPdU*sp.dPdV, c = sp.dPdV*sp.dPdV;
+	PFLOAT det = a*c - b*b;
+	if(!(std::fabs(det) > 1e-20f)) return 0.f;
+	PFLOAT idet = 1.f/det, width = 0.f;
+	for(int i=0; i<2; ++i)
+	{
+		PFLOAT pu = sp.dPdU * dP[i], pv = sp.dPdV * dP[i];
+		PFLOAT du = (c*pu - b*pv) * idet, dv = (a*pv - b*pu) * idet;
+		width = std::max(width, std::max(std::fabs(du), std::fabs(dv)));
+	}
+	return width;
+}
+
 void textureMapper_t::eval(nodeStack_t &stack, const renderState_t &state, const surfacePoint_t &sp)const
 {
 	point3d_t texpt;
@@ -148,6 +206,15 @@ void textureMapper_t::eval(nodeStack_t &stack, const renderState_t &state, const
 	// scale and offset:
 	texpt = mult((texpt+offset), scale);
 	
+	// prefiltered lookup for plain uv mapped image textures, if we know the pixel footprint
+	PFLOAT width = 0.f;
+	if(tex->discrete() && tex_coords == TXC_UV && vmap == 0 && tex_maptype == TXP_PLAIN)
+		width = uvFootprint(state, sp) * std::max(std::fabs(scale.x), std::fabs(scale.y));
+	if(width > 0.f)
+	{
+		stack[this->ID] = nodeResult_t(tex->getColorFiltered(texpt, width), (doScalar) ? tex->getFloatFiltered(texpt, width) : 0.f );
+		return;
+	}
 	stack[this->ID] = nodeResult_t(tex->getColor(texpt), (doScalar) ? tex->getFloat(texpt) : 0.f );
 }
 
@@ -336,44 +403,21 @@ shaderNode_t* vcolorNode_t::factory(const paraMap_t &params,renderEnvironment_t
 }
 
 /* ==========================================
-/  A simple mix node, could be used to derive other math nodes
+/  A mix node, the mode selects the math (see mixNodeResult())
 / ========================================== */
 
-mixNode_t::mixNode_t(): cfactor(0.f), input1(0), input2(0), factor(0)
+mixNode_t::mixNode_t(): cfactor(0.f), input1(0), input2(0), factor(0), mode(MN_MIX)
 {}
 
-mixNode_t::mixNode_t(float val): cfactor(val), input1(0), input2(0), factor(0)
+mixNode_t::mixNode_t(float val, mix_modes mmode): cfactor(val), input1(0), input2(0), factor(0), mode(mmode)
 {}
 
 void mixNode_t::eval(nodeStack_t &stack, const renderState_t &state, const surfacePoint_t &sp)const
 {
-	float f2 = (factor) ? factor->getScalar(stack) : cfactor;
-	float f1 = 1.f - f2, fin1, fin2;
+	float f2, fin1, fin2;
 	colorA_t cin1, cin2;
-	if(input1)
-	{
-		cin1 = input1->getColor(stack);
-		fin1 = input1->getScalar(stack);
-	}
-	else
-	{
-		cin1 = col1;
-		fin1 = val1;
-	}
-	if(input2)
-	{
-		cin2 = input2->getColor(stack);
-		fin2 = input2->getScalar(stack);
-	}
-	else
-	{
-		cin2 = col2;
-		fin2 = val2;
-	}
-	
-	colorA_t color = f1 * cin1 + f2 * cin2;
-	float   scalar = f1 * fin1 + f2 * fin2;
-	stack[this->ID] = nodeResult_t(color, scalar);
+	getInputs(stack, cin1, cin2, fin1, fin2, f2);
+	stack[this->ID] = mixNodeResult(mode, f2, cin1, cin2, fin1, fin2);
 }
 
 void mixNode_t::eval(nodeStack_t &stack, const renderState_t &state, const surfacePoint_t &sp, const vector3d_t &wo, const vector3d_t &wi)const
@@ -381,6 +425,19 @@ void mixNode_t::eval(nodeStack_t &stack, const renderState_t &state, const surfa
 	eval(stack, state, sp);
 }
 
+bool mixNode_t::compile(nodeInstr_t &instr) const
+{
+	instr.op = nodeInstr_t::OP_MIX;
+	instr.mode = mode;
+	instr.in[0] = input1 ? (int)input1->ID : -1;
+	instr.in[1] = input2 ? (int)input2->ID : -1;
+	instr.in[2] = factor ? (int)factor->ID : -1;
+	instr.col[0] = col1; instr.val[0] = val1;
+	instr.col[1] = col2; instr.val[1] = val2;
+	instr.val[2] = cfactor;
+	return true;
+}
+
 bool mixNode_t::configInputs(const paraMap_t &params, const nodeFinder_t &find)
 {
 	const std::string *name=0;
@@ -415,148 +472,6 @@ bool mixNode_t::getDependencies(std::vector<const shaderNode_t*> &dep) const
 	return !dep.empty();
 }
 
-class addNode_t: public mixNode_t
-{
-	public:
-		virtual void eval(nodeStack_t &stack, const renderState_t &state, const surfacePoint_t &sp)const
-		{
-			float f2, fin1, fin2;
-			colorA_t cin1, cin2;
-			getInputs(stack, cin1, cin2, fin1, fin2, f2);
-			
-			cin1 += f2 * cin2;
-			fin1 += f2 * fin2;
-			stack[this->ID] = nodeResult_t(cin1, fin1);
-		}
-};
-
-class multNode_t: public mixNode_t
-{
-	public:
-		virtual void eval(nodeStack_t &stack, const renderState_t &state, const surfacePoint_t &sp)const
-		{
-			float f1, f2, fin1, fin2;
-			colorA_t cin1, cin2;
-			getInputs(stack, cin1, cin2, fin1, fin2, f2);
-			f1 = 1.f - f2;
-			
-			cin1 *= colorA_t(f1) + f2 * cin2;
-			fin2 *= f1 + f2 * fin2;
-			stack[this->ID] = nodeResult_t(cin1, fin1);
-		}
-};
-
-class subNode_t: public mixNode_t
-{
-	public:
-		virtual void eval(nodeStack_t &stack, const renderState_t &state, const surfacePoint_t &sp)const
-		{
-			float f2, fin1, fin2;
-			colorA_t cin1, cin2;
-			getInputs(stack, cin1, cin2, fin1, fin2, f2);
-			
-			cin1 -= f2 * cin2;
-			fin1 -= f2 * fin2;
-			stack[this->ID] = nodeResult_t(cin1, fin1);
-		}
-};
-
-class screenNode_t: public mixNode_t
-{
-	public:
-		virtual void eval(nodeStack_t &stack, const renderState_t &state, const surfacePoint_t &sp)const
-		{
-			float f1, f2, fin1, fin2;
-			colorA_t cin1, cin2;
-			getInputs(stack, cin1, cin2, fin1, fin2, f2);
-			f1 = 1.f - f2;
-			
-			colorA_t color = colorA_t(1.f) - (colorA_t(f1) + f2 * (1.f - cin2)) * (1.f - cin1);
-			CFLOAT scalar   = 1.0 - (f1 + f2*(1.f - fin2)) * (1.f -  fin1);
-			stack[this->ID] = nodeResult_t(color, scalar);
-		}
-};
-
-class diffNode_t: public mixNode_t
-{
-	public:
-		virtual void eval(nodeStack_t &stack, const renderState_t &state, const surfacePoint_t &sp)const
-		{
-			float f1, f2, fin1, fin2;
-			colorA_t cin1, cin2;
-			getInputs(stack, cin1, cin2, fin1, fin2, f2);
-			f1 = 1.f - f2;
-			
-			cin1.R = f1*cin1.R + f2*std::fabs(cin1.R - cin2.R);
-			cin1.G = f1*cin1.G + f2*std::fabs(cin1.G - cin2.G);
-			cin1.B = f1*cin1.B + f2*std::fabs(cin1.B - cin2.B);
-			cin1.A = f1*cin1.A + f2*std::fabs(cin1.A - cin2.A);
-			fin1   = f1*fin1 + f2*std::fabs(fin1 - fin2);
-			stack[this->ID] = nodeResult_t(cin1, fin1);
-		}
-};
-
-class darkNode_t: public mixNode_t
-{
-	public:
-		virtual void eval(nodeStack_t &stack, const renderState_t &state, const surfacePoint_t &sp)const
-		{
-			float f2, fin1, fin2;
-			colorA_t cin1, cin2;
-			getInputs(stack, cin1, cin2, fin1, fin2, f2);
-			
-			cin2 *= f2;
-			if(cin2.R < cin1.R) cin1.R = cin2.R;
-			if(cin2.G < cin1.G) cin1.G = cin2.G;
-			if(cin2.B < cin1.B) cin1.B = cin2.B;
-			if(cin2.A < cin1.A) cin1.A = cin2.A;
-			fin2 *= f2;
-			if(fin2 < fin1) fin1 = fin2;
-			stack[this->ID] = nodeResult_t(cin1, fin1);
-		}
-};
-
-class lightNode_t: public mixNode_t
-{
-	public:
-		virtual void eval(nodeStack_t &stack, const renderState_t &state, const surfacePoint_t &sp)const
-		{
-			float f2, fin1, fin2;
-			colorA_t cin1, cin2;
-			getInputs(stack, cin1, cin2, fin1, fin2, f2);
-			
-			cin2 *= f2;
-			if(cin2.R > cin1.R) cin1.R = cin2.R;
-			if(cin2.G > cin1.G) cin1.G = cin2.G;
-			if(cin2.B > cin1.B) cin1.B = cin2.B;
-			if(cin2.A > cin1.A) cin1.A = cin2.A;
-			fin2 *= f2;
-			if(fin2 > fin1) fin1 = fin2;
-			stack[this->ID] = nodeResult_t(cin1, fin1);
-		}
-};
-
-class overlayNode_t: public mixNode_t
-{
-	public:
-		virtual void eval(nodeStack_t &stack, const renderState_t &state, const surfacePoint_t &sp)const
-		{
-			float f1, f2, fin1, fin2;
-			colorA_t cin1, cin2;
-			getInputs(stack, cin1, cin2, fin1, fin2, f2);
-			f1 = 1.f - f2;
-			
-			colorA_t color;
-			color.R = (cin1.R < 0.5f) ? cin1.R * (f1 + 2.0f*f2*cin2.R) : 1.0 - (f1 + 2.0f*f2*(1.0 - cin2.R)) * (1.0 - cin1.R);
-			color.G = (cin1.G < 0.5f) ? cin1.G * (f1 + 2.0f*f2*cin2.G) : 1.0 - (f1 + 2.0f*f2*(1.0 - cin2.G)) * (1.0 - cin1.G);
-			color.B = (cin1.B < 0.5f) ? cin1.B * (f1 + 2.0f*f2*cin2.B) : 1.0 - (f1 + 2.0f*f2*(1.0 - cin2.B)) * (1.0 - cin1.B);
-			color.A = (cin1.A < 0.5f) ? cin1.A * (f1 + 2.0f*f2*cin2.A) : 1.0 - (f1 + 2.0f*f2*(1.0 - cin2.A)) * (1.0 - cin1.A);
-			CFLOAT scalar = (fin1 < 0.5f) ? fin1 * (f1 + 2.0f*f2*fin2) : 1.0 - (f1 + 2.0f*f2*(1.0 - fin2)) * (1.0 - fin1);
-			stack[this->ID] = nodeResult_t(color, scalar);
-		}
-};
-
-
 shaderNode_t* mixNode_t::factory(const paraMap_t &params,renderEnvironment_t &render)
 {
 	float val=0.5f;
@@ -566,15 +481,14 @@ shaderNode_t* mixNode_t::factory(const paraMap_t &params,renderEnvironment_t &re
 	
 	switch(mode)
 	{
-		case MN_MIX: 		return new mixNode_t(val);
-		case MN_ADD: 		return new addNode_t();
-		case MN_MULT: 		return new multNode_t();
-		case MN_SUB: 		return new subNode_t();
-		case MN_SCREEN:		return new screenNode_t();
-		case MN_DIFF:		return new diffNode_t();
-		case MN_DARK:		return new darkNode_t();
-		case MN_LIGHT:		return new lightNode_t();
-		case MN_OVERLAY:	return new overlayNode_t();
+		case MN_ADD:
+		case MN_MULT:
+		case MN_SUB:
+		case MN_SCREEN:
+		case MN_DIFF:
+		case MN_DARK:
+		case MN_LIGHT:
+		case MN_OVERLAY:	return new mixNode_t(val, (mix_modes)mode);
 	}
 	return new mixNode_t(val);
 }
@@ -20,6 +20,9 @@
 
 #include <cstring>
 #include <cctype>
+#include <sstream>
+#include <sys/types.h>
+#include <sys/stat.h>
 #include <textures/imagetex.h>
 #include <textures/gamma.h>
 #if HAVE_EXR
@@ -35,24 +38,71 @@ gBuf_t<unsigned char, 4> * load_png(const char *name);
 gBuf_t<unsigned char, 4> * load_tga(const char *name);
 gBuf_t<rgbe_t, 1>* loadHDR(const char* filename);
 
+enum { FMT_JPEG, FMT_PNG, FMT_EXR, FMT_TGA };
+
+// the file did not decode as the format its extension suggests, test the others like for unknown
+// extensions (radiance files are identified by the factory already, targa has no ID)
+static bool probeFormat(const char *name, int tried, cBuffer_t *&image, fcBuffer_t *&float_image)
+{
+	std::cout << "could not decode " << name << ", testing format...";
+#ifdef HAVE_JPEG
+	if(tried != FMT_JPEG && (image = load_jpeg(name)))
+	{
+		std::cout << "identified as Jpeg format!\n";
+		return true;
+	}
+#endif
+#if HAVE_EXR
+	if(tried != FMT_EXR && (float_image = loadEXR(name)))
+	{
+		std::cout << "identified as OpenEXR format!\n";
+		return true;
+	}
+#endif
+	std::cout << "\nunknown format!\n";
+	return false;
+}
+
+// decoders handed to the texture cache, which calls them on the first lookup
+#ifdef HAVE_JPEG
+static bool jpegLoader(const char *name, cBuffer_t *&image, fcBuffer_t *&float_image)
+{
+	image = load_jpeg(name);
+	return image != 0 || probeFormat(name, FMT_JPEG, image, float_image);
+}
+#endif
+#if HAVE_PNG
+static bool pngLoader(const char *name, cBuffer_t *&image, fcBuffer_t *&float_image)
+{
+	image = load_png(name);
+	return image != 0 || probeFormat(name, FMT_PNG, image, float_image);
+}
+#endif
+#if HAVE_EXR
+static bool exrLoader(const char *name, cBuffer_t *&image, fcBuffer_t *&float_image)
+{
+	float_image = loadEXR(name);
+	return float_image != 0 || probeFormat(name, FMT_EXR, image, float_image);
+}
+#endif
+static bool tgaLoader(const char *name, cBuffer_t *&image, fcBuffer_t *&float_image)
+{
+	image = load_tga(name);
+	return image != 0 || probeFormat(name, FMT_TGA, image, float_image);
+}
+
 //-----------------------------------------------------------------------------------------
 // Integer/Float Image Texture
 //-----------------------------------------------------------------------------------------
 
-textureImageIF_t::textureImageIF_t(cBuffer_t *im, fcBuffer_t *f_im, INTERPOLATE_TYPE intp):
-				textureImage_t(intp), image(im), float_image(f_im), gammaLUT(0)
-{ }
+textureImageIF_t::textureImageIF_t(cachedImage_t *img, INTERPOLATE_TYPE intp):
+				textureImage_t(intp), cached(img), gammaLUT(0)
+{}
 
 textureImageIF_t::~textureImageIF_t()
 {
-	if (image) {
-		delete image;
-		image = NULL;
-	}
-	if (float_image) {
-		delete float_image;
-		float_image = NULL;
-	}
+	textureCache_t::instance().release(cached);
+	cached = 0;
 	if(gammaLUT){
 		delete gammaLUT;
 		gammaLUT = 0;
@@ -61,6 +111,9 @@ textureImageIF_t::~textureImageIF_t()
 
 void textureImageIF_t::resolution(int &x, int &y, int &z) const
 {
+	cached->use();
+	const mipMap_t<unsigned char> *image = cached->image();
+	const mipMap_t<float> *float_image = cached->floatImage();
 	if(image){ x=image->resx(); y=image->resy(); z=0; }
 	else if(float_image){ x=float_image->resx(); y=float_image->resy(); z=0; }
 	else { x=0; y=0; z=0; }
@@ -69,29 +122,58 @@ void textureImageIF_t::resolution(int &x, int &y, int &z) const
 static inline void getUcharPixel(unsigned char *data, colorA_t &col){ data >> col; }
 static inline void getFloatPixel(float *data, colorA_t &col){ data >> col; }
 
-colorA_t textureImageIF_t::getColor(const point3d_t &p) const
+colorA_t textureImageIF_t::lookup(const point3d_t &p, float lod) const
 {
 	// p->x/y == u, v
 	point3d_t p1 = point3d_t(p.x, 1.f-p.y, p.z);
 	bool outside = doMapping(p1);
 	if(outside) return colorA_t(0.f, 0.f, 0.f, 0.f);
 	colorA_t res(0.f);
+	cached->use();
+	const mipMap_t<unsigned char> *image = cached->image();
+	const mipMap_t<float> *float_image = cached->floatImage();
 	if(image)
 	{
 		if(gammaLUT)
-			res = interpolateImage(image, intp_type, p1, *gammaLUT);
+			res = interpolateMipMap(*image, intp_type, p1, lod, *gammaLUT);
 		else
-			res = interpolateImage(image, intp_type, p1, getUcharPixel);
+			res = interpolateMipMap(*image, intp_type, p1, lod, getUcharPixel);
 	}
 	else if (float_image)
-		res = interpolateImage(float_image, intp_type, p1, getFloatPixel);
+		res = interpolateMipMap(*float_image, intp_type, p1, lod, getFloatPixel);
 	if(!use_alpha) res.A = 1.f;
 	return res;
 }
 
+colorA_t textureImageIF_t::getColor(const point3d_t &p) const
+{
+	return lookup(p, 0.f);
+}
+
+colorA_t textureImageIF_t::getColorFiltered(const point3d_t &p, PFLOAT width) const
+{
+	// repeating shrinks the image in texture space
+	if(tex_clipmode == TCL_REPEAT) width *= (PFLOAT)std::max(xrepeat, yrepeat);
+	float lod = 0.f;
+	cached->use();
+	const mipMap_t<unsigned char> *image = cached->image();
+	const mipMap_t<float> *float_image = cached->floatImage();
+	if(image) lod = image->lod(width);
+	else if(float_image) lod = float_image->lod(width);
+	return lookup(p, lod);
+}
+
+CFLOAT textureImageIF_t::getFloatFiltered(const point3d_t &p, PFLOAT width) const
+{
+	return getColorFiltered(p, width).energy();
+}
+
 colorA_t textureImageIF_t::getColor(int x, int y, int z) const
 {
 	int resx, resy;
+	cached->use();
+	const mipMap_t<unsigned char> *image = cached->image();
+	const mipMap_t<float> *float_image = cached->floatImage();
 	if(image) resx=image->resx(), resy=image->resy();
 	else if(float_image) resx=float_image->resx(), resy=float_image->resy();
 	else return colorA_t(0.f);
@@ -103,13 +185,14 @@ colorA_t textureImageIF_t::getColor(int x, int y, int z) const
 	colorA_t c1(0.f);
 	if(image)
 	{
+		mipMap_t<unsigned char>::levelView_t base = image->level(0);
 		if(gammaLUT)
-			(*gammaLUT)( (*image)(x, y), c1); 
+			(*gammaLUT)( base(x, y), c1); 
 		else
-			getUcharPixel( (*image)(x, y), c1);
+			getUcharPixel( base(x, y), c1);
 	}
 	else if (float_image)
-		getFloatPixel( (*float_image)(x, y), c1);
+		getFloatPixel( float_image->level(0)(x, y), c1);
 	return c1;
 }
 
@@ -118,6 +201,20 @@ CFLOAT textureImageIF_t::getFloat(const point3d_t &p) const
 	return getColor(p).energy();
 }
 
+std::string textureImageIF_t::sourceKey() const
+{
+	// the cache entry only knows the name, a file changed on disk must give a new key
+	struct stat st;
+	if(!cached || stat(cached->fileName().c_str(), &st) != 0) return std::string();
+	std::ostringstream key;
+	key << cached->fileName() << " " << (long long)st.st_size << " " << (long long)st.st_mtime
+		<< " " << (gammaLUT ? gammaLUT->getGamma() : 1.f) << " " << intp_type << " " << tex_clipmode
+		<< " " << xrepeat << " " << yrepeat << " " << rot90 << " " << use_alpha << " " << calc_alpha
+		<< " " << cropminx << " " << cropmaxx << " " << cropminy << " " << cropmaxy
+		<< " " << checker_odd << " " << checker_even << " " << checker_dist;
+	return key.str();
+}
+
 void textureImageIF_t::setGammaLUT(gammaLUT_t *lut)
 {
 	gammaLUT = lut;
@@ -243,8 +340,10 @@ texture_t *textureImage_t::factory(paraMap_t &params, renderEnvironment_t &rende
 	const std::string *name=&_name, *intp=&_intp;
 	double gamma = 1.0;
 	double expadj=0.0;
+	bool mipmap = true;
 	textureImage_t *tex = 0;
 	params.getParam("interpolate", intp);
+	params.getParam("mipmap", mipmap); // prefiltered lookups when the pixel footprint is known
 	params.getParam("gamma", gamma);
 	params.getParam("exposure_adjust", expadj);
 	if(!params.getParam("filename", name))
@@ -271,10 +370,12 @@ texture_t *textureImage_t::factory(paraMap_t &params, renderEnvironment_t &rende
 	cBuffer_t *image = 0;
 	fcBuffer_t *float_image = 0;
 	gBuf_t<rgbe_t, 1> *rgbe_image = 0;
+	cachedImage_t::imageLoader_t *loader = 0;
 
 	std::cout << "Loading image file " << filename << std::endl;
 
-	// try loading image using extension as indication of imagetype
+	// try loading image using extension as indication of imagetype; except for radiance files
+	// decoding is left to the texture cache
 	if (extp) {
 		std::string ext( extp );
 		for(unsigned int i=0; i<ext.size(); ++i) ext[i] = std::tolower(ext[i]);
@@ -288,7 +389,7 @@ texture_t *textureImage_t::factory(paraMap_t &params, renderEnvironment_t &rende
 		if ( (ext == ".jpg") || (ext == ".jpeg") )
 #ifdef HAVE_JPEG
 		{
-			image = load_jpeg(filename);
+			loader = jpegLoader;
 			jpg_tried = true;
 		}
 #else
@@ -298,7 +399,7 @@ texture_t *textureImage_t::factory(paraMap_t &params, renderEnvironment_t &rende
 		if(ext == ".png")
 #if HAVE_PNG
 		{
-			image = load_png(filename);
+			loader = pngLoader;
 			png_tried = true;
 		}
 #else
@@ -308,7 +409,7 @@ texture_t *textureImage_t::factory(paraMap_t &params, renderEnvironment_t &rende
 		if(ext == ".exr")
 #if HAVE_EXR
 		{
-			float_image = loadEXR(filename);
+			loader = exrLoader;
 			exr_tried = true;
 		}
 #else
@@ -318,13 +419,13 @@ texture_t *textureImage_t::factory(paraMap_t &params, renderEnvironment_t &rende
 			// targa, apparently, according to ps description, on mac tga extension can be .tpic
 		if( (ext == ".tga") || (ext == ".tpic") )
 		{
-			image = load_tga(filename);
+			loader = tgaLoader;
 			tga_tried = true;
 		}
 	}
 	// if none was able to load (or no extension), try every type until one or none succeeds
 	// targa last (targa has no ID)
-	if ((float_image==NULL) && (image==NULL)  && (rgbe_image==NULL)) {
+	if ((loader==NULL) && (rgbe_image==NULL)) {
 		std::cout << "unknown file extension, testing format...";
 		for(;;) {
 
@@ -376,9 +477,29 @@ texture_t *textureImage_t::factory(paraMap_t &params, renderEnvironment_t &rende
 
 	}
 	
-	if(image)
+	cachedImage_t *cached = 0;
+	if(loader)
+	{
+		// only make sure the file is there, it gets decoded when a ray first hits the texture.
+		// radiance files do not go through the cache, so catch them here despite their extension
+		FILE *fp = fopen(filename, "rb");
+		if(fp)
+		{
+			char sig[2] = { 0, 0 };
+			bool radiance = (fread(sig, 1, 2, fp) == 2) && sig[0] == '#' && sig[1] == '?';
+			fclose(fp);
+			if(radiance) rgbe_image = loadHDR(filename);
+			if(rgbe_image) std::cout << "identified as Radiance format!\n";
+			else cached = textureCache_t::instance().acquire(*name, mipmap, loader);
+		}
+		else std::cout << "File " << filename << " not found\n";
+	}
+	else if(image || float_image) cached = textureCache_t::instance().insert(*name, mipmap, image, float_image);
+
+	if(cached)
 	{
-		textureImageIF_t *itex = new textureImageIF_t(image, float_image, intp_type);
+		textureImageIF_t *itex = new textureImageIF_t(cached, intp_type);
+		// the format may not be known yet, float images simply ignore the LUT
 		if((std::abs(1.0 - gamma) > 0.01) )
 		{
 			std::cout << "creating gamma LUT\n";
@@ -386,7 +507,6 @@ texture_t *textureImage_t::factory(paraMap_t &params, renderEnvironment_t &rende
 		}
 		tex = itex;
 	}
-	else if(float_image) tex = new textureImageIF_t(image, float_image, intp_type);
 	else if(rgbe_image) tex = new RGBEtexture_t(rgbe_image, intp_type, expadj);
 	else{ std::cout << "Could not load image\n"; return 0; }
 	
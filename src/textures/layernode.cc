@@ -1,89 +1,27 @@
 
 #include <textures/layernode.h>
+#include <yafraycore/nodeops.h>
 
 __BEGIN_YAFRAY
 
-color_t texture_rgb_blend(const color_t &tex, const color_t &out, CFLOAT fact, CFLOAT facg, mix_modes blendtype);
-CFLOAT texture_value_blend(CFLOAT tex, CFLOAT out, CFLOAT fact, CFLOAT facg, mix_modes blendtype, bool flip);
-
 layerNode_t::layerNode_t(unsigned tflag, CFLOAT col_fac, CFLOAT val_fac, CFLOAT def_val, colorA_t def_col, mix_modes mmod):
-			input(0), upperLayer(0), texflag(tflag), colfac(col_fac), valfac(val_fac), default_val(def_val),
-			default_col(def_col), mode(mmod), do_color(false), do_scalar(false), color_input(false)
-{}
+			input(0), upperLayer(0)
+{
+	layer.texflag = tflag;
+	layer.mode = mmod;
+	layer.colfac = col_fac;
+	layer.valfac = val_fac;
+	layer.default_val = def_val;
+	layer.default_col = def_col;
+	layer.do_color = layer.do_scalar = layer.color_input = layer.use_alpha = false;
+}
 
 void layerNode_t::eval(nodeStack_t &stack, const renderState_t &state, const surfacePoint_t &sp)const
 {
-	colorA_t rcol, texcolor;
-	CFLOAT rval, Tin=0.f, Ta=1.f, stencilTin = 1.f;
 	// == get result of upper layer (or base values) ==
-	rcol = (upperLayer) ? upperLayer->getColor(stack) : upper_col;
-	rval = (upperLayer) ? upperLayer->getScalar(stack) : upper_val;
-	stencilTin = rcol.A;
-	
-	// == get texture input color ==
-	bool TEX_RGB = color_input;
-	if(color_input)
-	{
-		texcolor = input->getColor(stack);
-		//Tin=texcolor.energy();
-		Ta=texcolor.A;
-	}
-	else Tin = input->getScalar(stack);
-	//bool Talpha = true;
-	
-	if(texflag & TXF_RGBTOINT){
-		Tin = 0.35f*texcolor.getR() + 0.45f*texcolor.getG() + 0.2f*texcolor.getB();
-		TEX_RGB = false;
-	}
-	if(texflag & TXF_NEGATIVE){
-		if (TEX_RGB) texcolor = colorA_t(1.f)-texcolor;
-		Tin = 1.f-Tin;
-	}
-	CFLOAT fact;
-	if(texflag & TXF_STENCIL)
-	{
-		if(TEX_RGB) // only scalar input affects stencil...?
-		{
-			fact = Ta;
-			Ta *= stencilTin;
-			stencilTin *= fact;
-		}
-		else
-		{
-			fact = Tin;
-			Tin *= stencilTin;
-			stencilTin *= fact;
-		}
-	}
-	
-	// color type modulation
-	if (do_color)
-	{
-		if(!TEX_RGB)	texcolor = default_col;
-		else			Tin = Ta;
-		
-		rcol = texture_rgb_blend(texcolor, rcol, Tin, stencilTin * colfac, mode);
-		rcol.clampRGB0();
-	}
-	
-	// intensity type modulation
-	if (do_scalar)
-	{
-		if(TEX_RGB)
-		{
-			if(use_alpha)
-			{
-				Tin = Ta;
-				if(texflag & TXF_NEGATIVE) Tin = 1.f - Tin;
-			}
-			else Tin = 0.35f*texcolor.getR() + 0.45f*texcolor.getG() + 0.2f*texcolor.getB();
-		}
-		
-		rval = texture_value_blend(default_val, rval, Tin, stencilTin * valfac, mode, (do_scalar<0));
-		if(rval<0.f) rval=0.f;
-	}
-	rcol.A = stencilTin;
-	stack[this->ID] = nodeResult_t(rcol, rval);
+	colorA_t rcol = (upperLayer) ? upperLayer->getColor(stack) : upper_col;
+	CFLOAT rval = (upperLayer) ? upperLayer->getScalar(stack) : upper_val;
+	stack[this->ID] = layerNodeResult(layer, rcol, rval, stack(input->ID));
 }
 
 void layerNode_t::eval(nodeStack_t &stack, const renderState_t &state, const surfacePoint_t &sp, const vector3d_t &wo, const vector3d_t &wi)const
@@ -109,7 +47,7 @@ void layerNode_t::evalDerivative(nodeStack_t &stack, const renderState_t &state,
 	tdu = texcolor.R;
 	tdv = texcolor.G;
 	
-	if(texflag & TXF_NEGATIVE)
+	if(layer.texflag & TXF_NEGATIVE)
 	{
 		tdu = -tdu;
 		tdv = -tdv;
@@ -150,6 +88,17 @@ bool layerNode_t::isViewDependant() const
 	return viewDep;
 }
 
+bool layerNode_t::compile(nodeInstr_t &instr) const
+{
+	instr.op = nodeInstr_t::OP_LAYER;
+	instr.in[0] = input->ID;
+	instr.in[1] = upperLayer ? (int)upperLayer->ID : -1;
+	instr.col[1] = upper_col;
+	instr.val[1] = upper_val;
+	instr.layer = layer;
+	return true;
+}
+
 bool layerNode_t::configInputs(const paraMap_t &params, const nodeFinder_t &find)
 {
 	const std::string *name=0;
@@ -219,117 +168,12 @@ shaderNode_t* layerNode_t::factory(const paraMap_t &params,renderEnvironment_t &
 	if(use_alpha) flags |= TXF_ALPHAMIX;
 	
 	layerNode_t *node = new layerNode_t(flags, colfac, valfac, def_val, def_col, (mix_modes)mode);
-	node->do_color = do_color;
-	node->do_scalar = do_scalar;
-	node->color_input = color_input;
-	node->use_alpha = use_alpha;
+	node->layer.do_color = do_color;
+	node->layer.do_scalar = do_scalar;
+	node->layer.color_input = color_input;
+	node->layer.use_alpha = use_alpha;
 	
 	return node;
 }
 
-//////////////////
-
-
-color_t texture_rgb_blend(const color_t &tex, const color_t &out, CFLOAT fact, CFLOAT facg, mix_modes blendtype)
-{
-	
-	switch(blendtype) {
-		case MN_MULT:
-			fact *= facg;
-			return (color_t(1.f-facg) + fact*tex)*out;
-
-		case MN_SCREEN: {
-			color_t white(1.0);
-			fact *= facg;
-			return white - (color_t(1.f-facg) + fact*(white-tex)) * (white-out);
-		}
-
-		case MN_SUB:
-			fact = -fact;
-		case MN_ADD:
-			fact *= facg;
-			return fact*tex + out;
-
-		case MN_DIV: {
-			fact *= facg;
-			color_t itex(tex);
-			itex.invertRGB();
-			return (1.f-fact)*out + fact*out*itex;
-		}
-
-		case MN_DIFF: {
-			fact *= facg;
-			color_t tmo(tex-out);
-			tmo.absRGB();
-			return (1.f-fact)*out + fact*tmo;
-		}
-
-		case MN_DARK: {
-			fact *= facg;
-			color_t col(fact*tex);
-			col.darkenRGB(out);
-			return col;
-		}
-
-		case MN_LIGHT: {
-			fact *= facg;
-			color_t col(fact*tex);
-			col.lightenRGB(out);
-			return col;
-		}
-
-		default:
-		case MN_MIX:
-			fact *= facg;
-			return fact*tex + (1.f-fact)*out;
-	}
-
-}
-
-CFLOAT texture_value_blend(CFLOAT tex, CFLOAT out, CFLOAT fact, CFLOAT facg, mix_modes blendtype, bool flip)
-{
-	fact *= facg;
-	CFLOAT facm = 1.f-fact;
-	if (flip) std::swap(fact, facm);
-
-	switch(blendtype) {
-		case MN_MULT:
-			facm = 1.f-facg;
-			return (facm+fact*tex)*out;
-
-		case MN_SCREEN:
-			facm = 1.f-facg;
-			return 1.f-(facm+fact*(1.f-tex))*(1.f-out);
-
-		case MN_SUB:
-			fact = -fact;
-		case MN_ADD:
-			return fact*tex + out;
-
-		case MN_DIV:
-			if (tex==0.f) return 0.f;
-			return facm*out + fact*out/tex;
-
-		case MN_DIFF:
-			return facm*out + fact*fabs(tex-out);
-
-		case MN_DARK: {
-			CFLOAT col = fact*tex;
-			if (col<out) return col;
-			return out;
-		}
-
-		case MN_LIGHT: {
-			CFLOAT col = fact*tex;
-			if (col>out) return col;
-			return out;
-		}
-
-		default:
-		case MN_MIX:
-			return fact*tex + facm*out;
-	}
-}
-
-
 __END_YAFRAY
@@ -1,5 +1,11 @@
 #include <textures/noise.h>
 
+// MSVC offers the SSE2 intrinsics on every x86 target
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_IX86)
+	#define NOISE_SSE2 1
+	#include <emmintrin.h>
+#endif
+
 __BEGIN_YAFRAY
 
 // needed for voronoi
@@ -155,6 +161,49 @@ static float hashvectf[768]= {
 
 #define lerp(t, a, b) ((a)+(t)*((b)-(a)))
 
+#if NOISE_SSE2
+//------------------------------------------------------------------------------------
+// SIMD helpers, 4 points per register. Operations are done in the same order as
+// in the scalar versions, so batch() gives the same results as operator().
+
+#define lerp4(t, a, b) _mm_add_ps((a), _mm_mul_ps((t), _mm_sub_ps((b), (a))))
+
+static inline __m128 floor4(__m128 x)
+{
+	__m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+	return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, x), _mm_set1_ps(1.f)));
+}
+
+static inline void load4(const point3d_t *pt, __m128 &x, __m128 &y, __m128 &z)
+{
+	x = _mm_set_ps(pt[3].x, pt[2].x, pt[1].x, pt[0].x);
+	y = _mm_set_ps(pt[3].y, pt[2].y, pt[1].y, pt[0].y);
+	z = _mm_set_ps(pt[3].z, pt[2].z, pt[1].z, pt[0].z);
+}
+
+static inline __m128 select4(__m128 mask, __m128 a, __m128 b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+typedef void (noise4Func)(const point3d_t *pt, PFLOAT *res);
+
+//! runs a 4 point kernel over n points; a partial last group is padded, that is still cheaper than scalar code
+static void batch4(noise4Func *f, const point3d_t *pt, PFLOAT *res, int n)
+{
+	int i=0;
+	for(; i+4<=n; i+=4) f(pt+i, res+i);
+	if(i < n)
+	{
+		point3d_t p4[4];
+		PFLOAT r4[4];
+		for(int k=0; k<4; ++k) p4[k] = pt[std::min(i+k, n-1)];
+		f(p4, r4);
+		for(int k=0; i<n; ++k, ++i) res[i] = r4[k];
+	}
+}
+#endif
+
 //------------------------------------------------------------------------------------
 // New Perlin noise
 
@@ -182,6 +231,77 @@ PFLOAT newPerlin_t::operator() (const point3d_t &pt) const
 	return (0.5 + 0.5*nv);
 }
 
+#if NOISE_SSE2
+static inline __m128 fade4(__m128 t)
+{
+	// t*t*t*(t*(t*6 - 15) + 10)
+	__m128 p = _mm_add_ps(_mm_mul_ps(t, _mm_sub_ps(_mm_mul_ps(t, _mm_set1_ps(6.f)), _mm_set1_ps(15.f))), _mm_set1_ps(10.f));
+	return _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(t, t), t), p);
+}
+
+static inline __m128 grad4(__m128i hash, __m128 x, __m128 y, __m128 z)
+{
+	__m128i h = _mm_and_si128(hash, _mm_set1_epi32(15));
+	__m128 u = select4(_mm_castsi128_ps(_mm_cmplt_epi32(h, _mm_set1_epi32(8))), x, y);
+	__m128 xz = select4(_mm_castsi128_ps(_mm_or_si128(_mm_cmpeq_epi32(h, _mm_set1_epi32(12)),
+												_mm_cmpeq_epi32(h, _mm_set1_epi32(14)))), x, z);
+	__m128 v = select4(_mm_castsi128_ps(_mm_cmplt_epi32(h, _mm_set1_epi32(4))), y, xz);
+	// flip the sign bit where bit 0 resp. 1 of the hash is set
+	__m128i sign = _mm_set1_epi32(0x80000000);
+	__m128 su = _mm_castsi128_ps(_mm_and_si128(_mm_cmpeq_epi32(_mm_and_si128(h, _mm_set1_epi32(1)), _mm_set1_epi32(1)), sign));
+	__m128 sv = _mm_castsi128_ps(_mm_and_si128(_mm_cmpeq_epi32(_mm_and_si128(h, _mm_set1_epi32(2)), _mm_set1_epi32(2)), sign));
+	return _mm_add_ps(_mm_xor_ps(u, su), _mm_xor_ps(v, sv));
+}
+
+static void newPerlin4(const point3d_t *pt, PFLOAT *res)
+{
+	__m128 x, y, z;
+	load4(pt, x, y, z);
+	__m128 fx = floor4(x), fy = floor4(y), fz = floor4(z);
+	int X[4], Y[4], Z[4];
+	__m128i mask = _mm_set1_epi32(255);
+	_mm_storeu_si128((__m128i*)X, _mm_and_si128(_mm_cvttps_epi32(fx), mask));
+	_mm_storeu_si128((__m128i*)Y, _mm_and_si128(_mm_cvttps_epi32(fy), mask));
+	_mm_storeu_si128((__m128i*)Z, _mm_and_si128(_mm_cvttps_epi32(fz), mask));
+	x = _mm_sub_ps(x, fx);
+	y = _mm_sub_ps(y, fy);
+	z = _mm_sub_ps(z, fz);
+	__m128 u = fade4(x), v = fade4(y), w = fade4(z);
+	// the permutation table lookups stay scalar, SSE2 has no gather
+	int hc[8][4];
+	for(int l=0; l<4; ++l)
+	{
+		int A=hash[X[l]  ]+Y[l], AA=hash[A]+Z[l], AB=hash[A+1]+Z[l],
+		    B=hash[X[l]+1]+Y[l], BA=hash[B]+Z[l], BB=hash[B+1]+Z[l];
+		hc[0][l] = hash[AA];   hc[1][l] = hash[BA];   hc[2][l] = hash[AB];   hc[3][l] = hash[BB];
+		hc[4][l] = hash[AA+1]; hc[5][l] = hash[BA+1]; hc[6][l] = hash[AB+1]; hc[7][l] = hash[BB+1];
+	}
+	__m128 one = _mm_set1_ps(1.f);
+	__m128 x1 = _mm_sub_ps(x, one), y1 = _mm_sub_ps(y, one), z1 = _mm_sub_ps(z, one);
+	__m128 g0 = grad4(_mm_loadu_si128((__m128i*)hc[0]), x , y , z );
+	__m128 g1 = grad4(_mm_loadu_si128((__m128i*)hc[1]), x1, y , z );
+	__m128 g2 = grad4(_mm_loadu_si128((__m128i*)hc[2]), x , y1, z );
+	__m128 g3 = grad4(_mm_loadu_si128((__m128i*)hc[3]), x1, y1, z );
+	__m128 g4 = grad4(_mm_loadu_si128((__m128i*)hc[4]), x , y , z1);
+	__m128 g5 = grad4(_mm_loadu_si128((__m128i*)hc[5]), x1, y , z1);
+	__m128 g6 = grad4(_mm_loadu_si128((__m128i*)hc[6]), x , y1, z1);
+	__m128 g7 = grad4(_mm_loadu_si128((__m128i*)hc[7]), x1, y1, z1);
+	__m128 nv = lerp4(w, lerp4(v, lerp4(u, g0, g1), lerp4(u, g2, g3)),
+						 lerp4(v, lerp4(u, g4, g5), lerp4(u, g6, g7)));
+	__m128 half = _mm_set1_ps(0.5f);
+	_mm_storeu_ps(res, _mm_add_ps(half, _mm_mul_ps(half, nv)));
+}
+#endif
+
+void newPerlin_t::batch(const point3d_t *pt, PFLOAT *res, int n) const
+{
+#if NOISE_SSE2
+	batch4(newPerlin4, pt, res, n);
+#else
+	noiseGenerator_t::batch(pt, res, n);
+#endif
+}
+
 //------------------------------------------------------------------------------------
 // Standard (old) Perlin noise
 
@@ -456,6 +576,81 @@ PFLOAT blenderNoise_t::operator() (const point3d_t &pt) const
 	return n;
 }
 
+#if NOISE_SSE2
+// 1 - 3*c + 2*c*o resp. 1 - 3*c - 2*c*o with c = o*o; like the scalar code this is done in double
+static inline __m128d blendCurve2(__m128d c, __m128d o, bool neg)
+{
+	__m128d a = _mm_sub_pd(_mm_set1_pd(1.0), _mm_mul_pd(_mm_set1_pd(3.0), c));
+	__m128d b = _mm_mul_pd(_mm_mul_pd(_mm_set1_pd(2.0), c), o);
+	return neg ? _mm_sub_pd(a, b) : _mm_add_pd(a, b);
+}
+
+static inline __m128 blendCurve4(__m128 o, bool neg)
+{
+	__m128 c = _mm_mul_ps(o, o);
+	__m128d lo = blendCurve2(_mm_cvtps_pd(c), _mm_cvtps_pd(o), neg);
+	__m128d hi = blendCurve2(_mm_cvtps_pd(_mm_movehl_ps(c, c)), _mm_cvtps_pd(_mm_movehl_ps(o, o)), neg);
+	return _mm_movelh_ps(_mm_cvtpd_ps(lo), _mm_cvtpd_ps(hi));
+}
+
+static void blenderNoise4(const point3d_t *pt, PFLOAT *res)
+{
+	__m128 x, y, z;
+	load4(pt, x, y, z);
+	__m128 fx = floor4(x), fy = floor4(y), fz = floor4(z);
+	int ix[4], iy[4], iz[4];
+	_mm_storeu_si128((__m128i*)ix, _mm_cvttps_epi32(fx));
+	_mm_storeu_si128((__m128i*)iy, _mm_cvttps_epi32(fy));
+	_mm_storeu_si128((__m128i*)iz, _mm_cvttps_epi32(fz));
+	__m128 one = _mm_set1_ps(1.f);
+	__m128 ox = _mm_sub_ps(x, fx), oy = _mm_sub_ps(y, fy), oz = _mm_sub_ps(z, fz);
+	__m128 jx = _mm_sub_ps(ox, one), jy = _mm_sub_ps(oy, one), jz = _mm_sub_ps(oz, one);
+	__m128 cn1 = blendCurve4(ox, false), cn2 = blendCurve4(oy, false), cn3 = blendCurve4(oz, false);
+	__m128 cn4 = blendCurve4(jx, true), cn5 = blendCurve4(jy, true), cn6 = blendCurve4(jz, true);
+	// gradients of the 8 corners, in the order of the scalar code
+	float h[8][3][4];
+	for(int l=0; l<4; ++l)
+	{
+		int b00= hash[ hash[ix[l] & 255]+(iy[l] & 255)];
+		int b10= hash[ hash[(ix[l]+1) & 255]+(iy[l] & 255)];
+		int b01= hash[ hash[ix[l] & 255]+((iy[l]+1) & 255)];
+		int b11= hash[ hash[(ix[l]+1) & 255]+((iy[l]+1) & 255)];
+		int b20=iz[l] & 255, b21= (iz[l]+1) & 255;
+		const int corner[8] = { b20+b00, b21+b00, b20+b01, b21+b01, b20+b10, b21+b10, b20+b11, b21+b11 };
+		for(int c=0; c<8; ++c)
+		{
+			const float *hv = hashvectf + 3*hash[corner[c]];
+			h[c][0][l] = hv[0]; h[c][1][l] = hv[1]; h[c][2][l] = hv[2];
+		}
+	}
+	const __m128 cx[8] = { ox, ox, ox, ox, jx, jx, jx, jx };
+	const __m128 cy[8] = { oy, oy, jy, jy, oy, oy, jy, jy };
+	const __m128 cz[8] = { oz, jz, oz, jz, oz, jz, oz, jz };
+	const __m128 wx[8] = { cn1, cn1, cn1, cn1, cn4, cn4, cn4, cn4 };
+	const __m128 wy[8] = { cn2, cn2, cn5, cn5, cn2, cn2, cn5, cn5 };
+	const __m128 wz[8] = { cn3, cn6, cn3, cn6, cn3, cn6, cn3, cn6 };
+	__m128 n = _mm_set1_ps(0.5f);
+	for(int c=0; c<8; ++c)
+	{
+		__m128 i = _mm_mul_ps(_mm_mul_ps(wx[c], wy[c]), wz[c]);
+		__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(h[c][0]), cx[c]), _mm_mul_ps(_mm_loadu_ps(h[c][1]), cy[c])),
+								_mm_mul_ps(_mm_loadu_ps(h[c][2]), cz[c]));
+		n = _mm_add_ps(n, _mm_mul_ps(i, d));
+	}
+	n = _mm_min_ps(_mm_max_ps(n, _mm_setzero_ps()), one);
+	_mm_storeu_ps(res, n);
+}
+#endif
+
+void blenderNoise_t::batch(const point3d_t *pt, PFLOAT *res, int n) const
+{
+#if NOISE_SSE2
+	batch4(blenderNoise4, pt, res, n);
+#else
+	noiseGenerator_t::batch(pt, res, n);
+#endif
+}
+
 //------------------------------------------------------------------------------------
 // Voronoi/Worley/Celullar basis
 
@@ -543,11 +738,8 @@ void voronoi_t::getFeatures(const point3d_t &pt, PFLOAT da[4], point3d_t pa[4])
 	}
 }
 
-PFLOAT voronoi_t::operator() (const point3d_t &pt) const
+PFLOAT voronoi_t::featureValue(const PFLOAT da[4]) const
 {
-	PFLOAT da[4];
-	point3d_t pa[4];
-	getFeatures(pt, da, pa);
 	switch (vType) {
 		case V_F2:
 			return da[1];
@@ -567,6 +759,96 @@ PFLOAT voronoi_t::operator() (const point3d_t &pt) const
 	}
 }
 
+PFLOAT voronoi_t::operator() (const point3d_t &pt) const
+{
+	PFLOAT da[4];
+	point3d_t pa[4];
+	getFeatures(pt, da, pa);
+	return featureValue(da);
+}
+
+#if NOISE_SSE2
+/*! the 4 smallest feature distances of 4 points. Instead of the scalar insertion every
+	distance is sorted in with a min/max chain, which yields the same distances */
+static void voronoiDist4(const point3d_t *pt, int metric, PFLOAT res[4][4])
+{
+	__m128 x, y, z;
+	load4(pt, x, y, z);
+	int xi[4], yi[4], zi[4];
+	_mm_storeu_si128((__m128i*)xi, _mm_cvttps_epi32(floor4(x)));
+	_mm_storeu_si128((__m128i*)yi, _mm_cvttps_epi32(floor4(y)));
+	_mm_storeu_si128((__m128i*)zi, _mm_cvttps_epi32(floor4(z)));
+	__m128 da[4];
+	da[0] = da[1] = da[2] = da[3] = _mm_set1_ps(1e10f);
+	__m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	for (int xx=-1;xx<=1;xx++) {
+		for (int yy=-1;yy<=1;yy++) {
+			for (int zz=-1;zz<=1;zz++) {
+				float fp[3][4];
+				for(int l=0; l<4; ++l)
+				{
+					int cx = xi[l]+xx, cy = yi[l]+yy, cz = zi[l]+zz;
+					float *p = HASHPNT(cx, cy, cz);
+					fp[0][l] = p[0] + cx; fp[1][l] = p[1] + cy; fp[2][l] = p[2] + cz;
+				}
+				__m128 xd = _mm_sub_ps(x, _mm_loadu_ps(fp[0]));
+				__m128 yd = _mm_sub_ps(y, _mm_loadu_ps(fp[1]));
+				__m128 zd = _mm_sub_ps(z, _mm_loadu_ps(fp[2]));
+				__m128 d;
+				if(metric == voronoi_t::DIST_CHEBYCHEV)
+				{
+					xd = _mm_and_ps(xd, absMask); yd = _mm_and_ps(yd, absMask); zd = _mm_and_ps(zd, absMask);
+					d = _mm_max_ps(zd, _mm_max_ps(xd, yd));
+				}
+				else
+				{
+					d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(xd, xd), _mm_mul_ps(yd, yd)), _mm_mul_ps(zd, zd));
+					if(metric == voronoi_t::DIST_REAL) d = _mm_sqrt_ps(d);
+				}
+				for(int k=0; k<4; ++k)
+				{
+					__m128 t = _mm_min_ps(da[k], d);
+					d = _mm_max_ps(da[k], d);
+					da[k] = t;
+				}
+			}
+		}
+	}
+	for(int k=0; k<4; ++k) _mm_storeu_ps(res[k], da[k]);
+}
+#endif
+
+void voronoi_t::batch(const point3d_t *pt, PFLOAT *res, int n) const
+{
+	int i=0;
+#if NOISE_SSE2
+	// manhattan is mapped to the squared distance by setDistM()
+	int metric = (dmType == DIST_MANHATTAN) ? DIST_SQUARED : dmType;
+	if(metric == DIST_REAL || metric == DIST_SQUARED || metric == DIST_CHEBYCHEV)
+	{
+		PFLOAT d4[4][4];
+		point3d_t p4[4];
+		for(; i<n; i+=4)
+		{
+			// pad a partial last group like batch4()
+			const point3d_t *p = pt+i;
+			if(i+4 > n)
+			{
+				for(int k=0; k<4; ++k) p4[k] = pt[std::min(i+k, n-1)];
+				p = p4;
+			}
+			voronoiDist4(p, metric, d4);
+			for(int l=0; l<4 && i+l<n; ++l)
+			{
+				PFLOAT da[4] = { d4[0][l], d4[1][l], d4[2][l], d4[3][l] };
+				res[i+l] = featureValue(da);
+			}
+		}
+	}
+#endif
+	for(; i<n; ++i) res[i] = (*this)(pt[i]);
+}
+
 // Cell noise
 PFLOAT cellNoise_t::operator() (const point3d_t &pt) const
 {
@@ -578,6 +860,44 @@ PFLOAT cellNoise_t::operator() (const point3d_t &pt) const
   return ((PFLOAT)(n*(n*n*15731 + 789221) + 1376312589) / 4294967296.0);
 }
 
+//------------------------------------------------------------------------------------
+// Octaves for the fractal functions
+
+/*! Noise values of successive octaves, the point being scaled by the lacunarity from one
+	octave to the next. The points do not depend on the noise values, so up to 8 octaves
+	are handed to noiseGenerator_t::batch() at once. Octaves have to be read in order. */
+class octaveNoise_t
+{
+	public:
+		octaveNoise_t(const noiseGenerator_t *gen, const point3d_t &pt, PFLOAT lacu, int octaves):
+			nGen(gen), tp(pt), lacunarity(lacu), total(octaves), first(0), count(0) {}
+		PFLOAT operator[](int i)
+		{
+			if(i >= first+count) fill(i);
+			return val[i-first];
+		}
+		//! same as getSignedNoise()
+		PFLOAT sgn(int i) { return (PFLOAT)2.0 * (*this)[i] - (PFLOAT)1.0; }
+	protected:
+		void fill(int i)
+		{
+			first = i;
+			count = std::max(1, std::min(8, total-i));
+			for(int k=0; k<count; ++k)
+			{
+				pts[k] = tp;
+				tp *= lacunarity;
+			}
+			nGen->batch(pts, val, count);
+		}
+		const noiseGenerator_t *nGen;
+		point3d_t tp;
+		PFLOAT lacunarity;
+		int total, first, count;
+		point3d_t pts[8];
+		PFLOAT val[8];
+};
+
 //------------------------------------------------------------------------------------
 // Musgrave
 
@@ -596,14 +916,14 @@ PFLOAT cellNoise_t::operator() (const point3d_t &pt) const
 PFLOAT fBm_t::operator() (const point3d_t &pt) const
 {
 	PFLOAT value=0, pwr=1, pwHL=pow(lacunarity, -H);
-	point3d_t tp(pt);
-	for (int i=0; i<(int)octaves; i++) {
-		value += getSignedNoise(nGen, tp) * pwr;
+	PFLOAT rmd = octaves - floor(octaves);
+	int oct = (int)octaves;
+	octaveNoise_t noise(nGen, pt, lacunarity, oct + (rmd!=0.f));
+	for (int i=0; i<oct; i++) {
+		value += noise.sgn(i) * pwr;
 		pwr *= pwHL;
-		tp *= lacunarity;
 	}
-	PFLOAT rmd = octaves - floor(octaves);
-	if (rmd!=0.f) value += rmd * getSignedNoise(nGen, tp) * pwr;
+	if (rmd!=0.f) value += rmd * noise.sgn(oct) * pwr;
 	return value;
 }
 
@@ -624,14 +944,14 @@ PFLOAT fBm_t::operator() (const point3d_t &pt) const
 PFLOAT mFractal_t::operator() (const point3d_t &pt) const
 {
 	PFLOAT value=1, pwr=1, pwHL=pow(lacunarity, -H);
-	point3d_t tp(pt);
-	for (int i=0; i<(int)octaves; i++) {
-		value *= (pwr*getSignedNoise(nGen, tp) + (PFLOAT)1.0);
+	PFLOAT rmd = octaves - floor(octaves);
+	int oct = (int)octaves;
+	octaveNoise_t noise(nGen, pt, lacunarity, oct + (rmd!=(PFLOAT)0.0));
+	for (int i=0; i<oct; i++) {
+		value *= (pwr*noise.sgn(i) + (PFLOAT)1.0);
 		pwr *= pwHL;
-		tp *= lacunarity;
 	}
-	PFLOAT rmd = octaves - floor(octaves);
-	if (rmd!=(PFLOAT)0.0) value *= (rmd * getSignedNoise(nGen, tp) * pwr + (PFLOAT)1.0);
+	if (rmd!=(PFLOAT)0.0) value *= (rmd * noise.sgn(oct) * pwr + (PFLOAT)1.0);
 	return value;
 }
 
@@ -650,22 +970,21 @@ PFLOAT heteroTerrain_t::operator() (const point3d_t &pt) const
 {
 	PFLOAT pwHL = pow(lacunarity, -H);
 	PFLOAT pwr = pwHL;	// starts with i=1 instead of 0
-	point3d_t tp(pt);
+	PFLOAT rmd = octaves - floor(octaves);
+	int oct = std::max(1, (int)octaves);
+	octaveNoise_t noise(nGen, pt, lacunarity, oct + (rmd!=(PFLOAT)0.0));
 
 	// first unscaled octave of function; later octaves are scaled
-	PFLOAT value = offset + getSignedNoise(nGen, tp);
-	tp *= lacunarity;
+	PFLOAT value = offset + noise.sgn(0);
 	PFLOAT increment;
-	for (int i=1; i<(int)octaves; i++) {
-		increment = (getSignedNoise(nGen, tp) + offset) * pwr * value;
+	for (int i=1; i<oct; i++) {
+		increment = (noise.sgn(i) + offset) * pwr * value;
 		value += increment;
 		pwr *= pwHL;
-		tp *= lacunarity;
 	}
 
-	PFLOAT rmd = octaves - floor(octaves);
 	if (rmd!=(PFLOAT)0.0) {
-		increment = (getSignedNoise(nGen, tp) + offset) * pwr * value;
+		increment = (noise.sgn(oct) + offset) * pwr * value;
 		value += rmd * increment;
 	}
 
@@ -684,23 +1003,24 @@ PFLOAT hybridMFractal_t::operator() (const point3d_t &pt) const
 {
 	PFLOAT pwHL = pow(lacunarity, -H);
 	PFLOAT pwr = pwHL;	// starts with i=1 instead of 0
-	point3d_t tp(pt);
+	PFLOAT rmd = octaves - floor(octaves);
+	int oct = std::max(1, (int)octaves);
+	octaveNoise_t noise(nGen, pt, lacunarity, oct + (rmd!=(PFLOAT)0.0));
 
-	PFLOAT result = getSignedNoise(nGen, tp) + offset;
+	PFLOAT result = noise.sgn(0) + offset;
 	PFLOAT weight = gain * result;
-	tp *= lacunarity;
 
-	for (int i=1; (weight>(PFLOAT)0.001) && (i<(int)octaves); i++) {
+	int i=1;
+	for (; (weight>(PFLOAT)0.001) && (i<oct); i++) {
 		if (weight>(PFLOAT)1.0)  weight=(PFLOAT)1.0;
-		PFLOAT signal = (getSignedNoise(nGen, tp) + offset) * pwr;
+		PFLOAT signal = (noise.sgn(i) + offset) * pwr;
 		pwr *= pwHL;
 		result += weight * signal;
 		weight *= gain * signal;
-		tp *= lacunarity;
 	}
 
-	PFLOAT rmd = octaves - floor(octaves);
-	if (rmd!=(PFLOAT)0.0) result += rmd * ((getSignedNoise(nGen, tp) + offset) * pwr);
+	// the remainder uses the octave after the last one evaluated
+	if (rmd!=(PFLOAT)0.0) result += rmd * ((noise.sgn(i) + offset) * pwr);
 
 	return result;
 
@@ -719,18 +1039,18 @@ PFLOAT ridgedMFractal_t::operator() (const point3d_t &pt) const
 {
 	PFLOAT pwHL = pow(lacunarity, -H);
 	PFLOAT pwr = pwHL;	// starts with i=1 instead of 0
-	point3d_t tp(pt);
+	int oct = std::max(1, (int)octaves);
+	octaveNoise_t noise(nGen, pt, lacunarity, oct);
 
-	PFLOAT signal = offset - fabs(getSignedNoise(nGen, tp));
+	PFLOAT signal = offset - fabs(noise.sgn(0));
 	signal *= signal;
 	PFLOAT result = signal;
 	PFLOAT weight = 1.0;
 
-	for(int i=1; i<(int)octaves; i++ ) {
-		tp *= lacunarity;
+	for(int i=1; i<oct; i++ ) {
 		weight = signal * gain;
 		if (weight>(PFLOAT)1.0) weight=(PFLOAT)1.0; else if (weight<(PFLOAT)0.0) weight=(PFLOAT)0.0;
-		signal = offset - fabs(getSignedNoise(nGen, tp));
+		signal = offset - fabs(noise.sgn(i));
 		signal *= signal;
 		signal *= weight;
 		result += signal * pwr;
@@ -758,9 +1078,9 @@ colorA_t cellNoiseColor(const point3d_t &pt)
 CFLOAT turbulence(const noiseGenerator_t* ngen, const point3d_t &pt, int oct, PFLOAT size, bool hard)
 {
 	PFLOAT val, amp=1, sum=0;
-	point3d_t tp = ngen->offset(pt)*size;	// only blendernoise adds offset
-	for (int i=0;i<=oct;i++, amp*=0.5, tp*=2.0) {
-		val = (*ngen)(tp);
+	octaveNoise_t noise(ngen, ngen->offset(pt)*size, 2.0, oct+1);	// only blendernoise adds offset
+	for (int i=0;i<=oct;i++, amp*=0.5) {
+		val = noise[i];
 		if (hard) val = fabs(2.0*val-1.0);
 		sum += amp*val;
 	}
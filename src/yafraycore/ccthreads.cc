@@ -102,6 +102,16 @@ void conditionVar_t::signal()
 #endif
 }
 
+void conditionVar_t::broadcast()
+{
+#if HAVE_PTHREAD
+	if(pthread_cond_broadcast(&c))
+	{
+		throw std::runtime_error("Error condition broadcast");
+	}	
+#endif
+}
+
 void conditionVar_t::wait()
 {
 #if HAVE_PTHREAD
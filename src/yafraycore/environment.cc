@@ -460,6 +460,9 @@ imageFilm_t* renderEnvironment_t::createImageFilm(const paraMap_t &params, color
 	int width=320, height=240, xstart=0, ystart=0;
 	float filt_sz = 1.5, gamma=1.f;
 	bool clamp = false;
+	bool varianceAA = false;
+	bool streamTiles = false;
+	bool deterministic = false;
 	
 	params.getParam("gamma", gamma);
 	params.getParam("clamp_rgb", clamp);
@@ -469,6 +472,9 @@ imageFilm_t* renderEnvironment_t::createImageFilm(const paraMap_t &params, color
 	params.getParam("xstart", xstart); // x-offset (for cropped rendering)
 	params.getParam("ystart", ystart); // y-offset (for cropped rendering)
 	params.getParam("filter_type", name); // AA filter type
+	params.getParam("AA_variance", varianceAA); // adaptive AA driven by per pixel variance
+	params.getParam("stream_tiles", streamTiles); // write finished tile rows instead of keeping the image
+	params.getParam("deterministic", deterministic); // same result for any number of threads
 	
 	imageFilm_t::filterType type=imageFilm_t::BOX;
 	if(name)
@@ -480,6 +486,9 @@ imageFilm_t* renderEnvironment_t::createImageFilm(const paraMap_t &params, color
 	
 	imageFilm_t *film = new imageFilm_t(width, height, xstart, ystart, output, filt_sz, type, &(*this));
 	film->setClamp(clamp);
+	film->setVarianceAA(varianceAA);
+	film->setStreaming(streamTiles);
+	film->setDeterministic(deterministic);
 	if(gamma > 0 && std::fabs(1.f-gamma) > 0.001) film->setGamma(gamma, true);
 	return film;
 }
@@ -550,7 +559,7 @@ VolumeRegion* renderEnvironment_t::createVolumeRegion(const std::string &name, p
 bool renderEnvironment_t::setupScene(scene_t &scene, const paraMap_t &params, colorOutput_t &output)
 {
 	const std::string *name=0;
-	int AA_passes=1, AA_samples=1, AA_inc_samples=1, nthreads=1;
+	int AA_passes=1, AA_samples=1, AA_inc_samples=1, nthreads=1, seed=0;
 	double AA_threshold=0.05;
 	bool z_chan = false;
 	
@@ -577,6 +586,7 @@ bool renderEnvironment_t::setupScene(scene_t &scene, const paraMap_t &params, co
 	params.getParam("AA_inc_samples", AA_inc_samples);
 	params.getParam("AA_threshold", AA_threshold);
 	params.getParam("threads", nthreads); // number of threads
+	params.getParam("seed", seed); // key of the random number streams
 	params.getParam("z_channel", z_chan); // render z-buffer
 	
 	imageFilm_t *film = createImageFilm(params, output);
@@ -590,6 +600,7 @@ bool renderEnvironment_t::setupScene(scene_t &scene, const paraMap_t &params, co
 	scene.setVolIntegrator((volumeIntegrator_t*)volInte);
 	scene.setAntialiasing(AA_samples, AA_passes, AA_inc_samples, AA_threshold);
 	scene.setNumThreads(nthreads);
+	scene.setSeed(seed);
 	if(backg) scene.setBackground(backg);
 	
 	return true;
@@ -3,6 +3,7 @@
 #include <utilities/math_utils.h>
 //#include <utilities/tiled_array.h>
 #include <yafraycore/timer.h>
+#include <yafraycore/rendertrace.h>
 #include <yaf_revision.h>
 #include <cstring>
 #include <string>
@@ -22,6 +23,9 @@ __BEGIN_YAFRAY
 
 #define FILTER_TABLE_SIZE 16
 #define MAX_FILTER_SIZE 8
+#define SPLIT_BLOCK_SIZE 32
+//! tile rows held in memory when streaming, the buffer height has to be a power of two
+#define STREAM_RING_BANDS 8
 
 #if HAVE_FREETYPE
 void imageFilm_t::drawFontBitmap( FT_Bitmap* bitmap, int x, int y)
@@ -189,8 +193,8 @@ float Gauss(float dx, float dy)
 
 imageFilm_t::imageFilm_t (int width, int height, int xstart, int ystart, colorOutput_t &out, float filterSize, filterType filt, renderEnvironment_t *e):
 	flags(0), w(width), h(height), cx0(xstart), cy0(ystart), gamma(1.0), filterw(filterSize*0.5), output(&out),
-	clamp(false), split(true), interactive(true), abort(false), correctGamma(false), estimateDensity(false), numSamples(0),
-	splitter(0), pbar(0), env(e)
+	clamp(false), split(true), interactive(true), abort(false), correctGamma(false), estimateDensity(false), varianceAA(false), sampleStatsOn(false),
+	streaming(false), bufH(height), rowMask(~0), nBands(0), outBands(0), numSamples(0), deterministic(false), apronW(0), nextMerge(0), tilesX(1), splitter(0), pbar(0), env(e)
 {
 	cx1 = xstart + width;
 	cy1 = ystart + height;
@@ -235,10 +239,35 @@ void imageFilm_t::setGamma(float gammaVal, bool enable)
 
 void imageFilm_t::setDensityEstimation(bool enable)
 {
-	if(enable) densityImage.resize(w, h, false);
+	if(enable) densityImage.resize(w, bufH, false);
 	estimateDensity = enable;
 }
 
+void imageFilm_t::setVarianceAA(bool enable)
+{
+	if(enable) keepSampleStats(true);
+	varianceAA = enable;
+}
+
+void imageFilm_t::keepSampleStats(bool enable)
+{
+	if(enable && !sampleStatsOn) sampleStats.resize(w, bufH, false);
+	sampleStatsOn = enable;
+}
+
+void imageFilm_t::setStreaming(bool enable)
+{
+	if(enable == streaming) return;
+	if(enable && estimateDensity) std::cout << "imageFilm: density image can not be streamed and is ignored!\n";
+	streaming = enable;
+	bufH = enable ? SPLIT_BLOCK_SIZE*STREAM_RING_BANDS : h;
+	rowMask = enable ? bufH-1 : ~0;
+	image->resize(w, bufH, false);
+	if(estimateDensity) densityImage.resize(w, bufH, false);
+	if(sampleStatsOn) sampleStats.resize(w, bufH, false);
+	for(unsigned int i=0; i<channels.size(); ++i) channels[i]->resize(w, bufH, false);
+}
+
 
 void imageFilm_t::init()
 {
@@ -250,10 +279,15 @@ void imageFilm_t::init()
 	{
 		std::memset(densityImage.getData(), 0, densityImage.size()*sizeof(color_t));
 	}
+	//clear sample statistics
+	if(sampleStatsOn)
+	{
+		std::memset(sampleStats.getData(), 0, sampleStats.size()*sizeof(sampleStat_t));
+	}
 	//clear custom channels:
 	for(unsigned int i=0; i<channels.size(); ++i)
 	{
-		tiledArray2D_t<float, 3> &chan = channels[i];
+		tiledArray2D_t<float, 3> &chan = *channels[i];
 		float *cdata = chan.getData();
 		std::memset(cdata, 0, chan.size() * sizeof(float));
 	}
@@ -261,10 +295,16 @@ void imageFilm_t::init()
 	if(split)
 	{
 		next_area = 0;
-		splitter = new imageSpliter_t(w, h, cx0, cy0, 32);
+		splitter = new imageSpliter_t(w, h, cx0, cy0, SPLIT_BLOCK_SIZE);
 		area_cnt = splitter->size();
 	}
 	else area_cnt = 1;
+	tilesX = (w + SPLIT_BLOCK_SIZE - 1) / SPLIT_BLOCK_SIZE;
+	apronW = int(ceil(filterw));
+	clearAprons();
+	nBands = (h + SPLIT_BLOCK_SIZE - 1) / SPLIT_BLOCK_SIZE;
+	outBands = 0;
+	bandDone.assign(nBands, 0);
 	if(pbar) pbar->init(area_cnt);
 	abort = false;
 	completed_cnt = 0;
@@ -283,6 +323,16 @@ bool imageFilm_t::nextArea(renderArea_t &a)
 		splitterMutex.unlock();
 		if(	splitter->getArea(n, a) )
 		{
+			if(streaming)
+			{
+				// the filter of this tile reaches into the next tile row, whose ring slot must have been
+				// passed to the output already. Tiles are handed out in scanline order, so all tile rows
+				// in the way are being rendered and this can not deadlock.
+				int band = (a.Y - cy0) / SPLIT_BLOCK_SIZE;
+				bandCV.lock();
+				while(band + 1 - STREAM_RING_BANDS >= outBands && !abort) bandCV.wait();
+				bandCV.unlock();
+			}
 			a.sx0 = a.X + ifilterw;
 			a.sx1 = a.X + a.W - ifilterw;
 			a.sy0 = a.Y + ifilterw;
@@ -311,6 +361,32 @@ bool imageFilm_t::nextArea(renderArea_t &a)
 void imageFilm_t::finishArea(renderArea_t &a)
 {
 	outMutex.lock();
+	bool ordered = deterministic && split;
+	if(ordered) tileDone[tileIndex(a)] = 1;
+	if(streaming)
+	{
+		// a tile row is final once the row below is finished too, rows above are already out;
+		// in deterministic mode it also needs the aprons of the row below
+		if(ordered) mergeFinishedTiles();
+		int bandTiles = tilesX;
+		++bandDone[(a.Y - cy0) / SPLIT_BLOCK_SIZE];
+		while(outBands < nBands && (ordered ? nextMerge >= std::min(area_cnt, (outBands+2)*bandTiles) :
+			bandDone[outBands] == bandTiles && (outBands+1 == nBands || bandDone[outBands+1] == bandTiles)))
+		{
+			outputBand(outBands);
+			bandCV.lock();
+			++outBands;
+			bandCV.broadcast();
+			bandCV.unlock();
+		}
+		if(pbar)
+		{
+			if(++completed_cnt == area_cnt) pbar->done();
+			else pbar->update(1);
+		}
+		outMutex.unlock();
+		return;
+	}
 	int end_x = a.X+a.W-cx0, end_y = a.Y+a.H-cy0;
 	for(int j=a.Y-cy0; j<end_y; ++j)
 	{
@@ -333,6 +409,8 @@ void imageFilm_t::finishArea(renderArea_t &a)
 		}
 	}
 	if(interactive) output->flushArea(a.X-cx0, a.Y-cy0, end_x, end_y);
+	// only now, the tile must not show aprons of tiles that happened to finish earlier
+	if(ordered) mergeFinishedTiles();
 	if(pbar)
 	{
 		if(++completed_cnt == area_cnt) pbar->done();
@@ -341,6 +419,105 @@ void imageFilm_t::finishArea(renderArea_t &a)
 	outMutex.unlock();
 }
 
+template<class T> static void clearRows(tiledArray2D_t<T, 3> &arr, int y, int nRows)
+{
+	// rows of a tile row are contiguous in the tiled layout
+	std::memset(&arr(0, y), 0, arr.roundUp(arr.xSize()) * nRows * sizeof(T));
+}
+
+void imageFilm_t::outputBand(int band)
+{
+	int y0 = band * SPLIT_BLOCK_SIZE, y1 = std::min(h, y0 + SPLIT_BLOCK_SIZE);
+	int n = channels.size();
+	float *fb = (float *)alloca( (n+5) * sizeof(float) );
+	for(int j=y0; j<y1; ++j)
+	{
+		for(int i=0; i<w; ++i)
+		{
+			pixel_t &pixel = (*image)(i, ringRow(j));
+			colorA_t col;
+			if(pixel.weight>0.f)
+			{
+				col = pixel.col*(1.f/pixel.weight);
+				col.clampRGB0();
+			}
+			else col = 0.0;
+			if(correctGamma) col.gammaAdjust(gamma);
+			fb[0] = col.R, fb[1] = col.G, fb[2] = col.B, fb[3] = col.A, fb[4] = 0.f;
+			for(int k=0; k<n; ++k) fb[k+4] = getChanPixel(k, i, j);
+			if( !output->putPixel(i, j, fb, 4+n ) ) abort=true;
+		}
+	}
+	output->flushArea(0, y0, w, y1);
+	// the slot is reused by tile row band+STREAM_RING_BANDS
+	int slot = ringRow(y0);
+	clearRows(*image, slot, SPLIT_BLOCK_SIZE);
+	if(sampleStatsOn) clearRows(sampleStats, slot, SPLIT_BLOCK_SIZE);
+	if(estimateDensity) clearRows(densityImage, slot, SPLIT_BLOCK_SIZE);
+	for(unsigned int k=0; k<channels.size(); ++k) clearRows(*channels[k], slot, SPLIT_BLOCK_SIZE);
+}
+
+int imageFilm_t::tileIndex(const renderArea_t &a) const
+{
+	return ((a.Y - cy0) / SPLIT_BLOCK_SIZE) * tilesX + (a.X - cx0) / SPLIT_BLOCK_SIZE;
+}
+
+imageFilm_t::pixel_t* imageFilm_t::tileApron(const renderArea_t &a)
+{
+	pixel_t *&apron = aprons[tileIndex(a)];
+	if(!apron)
+	{
+		int size = (a.W + 2*apronW) * (a.H + 2*apronW);
+		apron = new pixel_t[size];
+		std::memset(apron, 0, size * sizeof(pixel_t));
+	}
+	return apron;
+}
+
+void imageFilm_t::mergeFinishedTiles()
+{
+	int tilesY = area_cnt / tilesX;
+	while(nextMerge < area_cnt)
+	{
+		// the apron covers the neighbour tiles only, the filter is narrower than a tile
+		int tx = nextMerge % tilesX, ty = nextMerge / tilesX;
+		bool ready = true;
+		for(int j=std::max(0, ty-1); j<=std::min(tilesY-1, ty+1) && ready; ++j)
+			for(int i=std::max(0, tx-1); i<=std::min(tilesX-1, tx+1); ++i)
+				if(!tileDone[j*tilesX + i]){ ready = false; break; }
+		if(!ready) break;
+		pixel_t *apron = aprons[nextMerge];
+		if(apron)
+		{
+			renderArea_t a;
+			splitter->getArea(nextMerge, a);
+			int aw = a.W + 2*apronW;
+			int y1 = std::min(cy1, a.Y+a.H+apronW), x1 = std::min(cx1, a.X+a.W+apronW);
+			for(int y=std::max(cy0, a.Y-apronW); y<y1; ++y)
+				for(int x=std::max(cx0, a.X-apronW); x<x1; ++x)
+				{
+					if(x >= a.X && x < a.X+a.W && y >= a.Y && y < a.Y+a.H) continue;
+					const pixel_t &c = apron[(y - a.Y + apronW)*aw + x - a.X + apronW];
+					pixel_t &pixel = (*image)(x - cx0, ringRow(y - cy0));
+					pixel.col += c.col;
+					pixel.weight += c.weight;
+				}
+			delete[] apron;
+			aprons[nextMerge] = 0;
+		}
+		++nextMerge;
+	}
+}
+
+void imageFilm_t::clearAprons()
+{
+	for(unsigned int i=0; i<aprons.size(); ++i) delete[] aprons[i];
+	int n = (deterministic && split) ? area_cnt : 0;
+	aprons.assign(n, (pixel_t *)0);
+	tileDone.assign(n, 0);
+	nextMerge = 0;
+}
+
 /* CAUTION! Implemantation of this function needs to be thread safe for samples that
 	contribute to pixels outside the area a AND pixels that might get
 	contributions from outside area a! (yes, really!) */
@@ -399,20 +576,37 @@ void imageFilm_t::addSample(const colorA_t &c, int x, int y, float dx, float dy,
 //		std::cout << "x0 "<<x0<<", x1 "<<x1<<", y0 "<<y0<<", y1 "<<y1<<"\n";
 	// check if we need to be thread-safe, i.e. add outside safe area (4 ugly conditionals...can't help it):
 	bool locked=false;
-	if(!a || x0 < a->sx0 || x1 > a->sx1 || y0 < a->sy0 || y1 > a->sy1)
+	pixel_t *apron=0;
+	if(deterministic && split && a)
+	{
+		// no other thread writes to this tile, contributions to other tiles wait in the apron
+		if(x0 < a->X || x1 >= a->X+a->W || y0 < a->Y || y1 >= a->Y+a->H) apron = tileApron(*a);
+	}
+	else if(!a || x0 < a->sx0 || x1 > a->sx1 || y0 < a->sy0 || y1 > a->sy1)
 	{
 		imageMutex.lock();
 		locked=true;
 		++_n_locked;
 	}
 	else ++_n_unlocked;
+	if(sampleStatsOn)
+	{
+		// statistics are only kept for the pixel the sample belongs to, which lies inside the
+		// area a of the calling thread, so no other thread updates them at the same time
+		CFLOAT bri = col.col2bri();
+		sampleStat_t &stat = sampleStats(x - cx0, ringRow(y - cy0));
+		stat.sum += bri;
+		stat.sumSq += bri*bri;
+		++stat.n;
+	}
 	for (int j = y0; j <= y1; ++j)
 		for (int i = x0; i <= x1; ++i) {
 			// get filter value at pixel (x,y)
 			int offset = yIndex[j-y0]*FILTER_TABLE_SIZE + xIndex[i-x0];
 			float filterWt = filterTable[offset];
 			// update pixel values with filtered sample contribution
-			pixel_t &pixel = (*image)(i - cx0, j - cy0);
+			pixel_t &pixel = (apron && (i < a->X || i >= a->X+a->W || j < a->Y || j >= a->Y+a->H)) ?
+				apron[(j - a->Y + apronW)*(a->W + 2*apronW) + i - a->X + apronW] : (*image)(i - cx0, ringRow(j - cy0));
 			pixel.col += (col * filterWt);
 			pixel.weight += filterWt;
 			/*if(i==0 && j==129) std::cout<<"col: "<<col<<" pcol: "<<
@@ -468,7 +662,7 @@ void imageFilm_t::addDensitySample(const color_t &c, int x, int y, float dx, flo
 			int offset = yIndex[j-y0]*FILTER_TABLE_SIZE + xIndex[i-x0];
 			float filterWt = filterTable[offset];
 			// update pixel values with filtered sample contribution
-			color_t &pixel = densityImage(i - cx0, j - cy0);
+			color_t &pixel = densityImage(i - cx0, ringRow(j - cy0));
 			pixel += c * filterWt;
 		}
 	++numSamples;
@@ -479,7 +673,23 @@ void imageFilm_t::addDensitySample(const color_t &c, int x, int y, float dx, flo
 // although this is write-only and overwriting the same pixel makes little sense...
 void imageFilm_t::setChanPixel(float val, int chan, int x, int y)
 {
-	channels[chan](x-cx0, y-cy0) = val;
+	(*channels[chan])(x-cx0, ringRow(y-cy0)) = val;
+}
+
+void imageFilm_t::addChanSample(float val, int chan, int x, int y)
+{
+	(*channels[chan])(x-cx0, ringRow(y-cy0)) += val;
+}
+
+float imageFilm_t::getChanPixel(int chan, int x, int y) const
+{
+	float val = (*channels[chan])(x, ringRow(y));
+	if(channelAccum[chan])
+	{
+		int n = sampleStats(x, ringRow(y)).n;
+		return (n > 0) ? val / (float)n : 0.f;
+	}
+	return val;
 }
 
 void imageFilm_t::nextPass(bool adaptive_AA)
@@ -489,9 +699,51 @@ void imageFilm_t::nextPass(bool adaptive_AA)
 	splitterMutex.lock();
 	next_area = 0;
 	splitterMutex.unlock();
+	clearAprons();
+	if(streaming)
+	{
+		// finished rows are gone, there is nothing to resample
+		if(adaptive_AA)
+		{
+			if(!abort) std::cout << "imageFilm: streaming output, skipping further AA passes!\n";
+			abort = true;
+			return;
+		}
+		outBands = 0;
+		bandDone.assign(nBands, 0);
+		if(pbar) pbar->init(area_cnt);
+		completed_cnt = 0;
+		return;
+	}
 	if(flags) flags->clear();
 	else flags = new tiledBitArray2D_t<3>(w, h, true);
-	if(adaptive_AA && AA_thesh>0.f) for(int y=0; y<h-1; ++y)
+	if(adaptive_AA && AA_thesh>0.f && varianceAA) for(int y=0; y<h; ++y)
+	{
+		for(int x=0; x<w; ++x)
+		{
+			// pixels without samples are not covered by the camera (e.g. lightmap gutters); a single
+			// sample does not tell anything about the variance, so such pixels always get more
+			const sampleStat_t &stat = sampleStats(x, y);
+			if(stat.n < 1) continue;
+			bool refine = (stat.n < 2);
+			if(!refine)
+			{
+				float mean = stat.sum / (float)stat.n;
+				float var = (stat.sumSq - stat.sum*mean) / (float)(stat.n - 1);
+				// compare standard error of the mean against threshold
+				refine = (var >= AA_thesh*AA_thesh*(float)stat.n);
+			}
+			if(refine)
+			{
+				flags->setBit(x, y);
+				float fb[5];
+				fb[0] =  fb[1] = fb[2] = fb[3] = 1.f; fb[4] = 0.f;
+				if(interactive) output->putPixel(x, y, fb, 4 );
+				++n_resample;
+			}
+		}
+	}
+	else if(adaptive_AA && AA_thesh>0.f) for(int y=0; y<h-1; ++y)
 	{
 		for(int x=0; x<w-1; ++x)
 		{
@@ -530,7 +782,15 @@ void imageFilm_t::nextPass(bool adaptive_AA)
 void imageFilm_t::flush(int flags, colorOutput_t *out)
 {
 	//std::cout << "flushing imageFilm buffer\n";
+	traceScope_t flushTrace("film flush");
 	colorOutput_t *colout = out ? out : output;
+	if(streaming)
+	{
+		// all rows have been passed to the output while rendering already
+		if(colout != output) std::cout << "imageFilm: streaming output, can not flush to another output!\n";
+		else output->flush();
+		return;
+	}
 #if HAVE_FREETYPE
 	if (env && env->getDrawParams()) {
 		drawRenderSettings();
@@ -556,35 +816,20 @@ void imageFilm_t::flush(int flags, colorOutput_t *out)
 				if(correctGamma) col.gammaAdjust(gamma);
 				
 				fb[0] = col.R, fb[1] = col.G, fb[2] = col.B, fb[3] = col.A, fb[4] = 0.f;
-				for(int k=0; k<n; ++k) fb[k+4] = channels[k](i, j);
+				for(int k=0; k<n; ++k) fb[k+4] = (*channels[k])(i, j);
 				output->putPixel(i, j, fb, 4+n );
 			}
 		}
 	}
 	else */
-	float multi = float(w*h)/(float)numSamples;
 	for(int j=0; j<h; ++j)
 	{
 		for(int i=0; i<w; ++i)
 		{
-			pixel_t &pixel = (*image)(i, j);
-			colorA_t col;
-			if((flags & IF_IMAGE) && pixel.weight>0.f)
-			{
-				col = pixel.col/pixel.weight;
-				col.clampRGB0();
-			}
-			else col = 0.0;
-			if(estimateDensity && (flags & IF_DENSITYIMAGE))
-			{
-				col += densityImage(i, j) * multi;
-				col.clampRGB0();
-			}
 			// !!! assume color output size matches width and height of image film, probably (likely!) stupid!
-			if(correctGamma) col.gammaAdjust(gamma);
-			
-			fb[0] = col.R, fb[1] = col.G, fb[2] = col.B, fb[3] = col.A, fb[4] = 0.f;
-			for(int k=0; k<n; ++k) fb[k+4] = channels[k](i, j);
+			getPixel(i, j, fb, flags);
+			fb[4] = 0.f;
+			for(int k=0; k<n; ++k) fb[k+4] = getChanPixel(k, i, j);
 			colout->putPixel(i, j, fb, 4+n );
 			//output->putPixel(i, j, col, col.getA());
 		}
@@ -593,18 +838,79 @@ void imageFilm_t::flush(int flags, colorOutput_t *out)
 	colout->flush();
 }
 
+void imageFilm_t::getPixel(int x, int y, float *rgba, int flags) const
+{
+	const pixel_t &pixel = (*image)(x, y);
+	colorA_t col;
+	if((flags & IF_IMAGE) && pixel.weight>0.f)
+	{
+		col = pixel.col/pixel.weight;
+		col.clampRGB0();
+	}
+	else col = 0.0;
+	if(estimateDensity && (flags & IF_DENSITYIMAGE))
+	{
+		float multi = float(w*h)/(float)numSamples;
+		col += densityImage(x, y) * multi;
+		col.clampRGB0();
+	}
+	if(correctGamma) col.gammaAdjust(gamma);
+	rgba[0] = col.R, rgba[1] = col.G, rgba[2] = col.B, rgba[3] = col.A;
+}
+
+void imageFilm_t::readImage(float *rgba, int flags) const
+{
+	if(streaming)
+	{
+		std::cout << "imageFilm: streaming output, can not read the image back!\n";
+		return;
+	}
+	for(int j=0; j<h; ++j)
+	{
+		for(int i=0; i<w; ++i, rgba+=4) getPixel(i, j, rgba, flags);
+	}
+}
+
+void imageFilm_t::readChannel(int chan, float *buf) const
+{
+	if(streaming)
+	{
+		std::cout << "imageFilm: streaming output, can not read channels back!\n";
+		return;
+	}
+	for(int j=0; j<h; ++j)
+	{
+		for(int i=0; i<w; ++i) *buf++ = getChanPixel(chan, i, j);
+	}
+}
+
 bool imageFilm_t::doMoreSamples(int x, int y) const
 {
 	return (AA_thesh>0.f) ? flags->getBit(x-cx0, y-cy0) : true;
 }
 
-int imageFilm_t::addChannel(const std::string &name)
+int imageFilm_t::addChannel(const std::string &name, bool accumulate)
 {
-	channels.push_back( tiledArray2D_t<float, 3>() );
-	tiledArray2D_t<float, 3> &chan = channels.back();
-	chan.resize(w, h, false);
+	// the arrays own their memory and can not be copied, so the vector only holds pointers
+	tiledArray2D_t<float, 3> *chanp = new tiledArray2D_t<float, 3>(w, bufH, false);
+	channels.push_back(chanp);
+	tiledArray2D_t<float, 3> &chan = *chanp;
+	std::memset(chan.getData(), 0, chan.size() * sizeof(float));
+	channelNames.push_back(name);
+	channelAccum.push_back(accumulate);
+	// averaging needs the number of samples per pixel
+	if(accumulate) keepSampleStats(true);
 	
-	return channels.size();
+	return channels.size() - 1;
+}
+
+int imageFilm_t::getChannel(const std::string &name) const
+{
+	for(unsigned int i=0; i<channelNames.size(); ++i)
+	{
+		if(channelNames[i] == name) return i;
+	}
+	return -1;
 }
 
 imageFilm_t::~imageFilm_t ()
@@ -612,7 +918,8 @@ imageFilm_t::~imageFilm_t ()
 	delete image;
 	delete[] filterTable;
 	if(splitter) delete splitter;
-	if(pbar) delete pbar; //remove when pbar no longer created by imageFilm_t!!
+	for(unsigned int i=0; i<channels.size(); ++i) delete channels[i];
+	clearAprons();
 	//std::cout << "** imageFilter stats: unlocked adds: "<<_n_unlocked<<" locked adds: " <<_n_locked<<"\n";
 }
 
@@ -2,7 +2,9 @@
 #include <yafraycore/tiledintegrator.h>
 #include <core_api/imagefilm.h>
 #include <core_api/camera.h>
+#include <core_api/surface.h>
 #include <yafraycore/timer.h>
+#include <yafraycore/rendertrace.h>
 #include <yafraycore/scr_halton.h>
 #include <utilities/mcqmc.h>
 #include <utilities/sample_utils.h>
@@ -15,7 +17,8 @@ class renderWorker_t: public yafthreads::thread_t
 {
 	public:
 		renderWorker_t(tiledIntegrator_t *it, scene_t *s, imageFilm_t *f, threadControl_t *c, int id, int smpls, int offs=0, bool adptv=false):
-			integrator(it), scene(s), imageFilm(f), control(c), samples(smpls), offset(offs), threadID(id), adaptive(adptv)
+			integrator(it), scene(s), imageFilm(f), control(c), samples(smpls), offset(offs), threadID(id), adaptive(adptv),
+			traceMesh(renderTrace_t::instance().getMesh())
 		{ /* std::cout << "renderWorker_t::renderWorker_t(): *this="<<(void*)this<<std::endl; */ };
 		virtual void body();
 	protected:
@@ -26,10 +29,12 @@ class renderWorker_t: public yafthreads::thread_t
 		int samples, offset;
 		int threadID;
 		bool adaptive;
+		int traceMesh; //!< trace mesh id of the thread that created us
 };
 
 void renderWorker_t::body()
 {
+	renderTrace_t::instance().setMesh(traceMesh);
 	renderArea_t a;
 	while(imageFilm->nextArea(a))
 	{
@@ -79,6 +84,7 @@ bool tiledIntegrator_t::render(imageFilm_t *image)
 bool tiledIntegrator_t::renderPass(int samples, int offset, bool adaptive)
 {
 	int nthreads = scene->getNumThreads();
+	traceScope_t passTrace(adaptive ? "adaptive pass" : "pass");
 #if HAVE_PTHREAD
 	if(nthreads>1)
 	{
@@ -126,7 +132,8 @@ bool tiledIntegrator_t::renderTile(renderArea_t &a, int n_samples, int offset, b
 {	
 	int x, y;
 	const camera_t* camera = scene->getCamera();
-	bool do_depth = scene->doDepth();
+	// the depth channel need not be the only (or first) custom channel of the film
+	int depthChan = scene->doDepth() ? imageFilm->getChannel("Depth") : -1;
 	x=camera->resX();
 	y=camera->resY();
 	diffRay_t c_ray;
@@ -134,10 +141,19 @@ bool tiledIntegrator_t::renderTile(renderArea_t &a, int n_samples, int offset, b
 	PFLOAT dx=0.5, dy=0.5, d1=1.0/(PFLOAT)n_samples;
 	float lens_u=0.5f, lens_v=0.5f;
 	PFLOAT wt, wt_dummy;
-	random_t prng(offset*(x*a.Y+a.X)+123);
+	// keyed by the pass offset, one stream per texel (see below)
+	random_t prng(scene->getSeed() ^ random_t::hash(offset));
 	renderState_t rstate(&prng);
 	rstate.threadID = threadID;
+	rstate.cameraRay = &c_ray;
+	rstate.stats = scene->getStats().thread(threadID);
+	double tileStart = renderStats_t::clock();
+	int tile[4] = { a.X, a.Y, a.W, a.H };
+	traceScope_t tileTrace("tile", threadID+1, tile);
 	bool sampleLns = camera->sampleLense();
+	// lightmap cameras already know the surface point of every texel, no need to trace the primary ray
+	bool surfSamples = camera->surfaceSamples();
+	surfacePoint_t sp;
 	int pass_offs=offset, end_x=a.X+a.W, end_y=a.Y+a.H;
 	for(int i=a.Y; i<end_y; ++i)
 	{
@@ -145,11 +161,20 @@ bool tiledIntegrator_t::renderTile(renderArea_t &a, int n_samples, int offset, b
 		{
 			if(adaptive)
 			{
-				if(!imageFilm->doMoreSamples(j, i)) continue;
+				if(!imageFilm->doMoreSamples(j, i))
+				{
+					rstate.count(RS_TEXELS_SKIPPED);
+					continue;
+				}
 			}
 			rstate.pixelNumber = x*i+j;
+			// the random numbers of a texel do not depend on the tile or on the texels before it
+			prng.setStream(rstate.pixelNumber);
+			rstate.screenpos.x = j;
+			rstate.screenpos.y = i;
 			rstate.samplingOffs = fnv_32a_buf(i*fnv_32a_buf(j));//fnv_32a_buf(rstate.pixelNumber);
 			float toff = scrHalton(5, pass_offs+rstate.samplingOffs); // **shall be just the pass number...**
+			int integrated = 0;
 			for(int sample=0; sample<n_samples; ++sample)
 			{
 				rstate.setDefaults();
@@ -172,27 +197,38 @@ bool tiledIntegrator_t::renderTile(renderArea_t &a, int n_samples, int offset, b
 					lens_u = scrHalton(3, rstate.pixelSample+rstate.samplingOffs);
 					lens_v = scrHalton(4, rstate.pixelSample+rstate.samplingOffs);
 				}
-				c_ray = camera->shootRay(j+dx, i+dy, lens_u, lens_v, wt);
+				if(surfSamples)
+				{
+					if(!camera->sampleSurface(j+dx, i+dy, sp, c_ray, wt)) continue;
+				}
+				else c_ray = camera->shootRay(j+dx, i+dy, lens_u, lens_v, wt);
 				if(wt==0.0) continue;
+				rstate.count(RS_SAMPLES);
+				++integrated;
 				//setup ray differentials
 				d_ray = camera->shootRay(j+1+dx, i+dy, lens_u, lens_v, wt_dummy);
 				c_ray.xfrom = d_ray.from;
 				c_ray.xdir = d_ray.dir;
+				// neighbours the camera can't shoot (e.g. lightmap gutters) give no differentials
+				c_ray.hasDifferentials = (wt_dummy != 0.0);
 				d_ray = camera->shootRay(j+dx, i+1+dy, lens_u, lens_v, wt_dummy);
 				c_ray.yfrom = d_ray.from;
 				c_ray.ydir = d_ray.dir;
 				c_ray.time = rstate.time;
-				c_ray.hasDifferentials = true;
+				c_ray.hasDifferentials = c_ray.hasDifferentials && (wt_dummy != 0.0);
 				// col = T * L_o + L_v
-				colorA_t col = integrate(rstate, c_ray); // L_o
+				colorA_t col = surfSamples ? integrateSurface(rstate, c_ray, sp) : integrate(rstate, c_ray); // L_o
 				// I really don't like this here, bert...
 				//col *= scene->volIntegrator->transmittance(rstate, c_ray); // T
 				//col += scene->volIntegrator->integrate(rstate, c_ray); // L_v
 				imageFilm->addSample(wt * col, j, i, dx, dy,/*.5f, .5f,*/ &a);
 			}
-			if(do_depth) imageFilm->setChanPixel(c_ray.tmax, 0, j, i);
+			// texels on the mesh border may still be covered by some of their samples
+			if(!integrated) rstate.count(RS_TEXELS_SKIPPED);
+			if(depthChan >= 0) imageFilm->setChanPixel(c_ray.tmax, depthChan, j, i);
 		}
 	}
+	rstate.stats->busy += renderStats_t::clock() - tileStart;
 	return true;
 }
 
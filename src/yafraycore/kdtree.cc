@@ -675,7 +675,7 @@ int triKdTree_t::buildTree(u_int32 nPrims, bound_t &nodeBound, u_int32 *primNums
 	returns the closest hit within dist
 */
 
-bool triKdTree_t::Intersect(const ray_t &ray, PFLOAT dist, triangle_t **tr, PFLOAT &Z, void *udat) const
+bool triKdTree_t::Intersect(const ray_t &ray, PFLOAT dist, triangle_t **tr, PFLOAT &Z, void *udat, unsigned int *nodeCount) const
 {
 	Z=dist;
 //	std::cout << "kdTree_t::Intersect: Z="<<Z<<"\n";
@@ -690,6 +690,7 @@ bool triKdTree_t::Intersect(const ray_t &ray, PFLOAT dist, triangle_t **tr, PFLO
 	vector3d_t invDir(1.0/ray.dir.x, 1.0/ray.dir.y, 1.0/ray.dir.z); //was 1.f!
 //	int rayId = curMailboxId++;
 	bool hit = false;
+	unsigned int visited = 0;
 	
 	KdStack stack[KD_MAX_STACK];
 	const kdTreeNode *farChild, *currNode;
@@ -717,6 +718,7 @@ bool triKdTree_t::Intersect(const ray_t &ray, PFLOAT dist, triangle_t **tr, PFLO
 		// loop until leaf is found
 		while( !currNode->IsLeaf() )
 		{
+			++visited;
 			int axis = currNode->SplitAxis();
 			PFLOAT splitVal = currNode->SplitPos();
 			
@@ -768,6 +770,7 @@ bool triKdTree_t::Intersect(const ray_t &ray, PFLOAT dist, triangle_t **tr, PFLO
 		}
 				 
 		// Check for intersections inside leaf node
+		++visited;
 		u_int32 nPrimitives = currNode->nPrimitives();
 		if (nPrimitives == 1) {
 			triangle_t *mp = currNode->onePrimitive;
@@ -807,7 +810,12 @@ bool triKdTree_t::Intersect(const ray_t &ray, PFLOAT dist, triangle_t **tr, PFLO
 			}
 		}
 		
-		if(hit && Z <= stack[exPt].t){ memcpy(udat, c_udat, PRIM_DAT_SIZE); return true;}
+		if(hit && Z <= stack[exPt].t)
+		{
+			memcpy(udat, c_udat, PRIM_DAT_SIZE);
+			if(nodeCount) *nodeCount += visited;
+			return true;
+		}
 		
 		enPt = exPt;
 		currNode = stack[exPt].node;
@@ -816,22 +824,26 @@ bool triKdTree_t::Intersect(const ray_t &ray, PFLOAT dist, triangle_t **tr, PFLO
 	} // while
 //	if(hit) return true;
 	memcpy(udat, c_udat, PRIM_DAT_SIZE);
+	if(nodeCount) *nodeCount += visited;
 	return hit; //false;
 }
 
 
-bool triKdTree_t::IntersectS(const ray_t &ray, PFLOAT dist, triangle_t **tr) const
+bool triKdTree_t::IntersectS(const ray_t &ray, PFLOAT dist, triangle_t **tr, unsigned int *nodeCount) const
 {
 	PFLOAT a, b, t; // entry/exit/splitting plane signed distance
 	PFLOAT t_hit;
 	
 	if (!treeBound.cross(ray.from, ray.dir, a, b, dist))
 		return false;
+	// nothing beyond dist can occlude, so clip the exit point to not descend into such nodes at all
+	if(b > dist) b = dist;
 	
 	unsigned char udat[PRIM_DAT_SIZE];
 	vector3d_t invDir(1.f/ray.dir.x, 1.f/ray.dir.y, 1.f/ray.dir.z);
 //	int rayId = curMailboxId++;
 //	bool hit = false;
+	unsigned int visited = 0;
 	
 	KdStack stack[KD_MAX_STACK];
 	const kdTreeNode *farChild, *currNode;
@@ -859,6 +871,7 @@ bool triKdTree_t::IntersectS(const ray_t &ray, PFLOAT dist, triangle_t **tr) con
 		// loop until leaf is found
 		while( !currNode->IsLeaf() )
 		{
+			++visited;
 			int axis = currNode->SplitAxis();
 			PFLOAT splitVal = currNode->SplitPos();
 			
@@ -910,6 +923,7 @@ bool triKdTree_t::IntersectS(const ray_t &ray, PFLOAT dist, triangle_t **tr) con
 		}
 				 
 		// Check for intersections inside leaf node
+		++visited;
 		u_int32 nPrimitives = currNode->nPrimitives();
 		if (nPrimitives == 1) {
 			triangle_t *mp = currNode->onePrimitive;
@@ -921,6 +935,7 @@ bool triKdTree_t::IntersectS(const ray_t &ray, PFLOAT dist, triangle_t **tr) con
 					if(t_hit < dist && t_hit > 0.f ) // '>=' ?
 					{
 						*tr = mp;
+						if(nodeCount) *nodeCount += visited;
 						return true;
 					}
 				}
@@ -938,6 +953,7 @@ bool triKdTree_t::IntersectS(const ray_t &ray, PFLOAT dist, triangle_t **tr) con
 						{
 //							hit = true;
 							*tr = mp;
+							if(nodeCount) *nodeCount += visited;
 							return true;
 						}
 					}
@@ -953,6 +969,7 @@ bool triKdTree_t::IntersectS(const ray_t &ray, PFLOAT dist, triangle_t **tr) con
 				
 	} // while
 //	if(hit) return true;
+	if(nodeCount) *nodeCount += visited;
 	return false;
 }
 
@@ -960,19 +977,22 @@ bool triKdTree_t::IntersectS(const ray_t &ray, PFLOAT dist, triangle_t **tr) con
 	allow for transparent shadows.
 =============================================================*/
 
-bool triKdTree_t::IntersectTS(renderState_t &state, const ray_t &ray, int maxDepth, PFLOAT dist, triangle_t **tr, color_t &filt) const
+bool triKdTree_t::IntersectTS(renderState_t &state, const ray_t &ray, int maxDepth, PFLOAT dist, triangle_t **tr, color_t &filt, unsigned int *nodeCount) const
 {
 	PFLOAT a, b, t; // entry/exit/splitting plane signed distance
 	PFLOAT t_hit;
 	
 	if (!treeBound.cross(ray.from, ray.dir, a, b, dist))
 		return false;
+	// clip to dist, see IntersectS()
+	if(b > dist) b = dist;
 	
 	/* unsigned char */double udat[PRIM_DAT_SIZE];
 	vector3d_t invDir(1.f/ray.dir.x, 1.f/ray.dir.y, 1.f/ray.dir.z);
 //	int rayId = curMailboxId++;
 //	bool hit = false;
 	int depth=0;
+	unsigned int visited = 0;
 //	filt = color_t(1.0);
 #if ( HAVE_PTHREAD && defined (__GNUC__) )
 	std::set<const triangle_t *, std::less<const triangle_t *>, __gnu_cxx::__mt_alloc<const triangle_t *> > filtered;
@@ -1005,6 +1025,7 @@ bool triKdTree_t::IntersectTS(renderState_t &state, const ray_t &ray, int maxDep
 		// loop until leaf is found
 		while( !currNode->IsLeaf() )
 		{
+			++visited;
 			int axis = currNode->SplitAxis();
 			PFLOAT splitVal = currNode->SplitPos();
 			
@@ -1056,6 +1077,7 @@ bool triKdTree_t::IntersectTS(renderState_t &state, const ray_t &ray, int maxDep
 		}
 				 
 		// Check for intersections inside leaf node
+		++visited;
 		u_int32 nPrimitives = currNode->nPrimitives();
 //		PFLOAT tmax = (stack[exPt].t < dist) ? stack[exPt].t : dist;
 //		PFLOAT tmin = (stack[enPt].t > ray.tmin) ? stack[enPt].t : ray.tmin;
@@ -1067,10 +1089,10 @@ bool triKdTree_t::IntersectTS(renderState_t &state, const ray_t &ray, int maxDep
 				{
 //					*tr = mp;
 					const material_t *mat = mp->getMaterial();
-					if(!mat->isTransparent() ) return true;
+					if(!mat->isTransparent() ){ if(nodeCount) *nodeCount += visited; return true; }
 					if(filtered.insert(mp).second)
 					{
-						if(depth>=maxDepth) return true;
+						if(depth>=maxDepth){ if(nodeCount) *nodeCount += visited; return true; }
 						point3d_t h=ray.from + t_hit*ray.dir;
 						surfacePoint_t sp;
 						mp->getSurface(sp, h, (void*)&udat[0]);
@@ -1090,10 +1112,10 @@ bool triKdTree_t::IntersectTS(renderState_t &state, const ray_t &ray, int maxDep
 					{
 //						*tr = mp;
 						const material_t *mat = mp->getMaterial();
-						if(!mat->isTransparent() ) return true;
+						if(!mat->isTransparent() ){ if(nodeCount) *nodeCount += visited; return true; }
 						if(filtered.insert(mp).second)
 						{
-							if(depth>=maxDepth) return true;
+							if(depth>=maxDepth){ if(nodeCount) *nodeCount += visited; return true; }
 							point3d_t h=ray.from + t_hit*ray.dir;
 							surfacePoint_t sp;
 							mp->getSurface(sp, h, (void*)&udat[0]);
@@ -1113,6 +1135,7 @@ bool triKdTree_t::IntersectTS(renderState_t &state, const ray_t &ray, int maxDep
 				
 	} // while
 //	if(hit) return true;
+	if(nodeCount) *nodeCount += visited;
 	return false;
 }
 
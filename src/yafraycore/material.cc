@@ -27,9 +27,9 @@
 
 __BEGIN_YAFRAY
 
-bool material_t::scatterPhoton(const renderState_t &state, const surfacePoint_t &sp, const vector3d_t &wi, vector3d_t &wo, pSample_t &s) const
+//! russian roulette on the photon color after scattering with color scol to direction wo
+static inline bool photonRoulette(const color_t &scol, const surfacePoint_t &sp, const vector3d_t &wo, pSample_t &s)
 {
-	color_t scol = sample(state, sp, wi, wo, s);
 	if(s.pdf > 1.0e-6f)
 	{
 		color_t cnew = s.lcol * s.alpha * scol * (std::fabs(wo*sp.N)/s.pdf);
@@ -45,6 +45,18 @@ bool material_t::scatterPhoton(const renderState_t &state, const surfacePoint_t
 	return false;
 }
 
+bool material_t::scatterPhoton(const renderState_t &state, const surfacePoint_t &sp, const vector3d_t &wi, vector3d_t &wo, pSample_t &s) const
+{
+	color_t scol = sample(state, sp, wi, wo, s);
+	return photonRoulette(scol, sp, wo, s);
+}
+
+bool material_t::scatterPhotonConstDiffuse(const surfacePoint_t &sp, const vector3d_t &wi, vector3d_t &wo, pSample_t &s) const
+{
+	color_t scol = sampleConstDiffuse(sp, wi, wo, s);
+	return photonRoulette(scol, sp, wo, s);
+}
+
 color_t material_t::getReflectivity(const renderState_t &state, const surfacePoint_t &sp, BSDF_t flags)const
 {
 	if(! (flags & (BSDF_TRANSMIT | BSDF_REFLECT) & bsdfFlags) ) return color_t(0.f);
@@ -1,5 +1,6 @@
 #include <yafraycore/nodematerial.h>
 #include <core_api/environment.h>
+#include <yafraycore/nodeops.h>
 #include <set>
 
 __BEGIN_YAFRAY
@@ -62,6 +63,7 @@ void nodeMaterial_t::solveNodesOrder(const std::vector<shaderNode_t *> &roots)
 	//set all IDs = 0 to indicate "not tested yet"
 	for(unsigned int i=0; i<allNodes.size(); ++i) allNodes[i]->ID=0;
 	for(unsigned int i=0; i<roots.size(); ++i) recursiveSolver(roots[i], allSorted);
+	rootNodes = roots;
 	if(allNodes.size() != allSorted.size()) std::cout << "warning, unreachable nodes!\n";
 	//give the nodes an index to be used as the "stack"-index. 
 	//using the order of evaluation can't hurt, can it?
@@ -103,6 +105,114 @@ void nodeMaterial_t::filterNodes(const std::vector<shaderNode_t *> &input, std::
 	}
 }
 
+void nodeMaterial_t::compileNodes()
+{
+	size_t n = allSorted.size();
+	constResults.assign(n, nodeResult_t(colorA_t(0.f), 0.f));
+	isConst.assign(n, 0);
+	constRead.assign(n, 0);
+	if(n == 0) return;
+	// fold nodes that depend on nothing but constant inputs, allSorted is in evaluation order
+	nodeStack_t stack(&constResults[0]);
+	renderState_t state;
+	surfacePoint_t sp;
+	int folded = 0;
+	for(unsigned int i=0; i<n; ++i)
+	{
+		shaderNode_t *node = allSorted[i];
+		if(node->isPointDependant() || node->isViewDependant()) continue;
+		std::vector<const shaderNode_t*> deps;
+		bool constIn = true;
+		if(node->getDependencies(deps))
+			for(unsigned int k=0; k<deps.size(); ++k) constIn = constIn && isConst[deps[k]->ID];
+		if(!constIn) continue;
+		node->eval(stack, state, sp);
+		isConst[node->ID] = 1;
+		++folded;
+	}
+	// folded results have to be on the stack where the material or a node called through eval() reads them
+	for(unsigned int i=0; i<rootNodes.size(); ++i) constRead[rootNodes[i]->ID] = 1;
+	for(unsigned int i=0; i<n; ++i)
+	{
+		nodeInstr_t instr;
+		if(isConst[i] || allSorted[i]->compile(instr)) continue;
+		std::vector<const shaderNode_t*> deps;
+		allSorted[i]->getDependencies(deps);
+		for(unsigned int k=0; k<deps.size(); ++k) constRead[deps[k]->ID] = 1;
+	}
+	compileNodeList(allSorted, sortedCode);
+	compileNodeList(allViewdep, viewdepCode);
+	compileNodeList(allViewindep, viewindepCode);
+	std::cout << "compiled " << n << " shader nodes, " << folded << " folded to constants\n";
+}
+
+void nodeMaterial_t::compileNodeList(const std::vector<shaderNode_t *> &nodes, nodeProgram_t &prog) const
+{
+	prog.code.clear();
+	prog.consts.clear();
+	for(unsigned int i=0; i<nodes.size(); ++i)
+	{
+		const shaderNode_t *node = nodes[i];
+		unsigned int id = node->ID;
+		if(isConst[id])
+		{
+			if(constRead[id]) prog.consts.push_back(std::make_pair(id, constResults[id]));
+			continue;
+		}
+		nodeInstr_t instr;
+		instr.out = id;
+		instr.node = node;
+		instr.in[0] = instr.in[1] = instr.in[2] = -1;
+		if(node->compile(instr))
+		{
+			// bake constant inputs into the instruction
+			for(int k=0; k<3; ++k)
+			{
+				int in = instr.in[k];
+				if(in < 0 || !isConst[in]) continue;
+				instr.col[k] = constResults[in].col;
+				instr.val[k] = constResults[in].f;
+				instr.in[k] = -1;
+			}
+		}
+		else instr.op = nodeInstr_t::OP_CALL;
+		prog.code.push_back(instr);
+	}
+}
+
+static inline nodeResult_t nodeInput(const nodeStack_t &stack, const nodeInstr_t &instr, int k)
+{
+	return (instr.in[k] >= 0) ? stack(instr.in[k]) : nodeResult_t(instr.col[k], instr.val[k]);
+}
+
+void nodeProgram_t::run(nodeStack_t &stack, const renderState_t &state, const surfacePoint_t &sp, const vector3d_t *wo, const vector3d_t *wi) const
+{
+	for(unsigned int i=0; i<consts.size(); ++i) stack[consts[i].first] = consts[i].second;
+	std::vector<nodeInstr_t>::const_iterator instr, end=code.end();
+	for(instr = code.begin(); instr!=end; ++instr)
+	{
+		switch(instr->op)
+		{
+			case nodeInstr_t::OP_MIX:
+			{
+				nodeResult_t in1 = nodeInput(stack, *instr, 0), in2 = nodeInput(stack, *instr, 1);
+				CFLOAT f2 = (instr->in[2] >= 0) ? stack(instr->in[2]).f : instr->val[2];
+				stack[instr->out] = mixNodeResult(instr->mode, f2, in1.col, in2.col, in1.f, in2.f);
+				break;
+			}
+			case nodeInstr_t::OP_LAYER:
+			{
+				nodeResult_t upper = nodeInput(stack, *instr, 1);
+				stack[instr->out] = layerNodeResult(instr->layer, upper.col, upper.f, nodeInput(stack, *instr, 0));
+				break;
+			}
+			default:
+				if(wo) instr->node->eval(stack, state, sp, *wo, *wi);
+				else instr->node->eval(stack, state, sp);
+		}
+	}
+}
+
 void nodeMaterial_t::evalBump(nodeStack_t &stack, const renderState_t &state, const surfacePoint_t &sp, const shaderNode_t *bumpS)const
 {
 	std::vector<shaderNode_t *>::const_iterator iter, end=bumpNodes.end();
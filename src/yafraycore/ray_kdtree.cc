@@ -840,6 +840,8 @@ bool kdTree_t<T>::IntersectS(const ray_t &ray, PFLOAT dist, T **tr) const
 	
 	if (!treeBound.cross(ray.from, ray.dir, a, b, dist))
 		return false;
+	// hits beyond dist don't count, skip nodes there
+	if(b > dist) b = dist;
 	
 	unsigned char udat[PRIM_DAT_SIZE];
 	vector3d_t invDir(1.f/ray.dir.x, 1.f/ray.dir.y, 1.f/ray.dir.z);
@@ -981,6 +983,8 @@ bool kdTree_t<T>::IntersectTS(renderState_t &state, const ray_t &ray, int maxDep
 	
 	if (!treeBound.cross(ray.from, ray.dir, a, b, dist))
 		return false;
+	// clip to dist, see IntersectS()
+	if(b > dist) b = dist;
 	
 	/* unsigned char */double udat[PRIM_DAT_SIZE];
 	vector3d_t invDir(1.f/ray.dir.x, 1.f/ray.dir.y, 1.f/ray.dir.z);
@@ -0,0 +1,93 @@
+/****************************************************************************
+ * 			renderstats.cc: per thread counters of the render hot paths
+ *      This is part of the yafray package
+ *      Copyright (C) 2009 BioWare
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include <yafraycore/renderstats.h>
+#include <time.h>
+#ifndef WIN32
+#include <sys/time.h>
+#endif
+
+__BEGIN_YAFRAY
+
+void threadStats_t::reset()
+{
+	for(int i=0; i<RS_NUM_COUNTERS; ++i) count[i] = 0.0;
+	busy = 0.0;
+}
+
+renderStats_t::renderStats_t()
+{
+	stages[RS_STAGE_TREE] = 0.0;
+	reset(1);
+}
+
+void renderStats_t::reset(int nthreads)
+{
+	if(nthreads < 1) nthreads = 1;
+	threads.assign(nthreads, threadStats_t());
+	for(int i=0; i<RS_NUM_COUNTERS; ++i) totals[i] = 0.0;
+	// the tree may have been built by an explicit update() before the render, keep its time
+	for(int i=0; i<RS_NUM_STAGES; ++i) if(i != RS_STAGE_TREE) stages[i] = 0.0;
+}
+
+threadStats_t* renderStats_t::thread(int id)
+{
+	if(id < 0 || id >= (int)threads.size()) id = 0;
+	return &threads[id];
+}
+
+void renderStats_t::aggregate()
+{
+	double busy = 0.0;
+	for(int i=0; i<RS_NUM_COUNTERS; ++i) totals[i] = 0.0;
+	for(unsigned int t=0; t<threads.size(); ++t)
+	{
+		for(int i=0; i<RS_NUM_COUNTERS; ++i) totals[i] += threads[t].count[i];
+		busy += threads[t].busy;
+	}
+	stages[RS_STAGE_TILES] = busy;
+}
+
+const char* renderStats_t::counterName(renderCounter_t c)
+{
+	static const char *names[RS_NUM_COUNTERS] = { "rays", "shadow_rays", "kd_nodes", "photon_lookups",
+		"fg_rays", "fg_points", "fg_vertices", "fg_fast_vertices", "samples", "texels_skipped" };
+	return names[c];
+}
+
+const char* renderStats_t::stageName(renderStage_t s)
+{
+	static const char *names[RS_NUM_STAGES] = { "tree_time", "preprocess_time", "render_time", "tile_time" };
+	return names[s];
+}
+
+double renderStats_t::clock()
+{
+#ifdef WIN32
+	// same source as timer_t, clock() measures wall time on windows
+	return (double)::clock() / (double)CLOCKS_PER_SEC;
+#else
+	timeval tv;
+	gettimeofday(&tv, 0);
+	return (double)tv.tv_sec + 1e-6 * (double)tv.tv_usec;
+#endif
+}
+
+__END_YAFRAY
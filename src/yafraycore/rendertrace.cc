@@ -0,0 +1,124 @@
+/****************************************************************************
+ * 			rendertrace.cc: timeline of the render phases in chrome trace format
+ *      This is part of the yafray package
+ *      Copyright (C) 2009 BioWare
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include <yafraycore/rendertrace.h>
+#include <yafraycore/renderstats.h>
+#include <iostream>
+
+__BEGIN_YAFRAY
+
+renderTrace_t& renderTrace_t::instance()
+{
+	static renderTrace_t trace;
+	return trace;
+}
+
+renderTrace_t::renderTrace_t(): file(0), start(0.0)
+{
+#if HAVE_PTHREAD
+	pthread_key_create(&meshKey, 0);
+#else
+	mesh = -1;
+#endif
+}
+
+renderTrace_t::~renderTrace_t()
+{
+	close();
+#if HAVE_PTHREAD
+	pthread_key_delete(meshKey);
+#endif
+}
+
+void renderTrace_t::setMesh(int id)
+{
+#if HAVE_PTHREAD
+	pthread_setspecific(meshKey, (void *)(size_t)(id + 1));
+#else
+	mesh = id;
+#endif
+}
+
+int renderTrace_t::getMesh() const
+{
+#if HAVE_PTHREAD
+	return (int)(size_t)pthread_getspecific(meshKey) - 1;
+#else
+	return mesh;
+#endif
+}
+
+bool renderTrace_t::open(const std::string &filename)
+{
+	close();
+	mutex.lock();
+	file = std::fopen(filename.c_str(), "w");
+	if(file)
+	{
+		start = renderStats_t::clock();
+		// array format: chrome accepts a missing ']' if we never get to close()
+		std::fprintf(file, "[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"render\"}},\n");
+	}
+	else std::cout << "renderTrace: could not open " << filename << "\n";
+	mutex.unlock();
+	return file != 0;
+}
+
+void renderTrace_t::close()
+{
+	mutex.lock();
+	if(file)
+	{
+		std::fprintf(file, "{\"name\":\"trace end\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":0,\"ts\":%.1f}\n]\n",
+			1e6 * (renderStats_t::clock() - start));
+		std::fclose(file);
+		file = 0;
+	}
+	mutex.unlock();
+}
+
+double renderTrace_t::now() const
+{
+	return 1e6 * (renderStats_t::clock() - start);
+}
+
+void renderTrace_t::complete(const char *name, int tid, double begin, const int *tile)
+{
+	double end = now();
+	int mesh = getMesh();
+	mutex.lock();
+	if(file)
+	{
+		std::fprintf(file, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.1f,\"dur\":%.1f,\"args\":{\"mesh\":%d",
+			name, tid, begin, end - begin, mesh);
+		if(tile) std::fprintf(file, ",\"x\":%d,\"y\":%d,\"w\":%d,\"h\":%d", tile[0], tile[1], tile[2], tile[3]);
+		std::fprintf(file, "}},\n");
+	}
+	mutex.unlock();
+}
+
+void renderTrace_t::flush()
+{
+	mutex.lock();
+	if(file) std::fflush(file);
+	mutex.unlock();
+}
+
+__END_YAFRAY
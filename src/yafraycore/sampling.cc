@@ -0,0 +1,159 @@
+/****************************************************************************
+ * 			sampling.cc: batch generation of the quasi monte carlo sequences
+ *      This is part of the yafray package
+ *      Copyright (C) 2009 BioWare
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include <core_api/sampling.h>
+#include <core_api/vector3d.h>
+#include <utilities/mcqmc.h>
+#include <yafraycore/scr_halton.h>
+
+__BEGIN_YAFRAY
+
+// same conversion as the scalar functions, including their rounding to PFLOAT
+static inline double toUnit(unsigned int bits)
+{
+	return (PFLOAT)(double(bits)/4294967296.0);
+}
+
+//! number of trailing one bits, i.e. the highest bit that changes from i to i+1
+static inline int trailingOnes(unsigned int i)
+{
+	int t = 0;
+	while(t < 31 && (i & (1u << t))) ++t;
+	return t;
+}
+
+void scrHaltonBatch(int dim, unsigned int start, int n, double *out)
+{
+	const int *sigma = faure[dim];
+	unsigned int base = prims[dim];
+	double invBase = 1.0/double(base);
+	
+	// a 32 bit index has at most 32 digits; the products digit weight * permuted digit
+	// are computed exactly like in scrHalton, so the sums round the same way
+	int maxDigits = 0;
+	for(unsigned int m = 0xffffffffu; m > 0; m /= base) ++maxDigits;
+	std::vector<double> prod(maxDigits * base);
+	double f, factor;
+	f = factor = invBase;
+	for(int k=0; k<maxDigits; ++k)
+	{
+		for(unsigned int d=0; d<base; ++d) prod[k*base + d] = double(sigma[d]) * factor;
+		factor *= f;
+	}
+	
+	unsigned int digit[32];
+	int nDigits = 0;
+	for(unsigned int m = start; m > 0; m /= base) digit[nDigits++] = m % base;
+	
+	for(int i=0; i<n; ++i)
+	{
+		double value = 0.0;
+		const double *p = &prod[0];
+		for(int k=0; k<nDigits; ++k, p += base) value += p[digit[k]];
+		out[i] = value;
+		if(start + (unsigned int)i == 0xffffffffu) { nDigits = 0; continue; } // next index wraps around to 0
+		// count up, scrHalton stops at the highest non-zero digit so the digit count never shrinks
+		int k = 0;
+		while(k < nDigits && ++digit[k] == base) digit[k++] = 0;
+		if(k == nDigits) digit[nDigits++] = 1;
+	}
+}
+
+void RI_vdCBatch(unsigned int start, int n, double *out, unsigned int r)
+{
+	// bits of start in reverse order, as in RI_vdC
+	unsigned int bits = start;
+	bits = ( bits << 16) | ( bits >> 16);
+	bits = ((bits & 0x00ff00ff) << 8) | ((bits & 0xff00ff00) >> 8);
+	bits = ((bits & 0x0f0f0f0f) << 4) | ((bits & 0xf0f0f0f0) >> 4);
+	bits = ((bits & 0x33333333) << 2) | ((bits & 0xcccccccc) >> 2);
+	bits = ((bits & 0x55555555) << 1) | ((bits & 0xaaaaaaaa) >> 1);
+	unsigned int i = start;
+	for(int j=0; j<n; ++j, ++i)
+	{
+		out[j] = toUnit(bits ^ r);
+		// bits 0..t flip from i to i+1, reversed they are the top t+1 bits
+		bits ^= 0xffffffffu << (31 - trailingOnes(i));
+	}
+}
+
+//! generator matrix columns of RI_S (mode 0) and RI_LP (mode 1), accumulated: acc[t] = v_0 ^ ... ^ v_t
+static void base2Columns(int mode, unsigned int acc[32])
+{
+	unsigned int v = 1u << 31, a = 0;
+	for(int k=0; k<32; ++k)
+	{
+		a ^= v;
+		acc[k] = a;
+		v = (mode == 0) ? (v ^ (v >> 1)) : (v | (v >> 1));
+	}
+}
+
+static void base2Batch(int mode, unsigned int start, int n, double *out, unsigned int r)
+{
+	unsigned int acc[32];
+	base2Columns(mode, acc);
+	unsigned int x = 0;
+	for(unsigned int v = 1u << 31, i = start; i; i >>= 1, v = (mode == 0) ? (v ^ (v >> 1)) : (v | (v >> 1)))
+		if(i & 1) x ^= v;
+	unsigned int i = start;
+	for(int j=0; j<n; ++j, ++i)
+	{
+		out[j] = toUnit(x ^ r);
+		// the columns of bits 0..t toggle from i to i+1
+		x ^= acc[trailingOnes(i)];
+	}
+}
+
+void RI_SBatch(unsigned int start, int n, double *out, unsigned int r)
+{
+	base2Batch(0, start, n, out, r);
+}
+
+void RI_LPBatch(unsigned int start, int n, double *out, unsigned int r)
+{
+	base2Batch(1, start, n, out, r);
+}
+
+int sampler_t::addDimension(qmcSequence_t seq, unsigned int param)
+{
+	dims.push_back(std::make_pair(seq, param));
+	return (int)dims.size() - 1;
+}
+
+void sampler_t::generate(unsigned int start, int n)
+{
+	first = start;
+	size = n;
+	values.resize(dims.size() * n);
+	for(unsigned int d=0; d<dims.size(); ++d)
+	{
+		double *out = &values[d*n];
+		switch(dims[d].first)
+		{
+			case QMC_VDC: RI_vdCBatch(start, n, out, dims[d].second); break;
+			case QMC_SOBOL: RI_SBatch(start, n, out, dims[d].second); break;
+			case QMC_LP: RI_LPBatch(start, n, out, dims[d].second); break;
+			case QMC_HALTON: scrHaltonBatch(dims[d].second, start, n, out); break;
+		}
+	}
+}
+
+__END_YAFRAY
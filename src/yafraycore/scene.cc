@@ -32,6 +32,8 @@
 #include <yafraycore/timer.h>
 #include <yafraycore/scr_halton.h>
 #include <yafraycore/vmap.h>
+#include <yafraycore/texcache.h>
+#include <yafraycore/rendertrace.h>
 #include <utilities/mcqmc.h>
 #include <utilities/sample_utils.h>
 #include <iostream>
@@ -40,13 +42,14 @@
 __BEGIN_YAFRAY
 
 scene_t::scene_t(): camera(0), imageFilm(0), tree(0), vtree(0), background(0), surfIntegrator(0), volIntegrator(0),
-					AA_samples(1), AA_passes(1), AA_threshold(0.05), nthreads(1), mode(0), do_depth(false), signals(0),
+					AA_samples(1), AA_passes(1), AA_threshold(0.05), nthreads(1), seed(0), mode(0), do_depth(false), doVolumes(true), signals(0),
                     currentLightLayer(LIGHT_LAYER_DEFAULT)
 {
 	state.changes = C_ALL;
 	state.stack.push_front(READY);
 	state.nextFreeID = 1;
 	state.curObj = 0;
+	lightsChanged();
 }
 
 scene_t::~scene_t()
@@ -497,11 +500,23 @@ bool scene_t::addLight(light_t *l )
 	{
 		lights[currentLightLayer].push_back(l);
 		state.changes |= C_LIGHT;
+		lightsChanged();
 		return true;
 	}
 	return false;
 }
 
+// one lights version counter for all scenes, an integrator might be moved to another scene
+static yafthreads::mutex_t versionMutex;
+static unsigned int nextVersion = 0;
+
+void scene_t::lightsChanged()
+{
+	versionMutex.lock();
+	lightsVersion = ++nextVersion;
+	versionMutex.unlock();
+}
+
 void scene_t::setCurrentLightLayer( lightLayers layer )
 {
     currentLightLayer = layer;
@@ -600,8 +615,10 @@ bool scene_t::update()
 {
 	SILENT_UPDATE(std::cout << "scene mode:" << mode << std::endl;)
 	if(!camera || !imageFilm) return false;
+	double t0 = renderStats_t::clock();
 	if(state.changes & C_GEOM)
 	{
+		traceScope_t treeTrace("tree build");
 		if(tree) delete tree;
 		if(vtree) delete vtree;
 		tree = 0, vtree = 0;
@@ -667,6 +684,8 @@ bool scene_t::update()
 			}
 			else std::cout << "scene is empty...\n";
 		}
+		stats.setStageTime(RS_STAGE_TREE, renderStats_t::clock() - t0);
+		t0 = renderStats_t::clock();
 	}
 	for(unsigned int i=0; i<lights[currentLightLayer].size(); ++i) lights[currentLightLayer][i]->init(*this);
 	if(background)
@@ -675,16 +694,30 @@ bool scene_t::update()
 		if(bgl) bgl->init(*this);
 	}
 	if(!surfIntegrator || !volIntegrator){ std::cout << "no surface/volume integrator!\n"; return false; }
+	// lightmap scenes hardly ever have volumes, spare the integrators calling an integrator that does nothing
+	doVolumes = !(volumes.empty() && volIntegrator->regionsOnly());
 	//if(state.changes != C_NONE)
 	{
+		traceScope_t preprocessTrace("preprocess");
 		bool success = (surfIntegrator->preprocess() && volIntegrator->preprocess());
 		if(!success) return false;
 	}
+	stats.setStageTime(RS_STAGE_PREPROCESS, renderStats_t::clock() - t0);
 	state.changes = C_NONE;
 	return true;
 }
 
 bool scene_t::intersect(const ray_t &ray, surfacePoint_t &sp) const
+{
+	return intersect(ray, sp, 0);
+}
+
+bool scene_t::intersect(const renderState_t &state, const ray_t &ray, surfacePoint_t &sp) const
+{
+	return intersect(ray, sp, state.stats);
+}
+
+bool scene_t::intersect(const ray_t &ray, surfacePoint_t &sp, threadStats_t *counters) const
 {
 	PFLOAT dis, Z;
 	unsigned char udat[PRIM_DAT_SIZE];
@@ -695,7 +728,16 @@ bool scene_t::intersect(const ray_t &ray, surfacePoint_t &sp) const
 	{
 		if(!tree) return false;
 		triangle_t *hitt=0;
-		if( ! tree->Intersect(ray, dis, &hitt, Z, (void*)&udat[0]) ){ return false; }
+		bool hit;
+		if(counters)
+		{
+			unsigned int visited = 0;
+			hit = tree->Intersect(ray, dis, &hitt, Z, (void*)&udat[0], &visited);
+			counters->count[RS_RAYS] += 1.0;
+			counters->count[RS_KD_NODES] += visited;
+		}
+		else hit = tree->Intersect(ray, dis, &hitt, Z, (void*)&udat[0]);
+		if(!hit) return false;
 		point3d_t h=ray.from + Z*ray.dir;
 		hitt->getSurface(sp, h, (void*)&udat[0]);
 		sp.origin = hitt;
@@ -703,6 +745,7 @@ bool scene_t::intersect(const ray_t &ray, surfacePoint_t &sp) const
 	else
 	{
 		if(!vtree) return false;
+		if(counters) counters->count[RS_RAYS] += 1.0;
 		primitive_t *hitprim=0;
 		if( ! vtree->Intersect(ray, dis, &hitprim, Z, (void*)&udat[0]) ){ return false; }
 		point3d_t h=ray.from + Z*ray.dir;
@@ -726,12 +769,18 @@ bool scene_t::isShadowed(renderState_t &state, const ray_t &ray) const
 	{
 		triangle_t *hitt=0;
 		if(!tree) return false;
-		return tree->IntersectS(sray, dis, &hitt);
+		if(!state.stats) return tree->IntersectS(sray, dis, &hitt);
+		unsigned int visited = 0;
+		bool hit = tree->IntersectS(sray, dis, &hitt, &visited);
+		state.stats->count[RS_SHADOW_RAYS] += 1.0;
+		state.stats->count[RS_KD_NODES] += visited;
+		return hit;
 	}
 	else
 	{
 		primitive_t *hitt=0;
 		if(!vtree) return false;
+		state.count(RS_SHADOW_RAYS);
 		return vtree->IntersectS(sray, dis, &hitt);
 	}
 }
@@ -744,6 +793,7 @@ bool scene_t::isShadowed(renderState_t &state, const ray_t &ray, int maxDepth, c
 	if(ray.tmax<0)	dis=std::numeric_limits<PFLOAT>::infinity();
 	else  dis = sray.tmax - 2*sray.tmin;
 	filt = color_t(1.0);
+	state.count(RS_SHADOW_RAYS);
 	void *odat = state.userdata;
 	unsigned char userdata[USER_DATA_SIZE+7];
 	state.userdata = (void *)( ((size_t)&userdata[7])&(~7 ) ); // pad userdata to 8 bytes
@@ -751,7 +801,9 @@ bool scene_t::isShadowed(renderState_t &state, const ray_t &ray, int maxDepth, c
 	if(mode==0)
 	{
 		triangle_t *hitt=0;
-		if(tree) isect = tree->IntersectTS(state, sray, maxDepth, dis, &hitt, filt);
+		unsigned int visited = 0;
+		if(tree) isect = tree->IntersectTS(state, sray, maxDepth, dis, &hitt, filt, &visited);
+		state.count(RS_KD_NODES, visited);
 	}
 	else
 	{
@@ -768,6 +820,9 @@ bool scene_t::render()
 	sig_mutex.lock();
 	signals = 0;
 	sig_mutex.unlock();
+	// no texture lookups happen yet, so the cache may drop images to meet its budget
+	textureCache_t::instance().trim();
+	stats.reset(nthreads);
 	if(!update()) return false;
 	/* std::cout << "rendering "<<AA_passes<<" passes, min " << AA_samples << " samples, " << 
 				AA_inc_samples << " per additional pass (max "<<AA_samples + std::max(0,AA_passes-1)*AA_inc_samples<<" total)\n";
@@ -789,9 +844,15 @@ bool scene_t::render()
 	}
 	gTimer.stop("rendert");
 	std::cout << "overall rendertime: "<< gTimer.getTime("rendert")<<"s\n"; */
+	double t0 = renderStats_t::clock();
+	traceScope_t renderTrace("render");
 	bool success = surfIntegrator->render(imageFilm);
+	renderTrace.end();
+	stats.setStageTime(RS_STAGE_RENDER, renderStats_t::clock() - t0);
+	stats.aggregate();
 	surfIntegrator->cleanup();
 	imageFilm->flush();
+	renderTrace_t::instance().flush();
 	return success;
 }
 
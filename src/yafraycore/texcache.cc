@@ -0,0 +1,257 @@
+/****************************************************************************
+ * 			texcache.cc: process wide cache of decoded image files
+ *      This is part of the yafray package
+ *      Copyright (C) 2009 BioWare
+ *
+ *      This library is free software; you can redistribute it and/or
+ *      modify it under the terms of the GNU Lesser General Public
+ *      License as published by the Free Software Foundation; either
+ *      version 2.1 of the License, or (at your option) any later version.
+ *
+ *      This library is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *      Lesser General Public License for more details.
+ *
+ *      You should have received a copy of the GNU Lesser General Public
+ *      License along with this library; if not, write to the Free Software
+ *      Foundation,Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+#include <yafraycore/texcache.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+
+__BEGIN_YAFRAY
+
+//-----------------------------------------------------------------------------------------
+// cached image
+//-----------------------------------------------------------------------------------------
+
+cachedImage_t::cachedImage_t(textureCache_t *c, const std::string &filename, bool mip, long size, time_t mtime):
+	cache(c), file(filename), mipmap(mip), fileSize(size), fileTime(mtime), loader(0), uchar_img(0), float_img(0),
+	loaded(false), failed(false), bytes(0), refs(0), stamp(0)
+{}
+
+cachedImage_t::~cachedImage_t()
+{
+	delete uchar_img;
+	delete float_img;
+}
+
+void cachedImage_t::setBuffers(cBuffer_t *im, fcBuffer_t *f_im)
+{
+	if(im) uchar_img = new mipMap_t<unsigned char>(*im, mipmap);
+	if(f_im) float_img = new mipMap_t<float>(*f_im, mipmap);
+	delete im;
+	delete f_im;
+	bytes = 0;
+	if(uchar_img) bytes += uchar_img->memSize();
+	if(float_img) bytes += float_img->memSize();
+	// lookups read the pyramids without locking once they see loaded
+	yafthreads::memoryBarrier();
+	loaded = true;
+	cache->account(bytes);
+}
+
+void cachedImage_t::load()
+{
+	mutex.lock();
+	// another thread may have been faster
+	if(!loaded && !failed)
+	{
+		cBuffer_t *im = 0;
+		fcBuffer_t *f_im = 0;
+		std::cout << "textureCache: decoding " << file << std::endl;
+		if(!loader || !loader(file.c_str(), im, f_im) || (!im && !f_im))
+		{
+			std::cout << "textureCache: could not load image " << file << std::endl;
+			delete im;
+			delete f_im;
+			failed = true;
+		}
+		else setBuffers(im, f_im);
+	}
+	mutex.unlock();
+}
+
+//-----------------------------------------------------------------------------------------
+// texture cache
+//-----------------------------------------------------------------------------------------
+
+textureCache_t::textureCache_t(): budget(0), used(0), stamp(0), decodes(0), reuses(0) {}
+
+textureCache_t::~textureCache_t()
+{
+	std::map<key_t, cachedImage_t*>::iterator i;
+	for(i=images.begin(); i!=images.end(); ++i) delete i->second;
+}
+
+bool textureCache_t::key_t::operator<(const key_t &k) const
+{
+	if(file != k.file) return file < k.file;
+	if(mipmap != k.mipmap) return mipmap < k.mipmap;
+	if(size != k.size) return size < k.size;
+	return mtime < k.mtime;
+}
+
+textureCache_t::key_t textureCache_t::fileKey(const std::string &filename, bool mipmap)
+{
+	struct stat st;
+	if(stat(filename.c_str(), &st) != 0) return key_t(filename, mipmap, -1, 0);
+	return key_t(filename, mipmap, (long)st.st_size, st.st_mtime);
+}
+
+void textureCache_t::dropStale(const key_t &key, std::vector<cachedImage_t*> &dropped)
+{
+	// entries of the same file are adjacent, older versions nobody references are of no use any more
+	std::map<key_t, cachedImage_t*>::iterator i = images.lower_bound(key_t(key.file, false, -1, 0));
+	while(i != images.end() && i->first.file == key.file)
+	{
+		cachedImage_t *img = i->second;
+		if(img->refs <= 0 && img->mipmap == key.mipmap && (img->fileSize != key.size || img->fileTime != key.mtime))
+		{
+			used -= img->bytes;
+			dropped.push_back(img);
+			images.erase(i++);
+		}
+		else ++i;
+	}
+}
+
+textureCache_t& textureCache_t::instance()
+{
+	static textureCache_t cache;
+	return cache;
+}
+
+cachedImage_t* textureCache_t::acquire(const std::string &filename, bool mipmap, cachedImage_t::imageLoader_t *loader)
+{
+	key_t key = fileKey(filename, mipmap);
+	std::vector<cachedImage_t*> dropped;
+	mutex.lock();
+	dropStale(key, dropped);
+	cachedImage_t *&img = images[key];
+	if(img) ++reuses;
+	else img = new cachedImage_t(this, filename, mipmap, key.size, key.mtime);
+	// the loader lives in a plugin, always keep the one of the latest caller
+	img->loader = loader;
+	++img->refs;
+	cachedImage_t *res = img;
+	mutex.unlock();
+	for(unsigned int k=0; k<dropped.size(); ++k) delete dropped[k];
+	return res;
+}
+
+cachedImage_t* textureCache_t::insert(const std::string &filename, bool mipmap, cBuffer_t *im, fcBuffer_t *f_im)
+{
+	key_t key = fileKey(filename, mipmap);
+	std::vector<cachedImage_t*> dropped;
+	mutex.lock();
+	dropStale(key, dropped);
+	cachedImage_t *&img = images[key];
+	if(!img) img = new cachedImage_t(this, filename, mipmap, key.size, key.mtime);
+	else ++reuses;
+	++img->refs;
+	cachedImage_t *res = img;
+	mutex.unlock();
+	for(unsigned int k=0; k<dropped.size(); ++k) delete dropped[k];
+	// account() locks the cache again
+	res->mutex.lock();
+	if(!res->loaded)
+	{
+		res->failed = false;
+		res->setBuffers(im, f_im);
+	}
+	else { delete im; delete f_im; }
+	res->mutex.unlock();
+	return res;
+}
+
+void textureCache_t::release(cachedImage_t *img)
+{
+	if(!img) return;
+	mutex.lock();
+	if(--img->refs <= 0 && budget == 0)
+	{
+		images.erase(keyOf(img));
+		used -= img->bytes;
+		delete img;
+	}
+	mutex.unlock();
+}
+
+void textureCache_t::setBudget(size_t bytes)
+{
+	mutex.lock();
+	budget = bytes;
+	std::vector<cachedImage_t*> dropped;
+	if(budget == 0)
+	{
+		// nothing gets kept for reuse without a budget
+		std::map<key_t, cachedImage_t*>::iterator i = images.begin();
+		while(i != images.end())
+		{
+			if(i->second->refs <= 0)
+			{
+				used -= i->second->bytes;
+				dropped.push_back(i->second);
+				images.erase(i++);
+			}
+			else ++i;
+		}
+	}
+	mutex.unlock();
+	for(unsigned int k=0; k<dropped.size(); ++k) delete dropped[k];
+}
+
+void textureCache_t::account(long delta)
+{
+	mutex.lock();
+	used += delta;
+	if(delta > 0) ++decodes;
+	mutex.unlock();
+}
+
+bool textureCache_t::lruLess(const cachedImage_t *a, const cachedImage_t *b)
+{
+	return a->stamp < b->stamp;
+}
+
+void textureCache_t::trim()
+{
+	mutex.lock();
+	++stamp;
+	if(budget == 0 || used <= budget)
+	{
+		mutex.unlock();
+		return;
+	}
+	// referenced images may be looked up by a render running on another thread, keep them
+	std::vector<cachedImage_t*> order;
+	std::map<key_t, cachedImage_t*>::iterator i;
+	for(i=images.begin(); i!=images.end(); ++i)
+	{
+		if(i->second->refs <= 0) order.push_back(i->second);
+	}
+	std::sort(order.begin(), order.end(), lruLess);
+	int evicted = 0;
+	std::vector<cachedImage_t*> dropped;
+	for(unsigned int k=0; k<order.size() && used > budget; ++k)
+	{
+		cachedImage_t *img = order[k];
+		images.erase(keyOf(img));
+		used -= img->bytes;
+		dropped.push_back(img);
+		++evicted;
+	}
+	mutex.unlock();
+	for(unsigned int k=0; k<dropped.size(); ++k) delete dropped[k];
+	std::cout << "textureCache: evicted " << evicted << " images, " << (used >> 20) << " of "
+		<< (budget >> 20) << "MB in use (" << decodes << " decodes, " << reuses << " shared)\n";
+}
+
+__END_YAFRAY
@@ -1,5 +1,6 @@
 
 #include <yafraycore/tga_io.h>
+#include <yafraycore/rendertrace.h>
 #include <utilities/buffer.h>
 #include <iostream>
 #include <stdio.h>
@@ -45,8 +46,8 @@ bool outTga_t::putPixel(int x, int y, const float *c, int channels)
 	pix[0]= (c[0]<0.f) ? 0 : ((c[0]>=1.f) ? 255 : (unsigned char)(255.f*c[0]) );
 	pix[1]= (c[1]<0.f) ? 0 : ((c[1]>=1.f) ? 255 : (unsigned char)(255.f*c[1]) );
 	pix[2]= (c[2]<0.f) ? 0 : ((c[2]>=1.f) ? 255 : (unsigned char)(255.f*c[2]) );
-	if (save_alpha && channels > 4)
-		alpha_buf[yx] = (unsigned char)(255.0*((c[4]<0)?0:((c[4]>1)?1:c[4])));
+	if (save_alpha && channels > 3)
+		alpha_buf[yx] = (unsigned char)(255.0*((c[3]<0)?0:((c[3]>1)?1:c[3])));
 	return true;
 }
 
@@ -66,6 +67,7 @@ bool outTga_t::savetga(const char* filename)
 {
 	// name is assigned by default
 	//cout << "Saving Targa file as \"" << filename << "\": ";
+	traceScope_t writeTrace("tga write");
 
 	FILE* fp;
 	unsigned short w, h, x, y;
@@ -115,6 +117,85 @@ bool outTga_t::savetga(const char* filename)
 	}
 }
 
+outTgaStream_t::outTgaStream_t(int resx, int resy, const char *fname, bool sv_alpha):
+	save_alpha(sv_alpha), sizex(resx), sizey(resy), outfile(fname), fp(NULL)
+{
+	bpp = save_alpha ? 4 : 3;
+}
+
+bool outTgaStream_t::openFile()
+{
+	unsigned char btsdesc[2];
+	if (save_alpha) {
+		btsdesc[0] = 0x20; // 32 bits
+		btsdesc[1] = 0x28; // topleft / 8 bit alpha
+	}
+	else {
+		btsdesc[0] = 0x18; // 24 bits
+		btsdesc[1] = 0x20; // topleft / no alpha
+	}
+	fp = fopen(outfile.c_str(), "wb");
+	if (fp == NULL)
+	{
+		cout << "outTgaStream: could not open \"" << outfile << "\" for writing!\n";
+		return false;
+	}
+	fwrite(&TGAHDR, 12, 1, fp);
+	fputc(sizex, fp);
+	fputc(sizex>>8, fp);
+	fputc(sizey, fp);
+	fputc(sizey>>8, fp);
+	fwrite(&btsdesc, 2, 1, fp);
+	return true;
+}
+
+bool outTgaStream_t::putPixel(int x, int y, const float *c, int channels)
+{
+	std::vector<unsigned char> &row = rows[y];
+	if(row.empty()) row.resize(sizex*bpp, 0);
+	unsigned char *pix = &row[x*bpp];
+	// same conversion as outTga_t, already swapped to BGR
+	pix[2]= (c[0]<0.f) ? 0 : ((c[0]>=1.f) ? 255 : (unsigned char)(255.f*c[0]) );
+	pix[1]= (c[1]<0.f) ? 0 : ((c[1]>=1.f) ? 255 : (unsigned char)(255.f*c[1]) );
+	pix[0]= (c[2]<0.f) ? 0 : ((c[2]>=1.f) ? 255 : (unsigned char)(255.f*c[2]) );
+	if (save_alpha && channels > 3)
+		pix[3] = (unsigned char)(255.0*((c[3]<0)?0:((c[3]>1)?1:c[3])));
+	return true;
+}
+
+void outTgaStream_t::flushArea(int x0, int y0, int x1, int y1)
+{
+	if(!fp && !openFile()) return;
+	for(int y=y0; y<y1; ++y)
+	{
+		std::map<int, std::vector<unsigned char> >::iterator row = rows.find(y);
+		if(row == rows.end()) continue;
+		fseek(fp, 18 + (y*sizex + x0)*bpp, SEEK_SET);
+		fwrite(&row->second[x0*bpp], bpp, x1-x0, fp);
+		// partially written rows are kept, they get written again with the rest
+		if(x0 == 0 && x1 == sizex) rows.erase(row);
+	}
+}
+
+void outTgaStream_t::flush()
+{
+	if(rows.empty() && !fp) return;
+	traceScope_t writeTrace("tga write");
+	if(!rows.empty()) flushArea(0, rows.begin()->first, sizex, rows.rbegin()->first + 1);
+	if(!fp) return;
+	// write targa 2.0 footer behind the pixel data, also pads rows that never got written:
+	fseek(fp, 18 + sizex*sizey*bpp, SEEK_SET);
+	for(int i=0; i<8; ++i) fputc(0, fp);
+	for(int i=0; i<18; ++i) fputc(TGA_FOOTER[i], fp);
+	fclose(fp);
+	fp = NULL;
+}
+
+outTgaStream_t::~outTgaStream_t()
+{
+	flush();
+}
+
 /*=============================================================
 /  TGA loading code
 =============================================================*/
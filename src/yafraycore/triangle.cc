@@ -18,7 +18,7 @@ void triangle_t::getSurface(surfacePoint_t &sp, const point3d_t &hit, void *user
 	PFLOAT u=1.0 - v - w;
 	if(mesh->is_smooth)
 	{
-		vector3d_t va(na>0? mesh->normals[na] : normal), vb(nb>0? mesh->normals[nb] : normal), vc(nc>0? mesh->normals[nc] : normal);
+		vector3d_t va(na>=0? mesh->normals[na] : normal), vb(nb>=0? mesh->normals[nb] : normal), vc(nc>=0? mesh->normals[nc] : normal);
 		sp.N = u*va + v*vb + w*vc;
 		sp.N.normalize();
 	}
@@ -196,7 +196,7 @@ void vTriangle_t::getSurface(surfacePoint_t &sp, const point3d_t &hit, void *use
 	PFLOAT u=1.0 - v - w;
 	if(mesh->is_smooth)
 	{
-		vector3d_t va(na>0? mesh->normals[na] : normal), vb(nb>0? mesh->normals[nb] : normal), vc(nc>0? mesh->normals[nc] : normal);
+		vector3d_t va(na>=0? mesh->normals[na] : normal), vb(nb>=0? mesh->normals[nb] : normal), vc(nc>=0? mesh->normals[nc] : normal);
 		sp.N = u*va + v*vb + w*vc;
 		sp.N.normalize();
 	}
@@ -421,7 +421,7 @@ void bsTriangle_t::getSurface(surfacePoint_t &sp, const point3d_t &hit, void *us
 	//todo: calculate smoothed normal...
 	/* if(mesh->is_smooth)
 	{
-		vector3d_t va(na>0? mesh->normals[na] : normal), vb(nb>0? mesh->normals[nb] : normal), vc(nc>0? mesh->normals[nc] : normal);
+		vector3d_t va(na>=0? mesh->normals[na] : normal), vb(nb>=0? mesh->normals[nb] : normal), vc(nc>=0? mesh->normals[nc] : normal);
 		sp.N = u*va + v*vb + w*vc;
 		sp.N.normalize();
 	}